@@ -52,6 +52,17 @@
 // require "KEYWORD" on undefined identifiers, keep it comented out unless needed
 // #define CMS_STRICT_CGATS  1
 
+// Uncomment this line if your compiler or platform cannot query the CPU by using cpuid.
+// Only generic kernels would then be used
+// #define CMS_DONT_USE_CPUID  1
+
+// Uncomment this line if your compiler cannot build SSE2 intrinsics. Those kernels are only built where the compiler
+// targets SSE2 anyway, as on x86-64
+// #define CMS_DONT_USE_SSE2  1
+
+// Uncomment this line if your platform has no pthreads (or Windows threads). Parallel functions would then run serially
+// #define CMS_NO_PTHREADS  1
+
 // ********** End of configuration toggles ******************************
 
 // Needed for streams
@@ -487,6 +498,9 @@ typedef enum {
     cmsSigNamedColorElemType            = 0x6E636C20,  // 'ncl '
     cmsSigLabV2toV4                     = 0x32203420,  // '2 4 '
     cmsSigLabV4toV2                     = 0x34203220,  // '4 2 '
+    cmsSigAdaptiveCLutElemType          = 0x61636C74,  // 'aclt'
+    cmsSigCAM02ForwardElemType          = 0x63616D66,  // 'camf'
+    cmsSigCAM02ReverseElemType          = 0x63616D72,  // 'camr'
 
     // Identities
     cmsSigIdentityElemType              = 0x69646E20   // 'idn '
@@ -734,7 +748,7 @@ typedef void* cmsHTRANSFORM;
 #define TYPE_BGRA_8            (COLORSPACE_SH(PT_RGB)|EXTRA_SH(1)|CHANNELS_SH(3)|BYTES_SH(1)|DOSWAP_SH(1)|SWAPFIRST_SH(1))
 #define TYPE_BGRA_8_PLANAR     (COLORSPACE_SH(PT_RGB)|EXTRA_SH(1)|CHANNELS_SH(3)|BYTES_SH(1)|DOSWAP_SH(1)|SWAPFIRST_SH(1)|PLANAR_SH(1))
 #define TYPE_BGRA_16           (COLORSPACE_SH(PT_RGB)|EXTRA_SH(1)|CHANNELS_SH(3)|BYTES_SH(2)|DOSWAP_SH(1)|SWAPFIRST_SH(1))
-#define TYPE_BGRA_16_SE        (COLORSPACE_SH(PT_RGB)|EXTRA_SH(1)|CHANNELS_SH(3)|BYTES_SH(2)|ENDIAN16_SH(1)|SWAPFIRST_SH(1))
+#define TYPE_BGRA_16_SE        (COLORSPACE_SH(PT_RGB)|EXTRA_SH(1)|CHANNELS_SH(3)|BYTES_SH(2)|ENDIAN16_SH(1)|DOSWAP_SH(1)|SWAPFIRST_SH(1))
 
 #define TYPE_CMY_8             (COLORSPACE_SH(PT_CMY)|CHANNELS_SH(3)|BYTES_SH(1))
 #define TYPE_CMY_8_PLANAR      (COLORSPACE_SH(PT_CMY)|CHANNELS_SH(3)|BYTES_SH(1)|PLANAR_SH(1))
@@ -986,6 +1000,9 @@ CMSAPI void              CMSEXPORT cmsUnregisterPlugins(void);
 #define cmsERROR_BAD_SIGNATURE                11
 #define cmsERROR_CORRUPTION_DETECTED          12
 #define cmsERROR_NOT_SUITABLE                 13
+#define cmsERROR_RESOURCE_LIMIT               14
+
+#define cmsMAX_ERROR_CODES                    32
 
 // Error logger is called with the ContextID when a message is raised. This gives the
 // chance to know which thread is responsible of the warning and any environment associated
@@ -996,6 +1013,46 @@ typedef void  (* cmsLogErrorHandlerFunction)(cmsContext ContextID, cmsUInt32Numb
 // Allows user to set any specific logger
 CMSAPI void              CMSEXPORT cmsSetLogErrorHandler(cmsLogErrorHandlerFunction Fn);
 
+// Messages are only formatted when a logger has been set. At most MaxPerSecond messages of each code reach the logger on
+// each second, zero meaning no limit, which is the default. Returns the previous limit
+CMSAPI cmsUInt32Number   CMSEXPORT cmsSetLogErrorRateLimit(cmsUInt32Number MaxPerSecond);
+
+// Number of errors signaled with each code, whatever the logger did with them. Codes from cmsMAX_ERROR_CODES on are
+// counted as cmsERROR_UNDEFINED
+CMSAPI cmsUInt32Number   CMSEXPORT cmsGetErrorCount(cmsUInt32Number ErrorCode);
+CMSAPI void              CMSEXPORT cmsResetErrorCounts(void);
+
+// Resource limits ----------------------------------------------------------------------------------------------------
+
+// Guards against profiles asking for huge tables or long chains. Zero means no limit, which is the default.
+// Note the library itself builds curves of up to 16385 entries and CLUTs of up to 255 nodes by side when optimizing
+typedef struct {
+    cmsUInt32Number MaxCLUTEntries;         // Entries (nodes by outputs) on a single CLUT
+    cmsUInt32Number MaxTableBytes;          // Bytes of CLUT and curve tables, on a single table and on a whole pipeline
+    cmsUInt32Number MaxCurveEntries;        // Entries on a single curve, tabulated or sampled segment
+    cmsUInt32Number MaxPipelineStages;      // Stages on a single pipeline
+    cmsUInt32Number MaxSamplerEvaluations;  // Evaluations done when sampling a CLUT or slicing a space
+
+} cmsResourceLimits;
+
+// NULL removes all limits
+CMSAPI void              CMSEXPORT cmsSetResourceLimits(const cmsResourceLimits* Limits);
+CMSAPI void              CMSEXPORT cmsGetResourceLimits(cmsResourceLimits* Limits);
+
+// Precision policy ---------------------------------------------------------------------------------------------------
+
+// Fast precision trades accuracy for speed on all the paths below at once. Exact is the default. Budgets in fast mode:
+//   Transforms optimized by resampling take the grid of cmsFLAGS_LOWRESPRECALC, unless the grid is given in dwFlags.
+//   On sRGB to Lab it stays below 1 dE max and 0.1 dE mean.
+//   atan2 on CIECAM02 hue angles: absolute error below 1E-5 radians
+// The policy is global, but it is only read when transforms and CIECAM02 models are created. They keep it for life,
+// so changing it later does not affect them. 
+#define cmsPRECISION_EXACT      0
+#define cmsPRECISION_FAST       1
+
+// Returns the previous policy. Negative values just query the current one
+CMSAPI cmsInt32Number    CMSEXPORT cmsSetPrecisionPolicy(cmsInt32Number Policy);
+
 // Conversions --------------------------------------------------------------------------------------------------------------
 
 // Returns pointers to constant structs
@@ -1181,6 +1238,16 @@ typedef cmsInt32Number (* cmsSAMPLERFLOAT)(register const cmsFloat32Number In[],
 CMSAPI cmsBool           CMSEXPORT cmsStageSampleCLut16bit(cmsStage* mpe,    cmsSAMPLER16 Sampler, void* Cargo, cmsUInt32Number dwFlags);
 CMSAPI cmsBool           CMSEXPORT cmsStageSampleCLutFloat(cmsStage* mpe, cmsSAMPLERFLOAT Sampler, void* Cargo, cmsUInt32Number dwFlags);
 
+// Adaptive CLUT, cells whose error exceeds Tolerance (in 16-bit units) are subdivided nRefine times by side. 3 inputs only.
+CMSAPI cmsStage*         CMSEXPORT cmsStageAllocCLutAdaptive16bit(cmsContext ContextID, cmsUInt32Number nGridPoints, cmsUInt32Number nRefine, 
+                                                                  cmsUInt32Number inputChan, cmsUInt32Number outputChan, cmsFloat64Number Tolerance,
+                                                                  cmsSAMPLER16 Sampler, void* Cargo);
+
+// CIECAM02 as pipeline stages, so appearance operations can be optimized in transforms. XYZ uses the PCS float
+// encoding and JCh is encoded as J/100, C/100 and h/360
+CMSAPI cmsStage*         CMSEXPORT cmsStageAllocCIECAM02Forward(cmsContext ContextID, const cmsViewingConditions* pVC);
+CMSAPI cmsStage*         CMSEXPORT cmsStageAllocCIECAM02Reverse(cmsContext ContextID, const cmsViewingConditions* pVC);
+
 // Slicers
 CMSAPI cmsBool           CMSEXPORT cmsSliceSpace16(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
                                                    cmsSAMPLER16 Sampler, void * Cargo);
@@ -1188,6 +1255,20 @@ CMSAPI cmsBool           CMSEXPORT cmsSliceSpace16(cmsUInt32Number nInputs, cons
 CMSAPI cmsBool           CMSEXPORT cmsSliceSpaceFloat(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
                                                    cmsSAMPLERFLOAT Sampler, void * Cargo);
 
+// Parallel slicers. The lattice is split in nThreads contiguous runs of nodes, and the i-th thread samples the i-th run
+// with ThreadCargo[i], or with Cargo when ThreadCargo is NULL (samplers have then to be re-entrant). Once all threads
+// are done, Reduce, if given, is called with Cargo and each ThreadCargo in thread order, so results are combined the
+// same way on every run. nThreads = 0 means one thread per processor, and is only valid without ThreadCargo.
+typedef cmsBool (* cmsSLICEREDUCE)(void* Cargo, void* ThreadCargo);
+
+CMSAPI cmsBool           CMSEXPORT cmsSliceSpace16Parallel(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                                   cmsSAMPLER16 Sampler, void* Cargo,
+                                                   cmsUInt32Number nThreads, void* ThreadCargo[], cmsSLICEREDUCE Reduce);
+
+CMSAPI cmsBool           CMSEXPORT cmsSliceSpaceFloatParallel(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                                   cmsSAMPLERFLOAT Sampler, void* Cargo,
+                                                   cmsUInt32Number nThreads, void* ThreadCargo[], cmsSLICEREDUCE Reduce);
+
 // Multilocalized Unicode management ---------------------------------------------------------------------------------------
 
 typedef struct _cms_MLU_struct cmsMLU;
@@ -1285,6 +1366,23 @@ CMSAPI cmsBool            CMSEXPORT cmsNamedColorInfo(const cmsNAMEDCOLORLIST* N
 // Retrieve named color list from transform
 CMSAPI cmsNAMEDCOLORLIST* CMSEXPORT cmsGetNamedColorList(cmsHTRANSFORM xform);
 
+// Nearest named colors to a Lab value. The query is taken as the reference color of the metric. Results are sorted by
+// ascending difference, ties by ascending index. Batch searches return exactly k results per query; DeltaE may be NULL
+#define cmsDELTAE_76            0
+#define cmsDELTAE_CIE94         1
+#define cmsDELTAE_CMC_1_1       2
+#define cmsDELTAE_CMC_2_1       3
+#define cmsDELTAE_2000          4
+
+CMSAPI cmsHANDLE          CMSEXPORT cmsNamedColorSearchAlloc(const cmsNAMEDCOLORLIST* NamedColorList);
+CMSAPI void               CMSEXPORT cmsNamedColorSearchFree(cmsHANDLE hSearch);
+CMSAPI cmsUInt32Number    CMSEXPORT cmsNamedColorNearest(cmsHANDLE hSearch, const cmsCIELab* Lab, cmsUInt32Number Metric,
+                                                         cmsUInt32Number k, cmsUInt32Number Indexes[], cmsFloat64Number DeltaE[]);
+CMSAPI cmsBool            CMSEXPORT cmsNamedColorNearestBatch(cmsHANDLE hSearch, const cmsCIELab Lab[], cmsUInt32Number n,
+                                                              cmsUInt32Number Metric, cmsUInt32Number k,
+                                                              cmsUInt32Number Indexes[], cmsFloat64Number DeltaE[],
+                                                              cmsUInt32Number nThreads);
+
 // Profile sequence -----------------------------------------------------------------------------------------------------
 
 // Profile sequence descriptor. Some fields come from profile sequence descriptor tag, others
@@ -1439,6 +1537,34 @@ CMSAPI cmsBool           CMSEXPORT cmsCloseIOhandler(cmsIOHANDLER* io);
 
 CMSAPI cmsBool           CMSEXPORT cmsMD5computeID(cmsHPROFILE hProfile);
 
+// Profile validation ---------------------------------------------------------------------------------------------------
+
+// Areas where problems were found
+#define cmsVALIDATE_HEADER      0x0001      // Truncated file, wrong size or version
+#define cmsVALIDATE_TAGTABLE    0x0002      // Tags out of bounds, overlapping or misaligned
+#define cmsVALIDATE_DECODE      0x0004      // Tags that cannot be decoded by their type handler
+#define cmsVALIDATE_CURVES      0x0008      // Curves evaluating to non-finite or non monotonic values
+#define cmsVALIDATE_MATRIX      0x0010      // Singular or non-finite colorant matrix
+#define cmsVALIDATE_CLUT        0x0020      // Pipelines with wrong channel count or non-finite outputs
+#define cmsVALIDATE_ID          0x0040      // Profile ID does not match the contents
+
+typedef struct {
+
+    cmsUInt32Number nTags;          // Tags in the directory
+    cmsUInt32Number nErrors;
+    cmsUInt32Number nWarnings;
+    cmsUInt32Number Failed;         // cmsVALIDATE_* of the areas with errors
+    char            FirstError[256];
+
+} cmsProfileValidation;
+
+// Decodes every tag and checks the profile for consistency. Returns TRUE if no errors were found. FailFast stops on
+// the first error. The profile should have been open for reading, and should not be in use by other threads.
+CMSAPI cmsBool           CMSEXPORT cmsValidateProfile(cmsHPROFILE hProfile, cmsBool FailFast, cmsProfileValidation* Report);
+
+// Same, on the bytes of a profile, as a memory mapped file. Those are read in place and should not change meanwhile
+CMSAPI cmsBool           CMSEXPORT cmsValidateProfileMem(cmsContext ContextID, const void* MemPtr, cmsUInt32Number dwSize, cmsBool FailFast, cmsProfileValidation* Report);
+
 // Profile high level funtions ------------------------------------------------------------------------------------------
 
 CMSAPI cmsHPROFILE      CMSEXPORT cmsOpenProfileFromFile(const char *ICCProfile, const char *sAccess);
@@ -1450,6 +1576,14 @@ CMSAPI cmsHPROFILE      CMSEXPORT cmsOpenProfileFromMemTHR(cmsContext ContextID,
 CMSAPI cmsHPROFILE      CMSEXPORT cmsOpenProfileFromIOhandlerTHR(cmsContext ContextID, cmsIOHANDLER* io);
 CMSAPI cmsBool          CMSEXPORT cmsCloseProfile(cmsHPROFILE hProfile);
 
+// Profile handles are reference counted. cmsCloseProfile releases one reference and frees on the last one
+CMSAPI cmsHPROFILE      CMSEXPORT cmsRetainProfile(cmsHPROFILE hProfile);
+
+// Frozen profiles have all tags in memory and are read only, so cmsReadTag may be called from several threads at once.
+// They also keep black points and matrix-shaper pipelines once worked out, for the next transform built out of them
+CMSAPI cmsBool          CMSEXPORT cmsFreezeProfile(cmsHPROFILE hProfile);
+CMSAPI cmsBool          CMSEXPORT cmsIsProfileFrozen(cmsHPROFILE hProfile);
+
 CMSAPI cmsBool          CMSEXPORT cmsSaveProfileToFile(cmsHPROFILE hProfile, const char* FileName);
 CMSAPI cmsBool          CMSEXPORT cmsSaveProfileToStream(cmsHPROFILE hProfile, FILE* Stream);
 CMSAPI cmsBool          CMSEXPORT cmsSaveProfileToMem(cmsHPROFILE hProfile, void *MemPtr, cmsUInt32Number* BytesNeeded);
@@ -1564,6 +1698,7 @@ CMSAPI cmsUInt32Number  CMSEXPORT cmsGetSupportedIntents(cmsUInt32Number nMax, c
 #define cmsFLAGS_FORCE_CLUT               0x0002    // Force CLUT optimization
 #define cmsFLAGS_CLUT_POST_LINEARIZATION  0x0001    // create postlinearization tables if possible
 #define cmsFLAGS_CLUT_PRE_LINEARIZATION   0x0010    // create prelinearization tables if possible
+#define cmsFLAGS_ADAPTIVE_CLUT            0x04000000 // Refine the CLUT only where needed (3 inputs)
 
 // Fine-tune control over number of gridpoints
 #define cmsFLAGS_GRIDPOINTS(n)           (((n) & 0xFF) << 16)
@@ -1571,6 +1706,10 @@ CMSAPI cmsUInt32Number  CMSEXPORT cmsGetSupportedIntents(cmsUInt32Number nMax, c
 // CRD special
 #define cmsFLAGS_NODEFAULTRESOURCEDEF     0x01000000
 
+// Encoding of CLUT strings in CSA and CRD, hexadecimal if none is given
+#define cmsFLAGS_PS_ASCII85               0x08000000 // ASCII85, PostScript level 2
+#define cmsFLAGS_PS_BINARY                0x10000000 // Binary tokens, for 8-bit clean channels only
+
 // Transforms ---------------------------------------------------------------------------------------------------
 
 CMSAPI cmsHTRANSFORM    CMSEXPORT cmsCreateTransformTHR(cmsContext ContextID,
@@ -1648,6 +1787,54 @@ CMSAPI void             CMSEXPORT cmsDoTransformStride(cmsHTRANSFORM Transform,
                                                  cmsUInt32Number Size,
                                                  cmsUInt32Number Stride);
 
+// Sparse transforms. Only the selected pixels are transformed, the rest of OutputBuffer is left untouched. Buffers are laid
+// out as in cmsDoTransformStride. Pixels are selected either by a list of indexes, in any order, or by a mask having one
+// entry per pixel: MaskBits 8 means a byte per pixel, non-zero if selected, and MaskBits 1 a bit per pixel, most
+// significant bit first. Formats must be known, that is, not zero.
+CMSAPI cmsBool          CMSEXPORT cmsDoTransformIndexed(cmsHTRANSFORM Transform,
+                                                 const void * InputBuffer,
+                                                 void * OutputBuffer,
+                                                 const cmsUInt32Number Indexes[],
+                                                 cmsUInt32Number nIndexes,
+                                                 cmsUInt32Number Stride);
+
+CMSAPI cmsBool          CMSEXPORT cmsDoTransformMasked(cmsHTRANSFORM Transform,
+                                                 const void * InputBuffer,
+                                                 void * OutputBuffer,
+                                                 const cmsUInt8Number Mask[],
+                                                 cmsUInt32Number MaskBits,
+                                                 cmsUInt32Number Size,
+                                                 cmsUInt32Number Stride);
+
+// Palette transforms, for indexed color outputs. Colors are transformed and then mapped to the index of the nearest palette
+// entry, in output device space. The transform must use 8 or 16 bits formats and should be kept while the map is in use.
+// Palette entries are laid out in the output format of the transform. Indexes are stored as bytes on palettes of 256
+// entries or less, and as 16 bits words otherwise. Conversion is split among nThreads, 0 meaning one per processor.
+CMSAPI cmsHANDLE        CMSEXPORT cmsPaletteMapAlloc(cmsHTRANSFORM Transform, const void* Palette, cmsUInt32Number nEntries);
+CMSAPI void             CMSEXPORT cmsPaletteMapFree(cmsHANDLE hMap);
+CMSAPI cmsBool          CMSEXPORT cmsDoTransformToPalette(cmsHANDLE hMap,
+                                                 const void * InputBuffer,
+                                                 void * IndexBuffer,
+                                                 cmsUInt32Number Size,
+                                                 cmsUInt32Number Stride,
+                                                 cmsUInt32Number nThreads);
+
+// Vectored transforms, for many buffers at once. Each buffer is laid out as in cmsDoTransformStride. Buffers are processed
+// back to back and split among nThreads threads, 0 meaning one per processor. Output buffers should not overlap.
+typedef struct {
+
+    const void*      InputBuffer;
+    void*            OutputBuffer;
+    cmsUInt32Number  Size;
+    cmsUInt32Number  Stride;
+
+} cmsTRANSFORMBUFFER;
+
+CMSAPI void             CMSEXPORT cmsDoTransformBuffers(cmsHTRANSFORM Transform,
+                                                 const cmsTRANSFORMBUFFER Buffers[],
+                                                 cmsUInt32Number nBuffers,
+                                                 cmsUInt32Number nThreads);
+
 
 CMSAPI void             CMSEXPORT cmsSetAlarmCodes(cmsUInt16Number NewAlarm[cmsMAXCHANNELS]);
 CMSAPI void             CMSEXPORT cmsGetAlarmCodes(cmsUInt16Number NewAlarm[cmsMAXCHANNELS]);
@@ -1655,6 +1842,34 @@ CMSAPI void             CMSEXPORT cmsGetAlarmCodes(cmsUInt16Number NewAlarm[cmsM
 // Adaptation state for absolute colorimetric intent
 CMSAPI cmsFloat64Number CMSEXPORT cmsSetAdaptationState(cmsFloat64Number d);
 
+// Tolerance, in 16-bit units, of CLUTs built with cmsFLAGS_ADAPTIVE_CLUT
+CMSAPI cmsFloat64Number CMSEXPORT cmsSetAdaptiveCLutTolerance(cmsFloat64Number Tolerance);
+
+// Max error (euclidean, outputs scaled to 0..100) to replace RGB to RGB CLUTs by a fitted matrix-shaper. Zero (the default)
+// disables it. Negative values just return the current setting
+CMSAPI cmsFloat64Number CMSEXPORT cmsSetMatrixShaperFitTolerance(cmsFloat64Number Tolerance);
+
+// Sharing of identical optimized tables across transforms. Tables of at least MinBytes are shared, zero (the default)
+// disables it. Negative values just return the current setting
+CMSAPI cmsInt32Number   CMSEXPORT cmsSetTableSharing(cmsInt32Number MinBytes);
+
+// Number of distinct tables being shared and, optionally, the bytes they take
+CMSAPI cmsUInt32Number  CMSEXPORT cmsGetSharedTableCount(cmsUInt32Number* Bytes);
+
+// CPU feature levels. Optimized kernels are selected for the highest level available when transforms are created
+#define cmsCPU_GENERIC      0
+#define cmsCPU_SSE2         1
+#define cmsCPU_SSE41        2
+#define cmsCPU_AVX2         3
+#define cmsCPU_AVX512       4
+
+// Level supported by the running CPU
+CMSAPI cmsInt32Number   CMSEXPORT cmsDetectCPUFeatureLevel(void);
+
+// Caps the level used to select kernels, mostly for testing. Negative values just return the current setting.
+// The initial cap may be given by LCMS2_CPU_LEVEL environment variable
+CMSAPI cmsInt32Number   CMSEXPORT cmsSetCPUFeatureLevel(cmsInt32Number Level);
+
 // Grab the ContextID from an open transform. Returns NULL if a NULL transform is passed
 CMSAPI cmsContext       CMSEXPORT cmsGetTransformContextID(cmsHTRANSFORM hTransform);
 
@@ -1667,6 +1882,49 @@ CMSAPI cmsBool          CMSEXPORT cmsChangeBuffersFormat(cmsHTRANSFORM hTransfor
                                                          cmsUInt32Number InputFormat, 
                                                          cmsUInt32Number OutputFormat);
 
+// Transform tables. Used to build a known set of transforms ahead of time and look them up by key later.
+// Entries may be built concurrently from several threads, as long as each entry is built by only one of them.
+// Lookups are read-only and may be done from any thread once the entries are built.
+
+typedef struct {
+    const char*      Key;               // Unique name to look up the transform
+    const char*      InputProfile;      // File name, or one of the built-ins *sRGB, *Lab, *Lab2, *Lab4 or *XYZ
+    const char*      OutputProfile;     // Same. NULL if input profile is a device link
+    cmsUInt32Number  InputFormat;
+    cmsUInt32Number  OutputFormat;
+    cmsUInt32Number  Intent;
+    cmsUInt32Number  dwFlags;
+
+} cmsTRANSFORMSPEC;
+
+CMSAPI cmsHANDLE        CMSEXPORT cmsTransformTableAlloc(cmsContext ContextID, const cmsTRANSFORMSPEC Specs[], cmsUInt32Number nSpecs);
+CMSAPI void             CMSEXPORT cmsTransformTableFree(cmsHANDLE hTable);
+CMSAPI cmsUInt32Number  CMSEXPORT cmsTransformTableCount(cmsHANDLE hTable);
+CMSAPI cmsBool          CMSEXPORT cmsTransformTableBuild(cmsHANDLE hTable, cmsUInt32Number n);
+CMSAPI cmsHTRANSFORM    CMSEXPORT cmsTransformTableLookup(cmsHANDLE hTable, const char* Key);
+
+// Transform bundles. Builds the transforms of one profile chain for several intent and flags variants at once, for
+// instance to switch intents or black point compensation on demand. The variants are built by nThreads threads, 0 meaning
+// one per processor, out of frozen profiles (see cmsFreezeProfile), so decoded tags, black points, adaptation matrices
+// and matrix-shaper segments are worked out once. Profiles not frozen yet are copied first and left untouched; freezing
+// them beforehand saves the copy and keeps what was worked out for later bundles. Transforms[] gets one handle per variant.
+
+typedef struct {
+    cmsUInt32Number  Intent;
+    cmsUInt32Number  dwFlags;
+
+} cmsTRANSFORMVARIANT;
+
+CMSAPI cmsBool          CMSEXPORT cmsCreateTransformBundleTHR(cmsContext ContextID,
+                                                  cmsHPROFILE hProfiles[],
+                                                  cmsUInt32Number nProfiles,
+                                                  cmsUInt32Number InputFormat,
+                                                  cmsUInt32Number OutputFormat,
+                                                  const cmsTRANSFORMVARIANT Variants[],
+                                                  cmsUInt32Number nVariants,
+                                                  cmsUInt32Number nThreads,
+                                                  cmsHTRANSFORM Transforms[]);
+
 
 
 // PostScript ColorRenderingDictionary and ColorSpaceArray ----------------------------------------------------
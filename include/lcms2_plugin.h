@@ -98,6 +98,12 @@ CMSAPI void               CMSEXPORT _cmsMAT3eval(cmsVEC3* r, const cmsMAT3* a, c
 
 CMSAPI void               CMSEXPORT  cmsSignalError(cmsContext ContextID, cmsUInt32Number ErrorCode, const char *ErrorText, ...);
 
+// Error filter. It gets the message before formatting, Args being the arguments of Format as in vsnprintf. Returning
+// FALSE drops the message, which is then neither formatted nor given to the logger.
+typedef cmsBool (* cmsErrorFilterFunction)(cmsContext ContextID, cmsUInt32Number ErrorCode, const char* Format, va_list Args);
+
+CMSAPI void               CMSEXPORT  cmsSetErrorFilter(cmsErrorFilterFunction Fn);
+
 // Memory management ----------------------------------------------------------------------------------
 
 CMSAPI void*              CMSEXPORT _cmsMalloc(cmsContext ContextID, cmsUInt32Number size);
@@ -107,6 +113,16 @@ CMSAPI void*              CMSEXPORT _cmsRealloc(cmsContext ContextID, void* Ptr,
 CMSAPI void               CMSEXPORT _cmsFree(cmsContext ContextID, void* Ptr);
 CMSAPI void*              CMSEXPORT _cmsDupMem(cmsContext ContextID, const void* Org, cmsUInt32Number size);
 
+// Threads --------------------------------------------------------------------------------------------
+
+// The library runner. Fn is called once for each of the nThreads cargo blocks, which are CargoSize bytes apart, and
+// the call returns when all are done. The first block runs on the calling thread. Without threads, or if they cannot
+// be created, the blocks just run serially, so results never depend on how many threads were actually used.
+typedef void (* _cmsThreadFn)(void* Cargo);
+
+CMSAPI cmsUInt32Number    CMSEXPORT _cmsGetProcessorCount(void);
+CMSAPI void               CMSEXPORT _cmsRunThreads(cmsContext ContextID, cmsUInt32Number nThreads, _cmsThreadFn Fn, void* Cargos, cmsUInt32Number CargoSize);
+
 // I/O handler ----------------------------------------------------------------------------------
 
 struct _cms_io_handler {
@@ -51,6 +51,7 @@ typedef struct  {
     cmsFloat64Number F, c, Nc;
     cmsUInt32Number surround;
     cmsFloat64Number n, Nbb, Ncb, z, FL, D;
+    cmsBool FastHue;            // Precision policy at the time the model was created
     
 	cmsContext ContextID;
 
@@ -186,13 +187,15 @@ CAM02COLOR ComputeCorrelates(CAM02COLOR clr, cmsCIECAM02* pMod)
     }
     else if (a > 0) {
         temp = b / a;
-        if (b > 0)       clr.h = (r2d * atan(temp));
+        temp = pMod ->FastHue ? _cmsArcTan2(temp, 1.0) : atan(temp);
+        if (b > 0)       clr.h = (r2d * temp);
         else if (b == 0) clr.h = 0;
-        else             clr.h = (r2d * atan(temp)) + 360;
+        else             clr.h = (r2d * temp) + 360;
     }
     else {
         temp = b / a;
-        clr.h = (r2d * atan(temp)) + 180;
+        temp = pMod ->FastHue ? _cmsArcTan2(temp, 1.0) : atan(temp);
+        clr.h = (r2d * temp) + 180;
     }
     
     d2r = (3.141592654 / 180.0);
@@ -367,6 +370,7 @@ cmsHANDLE  CMSEXPORT cmsCIECAM02Init(cmsContext ContextID, const cmsViewingCondi
 	}
 
 	lpMod ->ContextID = ContextID;
+	lpMod ->FastHue   = (cmsSetPrecisionPolicy(-1) == cmsPRECISION_FAST);
 
 	lpMod ->adoptedWhite.XYZ[0] = pVC ->whitePoint.X;
 	lpMod ->adoptedWhite.XYZ[1] = pVC ->whitePoint.Y;
@@ -481,3 +485,139 @@ void CMSEXPORT cmsCIECAM02Reverse(cmsHANDLE hModel, const cmsJCh* pIn, cmsCIEXYZ
     pOut ->Z = clr.XYZ[2];
 }
 
+
+
+// CIECAM02 as pipeline stages -------------------------------------------------------------------------------------
+
+// XYZ comes in the PCS float encoding and is scaled to 0..100 as the model expects. JCh is encoded 
+// as J/100, C/100 and h/360, so J and h are on 0..1 range.
+
+typedef struct {
+
+    cmsViewingConditions vc;    // Kept to rebuild the model on duplication
+    cmsHANDLE hModel;
+
+} CAM02StageData;
+
+
+static
+void EvaluateCAM02Forward(const cmsFloat32Number In[], cmsFloat32Number Out[], const cmsStage *mpe)
+{
+    CAM02StageData* Data = (CAM02StageData*) mpe ->Data;
+    cmsCIEXYZ XYZ;
+    cmsJCh JCh;
+
+    XYZ.X = In[0] * MAX_ENCODEABLE_XYZ * 100.0;
+    XYZ.Y = In[1] * MAX_ENCODEABLE_XYZ * 100.0;
+    XYZ.Z = In[2] * MAX_ENCODEABLE_XYZ * 100.0;
+
+    cmsCIECAM02Forward(Data ->hModel, &XYZ, &JCh);
+
+    Out[0] = (cmsFloat32Number) (JCh.J / 100.0);
+    Out[1] = (cmsFloat32Number) (JCh.C / 100.0);
+    Out[2] = (cmsFloat32Number) (JCh.h / 360.0);
+}
+
+
+static
+void EvaluateCAM02Reverse(const cmsFloat32Number In[], cmsFloat32Number Out[], const cmsStage *mpe)
+{
+    CAM02StageData* Data = (CAM02StageData*) mpe ->Data;
+    cmsCIEXYZ XYZ;
+    cmsJCh JCh;
+
+    JCh.J = In[0] * 100.0;
+    JCh.C = In[1] * 100.0;
+    JCh.h = In[2] * 360.0;
+
+    // The model is undefined on zero lightness
+    if (JCh.J <= 0) {
+        Out[0] = Out[1] = Out[2] = 0;
+        return;
+    }
+
+    if (JCh.C < 0) JCh.C = 0;
+
+    cmsCIECAM02Reverse(Data ->hModel, &JCh, &XYZ);
+
+    Out[0] = (cmsFloat32Number) (XYZ.X / (MAX_ENCODEABLE_XYZ * 100.0));
+    Out[1] = (cmsFloat32Number) (XYZ.Y / (MAX_ENCODEABLE_XYZ * 100.0));
+    Out[2] = (cmsFloat32Number) (XYZ.Z / (MAX_ENCODEABLE_XYZ * 100.0));
+}
+
+
+static
+void CAM02StageFree(cmsStage* mpe)
+{
+    CAM02StageData* Data = (CAM02StageData*) mpe ->Data;
+
+    if (Data ->hModel) cmsCIECAM02Done(Data ->hModel);
+    _cmsFree(mpe ->ContextID, Data);
+}
+
+
+static
+void* CAM02StageDup(cmsStage* mpe)
+{
+    CAM02StageData* Data = (CAM02StageData*) mpe ->Data;
+    CAM02StageData* NewElem;
+
+    NewElem = (CAM02StageData*) _cmsMallocZero(mpe ->ContextID, sizeof(CAM02StageData));
+    if (NewElem == NULL) return NULL;
+
+    NewElem ->vc = Data ->vc;
+    NewElem ->hModel = cmsCIECAM02Init(mpe ->ContextID, &NewElem ->vc);
+
+    if (NewElem ->hModel == NULL) {
+        _cmsFree(mpe ->ContextID, NewElem);
+        return NULL;
+    }
+
+    // The copy keeps the precision policy of the original, not the current one
+    ((cmsCIECAM02*) NewElem ->hModel) ->FastHue = ((cmsCIECAM02*) Data ->hModel) ->FastHue;
+
+    return (void*) NewElem;
+}
+
+
+static
+cmsStage* AllocCAM02Stage(cmsContext ContextID, const cmsViewingConditions* pVC, cmsStageSignature Type, _cmsStageEvalFn EvalPtr)
+{
+    CAM02StageData* Data;
+    cmsStage* mpe;
+
+    _cmsAssert(pVC != NULL);
+
+    Data = (CAM02StageData*) _cmsMallocZero(ContextID, sizeof(CAM02StageData));
+    if (Data == NULL) return NULL;
+
+    Data ->vc = *pVC;
+    Data ->hModel = cmsCIECAM02Init(ContextID, &Data ->vc);
+
+    if (Data ->hModel == NULL) {
+        _cmsFree(ContextID, Data);
+        return NULL;
+    }
+
+    mpe = _cmsStageAllocPlaceholder(ContextID, Type, 3, 3, EvalPtr, CAM02StageDup, CAM02StageFree, Data);
+    if (mpe == NULL) {
+        cmsCIECAM02Done(Data ->hModel);
+        _cmsFree(ContextID, Data);
+        return NULL;
+    }
+
+    return mpe;
+}
+
+
+// XYZ to JCh under the given viewing conditions
+cmsStage* CMSEXPORT cmsStageAllocCIECAM02Forward(cmsContext ContextID, const cmsViewingConditions* pVC)
+{
+    return AllocCAM02Stage(ContextID, pVC, cmsSigCAM02ForwardElemType, EvaluateCAM02Forward);
+}
+
+// JCh to XYZ under the given viewing conditions
+cmsStage* CMSEXPORT cmsStageAllocCIECAM02Reverse(cmsContext ContextID, const cmsViewingConditions* pVC)
+{
+    return AllocCAM02Stage(ContextID, pVC, cmsSigCAM02ReverseElemType, EvaluateCAM02Reverse);
+}
@@ -564,7 +564,10 @@ cmsPipeline* DefaultICCintents(cmsContext       ContextID,
         }
 
         // Concatenate to the output LUT
-        cmsPipelineCat(Result, Lut);
+        if (!cmsPipelineCat(Result, Lut)) {
+            cmsPipelineFree(Lut);
+            goto Error;
+        }
         cmsPipelineFree(Lut);                            
 
         // Update current space
@@ -245,6 +245,77 @@ void* CMSEXPORT _cmsDupMem(cmsContext ContextID, const void* Org, cmsUInt32Numbe
     return DupPtr(ContextID, Org, size);
 }
 
+// Resource limits ----------------------------------------------------------------------------------------------
+
+// No limits by default
+static cmsResourceLimits Limits = { 0, 0, 0, 0, 0 };
+
+void CMSEXPORT cmsSetResourceLimits(const cmsResourceLimits* NewLimits)
+{
+    if (NewLimits == NULL)
+        memset(&Limits, 0, sizeof(Limits));
+    else
+        Limits = *NewLimits;
+}
+
+void CMSEXPORT cmsGetResourceLimits(cmsResourceLimits* CurrentLimits)
+{
+    _cmsAssert(CurrentLimits != NULL);
+    *CurrentLimits = Limits;
+}
+
+// Checks are meant to be cheap, just a compare when no limit is set
+
+cmsBool _cmsCheckCLUTLimits(cmsContext ContextID, cmsUInt32Number nEntries, cmsUInt32Number EntrySize)
+{
+    if (Limits.MaxCLUTEntries != 0 && nEntries > Limits.MaxCLUTEntries) {
+        cmsSignalError(ContextID, cmsERROR_RESOURCE_LIMIT, "CLUT of %u entries exceeds the limit of %u", nEntries, Limits.MaxCLUTEntries);
+        return FALSE;
+    }
+
+    return _cmsCheckTableBytesLimit(ContextID, (cmsFloat64Number) nEntries * EntrySize);
+}
+
+cmsBool _cmsCheckCurveLimits(cmsContext ContextID, cmsUInt32Number nEntries)
+{
+    if (Limits.MaxCurveEntries != 0 && nEntries > Limits.MaxCurveEntries) {
+        cmsSignalError(ContextID, cmsERROR_RESOURCE_LIMIT, "Curve of %u entries exceeds the limit of %u", nEntries, Limits.MaxCurveEntries);
+        return FALSE;
+    }
+
+    return _cmsCheckTableBytesLimit(ContextID, (cmsFloat64Number) nEntries * sizeof(cmsUInt16Number));
+}
+
+cmsBool _cmsCheckTableBytesLimit(cmsContext ContextID, cmsFloat64Number nBytes)
+{
+    if (Limits.MaxTableBytes != 0 && nBytes > Limits.MaxTableBytes) {
+        cmsSignalError(ContextID, cmsERROR_RESOURCE_LIMIT, "Tables of %.0f bytes exceed the limit of %u", nBytes, Limits.MaxTableBytes);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+cmsBool _cmsCheckPipelineDepthLimit(cmsContext ContextID, cmsUInt32Number nStages)
+{
+    if (Limits.MaxPipelineStages != 0 && nStages > Limits.MaxPipelineStages) {
+        cmsSignalError(ContextID, cmsERROR_RESOURCE_LIMIT, "Pipeline of %u stages exceeds the limit of %u", nStages, Limits.MaxPipelineStages);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+cmsBool _cmsCheckSamplerLimit(cmsContext ContextID, cmsUInt32Number nEvaluations)
+{
+    if (Limits.MaxSamplerEvaluations != 0 && nEvaluations > Limits.MaxSamplerEvaluations) {
+        cmsSignalError(ContextID, cmsERROR_RESOURCE_LIMIT, "Sampling %u points exceeds the limit of %u", nEvaluations, Limits.MaxSamplerEvaluations);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 // ********************************************************************************************
 
 // Sub allocation takes care of many pointers of small size. The memory allocated in
@@ -377,6 +448,18 @@ static void DefaultLogErrorHandlerFunction(cmsContext ContextID, cmsUInt32Number
 // The current handler in actual environment
 static cmsLogErrorHandlerFunction LogErrorHandler   = DefaultLogErrorHandlerFunction;
 
+// Optional filter, called with the unformatted message
+static cmsErrorFilterFunction ErrorFilter = NULL;
+
+// Every signaled error is counted, including the ones nobody listens to. Unknown codes go to cmsERROR_UNDEFINED
+static volatile long ErrorCounts[cmsMAX_ERROR_CODES];
+
+// At most RateLimit messages of each code reach the handler on each second, zero means no limit
+static cmsUInt32Number  RateLimit = 0;
+static time_t           RateSecond[cmsMAX_ERROR_CODES];
+static cmsUInt32Number  RateCount[cmsMAX_ERROR_CODES];
+static volatile long    RateLock = 0;
+
 // The default error logger does nothing.
 static
 void DefaultLogErrorHandlerFunction(cmsContext ContextID, cmsUInt32Number ErrorCode, const char *Text)
@@ -398,12 +481,85 @@ void CMSEXPORT cmsSetLogErrorHandler(cmsLogErrorHandlerFunction Fn)
         LogErrorHandler = Fn;
 }
 
+// Change the filter, NULL lets all messages go
+void CMSEXPORT cmsSetErrorFilter(cmsErrorFilterFunction Fn)
+{
+    ErrorFilter = Fn;
+}
+
+// Returns the old limit
+cmsUInt32Number CMSEXPORT cmsSetLogErrorRateLimit(cmsUInt32Number MaxPerSecond)
+{
+    cmsUInt32Number Old = RateLimit;
+
+    RateLimit = MaxPerSecond;
+    return Old;
+}
+
+cmsUInt32Number CMSEXPORT cmsGetErrorCount(cmsUInt32Number ErrorCode)
+{
+    if (ErrorCode >= cmsMAX_ERROR_CODES) return 0;
+    return (cmsUInt32Number) ErrorCounts[ErrorCode];
+}
+
+void CMSEXPORT cmsResetErrorCounts(void)
+{
+    int i;
+
+    for (i=0; i < cmsMAX_ERROR_CODES; i++)
+        _cmsAtomicExchange(&ErrorCounts[i], 0);
+}
+
+// Whatever the message has room in the rate of its code
+static
+cmsBool WithinRateLimit(cmsUInt32Number ErrorCode)
+{
+    time_t Now;
+    cmsBool rc = TRUE;
+
+    if (RateLimit == 0) return TRUE;
+
+    Now = time(NULL);
+
+    while (_cmsAtomicExchange(&RateLock, 1)) { }
+
+    if (RateSecond[ErrorCode] != Now) {
+        RateSecond[ErrorCode] = Now;
+        RateCount[ErrorCode]  = 0;
+    }
+
+    if (RateCount[ErrorCode] < RateLimit)
+        RateCount[ErrorCode]++;
+    else
+        rc = FALSE;
+
+    _cmsAtomicRelease(&RateLock);
+    return rc;
+}
+
 // Log an error 
-// ErrorText is a text holding an english description of error.
+// ErrorText is a text holding an english description of error. The text is only formatted if some handler is going to see it
 void CMSEXPORT cmsSignalError(cmsContext ContextID, cmsUInt32Number ErrorCode, const char *ErrorText, ...)
 {
     va_list args;
     char Buffer[MAX_ERROR_MESSAGE_LEN];
+    cmsUInt32Number Slot = ErrorCode < cmsMAX_ERROR_CODES ? ErrorCode : cmsERROR_UNDEFINED;
+    cmsBool Accept;
+
+    _cmsAtomicIncrement(&ErrorCounts[Slot]);
+
+    if (ErrorFilter != NULL) {
+
+        va_start(args, ErrorText);
+        Accept = ErrorFilter(ContextID, ErrorCode, ErrorText, args);
+        va_end(args);
+
+        if (!Accept) return;
+    }
+
+    // Nobody listening, nothing to format
+    if (LogErrorHandler == DefaultLogErrorHandlerFunction) return;
+    if (!WithinRateLimit(Slot)) return;
 
     va_start(args, ErrorText);
     vsnprintf(Buffer, MAX_ERROR_MESSAGE_LEN-1, ErrorText, args);
@@ -161,6 +161,8 @@ cmsToneCurve* AllocateToneCurveStruct(cmsContext ContextID, cmsInt32Number nEntr
         return NULL;
     }
 
+    if (nEntries > 0 && !_cmsCheckCurveLimits(ContextID, (cmsUInt32Number) nEntries)) return NULL;
+
     // Allocate all required pointers, etc.
     p = (cmsToneCurve*) _cmsMallocZero(ContextID, sizeof(cmsToneCurve));
     if (!p) return NULL;
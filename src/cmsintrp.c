@@ -31,6 +31,7 @@
 
 // Interpolation routines by default
 static cmsInterpFunction DefaultInterpolatorsFactory(cmsUInt32Number nInputChannels, cmsUInt32Number nOutputChannels, cmsUInt32Number dwFlags);
+static void SelectSpecializedInterpolator(cmsInterpParams* p);
 
 // This is the default factory
 static cmsInterpFnFactory Interpolators = DefaultInterpolatorsFactory;
@@ -69,6 +70,9 @@ cmsBool _cmsSetInterpolationRoutine(cmsInterpParams* p)
     if (p ->Interpolation.Lerp16 == NULL) {    
             return FALSE;
     }
+
+    // Common grids have their own kernels
+    SelectSpecializedInterpolator(p);
     return TRUE;
 }
 
@@ -263,9 +267,11 @@ void Eval1InputFloat(const cmsFloat32Number Value[],
     cmsUInt32Number OutChan;
     const cmsFloat32Number* LutTable = (cmsFloat32Number*) p ->Table; 
 
-        // if last value...
+        // if last value, all channels come from the last node
        if (Value[0] == 1.0) {
-           Output[0] = LutTable[p -> Domain[0]];
+
+           for (OutChan=0; OutChan < p->nOutputs; OutChan++)
+               Output[OutChan] = LutTable[p -> Domain[0] * p -> opta[0] + OutChan];
            return;
        }
 
@@ -809,6 +815,229 @@ void TetrahedralInterp16(register const cmsUInt16Number Input[],
 }
 
 
+// Tetrahedral kernels specialized on grid size and number of outputs. Grids of 2^n+1 nodes have a power-of-two
+// domain, so scaling the input is a shift, and the node offsets are constants. Arithmetic is the same as
+// TetrahedralInterp16, so results are bit-exact.
+
+#define TETRA16_OUT(NOUT, SUB)                                          \
+    {                                                                   \
+    cmsS15Fixed16Number c0, c1, c2, c3, Rest;                           \
+    int OutChan;                                                        \
+    for (OutChan=0; OutChan < (NOUT); OutChan++) {                      \
+        c1 = LutTable[X1 + OutChan];                                    \
+        c2 = LutTable[Y1 + OutChan];                                    \
+        c3 = LutTable[Z1 + OutChan];                                    \
+        c0 = LutTable[OutChan];                                         \
+        SUB                                                             \
+        Rest = c1 * rx + c2 * ry + c3 * rz + 0x8001;                    \
+        Output[OutChan] = (cmsUInt16Number) c0 + ((Rest + (Rest>>16))>>16); \
+    }                                                                   \
+    }
+
+#define TETRA16_KERNEL(Name, SHIFT, NOUT, OUT, SUB)                                     \
+static                                                                                  \
+void Name(register const cmsUInt16Number Input[],                                       \
+          register cmsUInt16Number Output[],                                            \
+          register const cmsInterpParams* p)                                            \
+{                                                                                       \
+    const cmsUInt16Number* LutTable = (cmsUInt16Number*) p -> Table;                    \
+    const int OptaZ = (NOUT);                                                           \
+    const int OptaY = OptaZ * ((1 << (SHIFT)) + 1);                                     \
+    const int OptaX = OptaY * ((1 << (SHIFT)) + 1);                                     \
+    cmsS15Fixed16Number fx, fy, fz;                                                     \
+    cmsS15Fixed16Number rx, ry, rz;                                                     \
+    cmsS15Fixed16Number X1, Y1, Z1;                                                     \
+                                                                                        \
+    fx = _cmsToFixedDomain((int) Input[0] << (SHIFT));                                  \
+    fy = _cmsToFixedDomain((int) Input[1] << (SHIFT));                                  \
+    fz = _cmsToFixedDomain((int) Input[2] << (SHIFT));                                  \
+                                                                                        \
+    rx = FIXED_REST_TO_INT(fx);                                                         \
+    ry = FIXED_REST_TO_INT(fy);                                                         \
+    rz = FIXED_REST_TO_INT(fz);                                                         \
+                                                                                        \
+    X1 = (Input[0] == 0xFFFFU ? 0 : OptaX);                                             \
+    Y1 = (Input[1] == 0xFFFFU ? 0 : OptaY);                                             \
+    Z1 = (Input[2] == 0xFFFFU ? 0 : OptaZ);                                             \
+                                                                                        \
+    LutTable += OptaX * FIXED_TO_INT(fx) + OptaY * FIXED_TO_INT(fy) + OptaZ * FIXED_TO_INT(fz); \
+                                                                                        \
+    if (rx >= ry) {                                                                     \
+        if (ry >= rz) {                                                                 \
+            Y1 += X1; Z1 += Y1;                                                         \
+            OUT(NOUT, SUB(c3, c2) SUB(c2, c1) SUB(c1, c0))                              \
+        } else if (rz >= rx) {                                                          \
+            X1 += Z1; Y1 += X1;                                                         \
+            OUT(NOUT, SUB(c2, c1) SUB(c1, c3) SUB(c3, c0))                              \
+        } else {                                                                        \
+            Z1 += X1; Y1 += Z1;                                                         \
+            OUT(NOUT, SUB(c2, c3) SUB(c3, c1) SUB(c1, c0))                              \
+        }                                                                               \
+    } else {                                                                            \
+        if (rx >= rz) {                                                                 \
+            X1 += Y1; Z1 += X1;                                                         \
+            OUT(NOUT, SUB(c3, c1) SUB(c1, c2) SUB(c2, c0))                              \
+        } else if (ry >= rz) {                                                          \
+            Z1 += Y1; X1 += Z1;                                                         \
+            OUT(NOUT, SUB(c1, c3) SUB(c3, c2) SUB(c2, c0))                              \
+        } else {                                                                        \
+            Y1 += Z1; X1 += Y1;                                                         \
+            OUT(NOUT, SUB(c1, c2) SUB(c2, c3) SUB(c3, c0))                              \
+        }                                                                               \
+    }                                                                                   \
+}
+
+#define SUBINT(a, b)  a -= b;
+
+TETRA16_KERNEL(Tetrahedral16_9x1,  3, 1, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_9x3,  3, 3, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_9x4,  3, 4, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_17x1, 4, 1, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_17x3, 4, 3, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_17x4, 4, 4, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_33x1, 5, 1, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_33x3, 5, 3, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_33x4, 5, 4, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_65x1, 6, 1, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_65x3, 6, 3, TETRA16_OUT, SUBINT)
+TETRA16_KERNEL(Tetrahedral16_65x4, 6, 4, TETRA16_OUT, SUBINT)
+
+#if !defined(CMS_DONT_USE_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   include <emmintrin.h>
+#   define CMS_SSE2_KERNELS  1
+#endif
+
+#ifdef CMS_SSE2_KERNELS
+
+// SSE2 kernels. All outputs of a node go at once, one 32 bits lane each, and wrap around on overflow just
+// as the scalar arithmetic does, so results are still bit-exact. Single output grids have nothing to gain.
+
+// Low 32 bits of the lane products. There is no pmulld before SSE4.1, so even and odd lanes are multiplied apart
+cmsINLINE __m128i MulLo32(__m128i a, __m128i b)
+{
+    __m128i Even = _mm_mul_epu32(a, b);
+    __m128i Odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(Odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Outputs of one node, widened to 32 bits. Three outputs are read as 4 + 2 bytes, so nothing past the table is touched
+cmsINLINE __m128i LoadNode(const cmsUInt16Number* Node, int nOutputs)
+{
+    __m128i v;
+
+    if (nOutputs == 4) {
+        v = _mm_loadl_epi64((const __m128i*) Node);
+    }
+    else {
+        cmsUInt32Number Lo;
+
+        memmove(&Lo, Node, sizeof(cmsUInt32Number));
+        v = _mm_insert_epi16(_mm_cvtsi32_si128((int) Lo), Node[2], 2);
+    }
+
+    return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+// Keeps the low 16 bits of each lane, as the cast to cmsUInt16Number does
+cmsINLINE void StoreNode(cmsUInt16Number* Output, __m128i v, int nOutputs)
+{
+    v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    v = _mm_packs_epi32(v, v);
+
+    if (nOutputs == 4) {
+        _mm_storel_epi64((__m128i*) Output, v);
+    }
+    else {
+        cmsUInt32Number Lo = (cmsUInt32Number) _mm_cvtsi128_si32(v);
+
+        memmove(Output, &Lo, sizeof(cmsUInt32Number));
+        Output[2] = (cmsUInt16Number) _mm_extract_epi16(v, 2);
+    }
+}
+
+#define SUB32(a, b)  a = _mm_sub_epi32(a, b);
+
+#define TETRA16_SSE2_OUT(NOUT, SUB)                                     \
+    {                                                                   \
+    __m128i c0 = LoadNode(LutTable, (NOUT));                            \
+    __m128i c1 = LoadNode(LutTable + X1, (NOUT));                       \
+    __m128i c2 = LoadNode(LutTable + Y1, (NOUT));                       \
+    __m128i c3 = LoadNode(LutTable + Z1, (NOUT));                       \
+    __m128i Rest;                                                       \
+    SUB                                                                 \
+    Rest = _mm_add_epi32(_mm_add_epi32(MulLo32(c1, _mm_set1_epi32(rx)), MulLo32(c2, _mm_set1_epi32(ry))), \
+                         _mm_add_epi32(MulLo32(c3, _mm_set1_epi32(rz)), _mm_set1_epi32(0x8001)));         \
+    Rest = _mm_srai_epi32(_mm_add_epi32(Rest, _mm_srai_epi32(Rest, 16)), 16); \
+    StoreNode(Output, _mm_add_epi32(c0, Rest), (NOUT));                 \
+    }
+
+TETRA16_KERNEL(Tetrahedral16_9x3_SSE2,  3, 3, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_9x4_SSE2,  3, 4, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_17x3_SSE2, 4, 3, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_17x4_SSE2, 4, 4, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_33x3_SSE2, 5, 3, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_33x4_SSE2, 5, 4, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_65x3_SSE2, 6, 3, TETRA16_SSE2_OUT, SUB32)
+TETRA16_KERNEL(Tetrahedral16_65x4_SSE2, 6, 4, TETRA16_SSE2_OUT, SUB32)
+
+#undef TETRA16_SSE2_OUT
+#undef SUB32
+
+#endif
+
+#undef TETRA16_KERNEL
+#undef TETRA16_OUT
+#undef SUBINT
+
+// Kernels for each shape are listed best first. Entries needing some CPU feature level go before the generic ones
+typedef struct {
+    cmsUInt32Number nSamples;
+    cmsUInt32Number nOutputs;
+    cmsInt32Number  Level;
+    _cmsInterpFn16  Lerp16;
+
+} _cmsTetrahedral16Kernel;
+
+static const _cmsTetrahedral16Kernel Tetrahedral16Kernels[] = {
+
+#ifdef CMS_SSE2_KERNELS
+    {  9, 3, cmsCPU_SSE2, Tetrahedral16_9x3_SSE2  }, {  9, 4, cmsCPU_SSE2, Tetrahedral16_9x4_SSE2  },
+    { 17, 3, cmsCPU_SSE2, Tetrahedral16_17x3_SSE2 }, { 17, 4, cmsCPU_SSE2, Tetrahedral16_17x4_SSE2 },
+    { 33, 3, cmsCPU_SSE2, Tetrahedral16_33x3_SSE2 }, { 33, 4, cmsCPU_SSE2, Tetrahedral16_33x4_SSE2 },
+    { 65, 3, cmsCPU_SSE2, Tetrahedral16_65x3_SSE2 }, { 65, 4, cmsCPU_SSE2, Tetrahedral16_65x4_SSE2 },
+#endif
+
+    {  9, 1, cmsCPU_GENERIC, Tetrahedral16_9x1  }, {  9, 3, cmsCPU_GENERIC, Tetrahedral16_9x3  }, {  9, 4, cmsCPU_GENERIC, Tetrahedral16_9x4  },
+    { 17, 1, cmsCPU_GENERIC, Tetrahedral16_17x1 }, { 17, 3, cmsCPU_GENERIC, Tetrahedral16_17x3 }, { 17, 4, cmsCPU_GENERIC, Tetrahedral16_17x4 },
+    { 33, 1, cmsCPU_GENERIC, Tetrahedral16_33x1 }, { 33, 3, cmsCPU_GENERIC, Tetrahedral16_33x3 }, { 33, 4, cmsCPU_GENERIC, Tetrahedral16_33x4 },
+    { 65, 1, cmsCPU_GENERIC, Tetrahedral16_65x1 }, { 65, 3, cmsCPU_GENERIC, Tetrahedral16_65x3 }, { 65, 4, cmsCPU_GENERIC, Tetrahedral16_65x4 }
+};
+
+// Replaces the generic 16 bits tetrahedral by a kernel specialized for the grid, if there is any for this CPU.
+static
+void SelectSpecializedInterpolator(cmsInterpParams* p)
+{
+    cmsUInt32Number i;
+    cmsInt32Number  Level = _cmsCPUFeatureLevel();
+
+    if (p ->Interpolation.Lerp16 != TetrahedralInterp16) return;
+    if (p ->nSamples[0] != p ->nSamples[1] || p ->nSamples[0] != p ->nSamples[2]) return;
+
+    for (i=0; i < sizeof(Tetrahedral16Kernels) / sizeof(_cmsTetrahedral16Kernel); i++) {
+
+        if (Tetrahedral16Kernels[i].nSamples == p ->nSamples[0] && 
+            Tetrahedral16Kernels[i].nOutputs == p ->nOutputs &&
+            Tetrahedral16Kernels[i].Level <= Level) {
+
+                p ->Interpolation.Lerp16 = Tetrahedral16Kernels[i].Lerp16;
+                return;
+        }
+    }
+}
+
+
 #define DENS(i,j,k) (LutTable[(i)+(j)+(k)+OutChan])
 static
 void Eval4Inputs(register const cmsUInt16Number Input[], 
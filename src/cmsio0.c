@@ -305,6 +305,47 @@ Error:
     return NULL;
 }
 
+// Reads straight from a block owned by the caller, which should outlive the iohandler. No copy is made
+static
+cmsIOHANDLER* OpenIOhandlerFromBorrowedMem(cmsContext ContextID, const void* Buffer, cmsUInt32Number size)
+{
+    cmsIOHANDLER* iohandler = NULL;
+    FILEMEM* fm = NULL;
+
+    if (Buffer == NULL) {
+        cmsSignalError(ContextID, cmsERROR_READ, "Couldn't read profile from NULL pointer");
+        return NULL;
+    }
+
+    iohandler = (cmsIOHANDLER*) _cmsMallocZero(ContextID, sizeof(cmsIOHANDLER));
+    if (iohandler == NULL) return NULL;
+
+    fm = (FILEMEM*) _cmsMallocZero(ContextID, sizeof(FILEMEM));
+    if (fm == NULL) {
+        _cmsFree(ContextID, iohandler);
+        return NULL;
+    }
+
+    fm ->Block = (cmsUInt8Number*) Buffer;
+    fm ->FreeBlockOnClose = FALSE;
+    fm ->Size    = size;
+    fm ->Pointer = 0;
+
+    iohandler ->ContextID = ContextID;
+    iohandler ->stream  = (void*) fm;
+    iohandler ->UsedSpace = 0;
+    iohandler ->ReportedSize = size;
+    iohandler ->PhysicalFile[0] = 0;
+
+    iohandler ->Read    = MemoryRead;
+    iohandler ->Seek    = MemorySeek;
+    iohandler ->Close   = MemoryClose;
+    iohandler ->Tell    = MemoryTell;
+    iohandler ->Write   = MemoryWrite;
+
+    return iohandler;
+}
+
 // File-based stream -------------------------------------------------------
 
 // Read count elements of size bytes each. Return number of elements read
@@ -454,12 +495,14 @@ cmsBool CMSEXPORT cmsCloseIOhandler(cmsIOHANDLER* io)
 // Creates an empty structure holding all required parameters
 cmsHPROFILE CMSEXPORT cmsCreateProfilePlaceholder(cmsContext ContextID)
 {
-    time_t now = time(NULL);
     _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) _cmsMallocZero(ContextID, sizeof(_cmsICCPROFILE));
     if (Icc == NULL) return NULL;
 
     Icc ->ContextID = ContextID;
 
+    // The caller holds the only reference
+    Icc ->RefCount = 1;
+
     // Set it to empty
     Icc -> TagCount   = 0;
 
@@ -467,7 +510,10 @@ cmsHPROFILE CMSEXPORT cmsCreateProfilePlaceholder(cmsContext ContextID)
     Icc ->Version =  0x02100000;
 
     // Set creation date/time
-    memmove(&Icc ->Created, gmtime(&now), sizeof(Icc ->Created));
+    if (!_cmsGetTime(&Icc ->Created)) {
+        _cmsFree(ContextID, Icc);
+        return NULL;
+    }
 
     // Return the handle
     return (cmsHPROFILE) Icc;
@@ -496,25 +542,127 @@ cmsTagSignature CMSEXPORT cmsGetTagSignature(cmsHPROFILE hProfile, cmsUInt32Numb
 {
     _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;    
 
-    if (n > Icc->TagCount) return (cmsTagSignature) 0;  // Mark as not available     
-    if (n >= MAX_TABLE_TAG) return (cmsTagSignature) 0; // As double check
+    if (n >= Icc->TagCount) return (cmsTagSignature) 0;  // Mark as not available     
 
     return Icc ->TagNames[n];
 }
 
 
+// The tag directory grows on demand. Arrays are carved from a single block, TagPtrs is the
+// start of it. TagHash is an open addressing index with twice as many slots as the capacity.
+
+#define MIN_TAG_CAPACITY    8
+
+cmsINLINE cmsUInt32Number HashTagSig(cmsTagSignature sig, cmsUInt32Number Mask)
+{
+    cmsUInt32Number h = (cmsUInt32Number) sig * 0x9E3779B1U;
+
+    return (h ^ (h >> 16)) & Mask;
+}
+
+// Adds position n to the index. Duplicated signatures are not indexed, the first one wins
+static
+void IndexTag(_cmsICCPROFILE* Icc, cmsTagSignature sig, cmsUInt32Number n)
+{
+    cmsUInt32Number Mask = 2 * Icc ->TagCapacity - 1;
+    cmsUInt32Number h = HashTagSig(sig, Mask);
+
+    while (Icc ->TagHash[h] != 0) {
+
+        if (Icc ->TagNames[Icc ->TagHash[h] - 1] == sig) return;
+        h = (h + 1) & Mask;
+    }
+
+    Icc ->TagHash[h] = n + 1;
+}
+
+// Moves the directory to a new block of the given capacity, which should be a power of two.
+// The old block is returned, so the caller decides whether to free it or not
+static
+cmsBool ResizeTagDirectory(_cmsICCPROFILE* Icc, cmsUInt32Number Capacity, void** OldBlock)
+{
+    _cmsICCPROFILE Old;
+    cmsUInt8Number* Block;
+    cmsUInt32Number i, n = Icc ->TagCount;
+    cmsUInt32Number EntrySize = 2 * sizeof(void*) + 6 * sizeof(cmsUInt32Number) + sizeof(cmsBool);
+
+    *OldBlock = (void*) Icc ->TagPtrs;
+
+    if (Capacity < n || Capacity > 0x1000000) {
+        cmsSignalError(Icc ->ContextID, cmsERROR_RANGE, "Too many tags (%u)", Capacity);
+        return FALSE;
+    }
+
+    Block = (cmsUInt8Number*) _cmsMallocZero(Icc ->ContextID, Capacity * EntrySize);
+    if (Block == NULL) return FALSE;
+
+    memmove(&Old, Icc, sizeof(_cmsICCPROFILE));
+
+    Icc ->TagPtrs         = (void**) Block;               Block += Capacity * sizeof(void*);
+    Icc ->TagTypeHandlers = (cmsTagTypeHandler**) Block;  Block += Capacity * sizeof(void*);
+    Icc ->TagNames        = (cmsTagSignature*) Block;     Block += Capacity * sizeof(cmsUInt32Number);
+    Icc ->TagLinked       = (cmsTagSignature*) Block;     Block += Capacity * sizeof(cmsUInt32Number);
+    Icc ->TagSizes        = (cmsUInt32Number*) Block;     Block += Capacity * sizeof(cmsUInt32Number);
+    Icc ->TagOffsets      = (cmsUInt32Number*) Block;     Block += Capacity * sizeof(cmsUInt32Number);
+    Icc ->TagHash         = (cmsUInt32Number*) Block;     Block += 2 * Capacity * sizeof(cmsUInt32Number);
+    Icc ->TagSaveAsRaw    = (cmsBool*) Block;
+    Icc ->TagCapacity     = Capacity;
+
+    if (n > 0) {
+
+        memmove(Icc ->TagPtrs,         Old.TagPtrs,         n * sizeof(void*));
+        memmove(Icc ->TagTypeHandlers, Old.TagTypeHandlers, n * sizeof(cmsTagTypeHandler*));
+        memmove(Icc ->TagNames,        Old.TagNames,        n * sizeof(cmsTagSignature));
+        memmove(Icc ->TagLinked,       Old.TagLinked,       n * sizeof(cmsTagSignature));
+        memmove(Icc ->TagSizes,        Old.TagSizes,        n * sizeof(cmsUInt32Number));
+        memmove(Icc ->TagOffsets,      Old.TagOffsets,      n * sizeof(cmsUInt32Number));
+        memmove(Icc ->TagSaveAsRaw,    Old.TagSaveAsRaw,    n * sizeof(cmsBool));
+    }
+
+    for (i=0; i < n; i++) {
+
+        if (Icc ->TagNames[i] != (cmsTagSignature) 0)
+            IndexTag(Icc, Icc ->TagNames[i], i);
+    }
+
+    return TRUE;
+}
+
+// Makes room for one more tag
+static
+cmsBool GrowTagDirectory(_cmsICCPROFILE* Icc)
+{
+    void* OldBlock;
+
+    if (Icc ->TagCount < Icc ->TagCapacity) return TRUE;
+
+    if (!ResizeTagDirectory(Icc, Icc ->TagCapacity == 0 ? MIN_TAG_CAPACITY : 2 * Icc ->TagCapacity, &OldBlock)) 
+        return FALSE;
+
+    if (OldBlock != NULL) 
+        _cmsFree(Icc ->ContextID, OldBlock);
+    return TRUE;
+}
+
 static
 int SearchOneTag(_cmsICCPROFILE* Profile, cmsTagSignature sig)
 {
-	cmsUInt32Number i;
+    cmsUInt32Number Mask, h, n;
 
-	for (i=0; i < Profile -> TagCount; i++) {
+    if (Profile ->TagCapacity == 0) return -1;
 
-		if (sig == Profile -> TagNames[i])
-			return i;
-	}
+    Mask = 2 * Profile ->TagCapacity - 1;
+    h = HashTagSig(sig, Mask);
+
+    while ((n = Profile ->TagHash[h]) != 0) {
 
-	return -1;
+        if (Profile ->TagNames[n - 1] == sig) 
+            return (int) (n - 1);
+
+        h = (h + 1) & Mask;
+    }
+
+    return -1;
 }
 
 // Search for a specific tag in tag dictionary. Returns position or -1 if tag not found.
@@ -550,11 +698,24 @@ int _cmsSearchTag(_cmsICCPROFILE* Icc, cmsTagSignature sig, cmsBool lFollowLinks
 
 // Create a new tag entry
 
+// Frozen profiles may be read from several threads at once, so nothing should change them
+static
+cmsBool IsWritable(_cmsICCPROFILE* Icc)
+{
+    if (Icc ->IsFrozen) {
+        cmsSignalError(Icc ->ContextID, cmsERROR_NOT_SUITABLE, "Profile is frozen");
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static
 cmsBool _cmsNewTag(_cmsICCPROFILE* Icc, cmsTagSignature sig, int* NewPos)
 {
 	int i;
 
+    if (!IsWritable(Icc)) return FALSE;
+
 	// Search for the tag
     i = _cmsSearchTag(Icc, sig, FALSE);
 
@@ -566,13 +727,11 @@ cmsBool _cmsNewTag(_cmsICCPROFILE* Icc, cmsTagSignature sig, int* NewPos)
     else  {
 
         // New one
-        
-        if (Icc -> TagCount >= MAX_TABLE_TAG) {
-            cmsSignalError(Icc ->ContextID, cmsERROR_RANGE, "Too many tags (%d)", MAX_TABLE_TAG);
-            return FALSE;
-        }
+        if (!GrowTagDirectory(Icc)) return FALSE;
 
 		*NewPos = Icc ->TagCount;
+        Icc -> TagNames[*NewPos] = sig;
+        IndexTag(Icc, sig, *NewPos);
         Icc -> TagCount++;
     }
 
@@ -593,10 +752,11 @@ cmsBool _cmsReadHeader(_cmsICCPROFILE* Icc)
 {
     cmsTagEntry Tag;
     cmsICCHeader Header;
-    cmsUInt32Number i, j;
+    cmsUInt32Number i, j, h, Mask, Capacity;
     cmsUInt32Number HeaderSize;
     cmsIOHANDLER* io = Icc ->IOhandler;
     cmsUInt32Number TagCount;
+    void* OldBlock;
 
 
     // Read the header
@@ -636,14 +796,22 @@ cmsBool _cmsReadHeader(_cmsICCPROFILE* Icc)
     memmove(Icc ->ProfileID.ID32, Header.profileID.ID32, 16);
 
 
-    // Read tag directory
+    // Read tag directory. Each entry takes 12 bytes, so the count is bounded by the size of the file
     if (!_cmsReadUInt32Number(io, &TagCount)) return FALSE;                          
-    if (TagCount > MAX_TABLE_TAG) {
+    if (TagCount > (Icc ->IOhandler ->ReportedSize - sizeof(cmsICCHeader)) / sizeof(cmsTagEntry)) {
 
-        cmsSignalError(Icc ->ContextID, cmsERROR_RANGE, "Too many tags (%d)", TagCount);
+        cmsSignalError(Icc ->ContextID, cmsERROR_RANGE, "Too many tags (%u)", TagCount);
         return FALSE;
     }
 
+    for (Capacity = MIN_TAG_CAPACITY; Capacity < TagCount; Capacity <<= 1) { }
+
+    if (!ResizeTagDirectory(Icc, Capacity, &OldBlock)) return FALSE;
+    if (OldBlock != NULL) _cmsFree(Icc ->ContextID, OldBlock);
+
+    // Tags sharing the very same block are links. Since the directory is indexed by signature,
+    // TagHash is temporarily used to find them by offset, which keeps the search linear 
+    Mask = 2 * Capacity - 1;
 
     // Read tag directory
     Icc -> TagCount = 0;
@@ -662,19 +830,25 @@ cmsBool _cmsReadHeader(_cmsICCPROFILE* Icc)
         Icc -> TagOffsets[Icc ->TagCount] = Tag.offset;
         Icc -> TagSizes[Icc ->TagCount]   = Tag.size;
 
-       // Search for links
-        for (j=0; j < Icc ->TagCount; j++) {
+       // Search for links. The latest tag on same block is kept on the slot
+        for (h = HashTagSig((cmsTagSignature) Tag.offset, Mask); (j = Icc ->TagHash[h]) != 0; h = (h + 1) & Mask) {
 
-            if ((Icc ->TagOffsets[j] == Tag.offset) &&
-                (Icc ->TagSizes[j]   == Tag.size)) {
+            if ((Icc ->TagOffsets[j-1] == Tag.offset) &&
+                (Icc ->TagSizes[j-1]   == Tag.size)) {
 
-                Icc ->TagLinked[Icc ->TagCount] = Icc ->TagNames[j];   
+                Icc ->TagLinked[Icc ->TagCount] = Icc ->TagNames[j-1];   
+                break;
             }
-
         }
 
+        Icc ->TagHash[h] = Icc ->TagCount + 1;
         Icc ->TagCount++;
     }
+
+    // Now index by signature
+    memset(Icc ->TagHash, 0, 2 * Capacity * sizeof(cmsUInt32Number));
+    for (i=0; i < Icc ->TagCount; i++) 
+        IndexTag(Icc, Icc ->TagNames[i], i);
   
     return TRUE;
 }
@@ -1047,6 +1221,18 @@ cmsHPROFILE CMSEXPORT cmsOpenProfileFromMem(const void* MemPtr, cmsUInt32Number
 
 
 // Dump tag contents. If the profile is being modified, untouched tags are copied from FileOrig
+// Type handlers are shared by all profiles. Each call gets a private copy carrying the profile context and version,
+// so different profiles may be read and written from several threads at once.
+static
+cmsTagTypeHandler* SetHandlerContext(cmsTagTypeHandler* Local, const cmsTagTypeHandler* TypeHandler, _cmsICCPROFILE* Icc)
+{
+    *Local = *TypeHandler;
+
+    Local ->ContextID  = Icc ->ContextID;
+    Local ->ICCVersion = Icc ->Version;
+    return Local;
+}
+
 static
 cmsBool SaveTags(_cmsICCPROFILE* Icc, _cmsICCPROFILE* FileOrig)
 {
@@ -1057,6 +1243,7 @@ cmsBool SaveTags(_cmsICCPROFILE* Icc, _cmsICCPROFILE* FileOrig)
     cmsTagDescriptor* TagDescriptor;
     cmsTagTypeSignature TypeBase;
     cmsTagTypeHandler* TypeHandler;
+    cmsTagTypeHandler LocalTypeHandler;
 
 
     for (i=0; i < Icc -> TagCount; i++) {
@@ -1124,8 +1311,7 @@ cmsBool SaveTags(_cmsICCPROFILE* Icc, _cmsICCPROFILE* FileOrig)
             if (!_cmsWriteTypeBase(io, TypeBase)) 
                 return FALSE;
 
-            TypeHandler ->ContextID  = Icc ->ContextID;
-            TypeHandler ->ICCVersion = Icc ->Version;
+            TypeHandler = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
             if (!TypeHandler ->WritePtr(TypeHandler, io, Data, TagDescriptor ->ElemCount)) {
 
 				char String[5];
@@ -1183,17 +1369,24 @@ cmsUInt32Number CMSEXPORT cmsSaveProfileToIOhandler(cmsHPROFILE hProfile, cmsIOH
     cmsIOHANDLER* PrevIO;
     cmsUInt32Number UsedSpace;
     cmsContext ContextID;
+    void* OldBlock;
 
     memmove(&Keep, Icc, sizeof(_cmsICCPROFILE));
 
+    // Offsets and sizes are overwritten while saving, but untouched tags are still copied 
+    // from the original ones, so the work is done on a private copy of the directory
+    if (Icc ->TagCapacity > 0) {
+        if (!ResizeTagDirectory(Icc, Icc ->TagCapacity, &OldBlock)) return 0;
+    }
+
     ContextID = cmsGetProfileContextID(hProfile);
     PrevIO = Icc ->IOhandler = cmsOpenIOhandlerFromNULL(ContextID);
-    if (PrevIO == NULL) return 0;
+    if (PrevIO == NULL) goto Restore;
 
     // Pass #1 does compute offsets
 
-    if (!_cmsWriteHeader(Icc, 0)) return 0;
-    if (!SaveTags(Icc, &Keep)) return 0;
+    if (!_cmsWriteHeader(Icc, 0)) goto CleanUp;
+    if (!SaveTags(Icc, &Keep)) goto CleanUp;
 
     UsedSpace = PrevIO ->UsedSpace;
 
@@ -1206,6 +1399,7 @@ cmsUInt32Number CMSEXPORT cmsSaveProfileToIOhandler(cmsHPROFILE hProfile, cmsIOH
         if (!SaveTags(Icc, &Keep)) goto CleanUp;
     }
 
+    if (Icc ->TagPtrs != Keep.TagPtrs) _cmsFree(ContextID, Icc ->TagPtrs);
     memmove(Icc, &Keep, sizeof(_cmsICCPROFILE));
     if (!cmsCloseIOhandler(PrevIO)) return 0;
 
@@ -1214,6 +1408,9 @@ cmsUInt32Number CMSEXPORT cmsSaveProfileToIOhandler(cmsHPROFILE hProfile, cmsIOH
 
 CleanUp:     
     cmsCloseIOhandler(PrevIO);      
+
+Restore:
+    if (Icc ->TagPtrs != Keep.TagPtrs) _cmsFree(Icc ->ContextID, Icc ->TagPtrs);
     memmove(Icc, &Keep, sizeof(_cmsICCPROFILE));
     return 0;
 }
@@ -1288,6 +1485,9 @@ cmsBool  CMSEXPORT cmsCloseProfile(cmsHPROFILE hProfile)
 
     if (!Icc) return FALSE;
 
+    // Other references keep the profile alive
+    if (_cmsAtomicDecrement(&Icc ->RefCount) > 0) return TRUE;
+
     // Was open in write mode?   
     if (Icc ->IsWrite) {
 
@@ -1303,8 +1503,9 @@ cmsBool  CMSEXPORT cmsCloseProfile(cmsHPROFILE hProfile)
 
             if (TypeHandler != NULL) {
 
-                TypeHandler ->ContextID = Icc ->ContextID;              // As an additional parameters
-                TypeHandler ->ICCVersion = Icc ->Version;
+                cmsTagTypeHandler LocalTypeHandler;
+
+                TypeHandler = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
                 TypeHandler ->FreePtr(TypeHandler, Icc -> TagPtrs[i]);
             }
             else
@@ -1316,11 +1517,288 @@ cmsBool  CMSEXPORT cmsCloseProfile(cmsHPROFILE hProfile)
         rc &= cmsCloseIOhandler(Icc->IOhandler);   
     }       
 
+    if (Icc ->TagPtrs != NULL) 
+        _cmsFree(Icc ->ContextID, Icc ->TagPtrs);   // The whole tag directory
+
+    for (i=0; i < 2; i++) {
+        if (Icc ->MemoShaper[i] != NULL) cmsPipelineFree(Icc ->MemoShaper[i]);
+    }
+
     _cmsFree(Icc ->ContextID, Icc);   // Free placeholder memory
 
     return rc;
 }
 
+// Adds a reference to the profile. Each reference is released by cmsCloseProfile
+cmsHPROFILE CMSEXPORT cmsRetainProfile(cmsHPROFILE hProfile)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+
+    if (Icc == NULL) return NULL;
+
+    _cmsAtomicIncrement(&Icc ->RefCount);
+    return hProfile;
+}
+
+// Bytes of a tag as found in the file, or NULL if they cannot be read
+static
+void* ReadTagBytes(_cmsICCPROFILE* Icc, cmsUInt32Number n)
+{
+    cmsIOHANDLER* io = Icc ->IOhandler;
+    void* Block;
+
+    if (io == NULL || Icc ->TagSizes[n] == 0) return NULL;
+
+    Block = _cmsMalloc(Icc ->ContextID, Icc ->TagSizes[n]);
+    if (Block == NULL) return NULL;
+
+    if (!io ->Seek(io, Icc ->TagOffsets[n]) || io ->Read(io, Block, Icc ->TagSizes[n], 1) != 1) {
+
+        _cmsFree(Icc ->ContextID, Block);
+        return NULL;
+    }
+
+    return Block;
+}
+
+// Reads all tags in memory and makes the profile read only. Frozen profiles can then be shared across threads:
+// cmsReadTag only returns the cached tags and never touches the IO handler, and tags cannot be written anymore.
+// Tags that cannot be decoded are kept as raw bytes, so cmsReadRawTag does not need the IO handler either.
+cmsBool CMSEXPORT cmsFreezeProfile(cmsHPROFILE hProfile)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsUInt32Number i;
+
+    if (Icc == NULL) return FALSE;
+    if (Icc ->IsFrozen) return TRUE;
+
+    if (Icc ->IsWrite) {
+        cmsSignalError(Icc ->ContextID, cmsERROR_NOT_SUITABLE, "Profiles open for writing cannot be frozen");
+        return FALSE;
+    }
+
+    for (i=0; i < Icc ->TagCount; i++) {
+
+        if (Icc ->TagNames[i] == (cmsTagSignature) 0) continue;
+        if (Icc ->TagSaveAsRaw[i]) continue;
+
+        cmsReadTag(hProfile, Icc ->TagNames[i]);
+    }
+
+    // Unsupported, private or broken tags. Linked ones are read through the tag they link to
+    for (i=0; i < Icc ->TagCount; i++) {
+
+        if (Icc ->TagNames[i] == (cmsTagSignature) 0 || Icc ->TagLinked[i] != (cmsTagSignature) 0) continue;
+        if (Icc ->TagPtrs[i] != NULL) continue;
+
+        Icc ->TagPtrs[i] = ReadTagBytes(Icc, i);
+        Icc ->TagSaveAsRaw[i] = (Icc ->TagPtrs[i] != NULL);
+        Icc ->TagTypeHandlers[i] = NULL;        // Failed reads leave it set
+    }
+
+    Icc ->IsFrozen = TRUE;
+    return TRUE;
+}
+
+cmsBool CMSEXPORT cmsIsProfileFrozen(cmsHPROFILE hProfile)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+
+    if (Icc == NULL) return FALSE;
+    return Icc ->IsFrozen;
+}
+
+// Frozen copy of a profile, made in memory. Tags are duplicated by the type handlers they were read or written with,
+// so the copy reads exactly as the original. The original is left unfrozen; tags it had not read yet are read now.
+cmsHPROFILE _cmsDupFrozenProfile(cmsHPROFILE hProfile)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    _cmsICCPROFILE* NewIcc;
+    cmsHPROFILE hNew;
+    cmsTagTypeHandler* TypeHandler;
+    cmsTagTypeHandler LocalTypeHandler;
+    cmsTagDescriptor* TagDescriptor;
+    void* OldBlock;
+    cmsUInt32Number i;
+
+    if (Icc ->IsWrite) {
+        cmsSignalError(Icc ->ContextID, cmsERROR_NOT_SUITABLE, "Profiles open for writing cannot be frozen");
+        return NULL;
+    }
+
+    hNew = cmsCreateProfilePlaceholder(Icc ->ContextID);
+    if (hNew == NULL) return NULL;
+
+    NewIcc = (_cmsICCPROFILE*) hNew;
+
+    NewIcc ->Created         = Icc ->Created;
+    NewIcc ->Version         = Icc ->Version;
+    NewIcc ->DeviceClass     = Icc ->DeviceClass;
+    NewIcc ->ColorSpace      = Icc ->ColorSpace;
+    NewIcc ->PCS             = Icc ->PCS;
+    NewIcc ->RenderingIntent = Icc ->RenderingIntent;
+    NewIcc ->flags           = Icc ->flags;
+    NewIcc ->manufacturer    = Icc ->manufacturer;
+    NewIcc ->model           = Icc ->model;
+    NewIcc ->attributes      = Icc ->attributes;
+    NewIcc ->ProfileID       = Icc ->ProfileID;
+
+    if (Icc ->TagCount > 0) {
+        if (!ResizeTagDirectory(NewIcc, Icc ->TagCapacity, &OldBlock)) goto Error;
+    }
+
+    for (i=0; i < Icc ->TagCount; i++) {
+
+        cmsTagSignature sig = Icc ->TagNames[i];
+
+        NewIcc ->TagNames[i]     = sig;
+        NewIcc ->TagLinked[i]    = Icc ->TagLinked[i];
+        NewIcc ->TagSizes[i]     = Icc ->TagSizes[i];
+        NewIcc ->TagOffsets[i]   = Icc ->TagOffsets[i];
+        NewIcc ->TagSaveAsRaw[i] = Icc ->TagSaveAsRaw[i];
+        NewIcc ->TagCount        = i + 1;
+
+        if (sig == (cmsTagSignature) 0) continue;
+        IndexTag(NewIcc, sig, i);
+
+        // Linked tags are read through the tag they link to
+        if (Icc ->TagLinked[i] == (cmsTagSignature) 0 && !Icc ->TagSaveAsRaw[i])
+            cmsReadTag(hProfile, sig);
+
+        // Unsupported or broken tags are kept as raw bytes, the copy has no IO handler to read them later
+        if (Icc ->TagPtrs[i] == NULL) {
+
+            if (Icc ->TagLinked[i] == (cmsTagSignature) 0) {
+
+                NewIcc ->TagPtrs[i] = ReadTagBytes(Icc, i);
+                NewIcc ->TagSaveAsRaw[i] = (NewIcc ->TagPtrs[i] != NULL);
+            }
+            continue;
+        }
+
+        if (Icc ->TagSaveAsRaw[i]) {
+
+            NewIcc ->TagPtrs[i] = _cmsDupMem(Icc ->ContextID, Icc ->TagPtrs[i], Icc ->TagSizes[i]);
+        }
+        else {
+
+            TagDescriptor = _cmsGetTagDescriptor(sig);
+            if (TagDescriptor == NULL) continue;
+
+            NewIcc ->TagTypeHandlers[i] = Icc ->TagTypeHandlers[i];
+
+            TypeHandler = SetHandlerContext(&LocalTypeHandler, Icc ->TagTypeHandlers[i], NewIcc);
+            NewIcc ->TagPtrs[i] = TypeHandler ->DupPtr(TypeHandler, Icc ->TagPtrs[i], TagDescriptor ->ElemCount);
+        }
+
+        if (NewIcc ->TagPtrs[i] == NULL) goto Error;
+    }
+
+    NewIcc ->IsFrozen = TRUE;
+    return hNew;
+
+Error:
+    cmsCloseProfile(hNew);
+    return NULL;
+}
+
+
+// Derived results of frozen profiles. Several threads may build transforms out of the same frozen profile at
+// once, so the memo has its own lock. Whatever is stored is never changed afterwards.
+
+#define LockMemo(Icc)    while (_cmsAtomicExchange(&(Icc) ->MemoLock, 1)) { }
+#define UnlockMemo(Icc)  _cmsAtomicRelease(&(Icc) ->MemoLock)
+
+cmsPipeline* _cmsReadMemoShaper(cmsHPROFILE hProfile, int Direction)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsPipeline* Lut;
+
+    if (!Icc ->IsFrozen) return NULL;
+
+    LockMemo(Icc);
+    Lut = Icc ->MemoShaper[Direction];
+    UnlockMemo(Icc);
+
+    return Lut == NULL ? NULL : cmsPipelineDup(Lut);
+}
+
+cmsPipeline* _cmsWriteMemoShaper(cmsHPROFILE hProfile, int Direction, cmsPipeline* Lut)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsPipeline* Copy;
+
+    if (Lut == NULL || !Icc ->IsFrozen) return Lut;
+
+    Copy = cmsPipelineDup(Lut);
+    if (Copy == NULL) return Lut;
+
+    LockMemo(Icc);
+    if (Icc ->MemoShaper[Direction] == NULL) {
+        Icc ->MemoShaper[Direction] = Copy;
+        Copy = NULL;
+    }
+    UnlockMemo(Icc);
+
+    // Another thread got there first
+    if (Copy != NULL) cmsPipelineFree(Copy);
+    return Lut;
+}
+
+cmsBool _cmsReadMemoBlackPoint(cmsHPROFILE hProfile, int Direction, cmsUInt32Number Intent, cmsCIEXYZ* BlackPoint)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsBool Found;
+
+    if (!Icc ->IsFrozen || Intent > INTENT_ABSOLUTE_COLORIMETRIC) return FALSE;
+
+    LockMemo(Icc);
+    Found = (Icc ->MemoBlackPointSet[Direction] & (1 << Intent)) != 0;
+    if (Found) *BlackPoint = Icc ->MemoBlackPoint[Direction][Intent];
+    UnlockMemo(Icc);
+
+    return Found;
+}
+
+void _cmsWriteMemoBlackPoint(cmsHPROFILE hProfile, int Direction, cmsUInt32Number Intent, const cmsCIEXYZ* BlackPoint)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+
+    if (!Icc ->IsFrozen || Intent > INTENT_ABSOLUTE_COLORIMETRIC) return;
+
+    LockMemo(Icc);
+    Icc ->MemoBlackPoint[Direction][Intent] = *BlackPoint;
+    Icc ->MemoBlackPointSet[Direction] |= (1 << Intent);
+    UnlockMemo(Icc);
+}
+
+cmsBool _cmsReadMemoCHAD(cmsHPROFILE hProfile, cmsMAT3* CHAD)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsBool Found;
+
+    if (!Icc ->IsFrozen) return FALSE;
+
+    LockMemo(Icc);
+    Found = Icc ->MemoCHADSet;
+    if (Found) *CHAD = Icc ->MemoCHAD;
+    UnlockMemo(Icc);
+
+    return Found;
+}
+
+void _cmsWriteMemoCHAD(cmsHPROFILE hProfile, const cmsMAT3* CHAD)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+
+    if (!Icc ->IsFrozen) return;
+
+    LockMemo(Icc);
+    Icc ->MemoCHAD    = *CHAD;
+    Icc ->MemoCHADSet = TRUE;
+    UnlockMemo(Icc);
+}
+
 
 // -------------------------------------------------------------------------------------------------------------------
 
@@ -1349,6 +1827,7 @@ void* CMSEXPORT cmsReadTag(cmsHPROFILE hProfile, cmsTagSignature sig)
     _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile; 
     cmsIOHANDLER* io = Icc ->IOhandler;
     cmsTagTypeHandler* TypeHandler;
+    cmsTagTypeHandler LocalTypeHandler;
     cmsTagDescriptor*  TagDescriptor;
     cmsTagTypeSignature BaseType;
     cmsUInt32Number Offset, TagSize;
@@ -1366,6 +1845,9 @@ void* CMSEXPORT cmsReadTag(cmsHPROFILE hProfile, cmsTagSignature sig)
 		return Icc -> TagPtrs[n];
 	}
 
+    // Frozen profiles have already read all they could. Touching the IO handler is not safe from other threads
+    if (Icc ->IsFrozen) return NULL;
+
 	// We need to read it. Get the offset and size to the file
     Offset    = Icc -> TagOffsets[n];
     TagSize   = Icc -> TagSizes[n]; 
@@ -1394,8 +1876,7 @@ void* CMSEXPORT cmsReadTag(cmsHPROFILE hProfile, cmsTagSignature sig)
     // Read the tag
     Icc -> TagTypeHandlers[n] = TypeHandler;
 
-    TypeHandler ->ContextID = Icc ->ContextID;
-    TypeHandler ->ICCVersion = Icc ->Version;
+    TypeHandler = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
     Icc -> TagPtrs[n] = TypeHandler ->ReadPtr(TypeHandler, io, &ElemCount, TagSize);
 
     // The tag type is supported, but something wrong happend and we cannot read the tag.
@@ -1449,6 +1930,7 @@ cmsBool CMSEXPORT cmsWriteTag(cmsHPROFILE hProfile, cmsTagSignature sig, const v
 {
     _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;  
     cmsTagTypeHandler* TypeHandler = NULL;
+    cmsTagTypeHandler LocalTypeHandler;
     cmsTagDescriptor* TagDescriptor = NULL;
     cmsTagTypeSignature Type;
     int i;
@@ -1456,6 +1938,8 @@ cmsBool CMSEXPORT cmsWriteTag(cmsHPROFILE hProfile, cmsTagSignature sig, const v
     char TypeString[5], SigString[5];
 
 
+    if (!IsWritable(Icc)) return FALSE;
+
     if (data == NULL) {
 
          i = _cmsSearchTag(Icc, sig, FALSE);
@@ -1479,22 +1963,17 @@ cmsBool CMSEXPORT cmsWriteTag(cmsHPROFILE hProfile, cmsTagSignature sig, const v
 
                 if (TypeHandler != NULL) {
 
-                    TypeHandler ->ContextID = Icc ->ContextID;              // As an additional parameter
-                    TypeHandler ->ICCVersion = Icc ->Version;
-                    TypeHandler->FreePtr(TypeHandler, Icc -> TagPtrs[i]);
+                    TypeHandler = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
+                    TypeHandler ->FreePtr(TypeHandler, Icc -> TagPtrs[i]);
                 }
             }
         }
     }
     else  {
-        // New one
-        i = Icc -> TagCount;
-
-        if (i >= MAX_TABLE_TAG) {
-            cmsSignalError(Icc ->ContextID, cmsERROR_RANGE, "Too many tags (%d)", MAX_TABLE_TAG);
-            return FALSE;
-        }
+        // New one. It is named (and indexed) only once written
+        if (!GrowTagDirectory(Icc)) return FALSE;
 
+        i = Icc -> TagCount;
         Icc -> TagCount++;
     }
 
@@ -1555,11 +2034,11 @@ cmsBool CMSEXPORT cmsWriteTag(cmsHPROFILE hProfile, cmsTagSignature sig, const v
     // Fill fields on icc structure
     Icc ->TagTypeHandlers[i]  = TypeHandler;
     Icc ->TagNames[i]         = sig;
+    IndexTag(Icc, sig, i);
     Icc ->TagSizes[i]         = 0;
     Icc ->TagOffsets[i]       = 0;
 
-    TypeHandler ->ContextID  = Icc ->ContextID;
-    TypeHandler ->ICCVersion = Icc ->Version;
+    TypeHandler              = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
     Icc ->TagPtrs[i]         = TypeHandler ->DupPtr(TypeHandler, data, TagDescriptor ->ElemCount); 
 
     if (Icc ->TagPtrs[i] == NULL)  {
@@ -1587,6 +2066,7 @@ cmsInt32Number CMSEXPORT cmsReadRawTag(cmsHPROFILE hProfile, cmsTagSignature sig
     int i;
     cmsIOHANDLER* MemIO;
     cmsTagTypeHandler* TypeHandler = NULL;
+    cmsTagTypeHandler LocalTypeHandler;
     cmsTagDescriptor* TagDescriptor = NULL;
     cmsUInt32Number rc;
     cmsUInt32Number Offset, TagSize;
@@ -1598,6 +2078,9 @@ cmsInt32Number CMSEXPORT cmsReadRawTag(cmsHPROFILE hProfile, cmsTagSignature sig
 	// It is already read?
     if (Icc -> TagPtrs[i] == NULL) {
 
+        // Frozen profiles keep all that could be read. Their IO handler is not safe to share, or there is none
+        if (Icc ->IsFrozen) return 0;
+
         // No yet, get original position
         Offset   = Icc ->TagOffsets[i];
         TagSize  = Icc ->TagSizes[i];
@@ -1655,8 +2138,7 @@ cmsInt32Number CMSEXPORT cmsReadRawTag(cmsHPROFILE hProfile, cmsTagSignature sig
     }
     
     // Serialize
-    TypeHandler ->ContextID  = Icc ->ContextID;
-    TypeHandler ->ICCVersion = Icc ->Version;
+    TypeHandler = SetHandlerContext(&LocalTypeHandler, TypeHandler, Icc);
 
     if (!_cmsWriteTypeBase(MemIO, TypeHandler ->Signature)) {
         cmsCloseIOhandler(MemIO);      
@@ -1731,3 +2213,471 @@ cmsTagSignature  CMSEXPORT cmsTagLinkedTo(cmsHPROFILE hProfile, cmsTagSignature
 
     return Icc -> TagLinked[i];
 }
+
+
+// -------------------------------------------------------------------------------------------------------------------
+// Profile validation
+
+#define VALIDATION_PROBES   17
+
+static
+void ReportIssue(cmsProfileValidation* Report, cmsUInt32Number Area, cmsBool IsError, const char* Fmt, ...)
+{
+    va_list args;
+
+    if (!IsError) {
+        Report ->nWarnings++;
+        return;
+    }
+
+    if (Report ->nErrors++ == 0) {
+
+        va_start(args, Fmt);
+        vsnprintf(Report ->FirstError, sizeof(Report ->FirstError) - 1, Fmt, args);
+        va_end(args);
+    }
+
+    Report ->Failed |= Area;
+}
+
+static
+cmsBool IsFinite(cmsFloat64Number x)
+{
+    return (x == x) && (x - x == 0.0);
+}
+
+static
+cmsUInt32Number ReadBE32(const cmsUInt8Number* p)
+{
+    return ((cmsUInt32Number) p[0] << 24) | ((cmsUInt32Number) p[1] << 16) | ((cmsUInt32Number) p[2] << 8) | p[3];
+}
+
+// Where a tag lives in the file, to find overlaps
+typedef struct {
+    cmsUInt32Number Offset;
+    cmsUInt32Number Size;
+    cmsUInt32Number Index;     // Position in the directory
+
+} _cmsTagSpan;
+
+// Sorts by offset, then by size. Identical blocks end up together
+static
+int CompareTagSpans(const void* a, const void* b)
+{
+    const _cmsTagSpan* s1 = (const _cmsTagSpan*) a;
+    const _cmsTagSpan* s2 = (const _cmsTagSpan*) b;
+
+    if (s1 ->Offset != s2 ->Offset) return s1 ->Offset < s2 ->Offset ? -1 : 1;
+    if (s1 ->Size   != s2 ->Size)   return s1 ->Size   < s2 ->Size   ? -1 : 1;
+
+    return s1 ->Index < s2 ->Index ? -1 : (s1 ->Index > s2 ->Index);
+}
+
+// Checks on the raw bytes: header, tag directory and profile ID
+static
+void ValidateRaw(_cmsICCPROFILE* Icc, const cmsUInt8Number* Mem, cmsUInt32Number FileSize, cmsBool FailFast, cmsProfileValidation* Report)
+{
+    cmsUInt32Number HeaderSize, TagCount, TableEnd, i, n, MaxEnd;
+    cmsUInt32Number Offset, Size;
+    _cmsTagSpan* Spans;
+    const cmsUInt8Number* Directory = Mem + sizeof(cmsICCHeader) + sizeof(cmsUInt32Number);
+    char Sig[5];
+
+    if (FileSize < sizeof(cmsICCHeader) + sizeof(cmsUInt32Number)) {
+        ReportIssue(Report, cmsVALIDATE_HEADER, TRUE, "Truncated profile (%u bytes)", FileSize);
+        return;
+    }
+
+    HeaderSize = ReadBE32(Mem);
+    if (HeaderSize > FileSize) {
+        ReportIssue(Report, cmsVALIDATE_HEADER, TRUE, "Header size %u exceeds file size %u", HeaderSize, FileSize);
+        HeaderSize = FileSize;
+    }
+    else
+    if (HeaderSize < FileSize)
+        ReportIssue(Report, cmsVALIDATE_HEADER, FALSE, "Trailing bytes after the profile");
+
+    if (FailFast && Report ->nErrors > 0) return;
+
+    if (Mem[8] < 2 || Mem[8] > 4)
+        ReportIssue(Report, cmsVALIDATE_HEADER, FALSE, "Unknown major version %d", Mem[8]);
+
+    TagCount = ReadBE32(Mem + sizeof(cmsICCHeader));
+
+    if (HeaderSize < sizeof(cmsICCHeader) + sizeof(cmsUInt32Number) ||
+        TagCount > (HeaderSize - sizeof(cmsICCHeader) - sizeof(cmsUInt32Number)) / sizeof(cmsTagEntry)) {
+        ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Tag directory of %u entries does not fit", TagCount);
+        return;
+    }
+
+    TableEnd = sizeof(cmsICCHeader) + sizeof(cmsUInt32Number) + TagCount * sizeof(cmsTagEntry);
+
+    for (i=0; i < TagCount; i++) {
+
+        const cmsUInt8Number* Entry = Directory + i * sizeof(cmsTagEntry);
+
+        _cmsTagSignature2String(Sig, (cmsTagSignature) ReadBE32(Entry));
+        Offset = ReadBE32(Entry + 4);
+        Size   = ReadBE32(Entry + 8);
+
+        if (Offset + Size > HeaderSize || Offset + Size < Offset)
+            ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Tag '%s' is out of bounds", Sig);
+        else
+        if (Offset < TableEnd)
+            ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Tag '%s' overlaps the tag directory", Sig);
+        else
+        if (Size < 8)
+            ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Tag '%s' is too small", Sig);
+
+        if (Offset & 3)
+            ReportIssue(Report, cmsVALIDATE_TAGTABLE, FALSE, "Tag '%s' is not aligned", Sig);
+
+        if (FailFast && Report ->nErrors > 0) return;
+    }
+
+    // Tags may share the very same data, but not partially. The count is bounded only by the file size, 
+    // so tags in bounds are sorted by offset and each one is checked against the farthest end seen so far
+    if (TagCount > 0) {
+
+        Spans = (_cmsTagSpan*) _cmsCalloc(Icc ->ContextID, TagCount, sizeof(_cmsTagSpan));
+        if (Spans == NULL) {
+            ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Not enough memory to check the tag directory");
+            return;
+        }
+
+        for (i=n=0; i < TagCount; i++) {
+
+            Offset = ReadBE32(Directory + i * sizeof(cmsTagEntry) + 4);
+            Size   = ReadBE32(Directory + i * sizeof(cmsTagEntry) + 8);
+
+            if (Offset + Size > HeaderSize || Offset + Size < Offset) continue;
+
+            Spans[n].Offset = Offset;
+            Spans[n].Size   = Size;
+            Spans[n].Index  = i;
+            n++;
+        }
+
+        qsort(Spans, n, sizeof(_cmsTagSpan), CompareTagSpans);
+
+        for (i=0, MaxEnd = 0; i < n; i++) {
+
+            if (i > 0 && Spans[i].Offset == Spans[i-1].Offset && Spans[i].Size == Spans[i-1].Size) continue;
+
+            if (Spans[i].Offset < MaxEnd) {
+
+                _cmsTagSignature2String(Sig, (cmsTagSignature) ReadBE32(Directory + Spans[i].Index * sizeof(cmsTagEntry)));
+                ReportIssue(Report, cmsVALIDATE_TAGTABLE, TRUE, "Tag '%s' overlaps other tag", Sig);
+                if (FailFast) break;
+            }
+
+            if (Spans[i].Offset + Spans[i].Size > MaxEnd)
+                MaxEnd = Spans[i].Offset + Spans[i].Size;
+        }
+
+        _cmsFree(Icc ->ContextID, Spans);
+
+        if (FailFast && Report ->nErrors > 0) return;
+    }
+
+    // Profile ID, if present
+    for (i=0; i < 16; i++)
+        if (Icc ->ProfileID.ID8[i] != 0) break;
+
+    if (i < 16) {
+
+        cmsProfileID ID;
+
+        if (!_cmsMD5computeIDFromMem(Icc ->ContextID, Mem, HeaderSize, FALSE, &ID)) return;
+
+        if (memcmp(ID.ID8, Icc ->ProfileID.ID8, 16) != 0) {
+
+            if (!_cmsMD5computeIDFromMem(Icc ->ContextID, Mem, HeaderSize, TRUE, &ID)) return;
+
+            if (memcmp(ID.ID8, Icc ->ProfileID.ID8, 16) != 0)
+                ReportIssue(Report, cmsVALIDATE_ID, TRUE, "Profile ID does not match the contents");
+        }
+    }
+}
+
+static
+void ValidateCurve(const cmsToneCurve* Curve, const char* Sig, cmsProfileValidation* Report)
+{
+    int i;
+
+    for (i=0; i < 256; i++) {
+
+        if (!IsFinite(cmsEvalToneCurveFloat(Curve, (cmsFloat32Number) (i / 255.0)))) {
+            ReportIssue(Report, cmsVALIDATE_CURVES, TRUE, "Curve '%s' is not finite", Sig);
+            return;
+        }
+    }
+
+    if (!cmsIsToneCurveMonotonic(Curve))
+        ReportIssue(Report, cmsVALIDATE_CURVES, FALSE, "Curve '%s' is not monotonic", Sig);
+}
+
+// Channels expected on pipelines, depending on the tag. Zero if unknown
+static
+void ExpectedChannels(_cmsICCPROFILE* Icc, cmsTagSignature sig, cmsUInt32Number* In, cmsUInt32Number* Out)
+{
+    cmsUInt32Number Dev = cmsChannelsOf(Icc ->ColorSpace);
+    cmsUInt32Number PCS = cmsChannelsOf(Icc ->PCS);
+
+    *In = *Out = 0;
+
+    switch (sig) {
+
+    case cmsSigAToB0Tag: case cmsSigAToB1Tag: case cmsSigAToB2Tag:
+    case cmsSigDToB0Tag: case cmsSigDToB1Tag: case cmsSigDToB2Tag: case cmsSigDToB3Tag:
+        *In = Dev; *Out = PCS;
+        break;
+
+    case cmsSigBToA0Tag: case cmsSigBToA1Tag: case cmsSigBToA2Tag:
+    case cmsSigBToD0Tag: case cmsSigBToD1Tag: case cmsSigBToD2Tag: case cmsSigBToD3Tag:
+        *In = PCS; *Out = Dev;
+        break;
+
+    case cmsSigGamutTag:
+        *In = PCS; *Out = 1;
+        break;
+
+    case cmsSigPreview0Tag: case cmsSigPreview1Tag: case cmsSigPreview2Tag:
+        *In = PCS; *Out = PCS;
+        break;
+
+    default:;
+    }
+}
+
+// Channel counts, and outputs on the gray axis and on each primary
+static
+void ValidatePipeline(_cmsICCPROFILE* Icc, cmsTagSignature sig, const cmsPipeline* Lut, const char* Sig, cmsProfileValidation* Report)
+{
+    cmsFloat32Number In[cmsMAXCHANNELS], Out[cmsMAXCHANNELS];
+    cmsUInt32Number nIn, nOut, ExpIn, ExpOut, i, j, k;
+
+    nIn  = cmsPipelineInputChannels(Lut);
+    nOut = cmsPipelineOutputChannels(Lut);
+
+    ExpectedChannels(Icc, sig, &ExpIn, &ExpOut);
+
+    if ((ExpIn != 0 && nIn != ExpIn) || (ExpOut != 0 && nOut != ExpOut)) {
+        ReportIssue(Report, cmsVALIDATE_CLUT, TRUE, "'%s' has %u inputs and %u outputs, expected %u and %u", Sig, nIn, nOut, ExpIn, ExpOut);
+        return;
+    }
+
+    if (nIn == 0 || nIn >= cmsMAXCHANNELS || nOut == 0 || nOut >= cmsMAXCHANNELS) {
+        ReportIssue(Report, cmsVALIDATE_CLUT, TRUE, "'%s' has wrong number of channels", Sig);
+        return;
+    }
+
+    for (i=0; i < VALIDATION_PROBES + nIn; i++) {
+
+        for (j=0; j < nIn; j++) {
+
+            if (i < VALIDATION_PROBES)
+                In[j] = (cmsFloat32Number) i / (VALIDATION_PROBES - 1);
+            else
+                In[j] = (j == i - VALIDATION_PROBES) ? 1.0F : 0.0F;
+        }
+
+        cmsPipelineEvalFloat(In, Out, Lut);
+
+        for (k=0; k < nOut; k++) {
+
+            if (!IsFinite(Out[k])) {
+                ReportIssue(Report, cmsVALIDATE_CLUT, TRUE, "'%s' evaluates to non-finite values", Sig);
+                return;
+            }
+        }
+    }
+}
+
+static
+void ValidateMatrix(cmsHPROFILE hProfile, cmsProfileValidation* Report)
+{
+    cmsCIEXYZ *Red, *Green, *Blue;
+    cmsMAT3 Mat, Inv;
+    cmsFloat64Number dX, dY, dZ;
+
+    Red   = (cmsCIEXYZ*) cmsReadTag(hProfile, cmsSigRedColorantTag);
+    Green = (cmsCIEXYZ*) cmsReadTag(hProfile, cmsSigGreenColorantTag);
+    Blue  = (cmsCIEXYZ*) cmsReadTag(hProfile, cmsSigBlueColorantTag);
+
+    if (Red == NULL || Green == NULL || Blue == NULL) return;
+
+    _cmsVEC3init(&Mat.v[0], Red ->X, Green ->X, Blue ->X);
+    _cmsVEC3init(&Mat.v[1], Red ->Y, Green ->Y, Blue ->Y);
+    _cmsVEC3init(&Mat.v[2], Red ->Z, Green ->Z, Blue ->Z);
+
+    if (!IsFinite(Mat.v[0].n[0] + Mat.v[0].n[1] + Mat.v[0].n[2] +
+                  Mat.v[1].n[0] + Mat.v[1].n[1] + Mat.v[1].n[2] +
+                  Mat.v[2].n[0] + Mat.v[2].n[1] + Mat.v[2].n[2]) || !_cmsMAT3inverse(&Mat, &Inv)) {
+
+        ReportIssue(Report, cmsVALIDATE_MATRIX, TRUE, "Colorant matrix is singular");
+        return;
+    }
+
+    // Colorants should add up to the PCS white
+    dX = Red ->X + Green ->X + Blue ->X - cmsD50X;
+    dY = Red ->Y + Green ->Y + Blue ->Y - cmsD50Y;
+    dZ = Red ->Z + Green ->Z + Blue ->Z - cmsD50Z;
+
+    if (dX*dX + dY*dY + dZ*dZ > 0.01)
+        ReportIssue(Report, cmsVALIDATE_MATRIX, FALSE, "Colorants do not add up to D50");
+}
+
+// Mem holds the whole file, or is NULL if the profile does not come from one
+static
+cmsBool ValidateProfile(_cmsICCPROFILE* Icc, const cmsUInt8Number* Mem, cmsUInt32Number FileSize, cmsBool FailFast, cmsProfileValidation* Report)
+{
+    cmsHPROFILE hProfile = (cmsHPROFILE) Icc;
+    cmsUInt32Number i;
+    char Sig[5];
+
+    Report ->nTags = Icc ->TagCount;
+
+    if (Mem != NULL) {
+
+        ValidateRaw(Icc, Mem, FileSize, FailFast, Report);
+        if (FailFast && Report ->nErrors > 0) return FALSE;
+    }
+
+    // Decode all tags known to the library, and check them depending on the type
+    for (i=0; i < Icc ->TagCount; i++) {
+
+        cmsTagSignature sig = Icc ->TagNames[i];
+        void* Tag;
+        int n;
+
+        if (sig == (cmsTagSignature) 0) continue;
+        if (_cmsGetTagDescriptor(sig) == NULL) continue;                // Private tags
+
+        _cmsTagSignature2String(Sig, sig);
+
+        // Frozen profiles keep the tags they could not decode as raw bytes
+        if (Icc ->TagSaveAsRaw[i]) {
+
+            if (Icc ->IsFrozen) {
+                ReportIssue(Report, cmsVALIDATE_DECODE, TRUE, "Tag '%s' cannot be decoded", Sig);
+                if (FailFast) return FALSE;
+            }
+            continue;
+        }
+
+        Tag = cmsReadTag(hProfile, sig);
+        if (Tag == NULL) {
+
+            ReportIssue(Report, cmsVALIDATE_DECODE, TRUE, "Tag '%s' cannot be decoded", Sig);
+            if (FailFast) return FALSE;
+            continue;
+        }
+
+        n = _cmsSearchTag(Icc, sig, TRUE);
+        if (n < 0 || Icc ->TagTypeHandlers[n] == NULL) continue;
+
+        switch (Icc ->TagTypeHandlers[n] ->Signature) {
+
+        case cmsSigCurveType:
+        case cmsSigParametricCurveType:
+            ValidateCurve((cmsToneCurve*) Tag, Sig, Report);
+            break;
+
+        case cmsSigLut8Type:
+        case cmsSigLut16Type:
+        case cmsSigLutAtoBType:
+        case cmsSigLutBtoAType:
+        case cmsSigMultiProcessElementType:
+            ValidatePipeline(Icc, sig, (cmsPipeline*) Tag, Sig, Report);
+            break;
+
+        case cmsSigXYZType: {
+
+            cmsCIEXYZ* XYZ = (cmsCIEXYZ*) Tag;
+
+            if (!IsFinite(XYZ ->X) || !IsFinite(XYZ ->Y) || !IsFinite(XYZ ->Z))
+                ReportIssue(Report, cmsVALIDATE_DECODE, TRUE, "Tag '%s' is not finite", Sig);
+            else
+            if (sig == cmsSigMediaWhitePointTag && XYZ ->Y <= 0)
+                ReportIssue(Report, cmsVALIDATE_DECODE, FALSE, "Media white point has no luminance");
+            }
+            break;
+
+        default:;
+        }
+
+        if (FailFast && Report ->nErrors > 0) return FALSE;
+    }
+
+    if (cmsIsMatrixShaper(hProfile))
+        ValidateMatrix(hProfile, Report);
+
+    return Report ->nErrors == 0;
+}
+
+cmsBool CMSEXPORT cmsValidateProfile(cmsHPROFILE hProfile, cmsBool FailFast, cmsProfileValidation* Report)
+{
+    _cmsICCPROFILE* Icc = (_cmsICCPROFILE*) hProfile;
+    cmsProfileValidation Local;
+    cmsIOHANDLER* io;
+    cmsUInt8Number* Mem;
+    cmsBool rc;
+
+    if (Report == NULL) Report = &Local;
+    memset(Report, 0, sizeof(cmsProfileValidation));
+
+    if (Icc == NULL) return FALSE;
+
+    // Raw checks need the whole file in memory. Memory iohandlers already have it
+    io = Icc ->IOhandler;
+    if (io == NULL || io ->ReportedSize == 0)
+        return ValidateProfile(Icc, NULL, 0, FailFast, Report);
+
+    if (io ->Read == MemoryRead)
+        return ValidateProfile(Icc, ((FILEMEM*) io ->stream) ->Block, io ->ReportedSize, FailFast, Report);
+
+    Mem = (cmsUInt8Number*) _cmsMalloc(Icc ->ContextID, io ->ReportedSize);
+    if (Mem == NULL) return FALSE;
+
+    if (!io ->Seek(io, 0) || io ->Read(io, Mem, io ->ReportedSize, 1) != 1) {
+
+        ReportIssue(Report, cmsVALIDATE_HEADER, TRUE, "Cannot read the profile");
+        rc = FailFast ? FALSE : ValidateProfile(Icc, NULL, 0, FailFast, Report);
+    }
+    else
+        rc = ValidateProfile(Icc, Mem, io ->ReportedSize, FailFast, Report);
+
+    _cmsFree(Icc ->ContextID, Mem);
+    return rc;
+}
+
+// Same, on the bytes of a profile the caller keeps, as a memory mapped file. Nothing is copied
+cmsBool CMSEXPORT cmsValidateProfileMem(cmsContext ContextID, const void* MemPtr, cmsUInt32Number dwSize, cmsBool FailFast, cmsProfileValidation* Report)
+{
+    _cmsICCPROFILE* Icc;
+    cmsHPROFILE hProfile;
+    cmsProfileValidation Local;
+    cmsBool rc;
+
+    if (Report == NULL) Report = &Local;
+    memset(Report, 0, sizeof(cmsProfileValidation));
+
+    hProfile = cmsCreateProfilePlaceholder(ContextID);
+    if (hProfile == NULL) return FALSE;
+
+    Icc = (_cmsICCPROFILE*) hProfile;
+
+    Icc ->IOhandler = OpenIOhandlerFromBorrowedMem(ContextID, MemPtr, dwSize);
+    if (Icc ->IOhandler == NULL || !_cmsReadHeader(Icc)) {
+
+        ReportIssue(Report, cmsVALIDATE_HEADER, TRUE, "Not an ICC profile");
+        cmsCloseProfile(hProfile);
+        return FALSE;
+    }
+
+    rc = ValidateProfile(Icc, (const cmsUInt8Number*) MemPtr, dwSize, FailFast, Report);
+
+    cmsCloseProfile(hProfile);
+    return rc;
+}
@@ -121,7 +121,13 @@ cmsBool  _cmsReadCHAD(cmsMAT3* Dest, cmsHPROFILE hProfile)
                 return TRUE;
             }
 
-            return _cmsAdaptationMatrix(Dest, NULL, White, cmsD50_XYZ());
+            // Computed from the white point, so worth keeping
+            if (_cmsReadMemoCHAD(hProfile, Dest)) return TRUE;
+
+            if (!_cmsAdaptationMatrix(Dest, NULL, White, cmsD50_XYZ())) return FALSE;
+
+            _cmsWriteMemoCHAD(hProfile, Dest);
+            return TRUE;
         }
     }
 
@@ -269,6 +275,7 @@ cmsPipeline* _cmsReadFloatInputTag(cmsHPROFILE hProfile, cmsTagSignature tagFloa
 // is adjusted here in order to create a LUT that takes care of all those details
 cmsPipeline* _cmsReadInputLUT(cmsHPROFILE hProfile, int Intent)
 {
+    cmsPipeline* Lut;
     cmsTagTypeSignature OriginalType;
     cmsTagSignature tag16    = Device2PCS16[Intent];
     cmsTagSignature tagFloat = Device2PCSFloat[Intent];
@@ -277,7 +284,6 @@ cmsPipeline* _cmsReadInputLUT(cmsHPROFILE hProfile, int Intent)
     // On named color, take the appropiate tag
     if (cmsGetDeviceClass(hProfile) == cmsSigNamedColorClass) {
 
-        cmsPipeline* Lut; 
         cmsNAMEDCOLORLIST* nc = (cmsNAMEDCOLORLIST*) cmsReadTag(hProfile, cmsSigNamedColor2Tag);
 
         if (nc == NULL) return NULL;
@@ -310,7 +316,7 @@ cmsPipeline* _cmsReadInputLUT(cmsHPROFILE hProfile, int Intent)
         // Check profile version and LUT type. Do the necessary adjustments if needed
 
         // First read the tag
-        cmsPipeline* Lut = (cmsPipeline*) cmsReadTag(hProfile, tag16);
+        Lut = (cmsPipeline*) cmsReadTag(hProfile, tag16);
         if (Lut == NULL) return NULL;
 
         // After reading it, we have now info about the original type
@@ -332,18 +338,24 @@ cmsPipeline* _cmsReadInputLUT(cmsHPROFILE hProfile, int Intent)
         return Lut;
     }   
 
-    // Lut was not found, try to create a matrix-shaper
+    // Lut was not found, try to create a matrix-shaper. That is the same for all intents
+    Lut = _cmsReadMemoShaper(hProfile, LCMS_USED_AS_INPUT);
+    if (Lut != NULL) return Lut;
 
     // Check if this is a grayscale profile.
     if (cmsGetColorSpace(hProfile) == cmsSigGrayData) {
 
         // if so, build appropiate conversion tables. 
         // The tables are the PCS iluminant, scaled across GrayTRC
-        return BuildGrayInputMatrixPipeline(hProfile);              
+        Lut = BuildGrayInputMatrixPipeline(hProfile);              
+    }
+    else {
+
+        // Not gray, create a normal matrix-shaper 
+        Lut = BuildRGBInputMatrixShaper(hProfile);
     }
 
-    // Not gray, create a normal matrix-shaper 
-    return BuildRGBInputMatrixShaper(hProfile);
+    return _cmsWriteMemoShaper(hProfile, LCMS_USED_AS_INPUT, Lut);
 }
 
 // ---------------------------------------------------------------------------------------------------------------
@@ -488,6 +500,7 @@ cmsPipeline* _cmsReadFloatOutputTag(cmsHPROFILE hProfile, cmsTagSignature tagFlo
 // Create an output MPE LUT from agiven profile. Version mismatches are handled here
 cmsPipeline* _cmsReadOutputLUT(cmsHPROFILE hProfile, int Intent)
 {
+    cmsPipeline* Lut;
     cmsTagTypeSignature OriginalType;
     cmsTagSignature tag16    = PCS2Device16[Intent];
     cmsTagSignature tagFloat = PCS2DeviceFloat[Intent];
@@ -509,7 +522,7 @@ cmsPipeline* _cmsReadOutputLUT(cmsHPROFILE hProfile, int Intent)
         // Check profile version and LUT type. Do the necessary adjustments if needed
 
         // First read the tag
-        cmsPipeline* Lut = (cmsPipeline*) cmsReadTag(hProfile, tag16);
+        Lut = (cmsPipeline*) cmsReadTag(hProfile, tag16);
         if (Lut == NULL) return NULL;
 
         // After reading it, we have info about the original type
@@ -538,18 +551,24 @@ cmsPipeline* _cmsReadOutputLUT(cmsHPROFILE hProfile, int Intent)
         return Lut;
     }   
 
-    // Lut not found, try to create a matrix-shaper
+    // Lut not found, try to create a matrix-shaper. That is the same for all intents
+    Lut = _cmsReadMemoShaper(hProfile, LCMS_USED_AS_OUTPUT);
+    if (Lut != NULL) return Lut;
 
     // Check if this is a grayscale profile.
      if (cmsGetColorSpace(hProfile) == cmsSigGrayData) {
 
               // if so, build appropiate conversion tables. 
               // The tables are the PCS iluminant, scaled across GrayTRC
-              return BuildGrayOutputPipeline(hProfile);              
+              Lut = BuildGrayOutputPipeline(hProfile);              
+    }
+    else {
+
+        // Not gray, create a normal matrix-shaper 
+        Lut = BuildRGBOutputMatrixShaper(hProfile);
     }
 
-    // Not gray, create a normal matrix-shaper 
-    return BuildRGBOutputMatrixShaper(hProfile);
+    return _cmsWriteMemoShaper(hProfile, LCMS_USED_AS_OUTPUT, Lut);
 }
 
 // ---------------------------------------------------------------------------------------------------------------
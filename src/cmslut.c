@@ -497,10 +497,11 @@ void* CLUTElemDup(cmsStage* mpe)
 
     if (Data ->Tab.T) {
 
+        // Shared tables are not copied, just referenced once more
         if (Data ->HasFloatValues)
-            NewElem ->Tab.TFloat = (cmsFloat32Number*) _cmsDupMem(mpe ->ContextID, Data ->Tab.TFloat, Data ->nEntries * sizeof (cmsFloat32Number));
+            NewElem ->Tab.TFloat = (cmsFloat32Number*) _cmsDupSharedTable(mpe ->ContextID, Data ->Tab.TFloat, Data ->nEntries * sizeof (cmsFloat32Number));
         else
-            NewElem ->Tab.T = (cmsUInt16Number*) _cmsDupMem(mpe ->ContextID, Data ->Tab.T, Data ->nEntries * sizeof (cmsUInt16Number));
+            NewElem ->Tab.T = (cmsUInt16Number*) _cmsDupSharedTable(mpe ->ContextID, Data ->Tab.T, Data ->nEntries * sizeof (cmsUInt16Number));
     }
     
     NewElem ->Params   = _cmsComputeInterpParamsEx(mpe ->ContextID,
@@ -525,7 +526,7 @@ void CLutElemTypeFree(cmsStage* mpe)
 
     // This works for both types
     if (Data -> Tab.T)
-        _cmsFree(mpe ->ContextID, Data -> Tab.T);
+        _cmsFreeSharedTable(mpe ->ContextID, Data -> Tab.T);
 
     _cmsFreeInterpParams(Data ->Params);    
     _cmsFree(mpe ->ContextID, mpe ->Data);
@@ -560,7 +561,7 @@ cmsStage* CMSEXPORT cmsStageAllocCLut16bitGranular(cmsContext ContextID,
     NewElem -> nEntries = n = outputChan * CubeSize(clutPoints, inputChan);
     NewElem -> HasFloatValues = FALSE;
 
-    if (n == 0) {
+    if (n == 0 || !_cmsCheckCLUTLimits(ContextID, n, sizeof(cmsUInt16Number))) {
         cmsStageFree(NewMPE);
         return NULL;
     }
@@ -648,7 +649,7 @@ cmsStage* CMSEXPORT cmsStageAllocCLutFloatGranular(cmsContext ContextID, const c
     NewElem -> nEntries = n = outputChan * CubeSize(clutPoints, inputChan);
     NewElem -> HasFloatValues = TRUE;
 
-    if (n == 0) {
+    if (n == 0 || !_cmsCheckCLUTLimits(ContextID, n, sizeof(cmsFloat32Number))) {
         cmsStageFree(NewMPE);
         return NULL;
     }
@@ -725,6 +726,22 @@ cmsUInt16Number _cmsQuantizeVal(cmsFloat64Number i, int MaxSamples)
 }
 
 
+// Tables coming from the optimizer may be shared with other transforms. Get a private copy before writing on them
+static
+cmsBool UnshareCLut(cmsStage* mpe, _cmsStageCLutData* clut)
+{
+    cmsUInt32Number Size;
+
+    if (clut ->Tab.T == NULL) return TRUE;
+
+    Size = clut ->nEntries * (clut ->HasFloatValues ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number));
+
+    clut ->Tab.T = (cmsUInt16Number*) _cmsUnshareTable(mpe ->ContextID, clut ->Tab.T, Size);
+    clut ->Params ->Table = clut ->Tab.T;
+
+    return clut ->Tab.T != NULL;
+}
+
 // This routine does a sweep on whole input space, and calls its callback
 // function on knots. returns TRUE if all ok, FALSE otherwise.
 cmsBool CMSEXPORT cmsStageSampleCLut16bit(cmsStage* mpe, cmsSAMPLER16 Sampler, void * Cargo, cmsUInt32Number dwFlags)
@@ -750,6 +767,9 @@ cmsBool CMSEXPORT cmsStageSampleCLut16bit(cmsStage* mpe, cmsSAMPLER16 Sampler, v
 
     nTotalPoints = CubeSize(nSamples, nInputs);
     if (nTotalPoints == 0) return FALSE;
+    if (!_cmsCheckSamplerLimit(mpe ->ContextID, nTotalPoints)) return FALSE;
+
+    if (!(dwFlags & SAMPLER_INSPECT) && !UnshareCLut(mpe, clut)) return FALSE;
 
     index = 0;
     for (i = 0; i < nTotalPoints; i++) {
@@ -804,6 +824,9 @@ cmsBool CMSEXPORT cmsStageSampleCLutFloat(cmsStage* mpe, cmsSAMPLERFLOAT Sampler
 
     nTotalPoints = CubeSize(nSamples, nInputs);
     if (nTotalPoints == 0) return FALSE;
+    if (!_cmsCheckSamplerLimit(mpe ->ContextID, nTotalPoints)) return FALSE;
+
+    if (!(dwFlags & SAMPLER_INSPECT) && !UnshareCLut(mpe, clut)) return FALSE;
 
     index = 0;
     for (i = 0; i < nTotalPoints; i++) {
@@ -842,20 +865,18 @@ cmsBool CMSEXPORT cmsStageSampleCLutFloat(cmsStage* mpe, cmsSAMPLERFLOAT Sampler
 
 
 
-// This routine does a sweep on whole input space, and calls its callback
-// function on knots. returns TRUE if all ok, FALSE otherwise.
-cmsBool CMSEXPORT cmsSliceSpace16(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
-                                         cmsSAMPLER16 Sampler, void * Cargo)
+// Sweeps nodes First..Last-1 of the input space. Abort, if given, is shared among threads: it is raised when a sampler
+// fails, and checked on every node so the other threads stop early as well.
+static
+cmsBool SliceRange16(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[], int First, int Last,
+                     cmsSAMPLER16 Sampler, void * Cargo, volatile long* Abort)
 {
-    int i, t, nTotalPoints, rest;
+    int i, t, rest;
     cmsUInt16Number In[cmsMAXCHANNELS];
 
-    if (nInputs >= cmsMAXCHANNELS) return FALSE;
-
-    nTotalPoints = CubeSize(clutPoints, nInputs);
-    if (nTotalPoints == 0) return FALSE;
+    for (i = First; i < Last; i++) {
 
-    for (i = 0; i < nTotalPoints; i++) {
+        if (Abort != NULL && *Abort) return FALSE;
 
         rest = i;
         for (t = nInputs-1; t >=0; --t) {
@@ -867,25 +888,25 @@ cmsBool CMSEXPORT cmsSliceSpace16(cmsUInt32Number nInputs, const cmsUInt32Number
 
         }
 
-        if (!Sampler(In, NULL, Cargo))
+        if (!Sampler(In, NULL, Cargo)) {
+            if (Abort != NULL) _cmsAtomicExchange(Abort, 1);
             return FALSE;
+        }
     }
 
     return TRUE;
 }
 
-cmsInt32Number CMSEXPORT cmsSliceSpaceFloat(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
-                                            cmsSAMPLERFLOAT Sampler, void * Cargo)
+static
+cmsBool SliceRangeFloat(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[], int First, int Last,
+                        cmsSAMPLERFLOAT Sampler, void * Cargo, volatile long* Abort)
 {
-    int i, t, nTotalPoints, rest;
+    int i, t, rest;
     cmsFloat32Number In[cmsMAXCHANNELS];
 
-    if (nInputs >= cmsMAXCHANNELS) return FALSE;
+    for (i = First; i < Last; i++) {
 
-    nTotalPoints = CubeSize(clutPoints, nInputs);
-    if (nTotalPoints == 0) return FALSE;
-
-    for (i = 0; i < nTotalPoints; i++) {
+        if (Abort != NULL && *Abort) return FALSE;
 
         rest = i;
         for (t = nInputs-1; t >=0; --t) {
@@ -897,13 +918,511 @@ cmsInt32Number CMSEXPORT cmsSliceSpaceFloat(cmsUInt32Number nInputs, const cmsUI
 
         }
 
-        if (!Sampler(In, NULL, Cargo))
+        if (!Sampler(In, NULL, Cargo)) {
+            if (Abort != NULL) _cmsAtomicExchange(Abort, 1);
             return FALSE;
+        }
     }
 
     return TRUE;
 }
 
+// This routine does a sweep on whole input space, and calls its callback
+// function on knots. returns TRUE if all ok, FALSE otherwise.
+cmsBool CMSEXPORT cmsSliceSpace16(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                         cmsSAMPLER16 Sampler, void * Cargo)
+{
+    int nTotalPoints;
+
+    if (nInputs >= cmsMAXCHANNELS) return FALSE;
+
+    nTotalPoints = CubeSize(clutPoints, nInputs);
+    if (nTotalPoints == 0) return FALSE;
+    if (!_cmsCheckSamplerLimit(NULL, nTotalPoints)) return FALSE;
+
+    return SliceRange16(nInputs, clutPoints, 0, nTotalPoints, Sampler, Cargo, NULL);
+}
+
+cmsInt32Number CMSEXPORT cmsSliceSpaceFloat(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                            cmsSAMPLERFLOAT Sampler, void * Cargo)
+{
+    int nTotalPoints;
+
+    if (nInputs >= cmsMAXCHANNELS) return FALSE;
+
+    nTotalPoints = CubeSize(clutPoints, nInputs);
+    if (nTotalPoints == 0) return FALSE;
+    if (!_cmsCheckSamplerLimit(NULL, nTotalPoints)) return FALSE;
+
+    return SliceRangeFloat(nInputs, clutPoints, 0, nTotalPoints, Sampler, Cargo, NULL);
+}
+
+// Parallel slicing. Each thread gets a contiguous run of nodes, so the partition only depends on the
+// number of threads asked for.
+typedef struct {
+
+    cmsUInt32Number        nInputs;
+    const cmsUInt32Number* clutPoints;
+    int                    First, Last;
+
+    cmsSAMPLER16           Sampler16;
+    cmsSAMPLERFLOAT        SamplerFloat;
+    void*                  Cargo;
+
+    volatile long*         Abort;
+
+} SliceJob;
+
+static
+void SliceThread(void* Cargo)
+{
+    SliceJob* Job = (SliceJob*) Cargo;
+
+    if (Job ->Sampler16 != NULL)
+        SliceRange16(Job ->nInputs, Job ->clutPoints, Job ->First, Job ->Last, Job ->Sampler16, Job ->Cargo, Job ->Abort);
+    else
+        SliceRangeFloat(Job ->nInputs, Job ->clutPoints, Job ->First, Job ->Last, Job ->SamplerFloat, Job ->Cargo, Job ->Abort);
+}
+
+static
+cmsBool SliceParallel(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                      cmsSAMPLER16 Sampler16, cmsSAMPLERFLOAT SamplerFloat, void* Cargo,
+                      cmsUInt32Number nThreads, void* ThreadCargo[], cmsSLICEREDUCE Reduce)
+{
+    SliceJob* Jobs;
+    volatile long Abort = 0;
+    int nTotalPoints;
+    cmsUInt32Number i;
+    cmsBool rc;
+
+    if (nInputs >= cmsMAXCHANNELS) return FALSE;
+
+    nTotalPoints = CubeSize(clutPoints, nInputs);
+    if (nTotalPoints == 0) return FALSE;
+    if (!_cmsCheckSamplerLimit(NULL, nTotalPoints)) return FALSE;
+
+    if (nThreads == 0) {
+
+        if (ThreadCargo != NULL) {
+            cmsSignalError(NULL, cmsERROR_RANGE, "Per-thread cargo needs an explicit number of threads");
+            return FALSE;
+        }
+
+        nThreads = _cmsGetProcessorCount();
+        if (nThreads > (cmsUInt32Number) nTotalPoints) nThreads = nTotalPoints;
+    }
+
+    Jobs = (SliceJob*) _cmsCalloc(NULL, nThreads, sizeof(SliceJob));
+    if (Jobs == NULL) return FALSE;
+
+    for (i=0; i < nThreads; i++) {
+
+        Jobs[i].nInputs      = nInputs;
+        Jobs[i].clutPoints   = clutPoints;
+        Jobs[i].First        = (int) (((cmsUInt64Number) nTotalPoints * i) / nThreads);
+        Jobs[i].Last         = (int) (((cmsUInt64Number) nTotalPoints * (i + 1)) / nThreads);
+        Jobs[i].Sampler16    = Sampler16;
+        Jobs[i].SamplerFloat = SamplerFloat;
+        Jobs[i].Cargo        = ThreadCargo != NULL ? ThreadCargo[i] : Cargo;
+        Jobs[i].Abort        = &Abort;
+    }
+
+    _cmsRunThreads(NULL, nThreads, SliceThread, Jobs, sizeof(SliceJob));
+    _cmsFree(NULL, Jobs);
+
+    rc = !Abort;
+
+    // Combine in thread order
+    if (rc && Reduce != NULL && ThreadCargo != NULL) {
+
+        for (i=0; i < nThreads; i++) {
+
+            if (!Reduce(Cargo, ThreadCargo[i])) return FALSE;
+        }
+    }
+
+    return rc;
+}
+
+cmsBool CMSEXPORT cmsSliceSpace16Parallel(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                          cmsSAMPLER16 Sampler, void* Cargo,
+                                          cmsUInt32Number nThreads, void* ThreadCargo[], cmsSLICEREDUCE Reduce)
+{
+    return SliceParallel(nInputs, clutPoints, Sampler, NULL, Cargo, nThreads, ThreadCargo, Reduce);
+}
+
+cmsBool CMSEXPORT cmsSliceSpaceFloatParallel(cmsUInt32Number nInputs, const cmsUInt32Number clutPoints[],
+                                             cmsSAMPLERFLOAT Sampler, void* Cargo,
+                                             cmsUInt32Number nThreads, void* ThreadCargo[], cmsSLICEREDUCE Reduce)
+{
+    return SliceParallel(nInputs, clutPoints, NULL, Sampler, Cargo, nThreads, ThreadCargo, Reduce);
+}
+
+// ********************************************************************************
+// Type cmsSigAdaptiveCLutElemType
+// ********************************************************************************
+
+// An adaptive CLUT is a coarse uniform grid in which only the cells that cannot be
+// represented within a given tolerance are subdivided by a finer grid. Error on color
+// transforms is seldom uniform, so this gives the accuracy of a dense table at a fraction
+// of its size. Only 3 inputs are supported. On faces between a refined and a coarse cell
+// the table may be discontinuous, but the jump is bounded by twice the tolerance.
+
+// Tetrahedral interpolation on a single cell. Far corner offsets are zero when the rest on
+// that axis is zero, so nodes beyond the end of the table are never read.
+static
+void AdaptiveTetrahedral16(register const cmsUInt16Number* LutTable, 
+                           register const cmsUInt32Number opta[], 
+                           register cmsUInt32Number TotalOut,
+                           int rx, int ry, int rz, 
+                           register cmsUInt16Number Output[])
+{
+    cmsS15Fixed16Number c0, c1, c2, c3, Rest;
+    cmsUInt32Number X1, Y1, Z1, o1, o2, o3;
+    int r1, r2, r3;
+
+    X1 = (rx == 0 ? 0 : opta[2]);
+    Y1 = (ry == 0 ? 0 : opta[1]);
+    Z1 = (rz == 0 ? 0 : opta[0]);
+
+    // The tetrahedron is the path that visits the axes by decreasing rest
+    if (rx >= ry) {
+        if (ry >= rz)      { o1 = X1; o2 = X1 + Y1; r1 = rx; r2 = ry; r3 = rz; }
+        else if (rz >= rx) { o1 = Z1; o2 = Z1 + X1; r1 = rz; r2 = rx; r3 = ry; }
+        else               { o1 = X1; o2 = X1 + Z1; r1 = rx; r2 = rz; r3 = ry; }
+    }
+    else {
+        if (rx >= rz)      { o1 = Y1; o2 = Y1 + X1; r1 = ry; r2 = rx; r3 = rz; }
+        else if (ry >= rz) { o1 = Y1; o2 = Y1 + Z1; r1 = ry; r2 = rz; r3 = rx; }
+        else               { o1 = Z1; o2 = Z1 + Y1; r1 = rz; r2 = ry; r3 = rx; }
+    }
+    o3 = X1 + Y1 + Z1;
+
+    for (; TotalOut; TotalOut--) {
+
+        c0 = LutTable[0];
+        c1 = LutTable[o1];
+        c2 = LutTable[o2];
+        c3 = LutTable[o3];
+        LutTable++;
+
+        // Same rounding as TetrahedralInterp16
+        Rest = (c1 - c0) * r1 + (c2 - c1) * r2 + (c3 - c2) * r3 + 0x8001;
+        *Output++ = (cmsUInt16Number) (c0 + ((Rest + (Rest>>16))>>16));
+    }
+}
+
+
+// Evaluates the adaptive table. Fits the _cmsOPTeval16Fn prototype, so optimizations can use it directly.
+void _cmsEvalAdaptiveCLut16(register const cmsUInt16Number In[], 
+                            register cmsUInt16Number Out[], 
+                            register const void* D)
+{
+    const _cmsStageAdaptiveCLutData* Data = (const _cmsStageAdaptiveCLutData*) D;
+    int Domain = (int) Data ->nGridPoints - 1;
+    int nRefine = (int) Data ->nRefine;
+    cmsS15Fixed16Number fx, fy, fz;
+    int x0, y0, z0, rx, ry, rz;
+    int cx, cy, cz;
+    cmsUInt32Number Block;
+    const cmsUInt16Number* Table;
+
+    fx = _cmsToFixedDomain((int) In[0] * Domain);
+    fy = _cmsToFixedDomain((int) In[1] * Domain);
+    fz = _cmsToFixedDomain((int) In[2] * Domain);
+
+    x0 = FIXED_TO_INT(fx);
+    y0 = FIXED_TO_INT(fy);
+    z0 = FIXED_TO_INT(fz);
+
+    rx = FIXED_REST_TO_INT(fx);
+    ry = FIXED_REST_TO_INT(fy);
+    rz = FIXED_REST_TO_INT(fz);
+
+    // Last node on each axis belongs to the last cell
+    cx = (x0 == Domain) ? x0 - 1 : x0;
+    cy = (y0 == Domain) ? y0 - 1 : y0;
+    cz = (z0 == Domain) ? z0 - 1 : z0;
+
+    Block = Data ->CellMap[(cx * Domain + cy) * Domain + cz];
+
+    if (Block == 0) {
+
+        Table = Data ->Coarse + x0 * Data ->CoarseOpta[2] + y0 * Data ->CoarseOpta[1] + z0 * Data ->CoarseOpta[0];
+        AdaptiveTetrahedral16(Table, Data ->CoarseOpta, Data ->nOutputs, rx, ry, rz, Out);
+        return;
+    }
+
+    // Refined cell: scale the position inside the cell to the fine grid
+    fx = (x0 == Domain) ? (nRefine << 16) : rx * nRefine;
+    fy = (y0 == Domain) ? (nRefine << 16) : ry * nRefine;
+    fz = (z0 == Domain) ? (nRefine << 16) : rz * nRefine;
+
+    Table = Data ->Fine + (Block - 1) * Data ->BlockSize + 
+                FIXED_TO_INT(fx) * Data ->FineOpta[2] + 
+                FIXED_TO_INT(fy) * Data ->FineOpta[1] + 
+                FIXED_TO_INT(fz) * Data ->FineOpta[0];
+
+    AdaptiveTetrahedral16(Table, Data ->FineOpta, Data ->nOutputs, 
+                          FIXED_REST_TO_INT(fx), FIXED_REST_TO_INT(fy), FIXED_REST_TO_INT(fz), Out);
+}
+
+
+static
+void EvaluateAdaptiveCLUTfloatIn16(const cmsFloat32Number In[], cmsFloat32Number Out[], const cmsStage *mpe)
+{
+    cmsUInt16Number In16[MAX_STAGE_CHANNELS], Out16[MAX_STAGE_CHANNELS];
+
+    _cmsAssert(mpe ->InputChannels  <= MAX_STAGE_CHANNELS);
+    _cmsAssert(mpe ->OutputChannels <= MAX_STAGE_CHANNELS);
+
+    FromFloatTo16(In, In16, mpe ->InputChannels);   
+    _cmsEvalAdaptiveCLut16(In16, Out16, mpe ->Data);
+    From16ToFloat(Out16, Out,  mpe ->OutputChannels);
+}
+
+
+static
+void AdaptiveCLutElemTypeFree(cmsStage* mpe)
+{
+    _cmsStageAdaptiveCLutData* Data = (_cmsStageAdaptiveCLutData*) mpe ->Data;
+
+    if (Data == NULL) return;
+
+    if (Data ->Coarse)  _cmsFree(mpe ->ContextID, Data ->Coarse);
+    if (Data ->CellMap) _cmsFree(mpe ->ContextID, Data ->CellMap);
+    if (Data ->Fine)    _cmsFree(mpe ->ContextID, Data ->Fine);
+
+    _cmsFree(mpe ->ContextID, Data);
+}
+
+
+static
+void* AdaptiveCLutElemDup(cmsStage* mpe)
+{
+    _cmsStageAdaptiveCLutData* Data = (_cmsStageAdaptiveCLutData*) mpe ->Data;
+    _cmsStageAdaptiveCLutData* NewElem;
+    cmsUInt32Number nCells = Data ->nGridPoints - 1;
+
+    NewElem = (_cmsStageAdaptiveCLutData*) _cmsDupMem(mpe ->ContextID, Data, sizeof(_cmsStageAdaptiveCLutData));
+    if (NewElem == NULL) return NULL;
+
+    nCells = nCells * nCells * nCells;
+
+    NewElem ->Coarse  = (cmsUInt16Number*) _cmsDupMem(mpe ->ContextID, Data ->Coarse, Data ->nCoarseEntries * sizeof(cmsUInt16Number));
+    NewElem ->CellMap = (cmsUInt32Number*) _cmsDupMem(mpe ->ContextID, Data ->CellMap, nCells * sizeof(cmsUInt32Number));
+    NewElem ->Fine    = NULL;
+
+    if (Data ->nRefined > 0)
+        NewElem ->Fine = (cmsUInt16Number*) _cmsDupMem(mpe ->ContextID, Data ->Fine, Data ->nRefined * Data ->BlockSize * sizeof(cmsUInt16Number));
+
+    if (NewElem ->Coarse == NULL || NewElem ->CellMap == NULL || 
+        (Data ->nRefined > 0 && NewElem ->Fine == NULL)) {
+
+            if (NewElem ->Coarse)  _cmsFree(mpe ->ContextID, NewElem ->Coarse);
+            if (NewElem ->CellMap) _cmsFree(mpe ->ContextID, NewElem ->CellMap);
+            if (NewElem ->Fine)    _cmsFree(mpe ->ContextID, NewElem ->Fine);
+            _cmsFree(mpe ->ContextID, NewElem);
+            return NULL;
+    }
+
+    return (void*) NewElem;
+}
+
+
+// Copies the cube of n nodes by side at node (x, y, z) of a uniform 3D table of nSide nodes by side.
+static
+void CopyCube(cmsUInt16Number* Dest, const cmsUInt16Number* Src, cmsUInt32Number nSide, 
+              cmsUInt32Number x, cmsUInt32Number y, cmsUInt32Number z,
+              cmsUInt32Number n, cmsUInt32Number Step, cmsUInt32Number nOutputs)
+{
+    cmsUInt32Number i, j, k, t;
+    const cmsUInt16Number* Node;
+
+    for (i=0; i < n; i++) {
+        for (j=0; j < n; j++) {
+            for (k=0; k < n; k++) {
+
+                Node = Src + (((x + i*Step) * nSide + (y + j*Step)) * nSide + (z + k*Step)) * nOutputs;
+
+                for (t=0; t < nOutputs; t++)
+                    *Dest++ = Node[t];
+            }
+        }
+    }
+}
+
+// Maximum deviation, in 16 bits, of the coarse grid across the fine nodes of a given cell
+static
+cmsUInt32Number CoarseCellError(const _cmsStageAdaptiveCLutData* Data, const cmsUInt16Number* Dense, cmsUInt32Number nDense,
+                                cmsUInt32Number cx, cmsUInt32Number cy, cmsUInt32Number cz)
+{
+    cmsUInt32Number i, j, k, t, x, y, z, Err, MaxErr = 0;
+    cmsUInt16Number In[3], Out[MAX_STAGE_CHANNELS];
+    const cmsUInt16Number* Node;
+    cmsUInt32Number nRefine = Data ->nRefine;
+
+    for (i=0; i <= nRefine; i++) {
+        for (j=0; j <= nRefine; j++) {
+            for (k=0; k <= nRefine; k++) {
+
+                x = cx * nRefine + i;
+                y = cy * nRefine + j;
+                z = cz * nRefine + k;
+
+                In[0] = _cmsQuantizeVal(x, nDense);
+                In[1] = _cmsQuantizeVal(y, nDense);
+                In[2] = _cmsQuantizeVal(z, nDense);
+
+                _cmsEvalAdaptiveCLut16(In, Out, Data);
+
+                Node = Dense + ((x * nDense + y) * nDense + z) * Data ->nOutputs;
+
+                for (t=0; t < Data ->nOutputs; t++) {
+
+                    Err = abs((int) Out[t] - (int) Node[t]);
+                    if (Err > MaxErr) MaxErr = Err;
+                }
+            }
+        }
+    }
+
+    return MaxErr;
+}
+
+
+// Builds an adaptive CLUT of nGridPoints nodes by side, in which cells whose error exceeds Tolerance
+// (in 16-bit units) are split in nRefine steps by side. The sampler is called on every node of the 
+// equivalent dense grid, in the same way cmsStageSampleCLut16bit does.
+cmsStage* CMSEXPORT cmsStageAllocCLutAdaptive16bit(cmsContext ContextID, 
+                                                   cmsUInt32Number nGridPoints, 
+                                                   cmsUInt32Number nRefine,
+                                                   cmsUInt32Number inputChan, 
+                                                   cmsUInt32Number outputChan, 
+                                                   cmsFloat64Number Tolerance,
+                                                   cmsSAMPLER16 Sampler, void* Cargo)
+{
+    cmsStage* NewMPE;
+    cmsStage* Dense;
+    _cmsStageAdaptiveCLutData* NewElem;
+    const cmsUInt16Number* DenseTable;
+    cmsUInt8Number* Marks;
+    cmsUInt32Number nDense, nCells, nCellsBySide, nFine, i, x, y, z, Block;
+
+    if (inputChan != 3) {
+        cmsSignalError(ContextID, cmsERROR_NOT_SUITABLE, "Adaptive CLUT needs 3 inputs, %d found", inputChan);
+        return NULL;
+    }
+
+    if (outputChan < 1 || outputChan >= MAX_STAGE_CHANNELS || nGridPoints < 2 || nRefine < 1 || nRefine > 16) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Wrong adaptive CLUT parameters");
+        return NULL;
+    }
+
+    nDense = (nGridPoints - 1) * nRefine + 1;
+    if (nDense > 255) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Adaptive CLUT too big (%d nodes by side)", nDense);
+        return NULL;
+    }
+
+    // Sample the reference on the dense grid. This is thrown away once the refined cells are known.
+    Dense = cmsStageAllocCLut16bit(ContextID, nDense, inputChan, outputChan, NULL);
+    if (Dense == NULL) return NULL;
+
+    if (!cmsStageSampleCLut16bit(Dense, Sampler, Cargo, 0)) {
+        cmsStageFree(Dense);
+        return NULL;
+    }
+
+    DenseTable = ((_cmsStageCLutData*) Dense ->Data) ->Tab.T;
+
+    NewMPE = _cmsStageAllocPlaceholder(ContextID, cmsSigAdaptiveCLutElemType, inputChan, outputChan,
+                                       EvaluateAdaptiveCLUTfloatIn16, AdaptiveCLutElemDup, AdaptiveCLutElemTypeFree, NULL);
+    if (NewMPE == NULL) {
+        cmsStageFree(Dense);
+        return NULL;
+    }
+
+    NewElem = (_cmsStageAdaptiveCLutData*) _cmsMallocZero(ContextID, sizeof(_cmsStageAdaptiveCLutData));
+    if (NewElem == NULL) goto Error;
+
+    NewMPE ->Data = (void*) NewElem;
+
+    nCellsBySide = nGridPoints - 1;
+    nCells = nCellsBySide * nCellsBySide * nCellsBySide;
+    nFine  = nRefine + 1;
+
+    NewElem ->nGridPoints = nGridPoints;
+    NewElem ->nRefine     = nRefine;
+    NewElem ->nOutputs    = outputChan;
+
+    NewElem ->CoarseOpta[0] = outputChan;
+    NewElem ->CoarseOpta[1] = outputChan * nGridPoints;
+    NewElem ->CoarseOpta[2] = outputChan * nGridPoints * nGridPoints;
+
+    NewElem ->FineOpta[0] = outputChan;
+    NewElem ->FineOpta[1] = outputChan * nFine;
+    NewElem ->FineOpta[2] = outputChan * nFine * nFine;
+
+    NewElem ->BlockSize = outputChan * nFine * nFine * nFine;
+    NewElem ->nCoarseEntries = outputChan * nGridPoints * nGridPoints * nGridPoints;
+
+    NewElem ->Coarse  = (cmsUInt16Number*) _cmsCalloc(ContextID, NewElem ->nCoarseEntries, sizeof(cmsUInt16Number));
+    NewElem ->CellMap = (cmsUInt32Number*) _cmsCalloc(ContextID, nCells, sizeof(cmsUInt32Number));
+    if (NewElem ->Coarse == NULL || NewElem ->CellMap == NULL) goto Error;
+
+    // Coarse nodes are a subset of dense nodes
+    CopyCube(NewElem ->Coarse, DenseTable, nDense, 0, 0, 0, nGridPoints, nRefine, outputChan);
+
+    // First pass marks the cells to refine. Nodes on cell faces may be evaluated by the neighbour cell, so marks
+    // are kept apart until all cells are measured. Meanwhile, the map is all zeros and only the coarse grid is used.
+    Marks = (cmsUInt8Number*) _cmsCalloc(ContextID, nCells, sizeof(cmsUInt8Number));
+    if (Marks == NULL) goto Error;
+
+    for (i=0; i < nCells; i++) {
+
+        x = i / (nCellsBySide * nCellsBySide);
+        y = (i / nCellsBySide) % nCellsBySide;
+        z = i % nCellsBySide;
+
+        Marks[i] = (CoarseCellError(NewElem, DenseTable, nDense, x, y, z) > Tolerance);
+    }
+
+    Block = 0;
+    for (i=0; i < nCells; i++) {
+        if (Marks[i]) NewElem ->CellMap[i] = ++Block;
+    }
+
+    _cmsFree(ContextID, Marks);
+    NewElem ->nRefined = Block;
+
+    if (Block > 0) {
+
+        NewElem ->Fine = (cmsUInt16Number*) _cmsCalloc(ContextID, Block * NewElem ->BlockSize, sizeof(cmsUInt16Number));
+        if (NewElem ->Fine == NULL) goto Error;
+
+        for (i=0; i < nCells; i++) {
+
+            if (NewElem ->CellMap[i] == 0) continue;
+
+            x = i / (nCellsBySide * nCellsBySide);
+            y = (i / nCellsBySide) % nCellsBySide;
+            z = i % nCellsBySide;
+
+            CopyCube(NewElem ->Fine + (NewElem ->CellMap[i] - 1) * NewElem ->BlockSize, DenseTable, nDense, 
+                     x * nRefine, y * nRefine, z * nRefine, nFine, 1, outputChan);
+        }
+    }
+
+    cmsStageFree(Dense);
+    return NewMPE;
+
+Error:
+    cmsStageFree(Dense);
+    cmsStageFree(NewMPE);
+    return NULL;
+}
+
 // ********************************************************************************
 // Type cmsSigLab2XYZElemType
 // ********************************************************************************
@@ -1493,11 +2012,60 @@ void CMSEXPORT cmsPipelineUnlinkStage(cmsPipeline* lut, cmsStageLoc loc, cmsStag
 }
 
 
+// Bytes taken by the tables of a stage. Only CLUT and curves may be big
+static
+cmsFloat64Number StageTableBytes(const cmsStage* mpe)
+{
+    cmsFloat64Number Bytes = 0;
+    cmsUInt32Number i;
+
+    switch (mpe ->Type) {
+
+    case cmsSigCLutElemType: {
+
+        _cmsStageCLutData* Data = (_cmsStageCLutData*) mpe ->Data;
+
+        Bytes = (cmsFloat64Number) Data ->nEntries * (Data ->HasFloatValues ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number));
+        }
+        break;
+
+    case cmsSigCurveSetElemType: {
+
+        _cmsStageToneCurvesData* Data = (_cmsStageToneCurvesData*) mpe ->Data;
+
+        for (i=0; i < Data ->nCurves; i++)
+            Bytes += (cmsFloat64Number) cmsGetToneCurveEstimatedTableEntries(Data ->TheCurves[i]) * sizeof(cmsUInt16Number);
+        }
+        break;
+
+    default:;
+    }
+
+    return Bytes;
+}
+
+// Checks the limits on a pipeline resulting of joining two
+static
+cmsBool CheckCatLimits(const cmsPipeline* l1, const cmsPipeline* l2)
+{
+    cmsStage* mpe;
+    cmsFloat64Number Bytes = 0;
+
+    if (!_cmsCheckPipelineDepthLimit(l1 ->ContextID, cmsPipelineStageCount(l1) + cmsPipelineStageCount(l2))) return FALSE;
+
+    for (mpe = l1 ->Elements; mpe != NULL; mpe = mpe ->Next) Bytes += StageTableBytes(mpe);
+    for (mpe = l2 ->Elements; mpe != NULL; mpe = mpe ->Next) Bytes += StageTableBytes(mpe);
+
+    return _cmsCheckTableBytesLimit(l1 ->ContextID, Bytes);
+}
+
 // Concatenate two LUT into a new single one
 cmsBool  CMSEXPORT cmsPipelineCat(cmsPipeline* l1, const cmsPipeline* l2)
 {
     cmsStage* mpe, *NewMPE;
 
+    if (!CheckCatLimits(l1, l2)) return FALSE;
+
     // If both LUTS does not have elements, we need to inherit 
     // the number of channels
     if (l1 ->Elements == NULL && l2 ->Elements == NULL) {
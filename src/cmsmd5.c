@@ -315,3 +315,34 @@ Error:
     return FALSE;
 }
 
+
+// Computes the ID of a profile given as raw bytes. The header fields excluded by the spec (flags, rendering intent
+// and ID) are taken as zero. Former versions of this library zeroed attributes instead of flags, LegacyFields
+// computes that variant, so IDs written by them can be told apart from broken ones.
+cmsBool _cmsMD5computeIDFromMem(cmsContext ContextID, const cmsUInt8Number* Mem, cmsUInt32Number Size,
+                                cmsBool LegacyFields, cmsProfileID* ProfileID)
+{
+    cmsUInt8Number Header[sizeof(cmsICCHeader)];
+    cmsHANDLE MD5;
+
+    if (Size < sizeof(cmsICCHeader)) return FALSE;
+
+    memmove(Header, Mem, sizeof(cmsICCHeader));
+
+    if (LegacyFields)
+        memset(Header + offsetof(cmsICCHeader, attributes), 0, sizeof(cmsUInt64Number));
+    else
+        memset(Header + offsetof(cmsICCHeader, flags), 0, sizeof(cmsUInt32Number));
+
+    memset(Header + offsetof(cmsICCHeader, renderingIntent), 0, sizeof(cmsUInt32Number));
+    memset(Header + offsetof(cmsICCHeader, profileID), 0, sizeof(cmsProfileID));
+
+    MD5 = MD5alloc(ContextID);
+    if (MD5 == NULL) return FALSE;
+
+    MD5add(MD5, Header, sizeof(cmsICCHeader));
+    MD5add(MD5, (cmsUInt8Number*) Mem + sizeof(cmsICCHeader), Size - sizeof(cmsICCHeader));
+
+    MD5finish(ProfileID, MD5);
+    return TRUE;
+}
@@ -685,6 +685,797 @@ cmsNAMEDCOLORLIST* CMSEXPORT cmsGetNamedColorList(cmsHTRANSFORM xform)
 }
 
 
+// Nearest point search -----------------------------------------------------------------------------------------------------------
+
+// The domain is split in a grid of cells. Each cell keeps the points that may be the nearest one for some value within the
+// cell, that is, those whose distance to the cell is not above the smallest farthest-distance to the cell of any point.
+// Queries then look only at the points listed in their cell. The grid is sized so building it takes at most about
+// NEAREST_BUILD_OPS point-to-cell distances, and cells are split among threads.
+
+#define NEAREST_BUILD_OPS   (1 << 22)
+#define NEAREST_MAX_CELLS   65536
+#define NEAREST_MAX_LEVELS  32
+#define NEAREST_MAX_POINTS  65535
+
+struct _cms_nearest_struct {
+
+    cmsContext        ContextID;
+    cmsUInt32Number   nDims;
+    cmsUInt32Number   nPoints;
+    cmsFloat32Number* Points;                   // nPoints * nDims
+
+    cmsUInt32Number   Levels;                   // Cells per dimension
+    cmsUInt32Number   nCells;
+    cmsFloat64Number  Min[cmsMAXCHANNELS];
+    cmsFloat64Number  Max[cmsMAXCHANNELS];
+    cmsFloat64Number  CellSize[cmsMAXCHANNELS];
+
+    cmsUInt32Number*  CellStart;                // nCells + 1 offsets into Candidates
+    cmsUInt16Number*  Candidates;               // Point indexes, ascending on each cell
+};
+
+// What each thread builds
+typedef struct {
+
+    _cmsNEAREST*      nn;
+    cmsUInt32Number   FirstCell, LastCell;
+    cmsFloat64Number* MinDist;                  // Scratch, one per point
+    cmsUInt16Number*  List;                     // Candidates of all cells in the range, in order
+    cmsUInt32Number   nList, Allocated;
+    cmsBool           Failed;
+
+} NearestJob;
+
+static
+cmsFloat64Number PointDistance(const cmsFloat32Number* a, const cmsFloat32Number* b, cmsUInt32Number nDims)
+{
+    cmsFloat64Number d, Sum = 0;
+    cmsUInt32Number i;
+
+    for (i=0; i < nDims; i++) {
+        d = (cmsFloat64Number) a[i] - (cmsFloat64Number) b[i];
+        Sum += d * d;
+    }
+
+    return Sum;
+}
+
+static
+void NearestBuildThread(void* Cargo)
+{
+    NearestJob* Job = (NearestJob*) Cargo;
+    _cmsNEAREST* nn = Job ->nn;
+    cmsFloat64Number Lo[cmsMAXCHANNELS], Hi[cmsMAXCHANNELS];
+    cmsUInt32Number c, i, d, k;
+
+    if (Job ->Failed) return;
+
+    for (c = Job ->FirstCell; c < Job ->LastCell; c++) {
+
+        cmsFloat64Number Worst = HUGE_VAL;
+        cmsUInt32Number Rest = c;
+
+        // Cell bounds, a bit enlarged to absorb rounding when queries are placed in cells
+        for (d = nn ->nDims; d > 0; d--) {
+
+            k = Rest % nn ->Levels;
+            Rest /= nn ->Levels;
+
+            Lo[d-1] = nn ->Min[d-1] + k * nn ->CellSize[d-1];
+            Hi[d-1] = Lo[d-1] + nn ->CellSize[d-1];
+
+            Lo[d-1] -= nn ->CellSize[d-1] * 1E-6;
+            Hi[d-1] += nn ->CellSize[d-1] * 1E-6;
+        }
+
+        for (i=0; i < nn ->nPoints; i++) {
+
+            const cmsFloat32Number* pt = nn ->Points + i * nn ->nDims;
+            cmsFloat64Number MinDist = 0, MaxDist = 0;
+
+            for (d=0; d < nn ->nDims; d++) {
+
+                cmsFloat64Number v = pt[d];
+                cmsFloat64Number Near = v < Lo[d] ? Lo[d] - v : (v > Hi[d] ? v - Hi[d] : 0);
+                cmsFloat64Number Far  = (v - Lo[d]) > (Hi[d] - v) ? (v - Lo[d]) : (Hi[d] - v);
+
+                MinDist += Near * Near;
+                MaxDist += Far * Far;
+            }
+
+            Job ->MinDist[i] = MinDist;
+            if (MaxDist < Worst) Worst = MaxDist;
+        }
+
+        for (i=0; i < nn ->nPoints; i++) {
+
+            if (Job ->MinDist[i] > Worst) continue;
+
+            if (Job ->nList >= Job ->Allocated) {
+
+                cmsUInt32Number NewSize = Job ->Allocated * 2 + 1024;
+                cmsUInt16Number* NewList = (cmsUInt16Number*) _cmsRealloc(nn ->ContextID, Job ->List, NewSize * sizeof(cmsUInt16Number));
+
+                if (NewList == NULL) {
+                    Job ->Failed = TRUE;
+                    return;
+                }
+
+                Job ->List = NewList;
+                Job ->Allocated = NewSize;
+            }
+
+            Job ->List[Job ->nList++] = (cmsUInt16Number) i;
+        }
+
+        // End of the cell within this thread list, made global when lists are joined
+        nn ->CellStart[c + 1] = Job ->nList;
+    }
+}
+
+void _cmsNearestFree(_cmsNEAREST* nn)
+{
+    if (nn == NULL) return;
+
+    if (nn ->Points)     _cmsFree(nn ->ContextID, nn ->Points);
+    if (nn ->CellStart)  _cmsFree(nn ->ContextID, nn ->CellStart);
+    if (nn ->Candidates) _cmsFree(nn ->ContextID, nn ->Candidates);
+    _cmsFree(nn ->ContextID, nn);
+}
+
+_cmsNEAREST* _cmsNearestAlloc(cmsContext ContextID, cmsUInt32Number nDims, const cmsFloat32Number Points[], cmsUInt32Number nPoints,
+                              const cmsFloat32Number DomainMin[], const cmsFloat32Number DomainMax[])
+{
+    _cmsNEAREST* nn;
+    NearestJob* Jobs = NULL;
+    cmsUInt32Number i, d, nThreads, Total, Base;
+    cmsBool rc = TRUE;
+
+    if (nDims == 0 || nDims > cmsMAXCHANNELS || nPoints == 0 || nPoints > NEAREST_MAX_POINTS) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Wrong nearest search of %d points in %d dimensions", nPoints, nDims);
+        return NULL;
+    }
+
+    for (d=0; d < nDims; d++) {
+
+        if (!(DomainMax[d] > DomainMin[d])) {
+            cmsSignalError(ContextID, cmsERROR_RANGE, "Empty domain for nearest search");
+            return NULL;
+        }
+    }
+
+    nn = (_cmsNEAREST*) _cmsMallocZero(ContextID, sizeof(_cmsNEAREST));
+    if (nn == NULL) return NULL;
+
+    nn ->ContextID = ContextID;
+    nn ->nDims     = nDims;
+    nn ->nPoints   = nPoints;
+
+    nn ->Points = (cmsFloat32Number*) _cmsDupMem(ContextID, Points, nPoints * nDims * sizeof(cmsFloat32Number));
+    if (nn ->Points == NULL) goto Error;
+
+    // As many cells as affordable
+    nn ->Levels = 1;
+    nn ->nCells = 1;
+    while (nn ->Levels < NEAREST_MAX_LEVELS) {
+
+        cmsFloat64Number Cells = pow((cmsFloat64Number) (nn ->Levels + 1), (cmsFloat64Number) nDims);
+
+        if (Cells > NEAREST_MAX_CELLS || Cells * nPoints > NEAREST_BUILD_OPS) break;
+
+        nn ->Levels++;
+        nn ->nCells = (cmsUInt32Number) Cells;
+    }
+
+    for (d=0; d < nDims; d++) {
+
+        nn ->Min[d] = DomainMin[d];
+        nn ->Max[d] = DomainMax[d];
+        nn ->CellSize[d] = (nn ->Max[d] - nn ->Min[d]) / nn ->Levels;
+    }
+
+    nn ->CellStart = (cmsUInt32Number*) _cmsCalloc(ContextID, nn ->nCells + 1, sizeof(cmsUInt32Number));
+    if (nn ->CellStart == NULL) goto Error;
+
+    nThreads = _cmsGetProcessorCount();
+    if (nThreads > nn ->nCells) nThreads = nn ->nCells;
+
+    Jobs = (NearestJob*) _cmsCalloc(ContextID, nThreads, sizeof(NearestJob));
+    if (Jobs == NULL) goto Error;
+
+    for (i=0; i < nThreads; i++) {
+
+        Jobs[i].nn        = nn;
+        Jobs[i].FirstCell = (nn ->nCells * i) / nThreads;
+        Jobs[i].LastCell  = (nn ->nCells * (i + 1)) / nThreads;
+        Jobs[i].MinDist   = (cmsFloat64Number*) _cmsCalloc(ContextID, nPoints, sizeof(cmsFloat64Number));
+        if (Jobs[i].MinDist == NULL) Jobs[i].Failed = TRUE;
+    }
+
+    _cmsRunThreads(ContextID, nThreads, NearestBuildThread, Jobs, sizeof(NearestJob));
+
+    // Join the lists in cell order
+    Total = 0;
+    for (i=0; i < nThreads; i++) {
+
+        if (Jobs[i].Failed) rc = FALSE;
+        Total += Jobs[i].nList;
+    }
+
+    if (rc) {
+
+        nn ->Candidates = (cmsUInt16Number*) _cmsMalloc(ContextID, (Total > 0 ? Total : 1) * sizeof(cmsUInt16Number));
+        if (nn ->Candidates == NULL) rc = FALSE;
+    }
+
+    if (rc) {
+
+        Base = 0;
+        for (i=0; i < nThreads; i++) {
+
+            cmsUInt32Number c;
+
+            if (Jobs[i].nList > 0)
+                memmove(nn ->Candidates + Base, Jobs[i].List, Jobs[i].nList * sizeof(cmsUInt16Number));
+
+            for (c = Jobs[i].FirstCell; c < Jobs[i].LastCell; c++)
+                nn ->CellStart[c + 1] += Base;
+
+            Base += Jobs[i].nList;
+        }
+    }
+
+    for (i=0; i < nThreads; i++) {
+
+        if (Jobs[i].MinDist) _cmsFree(ContextID, Jobs[i].MinDist);
+        if (Jobs[i].List)    _cmsFree(ContextID, Jobs[i].List);
+    }
+    _cmsFree(ContextID, Jobs);
+
+    if (!rc) goto Error;
+    return nn;
+
+Error:
+    _cmsNearestFree(nn);
+    return NULL;
+}
+
+cmsUInt32Number _cmsNearestFind(const _cmsNEAREST* nn, const cmsFloat32Number Value[])
+{
+    cmsUInt32Number d, i, Cell = 0, First, Last, Best = 0;
+    cmsFloat64Number Dist, BestDist = HUGE_VAL;
+
+    for (d=0; d < nn ->nDims; d++) {
+
+        cmsFloat64Number v = Value[d];
+        cmsUInt32Number k;
+
+        // Out of the grid, all points are candidates
+        if (!(v >= nn ->Min[d] && v <= nn ->Max[d])) {
+            Cell = 0xFFFFFFFF;
+            break;
+        }
+
+        k = (cmsUInt32Number) ((v - nn ->Min[d]) / nn ->CellSize[d]);
+        if (k >= nn ->Levels) k = nn ->Levels - 1;
+
+        Cell = Cell * nn ->Levels + k;
+    }
+
+    if (Cell == 0xFFFFFFFF) {
+
+        for (i=0; i < nn ->nPoints; i++) {
+
+            Dist = PointDistance(Value, nn ->Points + i * nn ->nDims, nn ->nDims);
+            if (Dist < BestDist) {
+                BestDist = Dist;
+                Best = i;
+            }
+        }
+
+        return Best;
+    }
+
+    First = nn ->CellStart[Cell];
+    Last  = nn ->CellStart[Cell + 1];
+
+    for (i = First; i < Last; i++) {
+
+        cmsUInt32Number n = nn ->Candidates[i];
+
+        Dist = PointDistance(Value, nn ->Points + n * nn ->nDims, nn ->nDims);
+        if (Dist < BestDist) {
+            BestDist = Dist;
+            Best = n;
+        }
+    }
+
+    return Best;
+}
+
+// Named color search -------------------------------------------------------------------------------------------------------------
+
+// Colors of a list are bucketed in a grid over their own Lab bounding box. A query visits the cells in rings of growing
+// Chebyshev distance around its own cell, and skips any cell whose Lab box is too far to hold a better color. For every
+// metric there is a lower bound of the difference as an increasing function of the euclidean Lab distance, so skipping
+// is exact. Once a whole ring is skipped, all outer rings are too, as they are no closer.
+
+#define NCS_MAX_LEVELS      32
+#define NCS_MIN_BATCH       64
+
+typedef struct {
+
+    cmsContext        ContextID;
+    cmsUInt32Number   nColors;
+    cmsCIELab*        Lab;                      // Decoded PCS of each color
+
+    cmsUInt32Number   Levels;                   // Cells per axis
+    cmsFloat64Number  Min[3], Max[3];           // Bounding box of all colors, as L, a, b
+    cmsFloat64Number  CellSize[3];
+
+    cmsUInt32Number*  CellStart;                // Levels^3 + 1 offsets into Members
+    cmsUInt32Number*  Members;                  // Color indexes, ascending on each cell
+
+} _cmsNamedColorSearch;
+
+// The difference to any color at Lab distance d from the query is at least Scale * d / max(A[i] + B[i] * d)
+typedef struct {
+
+    cmsFloat64Number Scale;
+    cmsFloat64Number A[3], B[3];
+    cmsUInt32Number  n;
+
+} _cmsDeltaEBound;
+
+static
+cmsFloat64Number MetricDeltaE(cmsUInt32Number Metric, const cmsCIELab* Query, const cmsCIELab* Color)
+{
+    switch (Metric) {
+
+    case cmsDELTAE_CIE94:   return cmsCIE94DeltaE(Query, Color);
+    case cmsDELTAE_CMC_1_1: return cmsCMCdeltaE(Query, Color, 1, 1);
+    case cmsDELTAE_CMC_2_1: return cmsCMCdeltaE(Query, Color, 2, 1);
+    case cmsDELTAE_2000:    return cmsCIE2000DeltaE(Query, Color, 1, 1, 1);
+    default:                return cmsDeltaE(Query, Color);
+    }
+}
+
+static
+cmsFloat64Number Sl2000(cmsFloat64Number MeanL)
+{
+    return 1 + (0.015 * (MeanL - 50) * (MeanL - 50)) / sqrt(20 + (MeanL - 50) * (MeanL - 50));
+}
+
+// Sets the bound for a query. Chroma weights are bounded using C of the color <= C of the query + d, and a' within [a, 1.5a]
+// for dE2000. Its rotation term is bounded by |Rt| <= 2 * sin(60), which leaves at least 1 - 0.866 of the weighted sum
+static
+void SetDeltaEBound(_cmsDeltaEBound* b, cmsUInt32Number Metric, const cmsCIELab* Query, cmsFloat64Number MinL, cmsFloat64Number MaxL)
+{
+    cmsCIELCh LCh;
+    cmsFloat64Number sl, sc, sh, t, f;
+
+    cmsLab2LCh(&LCh, Query);
+
+    b ->Scale = 1;
+    b ->A[0]  = 1; b ->B[0] = 0;
+    b ->n     = 1;
+
+    switch (Metric) {
+
+    case cmsDELTAE_CIE94:
+        b ->A[0] = 1 + 0.048 * LCh.C;
+        b ->B[0] = 0.024;
+        break;
+
+    case cmsDELTAE_CMC_1_1:
+    case cmsDELTAE_CMC_2_1:
+
+        // Two blacks are always equal
+        if (Query ->L == 0) {
+            b ->Scale = 0;
+            break;
+        }
+
+        // Weights depend on the query only, as it is taken as the reference
+        if ((LCh.h > 164) && (LCh.h < 345))
+            t = 0.56 + fabs(0.2 * cos(((LCh.h + 168)/(180/M_PI))));
+        else
+            t = 0.36 + fabs(0.4 * cos(((LCh.h + 35 )/(180/M_PI))));
+
+        sc = 0.0638   * LCh.C / (1 + 0.0131  * LCh.C) + 0.638;
+        sl = Query ->L < 16 ? 0.511 : 0.040975 * Query ->L /(1 + 0.01765 * Query ->L);
+        f  = sqrt((LCh.C * LCh.C * LCh.C * LCh.C)/((LCh.C * LCh.C * LCh.C * LCh.C)+1900));
+        sh = sc*(t*f+1-f);
+
+        b ->A[0] = (Metric == cmsDELTAE_CMC_2_1 ? 2 : 1) * sl; b ->B[0] = 0;
+        b ->A[1] = sc; b ->B[1] = 0;
+        b ->A[2] = sh; b ->B[2] = 0;
+        b ->n = 3;
+        break;
+
+    case cmsDELTAE_2000:
+        sl = Sl2000((Query ->L + MinL) / 2);
+        t  = Sl2000((Query ->L + MaxL) / 2);
+
+        b ->Scale = sqrt(1 - sin(M_PI / 3));
+        b ->A[0] = sl > t ? sl : t;             b ->B[0] = 0;
+        b ->A[1] = 1 + 0.045 * 1.5 * LCh.C;     b ->B[1] = 0.045 * 0.75;
+        b ->A[2] = 1 + 0.029 * 1.5 * LCh.C;     b ->B[2] = 0.029 * 0.75;
+        b ->n = 3;
+        break;
+
+    default:
+        break;
+    }
+
+    // Some room for rounding
+    b ->Scale *= 0.999;
+}
+
+static
+cmsFloat64Number EvalDeltaEBound(const _cmsDeltaEBound* b, cmsFloat64Number d)
+{
+    cmsFloat64Number w, Worst = 0;
+    cmsUInt32Number i;
+
+    for (i=0; i < b ->n; i++) {
+
+        w = b ->A[i] + b ->B[i] * d;
+        if (w > Worst) Worst = w;
+    }
+
+    return b ->Scale * d / Worst;
+}
+
+// Inserts a color in the ascending list of best ones. Ties go to the lower index, so the result does not depend on the
+// visiting order
+static
+void InsertBest(cmsUInt32Number Index, cmsFloat64Number dE, cmsUInt32Number Best[], cmsFloat64Number BestDE[],
+                cmsUInt32Number* nFound, cmsUInt32Number k)
+{
+    cmsUInt32Number j = *nFound;
+
+    if (j == k) {
+        if (dE > BestDE[k-1] || (dE == BestDE[k-1] && Index > Best[k-1])) return;
+        j--;
+    }
+    else
+        (*nFound)++;
+
+    while (j > 0 && (dE < BestDE[j-1] || (dE == BestDE[j-1] && Index < Best[j-1]))) {
+
+        Best[j]   = Best[j-1];
+        BestDE[j] = BestDE[j-1];
+        j--;
+    }
+
+    Best[j]   = Index;
+    BestDE[j] = dE;
+}
+
+static
+cmsFloat64Number AxisDistance(const _cmsNamedColorSearch* s, cmsUInt32Number Axis, cmsUInt32Number k, cmsFloat64Number v)
+{
+    cmsFloat64Number Lo = s ->Min[Axis] + k * s ->CellSize[Axis];
+    cmsFloat64Number Hi = Lo + s ->CellSize[Axis];
+
+    return v < Lo ? Lo - v : (v > Hi ? v - Hi : 0);
+}
+
+static
+cmsUInt32Number SearchNearest(const _cmsNamedColorSearch* s, const cmsCIELab* Lab, cmsUInt32Number Metric, cmsUInt32Number k,
+                              cmsUInt32Number Best[], cmsFloat64Number BestDE[])
+{
+    cmsFloat64Number v[3], d0, d1, d2;
+    cmsInt32Number c[3], Lo[3], Hi[3], i, j, l, Step, R, MaxR = 0;
+    cmsUInt32Number nFound = 0, n, Cell;
+    cmsBool AnyVisited;
+    _cmsDeltaEBound Bound;
+
+    if (k > s ->nColors) k = s ->nColors;
+
+    SetDeltaEBound(&Bound, Metric, Lab, s ->Min[0], s ->Max[0]);
+
+    v[0] = Lab ->L; v[1] = Lab ->a; v[2] = Lab ->b;
+
+    // Cell of the query, clamped to the grid
+    for (i=0; i < 3; i++) {
+
+        cmsFloat64Number x = (v[i] - s ->Min[i]) / s ->CellSize[i];
+
+        c[i] = x <= 0 ? 0 : (x >= s ->Levels - 1 ? (cmsInt32Number) s ->Levels - 1 : (cmsInt32Number) x);
+        if (c[i] > MaxR) MaxR = c[i];
+        if ((cmsInt32Number) s ->Levels - 1 - c[i] > MaxR) MaxR = (cmsInt32Number) s ->Levels - 1 - c[i];
+    }
+
+    for (R = 0; R <= MaxR; R++) {
+
+        AnyVisited = FALSE;
+
+        for (i=0; i < 3; i++) {
+            Lo[i] = c[i] - R < 0 ? 0 : c[i] - R;
+            Hi[i] = c[i] + R > (cmsInt32Number) s ->Levels - 1 ? (cmsInt32Number) s ->Levels - 1 : c[i] + R;
+        }
+
+        for (i = Lo[0]; i <= Hi[0]; i++) {
+
+            d0 = AxisDistance(s, 0, i, v[0]);
+
+            for (j = Lo[1]; j <= Hi[1]; j++) {
+
+                d1 = AxisDistance(s, 1, j, v[1]);
+
+                // Only the surface of the ring is new
+                Step = (abs(i - c[0]) == R || abs(j - c[1]) == R || R == 0) ? 1 : 2 * R;
+
+                for (l = c[2] - R; l <= c[2] + R; l += Step) {
+
+                    if (l < 0 || l >= (cmsInt32Number) s ->Levels) continue;
+
+                    d2 = AxisDistance(s, 2, l, v[2]);
+
+                    if (nFound == k && EvalDeltaEBound(&Bound, sqrt(d0*d0 + d1*d1 + d2*d2)) > BestDE[k-1]) continue;
+
+                    AnyVisited = TRUE;
+
+                    Cell = ((cmsUInt32Number) i * s ->Levels + (cmsUInt32Number) j) * s ->Levels + (cmsUInt32Number) l;
+                    for (n = s ->CellStart[Cell]; n < s ->CellStart[Cell + 1]; n++) {
+
+                        cmsUInt32Number Index = s ->Members[n];
+                        InsertBest(Index, MetricDeltaE(Metric, Lab, s ->Lab + Index), Best, BestDE, &nFound, k);
+                    }
+                }
+            }
+        }
+
+        if (!AnyVisited && nFound == k) break;
+    }
+
+    return nFound;
+}
+
+cmsHANDLE CMSEXPORT cmsNamedColorSearchAlloc(const cmsNAMEDCOLORLIST* NamedColorList)
+{
+    _cmsNamedColorSearch* s;
+    cmsContext ContextID;
+    cmsUInt32Number i, d, nCells, Cell;
+    cmsUInt32Number k[3];
+
+    if (NamedColorList == NULL) return NULL;
+    ContextID = NamedColorList ->ContextID;
+
+    if (NamedColorList ->nColors == 0) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Cannot search an empty named color list");
+        return NULL;
+    }
+
+    s = (_cmsNamedColorSearch*) _cmsMallocZero(ContextID, sizeof(_cmsNamedColorSearch));
+    if (s == NULL) return NULL;
+
+    s ->ContextID = ContextID;
+    s ->nColors   = NamedColorList ->nColors;
+
+    s ->Lab = (cmsCIELab*) _cmsCalloc(ContextID, s ->nColors, sizeof(cmsCIELab));
+    if (s ->Lab == NULL) goto Error;
+
+    for (i=0; i < s ->nColors; i++) {
+
+        cmsFloat64Number v[3];
+
+        cmsLabEncoded2FloatV2(s ->Lab + i, NamedColorList ->List[i].PCS);
+        v[0] = s ->Lab[i].L; v[1] = s ->Lab[i].a; v[2] = s ->Lab[i].b;
+
+        for (d=0; d < 3; d++) {
+
+            if (i == 0 || v[d] < s ->Min[d]) s ->Min[d] = v[d];
+            if (i == 0 || v[d] > s ->Max[d]) s ->Max[d] = v[d];
+        }
+    }
+
+    // About two colors per cell
+    s ->Levels = (cmsUInt32Number) floor(pow(s ->nColors / 2.0, 1.0 / 3.0));
+    if (s ->Levels < 1) s ->Levels = 1;
+    if (s ->Levels > NCS_MAX_LEVELS) s ->Levels = NCS_MAX_LEVELS;
+
+    for (d=0; d < 3; d++) {
+
+        cmsFloat64Number Span = s ->Max[d] - s ->Min[d];
+        if (Span < 1E-6) Span = 1E-6;
+
+        s ->CellSize[d] = Span / s ->Levels;
+    }
+
+    nCells = s ->Levels * s ->Levels * s ->Levels;
+
+    s ->CellStart = (cmsUInt32Number*) _cmsCalloc(ContextID, nCells + 1, sizeof(cmsUInt32Number));
+    s ->Members   = (cmsUInt32Number*) _cmsCalloc(ContextID, s ->nColors, sizeof(cmsUInt32Number));
+    if (s ->CellStart == NULL || s ->Members == NULL) goto Error;
+
+    // Counting sort by cell, which keeps indexes ascending within cells. CellStart[c+1] counts first, then becomes
+    // the start of cell c while filling, and ends up being its end.
+    for (i=0; i < s ->nColors; i++) {
+
+        cmsFloat64Number v[3];
+
+        v[0] = s ->Lab[i].L; v[1] = s ->Lab[i].a; v[2] = s ->Lab[i].b;
+        for (d=0; d < 3; d++) {
+            k[d] = (cmsUInt32Number) ((v[d] - s ->Min[d]) / s ->CellSize[d]);
+            if (k[d] >= s ->Levels) k[d] = s ->Levels - 1;
+        }
+
+        Cell = (k[0] * s ->Levels + k[1]) * s ->Levels + k[2];
+        s ->CellStart[Cell + 1]++;
+    }
+
+    for (i=1; i <= nCells; i++)
+        s ->CellStart[i] += s ->CellStart[i-1];
+
+    for (i=0; i < s ->nColors; i++) {
+
+        cmsFloat64Number v[3];
+
+        v[0] = s ->Lab[i].L; v[1] = s ->Lab[i].a; v[2] = s ->Lab[i].b;
+        for (d=0; d < 3; d++) {
+            k[d] = (cmsUInt32Number) ((v[d] - s ->Min[d]) / s ->CellSize[d]);
+            if (k[d] >= s ->Levels) k[d] = s ->Levels - 1;
+        }
+
+        Cell = (k[0] * s ->Levels + k[1]) * s ->Levels + k[2];
+        s ->Members[s ->CellStart[Cell]++] = i;
+    }
+
+    // Starts were moved to ends, shift them back
+    for (i=nCells; i > 0; i--)
+        s ->CellStart[i] = s ->CellStart[i-1];
+    s ->CellStart[0] = 0;
+
+    return (cmsHANDLE) s;
+
+Error:
+    cmsNamedColorSearchFree((cmsHANDLE) s);
+    return NULL;
+}
+
+void CMSEXPORT cmsNamedColorSearchFree(cmsHANDLE hSearch)
+{
+    _cmsNamedColorSearch* s = (_cmsNamedColorSearch*) hSearch;
+
+    if (s == NULL) return;
+
+    if (s ->Lab)       _cmsFree(s ->ContextID, s ->Lab);
+    if (s ->CellStart) _cmsFree(s ->ContextID, s ->CellStart);
+    if (s ->Members)   _cmsFree(s ->ContextID, s ->Members);
+    _cmsFree(s ->ContextID, s);
+}
+
+static
+cmsBool CheckMetric(cmsContext ContextID, cmsUInt32Number Metric, cmsUInt32Number k)
+{
+    if (Metric > cmsDELTAE_2000) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Unknown delta E metric %d", Metric);
+        return FALSE;
+    }
+
+    if (k == 0) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "At least one nearest color should be asked for");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+cmsUInt32Number CMSEXPORT cmsNamedColorNearest(cmsHANDLE hSearch, const cmsCIELab* Lab, cmsUInt32Number Metric, cmsUInt32Number k,
+                                               cmsUInt32Number Indexes[], cmsFloat64Number DeltaE[])
+{
+    _cmsNamedColorSearch* s = (_cmsNamedColorSearch*) hSearch;
+    cmsFloat64Number Local[16];
+    cmsFloat64Number* dE = DeltaE;
+    cmsUInt32Number nFound;
+
+    if (s == NULL || Lab == NULL || Indexes == NULL) return 0;
+    if (!CheckMetric(s ->ContextID, Metric, k)) return 0;
+
+    if (dE == NULL) {
+
+        if (k <= 16) dE = Local;
+        else {
+            dE = (cmsFloat64Number*) _cmsCalloc(s ->ContextID, k, sizeof(cmsFloat64Number));
+            if (dE == NULL) return 0;
+        }
+    }
+
+    nFound = SearchNearest(s, Lab, Metric, k, Indexes, dE);
+
+    if (dE != DeltaE && dE != Local) _cmsFree(s ->ContextID, dE);
+    return nFound;
+}
+
+// What each thread searches
+typedef struct {
+
+    const _cmsNamedColorSearch* s;
+    const cmsCIELab*  Lab;
+    cmsUInt32Number   n;
+    cmsUInt32Number   Metric, k;
+    cmsUInt32Number*  Indexes;
+    cmsFloat64Number* DeltaE;                   // Caller's, or scratch of k entries if it gave none
+    cmsBool           OwnDeltaE;
+
+} NamedColorSearchJob;
+
+static
+void NamedColorSearchThread(void* Cargo)
+{
+    NamedColorSearchJob* Job = (NamedColorSearchJob*) Cargo;
+    cmsUInt32Number i;
+
+    for (i=0; i < Job ->n; i++) {
+
+        SearchNearest(Job ->s, Job ->Lab + i, Job ->Metric, Job ->k,
+                      Job ->Indexes + i * Job ->k,
+                      Job ->OwnDeltaE ? Job ->DeltaE : Job ->DeltaE + i * Job ->k);
+    }
+}
+
+cmsBool CMSEXPORT cmsNamedColorNearestBatch(cmsHANDLE hSearch, const cmsCIELab Lab[], cmsUInt32Number n,
+                                            cmsUInt32Number Metric, cmsUInt32Number k,
+                                            cmsUInt32Number Indexes[], cmsFloat64Number DeltaE[], cmsUInt32Number nThreads)
+{
+    _cmsNamedColorSearch* s = (_cmsNamedColorSearch*) hSearch;
+    NamedColorSearchJob* Jobs;
+    cmsUInt32Number i, First, Last;
+    cmsBool rc = TRUE;
+
+    if (s == NULL || Lab == NULL || Indexes == NULL) return FALSE;
+    if (!CheckMetric(s ->ContextID, Metric, k)) return FALSE;
+    if (n == 0) return TRUE;
+
+    // Every query gets exactly k entries
+    if (k > s ->nColors) {
+        cmsSignalError(s ->ContextID, cmsERROR_RANGE, "Only %d named colors, cannot find %d nearest", s ->nColors, k);
+        return FALSE;
+    }
+
+    if (nThreads == 0) nThreads = _cmsGetProcessorCount();
+    if (nThreads > n / NCS_MIN_BATCH) nThreads = n / NCS_MIN_BATCH;
+    if (nThreads < 1) nThreads = 1;
+
+    Jobs = (NamedColorSearchJob*) _cmsCalloc(s ->ContextID, nThreads, sizeof(NamedColorSearchJob));
+    if (Jobs == NULL) return FALSE;
+
+    for (i=0; i < nThreads; i++) {
+
+        First = (cmsUInt32Number) (((cmsUInt64Number) n * i) / nThreads);
+        Last  = (cmsUInt32Number) (((cmsUInt64Number) n * (i + 1)) / nThreads);
+
+        Jobs[i].s       = s;
+        Jobs[i].Lab     = Lab + First;
+        Jobs[i].n       = Last - First;
+        Jobs[i].Metric  = Metric;
+        Jobs[i].k       = k;
+        Jobs[i].Indexes = Indexes + First * k;
+
+        if (DeltaE != NULL)
+            Jobs[i].DeltaE = DeltaE + First * k;
+        else {
+            Jobs[i].DeltaE = (cmsFloat64Number*) _cmsCalloc(s ->ContextID, k, sizeof(cmsFloat64Number));
+            Jobs[i].OwnDeltaE = TRUE;
+            if (Jobs[i].DeltaE == NULL) rc = FALSE;
+        }
+    }
+
+    if (rc)
+        _cmsRunThreads(s ->ContextID, nThreads, NamedColorSearchThread, Jobs, sizeof(NamedColorSearchJob));
+
+    for (i=0; i < nThreads; i++) {
+        if (Jobs[i].OwnDeltaE && Jobs[i].DeltaE) _cmsFree(s ->ContextID, Jobs[i].DeltaE);
+    }
+    _cmsFree(s ->ContextID, Jobs);
+
+    return rc;
+}
+
+
 // Profile sequence description routines -------------------------------------------------------------------------------------
 
 cmsSEQ* CMSEXPORT cmsAllocProfileSequenceDescription(cmsContext ContextID, cmsUInt32Number n)
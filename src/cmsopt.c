@@ -517,6 +517,131 @@ cmsBool FixWhiteMisalignment(cmsPipeline* Lut, cmsColorSpaceSignature EntryColor
     return TRUE;
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------------------
+// Adaptive resampling. Used instead of the uniform grid when cmsFLAGS_ADAPTIVE_CLUT is given on 3-channel inputs. 
+// The coarse grid is a quarter of the reasonable one, and cells that deviate from the original LUT more than the 
+// tolerance are split 4 times by side, so those are as accurate as the uniform grid.
+// -----------------------------------------------------------------------------------------------------------------------------------------------
+
+// Tolerance in 16 bits. The default is half a step in 8 bits. 
+#define DEFAULT_ADAPTIVE_TOLERANCE  128.0
+
+// Steps by side on refined cells
+#define ADAPTIVE_REFINE             4
+
+static cmsFloat64Number GlobalAdaptiveTolerance = DEFAULT_ADAPTIVE_TOLERANCE;
+
+// The tolerance is global, as the adaptation state is. Negative values just return the current setting
+cmsFloat64Number CMSEXPORT cmsSetAdaptiveCLutTolerance(cmsFloat64Number Tolerance)
+{
+    cmsFloat64Number OldVal = GlobalAdaptiveTolerance;
+
+    if (Tolerance >= 0) 
+        GlobalAdaptiveTolerance = Tolerance;
+
+    return OldVal;
+}
+
+typedef struct {
+
+    cmsPipeline*    Lut;
+    cmsBool         FixWhite;
+    cmsUInt32Number nIns, nOuts;
+    cmsUInt16Number WhiteIn[cmsMAXCHANNELS];
+    cmsUInt16Number WhiteOut[cmsMAXCHANNELS];
+
+} AdaptiveCargo;
+
+// The white fixup cannot patch the table afterwards, since white may sit on a coarse or a refined node. 
+// Instead, white is fixed on the samples.
+static
+int AdaptiveSampler16(register const cmsUInt16Number In[], register cmsUInt16Number Out[], register void* Cargo)
+{
+    AdaptiveCargo* p = (AdaptiveCargo*) Cargo;
+    cmsUInt32Number i;
+
+    if (p ->FixWhite) {
+
+        for (i=0; i < p ->nIns; i++) 
+            if (In[i] != p ->WhiteIn[i]) break;
+
+        if (i == p ->nIns) {
+
+            for (i=0; i < p ->nOuts; i++) 
+                Out[i] = p ->WhiteOut[i];
+            return TRUE;
+        }
+    }
+
+    return XFormSampler16(In, Out, (void*) p ->Lut);
+}
+
+static
+cmsBool OptimizeByAdaptiveResampling(cmsPipeline** Lut, int nGridPoints, 
+                                     cmsColorSpaceSignature ColorSpace, cmsColorSpaceSignature OutputColorSpace, 
+                                     cmsUInt32Number dwFlags)
+{
+    cmsPipeline* Src = *Lut;
+    cmsPipeline* Dest;
+    cmsStage* CLUT;
+    _cmsStageAdaptiveCLutData* Data;
+    AdaptiveCargo Cargo;
+    cmsUInt16Number *WhitePointIn, *WhitePointOut;
+    cmsUInt16Number ObtainedOut[cmsMAXCHANNELS];
+    cmsUInt32Number i, nIns, nOuts;
+    int nCoarse;
+
+    Cargo.Lut      = Src;
+    Cargo.FixWhite = FALSE;
+    Cargo.nIns     = Src ->InputChannels;
+    Cargo.nOuts    = Src ->OutputChannels;
+
+    if (!(dwFlags & cmsFLAGS_NOWHITEONWHITEFIXUP) &&
+        _cmsEndPointsBySpace(ColorSpace, &WhitePointIn, NULL, &nIns) &&
+        _cmsEndPointsBySpace(OutputColorSpace, &WhitePointOut, NULL, &nOuts) &&
+        nIns == Src ->InputChannels && nOuts == Src ->OutputChannels) {
+
+            cmsPipelineEval16(WhitePointIn, ObtainedOut, Src);
+
+            if (!WhitesAreEqual(nOuts, WhitePointOut, ObtainedOut)) {
+
+                Cargo.FixWhite = TRUE;
+                for (i=0; i < nIns; i++)  Cargo.WhiteIn[i]  = WhitePointIn[i];
+                for (i=0; i < nOuts; i++) Cargo.WhiteOut[i] = WhitePointOut[i];
+            }
+    }
+
+    // Refined cells are as dense as the uniform grid would be
+    nCoarse = (nGridPoints + ADAPTIVE_REFINE - 2) / ADAPTIVE_REFINE + 1;
+    if (nCoarse < 2) nCoarse = 2;
+
+    CLUT = cmsStageAllocCLutAdaptive16bit(Src ->ContextID, nCoarse, ADAPTIVE_REFINE, Src ->InputChannels, Src ->OutputChannels, 
+                                          GlobalAdaptiveTolerance, AdaptiveSampler16, (void*) &Cargo);
+    if (CLUT == NULL) return FALSE;
+
+    // Refined cells don't share nodes, so if most of them need refinement the uniform grid is smaller.
+    Data = (_cmsStageAdaptiveCLutData*) CLUT ->Data;
+    if (Data ->nCoarseEntries + Data ->nRefined * Data ->BlockSize >= 
+        (cmsUInt32Number) nGridPoints * nGridPoints * nGridPoints * Src ->OutputChannels) {
+
+            cmsStageFree(CLUT);
+            return FALSE;
+    }
+
+    Dest = cmsPipelineAlloc(Src ->ContextID, Src ->InputChannels, Src ->OutputChannels);
+    if (Dest == NULL) {
+        cmsStageFree(CLUT);
+        return FALSE;
+    }
+
+    cmsPipelineInsertStage(Dest, cmsAT_END, CLUT);
+    _cmsPipelineSetOptimizationParameters(Dest, _cmsEvalAdaptiveCLut16, CLUT ->Data, NULL, NULL);
+
+    cmsPipelineFree(Src);
+    *Lut = Dest;
+    return TRUE;
+}
+
 // -----------------------------------------------------------------------------------------------------------------------------------------------
 // This function creates simple LUT from complex ones. The generated LUT has an optional set of 
 // prelinearization curves, a CLUT of nGridPoints and optional postlinearization tables. 
@@ -564,6 +689,16 @@ cmsBool OptimizeByResampling(cmsPipeline** Lut, cmsUInt32Number Intent, cmsUInt3
             if (cmsStageType(mpe) == cmsSigNamedColorElemType) return FALSE;
     }
 
+    // Adaptive tables take no pre/post linearization. Falls back to the uniform grid if not possible.
+    if ((*dwFlags & cmsFLAGS_ADAPTIVE_CLUT) && Src ->InputChannels == 3 && cmsPipelineStageCount(Src) > 0) {
+
+        if (Intent == INTENT_ABSOLUTE_COLORIMETRIC)
+            *dwFlags |= cmsFLAGS_NOWHITEONWHITEFIXUP;
+
+        if (OptimizeByAdaptiveResampling(Lut, nGridPoints, ColorSpace, OutputColorSpace, *dwFlags)) 
+            return TRUE;
+    }
+
     // Allocate an empty LUT    
     Dest =  cmsPipelineAlloc(Src ->ContextID, Src ->InputChannels, Src ->OutputChannels);
     if (!Dest) return FALSE;
@@ -1345,13 +1480,13 @@ Error:
 static
 void  FreeMatShaper(cmsContext ContextID, void* Data)
 {
-    if (Data != NULL) _cmsFree(ContextID, Data);
+    if (Data != NULL) _cmsFreeSharedTable(ContextID, Data);
 }
 
 static
 void* DupMatShaper(cmsContext ContextID, const void* Data)
 {
-    return _cmsDupMem(ContextID, Data, sizeof(MatShaper8Data));
+    return _cmsDupSharedTable(ContextID, Data, sizeof(MatShaper8Data));
 }
 
 
@@ -1446,8 +1581,8 @@ cmsBool SetMatShaper(cmsPipeline* Dest, cmsToneCurve* Curve1[3], cmsMAT3* Mat, c
     int i, j;
     cmsBool Is8Bits = _cmsFormatterIs8bit(*OutputFormat);
 
-    // Allocate a big chuck of memory to store precomputed tables
-    p = (MatShaper8Data*) _cmsMalloc(Dest ->ContextID, sizeof(MatShaper8Data));
+    // Allocate a big chuck of memory to store precomputed tables. Zeroed, so padding does not defeat table sharing
+    p = (MatShaper8Data*) _cmsMallocZero(Dest ->ContextID, sizeof(MatShaper8Data));
     if (p == NULL) return FALSE;
 
     p -> ContextID = Dest -> ContextID;
@@ -1482,6 +1617,9 @@ cmsBool SetMatShaper(cmsPipeline* Dest, cmsToneCurve* Curve1[3], cmsMAT3* Mat, c
     if (Is8Bits)
         *OutputFormat |= OPTIMIZED_SH(1);
 
+    // Identical tables from other transforms may be reused
+    p = (MatShaper8Data*) _cmsShareTable(Dest ->ContextID, p, sizeof(MatShaper8Data));
+
     // Fill function pointers    
     _cmsPipelineSetOptimizationParameters(Dest, MatShaperEval16, (void*) p, FreeMatShaper, DupMatShaper);
     return TRUE;
@@ -1565,6 +1703,675 @@ cmsBool OptimizeMatrixShaper(cmsPipeline** Lut, cmsUInt32Number Intent, cmsUInt3
 }
 
 
+// -------------------------------------------------------------------------------------------------------------------------------------
+// Matrix-shaper fitting. Many RGB profiles store plain matrix-shaper behaviour as CLUTs, so OptimizeMatrixShaper cannot
+// see it. Here the linked pipeline is sampled and a shaper-matrix-shaper model is fitted. The model is
+//
+//      Out = G(g^-1(M * g(In)))
+//
+// where G is the response of the pipeline on the gray axis, g is a gamma with linear toe (same for all channels) and M is
+// a 3x3 matrix. If the fit is good enough, the CLUT is not needed at all. Since this trades accuracy for speed, it
+// only runs when a tolerance has been set.
+// On 8 bits, g^-1 and G are joined so the fast matrix-shaper evaluator can be used.
+// -------------------------------------------------------------------------------------------------------------------------------------
+
+// Max error allowed, as euclidean distance on outputs scaled to 0..100. Zero, the default, disables the fitting
+#define DEFAULT_FIT_TOLERANCE   0
+
+static cmsFloat64Number GlobalFitTolerance = DEFAULT_FIT_TOLERANCE;
+
+// Negative values just return the current setting
+cmsFloat64Number CMSEXPORT cmsSetMatrixShaperFitTolerance(cmsFloat64Number Tolerance)
+{
+    cmsFloat64Number OldVal = GlobalFitTolerance;
+
+    if (Tolerance >= 0) 
+        GlobalFitTolerance = Tolerance;
+
+    return OldVal;
+}
+
+#define FIT_GRAY_POINTS     4096    // Entries on the gray response
+#define FIT_SEARCH_POINTS   7       // Grid used to search the gamma
+#define FIT_CHECK_POINTS    17      // Grid used to check the final fit
+
+// A gamma with a linear toe, the same construction sRGB uses. Slope is taken to be continuous at the breakpoint.
+typedef struct {
+
+    cmsFloat64Number Gamma, Offset;
+    cmsFloat64Number Break, Slope;
+
+} FitShaper;
+
+static
+void FitShaperInit(FitShaper* p, cmsFloat64Number Gamma, cmsFloat64Number Offset)
+{
+    p ->Gamma  = Gamma;
+    p ->Offset = Offset;
+
+    if (Offset > 0 && Gamma > 1) {
+
+        p ->Break = Offset / (Gamma - 1);
+        p ->Slope = pow((p ->Break + Offset) / (1 + Offset), Gamma) / p ->Break;
+    }
+    else {
+        p ->Break = 0;
+        p ->Slope = 0;
+    }
+}
+
+static
+cmsFloat64Number FitShaperEval(const FitShaper* p, cmsFloat64Number x)
+{
+    if (x <= 0) return 0;
+    if (x < p ->Break) return p ->Slope * x;
+
+    return pow((x + p ->Offset) / (1 + p ->Offset), p ->Gamma);
+}
+
+// Same curve as an ICC parametric type 4: Y = (aX+b)^Gamma | X >= d, Y = cX | X < d
+static
+cmsToneCurve* FitShaperToneCurve(cmsContext ContextID, const FitShaper* p)
+{
+    cmsFloat64Number Params[5];
+
+    Params[0] = p ->Gamma;
+    Params[1] = 1.0 / (1 + p ->Offset);
+    Params[2] = p ->Offset / (1 + p ->Offset);
+    Params[3] = p ->Slope;
+    Params[4] = p ->Break;
+
+    return cmsBuildParametricToneCurve(ContextID, 4, Params);
+}
+
+// Least squares on M * g(In) = g(z). Returns the sum of squared residuals, or -1 if the system cannot be solved
+static
+cmsFloat64Number FitMatrix(const FitShaper* Shaper, const cmsFloat64Number* In, const cmsFloat64Number* z, int nSamples, cmsMAT3* Mat)
+{
+    cmsMAT3 A;
+    cmsVEC3 b[3], x, gIn, gz;
+    cmsFloat64Number Residual, d;
+    int i, j, k;
+
+    memset(&A, 0, sizeof(A));
+    memset(b, 0, sizeof(b));
+
+    for (i=0; i < nSamples; i++) {
+
+        for (j=0; j < 3; j++) {
+            gIn.n[j] = FitShaperEval(Shaper, In[i*3+j]);
+            gz.n[j]  = FitShaperEval(Shaper, z[i*3+j]);
+        }
+
+        for (j=0; j < 3; j++) {
+            for (k=0; k < 3; k++) {
+
+                A.v[j].n[k] += gIn.n[j] * gIn.n[k];
+                b[k].n[j]   += gIn.n[j] * gz.n[k];
+            }
+        }
+    }
+
+    for (k=0; k < 3; k++) {
+
+        cmsMAT3 Tmp = A;
+
+        if (!_cmsMAT3solve(&x, &Tmp, &b[k])) return -1;
+        Mat ->v[k] = x;
+    }
+
+    Residual = 0;
+    for (i=0; i < nSamples; i++) {
+
+        for (j=0; j < 3; j++) 
+            gIn.n[j] = FitShaperEval(Shaper, In[i*3+j]);
+
+        _cmsMAT3eval(&x, Mat, &gIn);
+
+        for (j=0; j < 3; j++) {
+            d = x.n[j] - FitShaperEval(Shaper, z[i*3+j]);
+            Residual += d * d;
+        }
+    }
+
+    return Residual;
+}
+
+// Finds the gray that gives Value on the given channel. Gray response is known to be ascending. Done by bisection on 
+// the pipeline itself, since the gray response is very steep near zero and a table would not be accurate enough there.
+static
+cmsFloat64Number FitInverseGray(cmsPipeline* Lut, int Channel, cmsFloat32Number Value)
+{
+    cmsFloat32Number In[3], Out[cmsMAXCHANNELS];
+    cmsFloat64Number Lo = 0, Hi = 1, Mid;
+    int i;
+
+    for (i=0; i < 24; i++) {
+
+        Mid = (Lo + Hi) / 2;
+        In[0] = In[1] = In[2] = (cmsFloat32Number) Mid;
+        cmsPipelineEvalFloat(In, Out, Lut);
+
+        if (Out[Channel] < Value) Lo = Mid;
+        else Hi = Mid;
+    }
+
+    return (Lo + Hi) / 2;
+}
+
+// Samples the pipeline on a uniform grid. Outputs are mapped back to the gray that gives same value.
+static
+void FitSampleGrid(cmsPipeline* Lut, int nPoints, cmsFloat64Number* In, cmsFloat64Number* z)
+{
+    cmsFloat32Number InF[3], OutF[cmsMAXCHANNELS];
+    int i, j, n = 0;
+    int r, g, b;
+
+    for (r=0; r < nPoints; r++)
+        for (g=0; g < nPoints; g++)
+            for (b=0; b < nPoints; b++) {
+
+                InF[0] = (cmsFloat32Number) r / (nPoints - 1);
+                InF[1] = (cmsFloat32Number) g / (nPoints - 1);
+                InF[2] = (cmsFloat32Number) b / (nPoints - 1);
+
+                cmsPipelineEvalFloat(InF, OutF, Lut);
+
+                for (j=0; j < 3; j++) {
+
+                    i = n*3 + j;
+                    In[i] = InF[j];
+                    z[i]  = FitInverseGray(Lut, j, OutF[j]);
+                }
+                n++;
+            }
+}
+
+// Worst error of the fitted model against the pipeline on a dense grid
+static
+cmsFloat64Number FitMaxError(cmsPipeline* Lut, cmsPipeline* Model)
+{
+    cmsFloat32Number In[3], Out1[cmsMAXCHANNELS], Out2[cmsMAXCHANNELS];
+    cmsFloat64Number d, Dist, MaxDist = 0;
+    int r, g, b, j;
+
+    for (r=0; r < FIT_CHECK_POINTS; r++)
+        for (g=0; g < FIT_CHECK_POINTS; g++)
+            for (b=0; b < FIT_CHECK_POINTS; b++) {
+
+                In[0] = (cmsFloat32Number) r / (FIT_CHECK_POINTS - 1);
+                In[1] = (cmsFloat32Number) g / (FIT_CHECK_POINTS - 1);
+                In[2] = (cmsFloat32Number) b / (FIT_CHECK_POINTS - 1);
+
+                cmsPipelineEvalFloat(In, Out1, Lut);
+                cmsPipelineEvalFloat(In, Out2, Model);
+
+                Dist = 0;
+                for (j=0; j < 3; j++) {
+
+                    // Pipeline outputs are clipped when encoded
+                    if (Out1[j] < 0) Out1[j] = 0; 
+                    if (Out1[j] > 1) Out1[j] = 1;
+                    if (Out2[j] < 0) Out2[j] = 0; 
+                    if (Out2[j] > 1) Out2[j] = 1;
+
+                    d = 100.0 * (Out1[j] - Out2[j]);
+                    Dist += d * d;
+                }
+
+                Dist = sqrt(Dist);
+                if (Dist > MaxDist) MaxDist = Dist;
+            }
+
+    return MaxDist;
+}
+
+// Offsets of the linear toe that are tried. Zero is a pure gamma, 0.055 is sRGB and 0.099 is Rec709
+static const cmsFloat64Number FitOffsets[] = { 0, 0.02, 0.04, 0.055, 0.08, 0.099, 0.12 };
+
+static
+cmsBool OptimizeByFittingMatrixShaper(cmsPipeline** Lut, cmsUInt32Number Intent, cmsUInt32Number* InputFormat, cmsUInt32Number* OutputFormat, cmsUInt32Number* dwFlags)
+{
+    cmsPipeline* Src = *Lut;
+    cmsPipeline* Dest = NULL;
+    cmsContext ContextID = Src ->ContextID;
+    cmsStage *mpe, *Stage[4] = { NULL, NULL, NULL, NULL };
+    cmsBool HasCLUT = FALSE;
+    cmsToneCurve *Gray[3] = { NULL, NULL, NULL };
+    cmsToneCurve *Shaper = NULL, *InvShaper = NULL;
+    cmsToneCurve *Curve1[3], *Curve2[3] = { NULL, NULL, NULL };
+    cmsUInt16Number *GrayTab = NULL, *Joined = NULL;
+    cmsFloat64Number *In = NULL, *z = NULL;
+    cmsFloat32Number InF[3], OutF[cmsMAXCHANNELS];
+    cmsFloat64Number Gamma, BestGamma = 0, BestOffset = 0, Residual, BestResidual = -1;
+    FitShaper Best, Try;
+    cmsMAT3 Mat;
+    cmsBool rc = FALSE, CanUse8bits;
+    int i, j, k, nSamples;
+
+    if (GlobalFitTolerance <= 0) return FALSE;
+
+    // Only RGB to RGB, on integer formats. This is a lossy optimization as resampling is
+    if (_cmsFormatterIsFloat(*InputFormat) || _cmsFormatterIsFloat(*OutputFormat)) return FALSE;
+    if (T_COLORSPACE(*InputFormat) != PT_RGB || T_COLORSPACE(*OutputFormat) != PT_RGB) return FALSE;
+    if (Src ->InputChannels != 3 || Src ->OutputChannels != 3) return FALSE;
+    if (cmsPipelineStageCount(Src) == 0) return FALSE;
+
+    // Only worth on LUT based pipelines. Named color pipelines cannot be optimized.
+    for (mpe = cmsPipelineGetPtrToFirstStage(Src); mpe != NULL; mpe = cmsStageNext(mpe)) {
+        if (cmsStageType(mpe) == cmsSigNamedColorElemType) return FALSE;
+        if (cmsStageType(mpe) == cmsSigCLutElemType) HasCLUT = TRUE;
+    }
+
+    if (!HasCLUT) return FALSE;
+
+    // Response on the gray axis. Has to be ascending to be reversed.
+    GrayTab = (cmsUInt16Number*) _cmsCalloc(ContextID, 3 * FIT_GRAY_POINTS, sizeof(cmsUInt16Number));
+    if (GrayTab == NULL) return FALSE;
+
+    for (i=0; i < FIT_GRAY_POINTS; i++) {
+
+        InF[0] = InF[1] = InF[2] = (cmsFloat32Number) i / (FIT_GRAY_POINTS - 1);
+        cmsPipelineEvalFloat(InF, OutF, Src);
+
+        for (j=0; j < 3; j++)
+            GrayTab[j * FIT_GRAY_POINTS + i] = _cmsQuickSaturateWord(OutF[j] * 65535.0);
+    }
+
+    for (j=0; j < 3; j++) {
+
+        Gray[j] = cmsBuildTabulatedToneCurve16(ContextID, FIT_GRAY_POINTS, GrayTab + j * FIT_GRAY_POINTS);
+        if (Gray[j] == NULL) goto Done;
+
+        if (!cmsIsToneCurveMonotonic(Gray[j]) || cmsIsToneCurveDescending(Gray[j])) goto Done;
+        if (GrayTab[j * FIT_GRAY_POINTS] >= GrayTab[j * FIT_GRAY_POINTS + FIT_GRAY_POINTS - 1]) goto Done;
+    }
+
+    // Sample a small grid and search for the shaper that makes the relationship most linear
+    nSamples = FIT_SEARCH_POINTS * FIT_SEARCH_POINTS * FIT_SEARCH_POINTS;
+
+    In  = (cmsFloat64Number*) _cmsCalloc(ContextID, nSamples * 3, sizeof(cmsFloat64Number));
+    z   = (cmsFloat64Number*) _cmsCalloc(ContextID, nSamples * 3, sizeof(cmsFloat64Number));
+    if (In == NULL || z == NULL) goto Done;
+
+    FitSampleGrid(Src, FIT_SEARCH_POINTS, In, z);
+
+    for (k=0; k < (int) (sizeof(FitOffsets) / sizeof(cmsFloat64Number)); k++) {
+
+        for (Gamma = 1.0; Gamma <= 3.0001; Gamma += 0.05) {
+
+            FitShaperInit(&Try, Gamma, FitOffsets[k]);
+            Residual = FitMatrix(&Try, In, z, nSamples, &Mat);
+
+            if (Residual >= 0 && (BestResidual < 0 || Residual < BestResidual)) {
+                BestResidual = Residual; BestGamma = Gamma; BestOffset = FitOffsets[k];
+            }
+        }
+    }
+
+    if (BestResidual < 0) goto Done;
+
+    // Refine the gamma a bit
+    for (Gamma = BestGamma - 0.05; Gamma <= BestGamma + 0.05; Gamma += 0.01) {
+
+        if (Gamma < 1.0) continue;
+
+        FitShaperInit(&Try, Gamma, BestOffset);
+        Residual = FitMatrix(&Try, In, z, nSamples, &Mat);
+
+        if (Residual >= 0 && Residual < BestResidual) {
+            BestResidual = Residual; BestGamma = Gamma;
+        }
+    }
+
+    FitShaperInit(&Best, BestGamma, BestOffset);
+    if (FitMatrix(&Best, In, z, nSamples, &Mat) < 0) goto Done;
+
+    // Build the curves. Output goes back through the inverse shaper and then the gray response. Those are kept
+    // apart, as the composition is very steep near zero and would need a huge table to keep accuracy.
+    Shaper = FitShaperToneCurve(ContextID, &Best);
+    if (Shaper == NULL) goto Done;
+
+    InvShaper = cmsReverseToneCurve(Shaper);
+    if (InvShaper == NULL) goto Done;
+
+    Curve1[0] = Curve1[1] = Curve1[2] = Shaper;
+    Curve2[0] = Curve2[1] = Curve2[2] = InvShaper;
+
+    Dest = cmsPipelineAlloc(ContextID, 3, 3);
+    if (Dest == NULL) goto Done;
+
+    Stage[0] = cmsStageAllocToneCurves(ContextID, 3, Curve1);
+    Stage[1] = cmsStageAllocMatrix(ContextID, 3, 3, (const cmsFloat64Number*) &Mat, NULL);
+    Stage[2] = cmsStageAllocToneCurves(ContextID, 3, Curve2);
+    Stage[3] = cmsStageAllocToneCurves(ContextID, 3, Gray);
+
+    for (i=0; i < 4; i++) {
+        if (Stage[i] == NULL) goto Done;
+        cmsPipelineInsertStage(Dest, cmsAT_END, Stage[i]);
+        Stage[i] = NULL;
+    }
+
+    // Now see if the model is close enough
+    if (FitMaxError(Src, Dest) > GlobalFitTolerance) goto Done;
+
+    // 8 bits can use the fast matrix-shaper evaluator, as long as the matrix fits on 1.14 fixed point. 
+    // Output curves are joined on the exact nodes the evaluator uses.
+    CanUse8bits = _cmsFormatterIs8bit(*InputFormat);
+    for (i=0; i < 3; i++)
+        for (j=0; j < 3; j++)
+            if (fabs(Mat.v[i].n[j]) >= 2.0) CanUse8bits = FALSE;
+
+    if (CanUse8bits) {
+
+        Joined = (cmsUInt16Number*) _cmsCalloc(ContextID, 16385, sizeof(cmsUInt16Number));
+        if (Joined == NULL) goto Done;
+
+        for (j=0; j < 3; j++) {
+
+            for (i=0; i < 16385; i++) {
+
+                cmsFloat32Number v = cmsEvalToneCurveFloat(InvShaper, (cmsFloat32Number) (i / 16384.0));
+                Joined[i] = _cmsQuickSaturateWord(cmsEvalToneCurveFloat(Gray[j], v) * 65535.0);
+            }
+
+            Curve2[j] = cmsBuildTabulatedToneCurve16(ContextID, 16385, Joined);
+            if (Curve2[j] == NULL) goto Done;
+        }
+
+        *dwFlags |= cmsFLAGS_NOCACHE;
+        SetMatShaper(Dest, Curve1, &Mat, NULL, Curve2, OutputFormat);
+    }
+
+    cmsPipelineFree(Src);
+    *Lut = Dest;
+    Dest = NULL;
+    rc = TRUE;
+
+Done:
+    if (Dest) cmsPipelineFree(Dest);
+    for (i=0; i < 4; i++) 
+        if (Stage[i]) cmsStageFree(Stage[i]);
+    for (j=0; j < 3; j++) {
+        if (Gray[j]) cmsFreeToneCurve(Gray[j]);
+        if (Curve2[j] && Curve2[j] != InvShaper) cmsFreeToneCurve(Curve2[j]);
+    }
+    if (Joined) _cmsFree(ContextID, Joined);
+    if (Shaper) cmsFreeToneCurve(Shaper);
+    if (InvShaper) cmsFreeToneCurve(InvShaper);
+    if (GrayTab) _cmsFree(ContextID, GrayTab);
+    if (In) _cmsFree(ContextID, In);
+    if (z)  _cmsFree(ContextID, z);
+
+    return rc;
+
+    cmsUNUSED_PARAMETER(Intent);
+}
+
+
+// -------------------------------------------------------------------------------------------------------------------------------------
+// Shared tables. Independently built transforms often end with byte-identical CLUTs or matrix-shaper tables. When sharing is
+// enabled, tables produced by the optimizer are hashed and identical ones are kept only once, reference counted. Shared
+// tables are immutable; anything willing to write on them has to unshare first.
+
+#define SHARED_TABLE_BUCKETS  256
+
+typedef struct _cmsSharedTable_st {
+
+    void*           Table;
+    cmsUInt32Number Size;
+    cmsUInt32Number Hash;
+    cmsUInt32Number RefCount;
+    cmsContext      ContextID;
+
+    struct _cmsSharedTable_st* NextByHash;
+    struct _cmsSharedTable_st* NextByPtr;
+
+} _cmsSharedTable;
+
+static _cmsSharedTable* SharedByHash[SHARED_TABLE_BUCKETS];
+static _cmsSharedTable* SharedByPtr[SHARED_TABLE_BUCKETS];
+
+static cmsInt32Number   SharingMinBytes = 0;     // Zero means sharing is disabled
+static cmsUInt32Number  SharedCount     = 0;     // Those two are only touched with the store locked
+static cmsUInt32Number  SharedBytes     = 0;
+
+// Transforms may be built and freed from several threads, so the store is guarded by a tiny spin lock
+static volatile long SharedLock = 0;
+
+#define LockShared()    while (_cmsAtomicExchange(&SharedLock, 1)) { }
+#define UnlockShared()  _cmsAtomicRelease(&SharedLock)
+
+// FNV-1a over the whole table
+static
+cmsUInt32Number HashTable(const void* Table, cmsUInt32Number Size)
+{
+    const cmsUInt8Number* p = (const cmsUInt8Number*) Table;
+    cmsUInt32Number h = 2166136261U;
+    cmsUInt32Number i;
+
+    for (i=0; i < Size; i++) {
+        h ^= p[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+static
+cmsUInt32Number PtrBucket(const void* Table)
+{
+    cmsUInt32Number v = (cmsUInt32Number) ((size_t) Table >> 4);
+
+    return (v ^ (v >> 8) ^ (v >> 16)) % SHARED_TABLE_BUCKETS;
+}
+
+// Locate the entry of a shared table. Must be called with the store locked
+static
+_cmsSharedTable** FindByPtr(const void* Table)
+{
+    _cmsSharedTable** ptr = &SharedByPtr[PtrBucket(Table)];
+
+    while (*ptr != NULL && (*ptr) ->Table != Table)
+        ptr = &(*ptr) ->NextByPtr;
+
+    return ptr;
+}
+
+// Take out an entry that has no references left. Must be called with the store locked
+static
+void UnlinkShared(_cmsSharedTable* e)
+{
+    _cmsSharedTable** ptr = &SharedByHash[e ->Hash % SHARED_TABLE_BUCKETS];
+
+    while (*ptr != e) ptr = &(*ptr) ->NextByHash;
+    *ptr = e ->NextByHash;
+
+    ptr = FindByPtr(e ->Table);
+    *ptr = e ->NextByPtr;
+
+    SharedCount--;
+    SharedBytes -= e ->Size;
+}
+
+// Sets the minimum size, in bytes, of tables to share. Zero disables sharing, negative values just query
+cmsInt32Number CMSEXPORT cmsSetTableSharing(cmsInt32Number MinBytes)
+{
+    cmsInt32Number Old = SharingMinBytes;
+
+    if (MinBytes >= 0)
+        SharingMinBytes = MinBytes;
+
+    return Old;
+}
+
+// Number of distinct tables currently shared, and the memory they take
+cmsUInt32Number CMSEXPORT cmsGetSharedTableCount(cmsUInt32Number* Bytes)
+{
+    cmsUInt32Number n;
+
+    LockShared();
+    n = SharedCount;
+    if (Bytes) *Bytes = SharedBytes;
+    UnlockShared();
+
+    return n;
+}
+
+// Hands a table, allocated by _cmsMalloc, to the store. Returns the table to use instead, which is either the same one,
+// now shared, or an identical one that was already there. In the later case the given table is freed.
+void* _cmsShareTable(cmsContext ContextID, void* Table, cmsUInt32Number Size)
+{
+    _cmsSharedTable* e;
+    _cmsSharedTable** Bucket;
+    cmsUInt32Number Hash;
+
+    if (Table == NULL || SharingMinBytes <= 0 || Size < (cmsUInt32Number) SharingMinBytes)
+        return Table;
+
+    Hash = HashTable(Table, Size);
+
+    LockShared();
+
+    // Already in the store?
+    if (*FindByPtr(Table) != NULL) {
+        UnlockShared();
+        return Table;
+    }
+
+    for (e = SharedByHash[Hash % SHARED_TABLE_BUCKETS]; e != NULL; e = e ->NextByHash) {
+
+        if (e ->Hash == Hash && e ->Size == Size && e ->ContextID == ContextID &&
+            memcmp(e ->Table, Table, Size) == 0) {
+
+                e ->RefCount++;
+                UnlockShared();
+
+                _cmsFree(ContextID, Table);
+                return e ->Table;
+        }
+    }
+    UnlockShared();
+
+    e = (_cmsSharedTable*) _cmsMallocZero(ContextID, sizeof(_cmsSharedTable));
+    if (e == NULL) return Table;    // Just not shared
+
+    e ->Table     = Table;
+    e ->Size      = Size;
+    e ->Hash      = Hash;
+    e ->RefCount  = 1;
+    e ->ContextID = ContextID;
+
+    LockShared();
+
+    Bucket = &SharedByHash[Hash % SHARED_TABLE_BUCKETS];
+    e ->NextByHash = *Bucket;
+    *Bucket = e;
+
+    Bucket = &SharedByPtr[PtrBucket(Table)];
+    e ->NextByPtr = *Bucket;
+    *Bucket = e;
+
+    SharedCount++;
+    SharedBytes += Size;
+
+    UnlockShared();
+    return Table;
+}
+
+// Duplicates a table. Shared tables only get one more reference
+void* _cmsDupSharedTable(cmsContext ContextID, const void* Table, cmsUInt32Number Size)
+{
+    _cmsSharedTable* e;
+
+    if (Table == NULL) return NULL;
+
+    LockShared();
+    e = SharedCount > 0 ? *FindByPtr(Table) : NULL;
+    if (e != NULL) {
+        e ->RefCount++;
+        UnlockShared();
+        return (void*) Table;
+    }
+    UnlockShared();
+
+    return _cmsDupMem(ContextID, Table, Size);
+}
+
+// Frees a table, which may or may not be shared
+void _cmsFreeSharedTable(cmsContext ContextID, void* Table)
+{
+    _cmsSharedTable* e;
+
+    if (Table == NULL) return;
+
+    LockShared();
+    e = SharedCount > 0 ? *FindByPtr(Table) : NULL;
+    if (e != NULL) {
+
+        if (--e ->RefCount > 0) {
+            UnlockShared();
+            return;
+        }
+
+        UnlinkShared(e);
+        UnlockShared();
+
+        _cmsFree(e ->ContextID, Table);
+        _cmsFree(e ->ContextID, e);
+        return;
+    }
+    UnlockShared();
+
+    _cmsFree(ContextID, Table);
+}
+
+// Gets a private, writable copy of a table. The given one is released if it was shared
+void* _cmsUnshareTable(cmsContext ContextID, void* Table, cmsUInt32Number Size)
+{
+    void* Private;
+    cmsBool IsShared = FALSE;
+
+    if (Table == NULL) return Table;
+
+    LockShared();
+    IsShared = SharedCount > 0 && *FindByPtr(Table) != NULL;
+    UnlockShared();
+
+    if (!IsShared) return Table;
+
+    Private = _cmsDupMem(ContextID, Table, Size);
+    if (Private == NULL) return NULL;
+
+    _cmsFreeSharedTable(ContextID, Table);
+    return Private;
+}
+
+// Shares the tables of all CLUT stages on a pipeline. The interpolation parameters are pointed to the shared copy.
+static
+void ShareCLutTables(cmsPipeline* Lut)
+{
+    cmsStage* mpe;
+
+    if (SharingMinBytes <= 0) return;
+
+    for (mpe = cmsPipelineGetPtrToFirstStage(Lut); mpe != NULL; mpe = cmsStageNext(mpe)) {
+
+        _cmsStageCLutData* Data;
+        cmsUInt32Number Size;
+
+        if (cmsStageType(mpe) != cmsSigCLutElemType) continue;
+
+        Data = (_cmsStageCLutData*) mpe ->Data;
+        if (Data == NULL || Data ->Tab.T == NULL) continue;
+
+        Size = Data ->nEntries * (Data ->HasFloatValues ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number));
+
+        Data ->Tab.T = (cmsUInt16Number*) _cmsShareTable(mpe ->ContextID, Data ->Tab.T, Size);
+        Data ->Params ->Table = Data ->Tab.T;
+    }
+}
+
+
 // -------------------------------------------------------------------------------------------------------------------------------------
 // Optimization plug-ins
 
@@ -1578,12 +2385,14 @@ typedef struct _cmsOptimizationCollection_st {
 } _cmsOptimizationCollection;
 
 
-// The built-in list. We currently implement 4 types of optimizations. Joining of curves, matrix-shaper, linearization and resampling
+// The built-in list. We currently implement 5 types of optimizations. Joining of curves, matrix-shaper, matrix-shaper fitting,
+// linearization and resampling
 static _cmsOptimizationCollection DefaultOptimization[] = {
 
     { OptimizeByJoiningCurves,            &DefaultOptimization[1] },
     { OptimizeMatrixShaper,               &DefaultOptimization[2] },
-    { OptimizeByComputingLinearization,   &DefaultOptimization[3] },
+    { OptimizeByFittingMatrixShaper,      &DefaultOptimization[3] },
+    { OptimizeByComputingLinearization,   &DefaultOptimization[4] },
     { OptimizeByResampling,               NULL }
 };
 
@@ -1633,7 +2442,10 @@ cmsBool _cmsOptimizePipeline(cmsPipeline**    PtrLut,
     if (*dwFlags & cmsFLAGS_FORCE_CLUT) {
     
         PreOptimize(*PtrLut);
-        return OptimizeByResampling(PtrLut, Intent, InputFormat, OutputFormat, dwFlags);
+        if (!OptimizeByResampling(PtrLut, Intent, InputFormat, OutputFormat, dwFlags)) return FALSE;
+
+        ShareCLutTables(*PtrLut);
+        return TRUE;
     }
 
     // Anything to optimize?
@@ -1663,6 +2475,7 @@ cmsBool _cmsOptimizePipeline(cmsPipeline**    PtrLut,
             // If one schema succeeded, we are done
             if (Opts ->OptimizePtr(PtrLut, Intent, InputFormat, OutputFormat, dwFlags)) {
                 
+                ShareCLutTables(*PtrLut);
                 return TRUE;    // Optimized!
             }
     }
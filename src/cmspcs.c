@@ -106,6 +106,45 @@ void CMSEXPORT cmsxyY2XYZ(cmsCIEXYZ* Dest, const cmsCIExyY* Source)
     Dest -> Z = ((1 - Source -> x - Source -> y) / Source -> y) * Source -> Y;
 }
 
+// Precision policy ------------------------------------------------------------------------------------------
+
+// The policy is read only when transforms and CIECAM02 models are created, which keep it from then on.
+// Error budgets are documented along cmsSetPrecisionPolicy
+static cmsInt32Number PrecisionPolicy = cmsPRECISION_EXACT;
+
+cmsInt32Number CMSEXPORT cmsSetPrecisionPolicy(cmsInt32Number Policy)
+{
+    cmsInt32Number Old = PrecisionPolicy;
+
+    if (Policy >= 0)
+        PrecisionPolicy = (Policy == cmsPRECISION_FAST) ? cmsPRECISION_FAST : cmsPRECISION_EXACT;
+
+    return Old;
+}
+
+// Fast atan2, for objects created under the fast policy. Reduces to an octant and uses a minimax
+// polynomial. Absolute error is below 1E-5 radians
+cmsFloat64Number _cmsArcTan2(cmsFloat64Number y, cmsFloat64Number x)
+{
+    cmsFloat64Number ax, ay, a, s, r;
+
+    ax = fabs(x);
+    ay = fabs(y);
+
+    if (ax == 0 && ay == 0) return 0;
+
+    a = (ax > ay) ? ay / ax : ax / ay;
+    s = a * a;
+    r = a * (0.99997726 + s * (-0.33262347 + s * (0.19354346 + s * (-0.11643287 + s * (0.05265332 + s * -0.01172120)))));
+
+    if (ay > ax) r = 1.57079632679489662 - r;
+    if (x < 0)   r = 3.14159265358979324 - r;
+    if (y < 0)   r = -r;
+
+    return r;
+}
+
+
 static
 cmsFloat64Number f(cmsFloat64Number t)
 {
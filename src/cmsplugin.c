@@ -615,3 +615,358 @@ void CMSEXPORT cmsUnregisterPlugins(void)
 
     PluginPool = NULL;
 }
+
+
+// ----------------------------------------------------------------------------------
+// CPU feature dispatch
+// ----------------------------------------------------------------------------------
+
+#if !defined(CMS_DONT_USE_CPUID) && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#   include <cpuid.h>
+#   define CMS_GNU_CPUID   1
+#elif !defined(CMS_DONT_USE_CPUID) && defined(_MSC_VER) && (_MSC_VER >= 1700) && (defined(_M_IX86) || defined(_M_X64))
+#   include <intrin.h>
+#   define CMS_MSC_CPUID   1
+#endif
+
+// Detection is done once. Concurrent first calls would just compute the same value
+static cmsInt32Number DetectedCPULevel = -1;
+
+// Cap given by the user or by the environment. -1 if not yet read
+static cmsInt32Number CPULevelCap = -1;
+
+#if defined(CMS_GNU_CPUID) || defined(CMS_MSC_CPUID)
+
+static
+void CpuId(cmsUInt32Number Leaf, cmsUInt32Number Regs[4])
+{
+#ifdef CMS_GNU_CPUID
+    __cpuid_count(Leaf, 0, Regs[0], Regs[1], Regs[2], Regs[3]);
+#else
+    int r[4];
+
+    __cpuidex(r, (int) Leaf, 0);
+    Regs[0] = (cmsUInt32Number) r[0]; Regs[1] = (cmsUInt32Number) r[1];
+    Regs[2] = (cmsUInt32Number) r[2]; Regs[3] = (cmsUInt32Number) r[3];
+#endif
+}
+
+// Which register sets the OS saves on context switch
+static
+cmsUInt32Number XGetBV(void)
+{
+#ifdef CMS_GNU_CPUID
+    cmsUInt32Number eax, edx;
+
+    // xgetbv, written as bytes for old assemblers
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#else
+    return (cmsUInt32Number) _xgetbv(0);
+#endif
+}
+
+static
+cmsInt32Number DetectLevel(void)
+{
+    cmsUInt32Number Regs[4], MaxLeaf, XCR0;
+    cmsInt32Number Level = cmsCPU_GENERIC;
+
+    CpuId(0, Regs);
+    MaxLeaf = Regs[0];
+    if (MaxLeaf < 1) return Level;
+
+    CpuId(1, Regs);
+    if (!(Regs[3] & (1U << 26))) return Level;          // SSE2
+    Level = cmsCPU_SSE2;
+
+    if (!(Regs[2] & (1U << 19))) return Level;          // SSE4.1
+    Level = cmsCPU_SSE41;
+
+    // AVX needs the OS to save the YMM registers
+    if (!(Regs[2] & (1U << 27)) || !(Regs[2] & (1U << 28))) return Level;   // OSXSAVE, AVX
+    XCR0 = XGetBV();
+    if ((XCR0 & 0x06) != 0x06 || MaxLeaf < 7) return Level;
+
+    CpuId(7, Regs);
+    if (!(Regs[1] & (1U << 5))) return Level;           // AVX2
+    Level = cmsCPU_AVX2;
+
+    if (!(Regs[1] & (1U << 16)) || (XCR0 & 0xE6) != 0xE6) return Level;     // AVX-512F, ZMM state
+    return cmsCPU_AVX512;
+}
+
+#else
+
+static
+cmsInt32Number DetectLevel(void)
+{
+    return cmsCPU_GENERIC;
+}
+
+#endif
+
+// Level supported by the running CPU
+cmsInt32Number CMSEXPORT cmsDetectCPUFeatureLevel(void)
+{
+    if (DetectedCPULevel < 0)
+        DetectedCPULevel = DetectLevel();
+
+    return DetectedCPULevel;
+}
+
+// Level to use when selecting kernels
+cmsInt32Number _cmsCPUFeatureLevel(void)
+{
+    cmsInt32Number Level = cmsDetectCPUFeatureLevel();
+
+    if (CPULevelCap < 0) {
+
+        const char* Env = getenv("LCMS2_CPU_LEVEL");
+
+        CPULevelCap = (Env != NULL && *Env) ? atoi(Env) : cmsCPU_AVX512;
+        if (CPULevelCap < 0) CPULevelCap = cmsCPU_GENERIC;
+    }
+
+    return CPULevelCap < Level ? CPULevelCap : Level;
+}
+
+// Caps the level. Negative values just return the current setting
+cmsInt32Number CMSEXPORT cmsSetCPUFeatureLevel(cmsInt32Number Level)
+{
+    cmsInt32Number OldVal = _cmsCPUFeatureLevel();
+
+    if (Level >= 0)
+        CPULevelCap = Level;
+
+    return OldVal;
+}
+
+
+// ----------------------------------------------------------------------------------
+// Threads
+// ----------------------------------------------------------------------------------
+
+#if !defined(CMS_NO_PTHREADS) && defined(CMS_IS_WINDOWS_)
+#   include <windows.h>
+#   define CMS_WIN_THREADS     1
+#elif !defined(CMS_NO_PTHREADS)
+#   include <pthread.h>
+#   include <unistd.h>
+#   define CMS_POSIX_THREADS   1
+#endif
+
+// Atomics for compilers that have no intrinsics. Without threads there is nobody to race against.
+#if defined(CMS_ATOMICS_BY_FUNCTION)
+
+#if defined(CMS_WIN_THREADS)
+
+long _cmsAtomicIncrement(volatile long* p)         { return InterlockedIncrement((LONG*) p); }
+long _cmsAtomicDecrement(volatile long* p)         { return InterlockedDecrement((LONG*) p); }
+long _cmsAtomicExchange(volatile long* p, long v)  { return InterlockedExchange((LONG*) p, v); }
+void _cmsAtomicRelease(volatile long* p)           { InterlockedExchange((LONG*) p, 0); }
+long _cmsAtomicLoad(volatile long* p)              { return InterlockedCompareExchange((LONG*) p, 0, 0); }
+
+#elif defined(CMS_POSIX_THREADS)
+
+static pthread_mutex_t AtomicMutex = PTHREAD_MUTEX_INITIALIZER;
+
+long _cmsAtomicIncrement(volatile long* p)
+{
+    long n;
+
+    pthread_mutex_lock(&AtomicMutex);
+    n = ++*p;
+    pthread_mutex_unlock(&AtomicMutex);
+    return n;
+}
+
+long _cmsAtomicDecrement(volatile long* p)
+{
+    long n;
+
+    pthread_mutex_lock(&AtomicMutex);
+    n = --*p;
+    pthread_mutex_unlock(&AtomicMutex);
+    return n;
+}
+
+long _cmsAtomicExchange(volatile long* p, long v)
+{
+    long Old;
+
+    pthread_mutex_lock(&AtomicMutex);
+    Old = *p;
+    *p = v;
+    pthread_mutex_unlock(&AtomicMutex);
+    return Old;
+}
+
+void _cmsAtomicRelease(volatile long* p)
+{
+    _cmsAtomicExchange(p, 0);
+}
+
+long _cmsAtomicLoad(volatile long* p)
+{
+    long n;
+
+    pthread_mutex_lock(&AtomicMutex);
+    n = *p;
+    pthread_mutex_unlock(&AtomicMutex);
+    return n;
+}
+
+#else
+
+long _cmsAtomicIncrement(volatile long* p)         { return ++*p; }
+long _cmsAtomicDecrement(volatile long* p)         { return --*p; }
+long _cmsAtomicExchange(volatile long* p, long v)  { long Old = *p; *p = v; return Old; }
+void _cmsAtomicRelease(volatile long* p)           { *p = 0; }
+long _cmsAtomicLoad(volatile long* p)              { return *p; }
+
+#endif
+#endif
+
+// What each thread gets
+typedef struct {
+
+    _cmsThreadFn Fn;
+    void*        Cargo;
+
+} ThreadStart;
+
+#if defined(CMS_WIN_THREADS)
+
+static
+DWORD WINAPI ThreadEntry(LPVOID p)
+{
+    ThreadStart* ts = (ThreadStart*) p;
+
+    ts ->Fn(ts ->Cargo);
+    return 0;
+}
+
+#elif defined(CMS_POSIX_THREADS)
+
+static
+void* ThreadEntry(void* p)
+{
+    ThreadStart* ts = (ThreadStart*) p;
+
+    ts ->Fn(ts ->Cargo);
+    return NULL;
+}
+
+#endif
+
+// Number of processors available, at least one
+cmsUInt32Number CMSEXPORT _cmsGetProcessorCount(void)
+{
+#if defined(CMS_WIN_THREADS)
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors > 0 ? (cmsUInt32Number) si.dwNumberOfProcessors : 1;
+
+#elif defined(CMS_POSIX_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (cmsUInt32Number) n : 1;
+#else
+    return 1;
+#endif
+}
+
+// Current UTC time. gmtime returns a static buffer, so use the re-entrant flavours when threads are around
+cmsBool _cmsGetTime(struct tm* ptr_time)
+{
+    time_t now = time(NULL);
+
+#if defined(CMS_WIN_THREADS)
+    return gmtime_s(ptr_time, &now) == 0;
+#elif defined(CMS_POSIX_THREADS)
+    return gmtime_r(&now, ptr_time) != NULL;
+#else
+    struct tm* t = gmtime(&now);
+
+    if (t == NULL) return FALSE;
+    *ptr_time = *t;
+    return TRUE;
+#endif
+}
+
+// Runs Fn once for each of the nThreads cargo blocks, which are CargoSize bytes apart, and waits for all of them.
+// The first block runs on the calling thread. If threads are not available or cannot be created, the remaining
+// blocks just run serially, so results never depend on how many threads were actually used.
+void CMSEXPORT _cmsRunThreads(cmsContext ContextID, cmsUInt32Number nThreads, _cmsThreadFn Fn, void* Cargos, cmsUInt32Number CargoSize)
+{
+    cmsUInt8Number* Base = (cmsUInt8Number*) Cargos;
+    cmsUInt32Number i;
+
+#if defined(CMS_WIN_THREADS) || defined(CMS_POSIX_THREADS)
+
+    ThreadStart* Starts = NULL;
+#if defined(CMS_WIN_THREADS)
+    HANDLE* Handles = NULL;
+#else
+    pthread_t* Handles = NULL;
+#endif
+    cmsBool* Started = NULL;
+
+    if (nThreads > 1) {
+
+        Starts  = (ThreadStart*) _cmsCalloc(ContextID, nThreads, sizeof(ThreadStart));
+        Handles = _cmsCalloc(ContextID, nThreads, sizeof(*Handles));
+        Started = (cmsBool*) _cmsCalloc(ContextID, nThreads, sizeof(cmsBool));
+    }
+
+    if (Starts != NULL && Handles != NULL && Started != NULL) {
+
+        for (i=1; i < nThreads; i++) {
+
+            Starts[i].Fn    = Fn;
+            Starts[i].Cargo = Base + i * CargoSize;
+
+#if defined(CMS_WIN_THREADS)
+            Handles[i] = CreateThread(NULL, 0, ThreadEntry, &Starts[i], 0, NULL);
+            Started[i] = (Handles[i] != NULL);
+#else
+            Started[i] = (pthread_create(&Handles[i], NULL, ThreadEntry, &Starts[i]) == 0);
+#endif
+        }
+
+        Fn(Base);
+
+        for (i=1; i < nThreads; i++) {
+
+            if (Started[i]) {
+#if defined(CMS_WIN_THREADS)
+                WaitForSingleObject(Handles[i], INFINITE);
+                CloseHandle(Handles[i]);
+#else
+                pthread_join(Handles[i], NULL);
+#endif
+            }
+            else
+                Fn(Base + i * CargoSize);
+        }
+    }
+    else {
+
+        for (i=0; i < nThreads; i++)
+            Fn(Base + i * CargoSize);
+    }
+
+    if (Starts)  _cmsFree(ContextID, Starts);
+    if (Handles) _cmsFree(ContextID, Handles);
+    if (Started) _cmsFree(ContextID, Started);
+
+#else
+
+    for (i=0; i < nThreads; i++)
+        Fn(Base + i * CargoSize);
+
+    cmsUNUSED_PARAMETER(ContextID);
+#endif
+}
@@ -281,6 +281,11 @@ typedef struct {
 
     cmsColorSpaceSignature  ColorSpace;  // ColorSpace of profile
 
+    cmsBool          MinorStrings;  // Strings hold rows of the second component instead of the first one
+    cmsUInt32Number  dwFlags;       // Encoding of strings
+    cmsUInt8Number*  Pending;       // Bytes of the string being written
+    cmsUInt32Number  nPending;
+    char*            Text;          // Encoded string
 
 } cmsPsSamplerCargo;
 
@@ -308,19 +313,108 @@ cmsUInt8Number L2Byte(cmsUInt16Number w)
 }
 */
 
-// Write a cooked byte
+// CLUT strings. Each one is encoded at once into Text, which should have room for 3 * n + 16 chars, and then written
+// in a single call. Hex and ASCII85 strings break lines past MAXPSCOLS. ASCII85 needs PostScript level 2, and binary
+// tokens need a channel that is 8-bit clean as well; strings too long for a binary token go as ASCII85.
 
 static
-void WriteByte(cmsIOHANDLER* m, cmsUInt8Number b)
+cmsUInt32Number EncodeHex(char* Text, const cmsUInt8Number* Data, cmsUInt32Number n)
 {
-    _cmsIOPrintf(m, "%02x", b); 
-    _cmsPSActualColumn += 2;
+    static const char Digits[] = "0123456789abcdef";
+    cmsUInt32Number i, Len = 0;
 
-    if (_cmsPSActualColumn > MAXPSCOLS) {
+    Text[Len++] = '<';
 
-        _cmsIOPrintf(m, "\n");
-        _cmsPSActualColumn = 0;
-    }   
+    for (i=0; i < n; i++) {
+
+        Text[Len++] = Digits[Data[i] >> 4];
+        Text[Len++] = Digits[Data[i] & 0xF];
+        _cmsPSActualColumn += 2;
+
+        if (_cmsPSActualColumn > MAXPSCOLS) {
+            Text[Len++] = '\n';
+            _cmsPSActualColumn = 0;
+        }
+    }
+
+    Text[Len++] = '>';
+    return Len;
+}
+
+static
+cmsUInt32Number EncodeASCII85(char* Text, const cmsUInt8Number* Data, cmsUInt32Number n)
+{
+    cmsUInt32Number i, j, Len = 0, Rest, Group;
+    char Digits[5];
+
+    Text[Len++] = '<';
+    Text[Len++] = '~';
+
+    for (i=0; i < n; i += 4) {
+
+        Rest  = n - i < 4 ? n - i : 4;
+        Group = 0;
+        for (j=0; j < 4; j++)
+            Group = (Group << 8) | (j < Rest ? Data[i + j] : 0);
+
+        // Whole groups of zeros have a shortcut
+        if (Group == 0 && Rest == 4) {
+            Text[Len++] = 'z';
+            _cmsPSActualColumn++;
+        }
+        else {
+
+            for (j=5; j > 0; j--) {
+                Digits[j-1] = (char) ('!' + Group % 85);
+                Group /= 85;
+            }
+
+            for (j=0; j <= Rest; j++)
+                Text[Len++] = Digits[j];
+
+            _cmsPSActualColumn += Rest + 1;
+        }
+
+        if (_cmsPSActualColumn > MAXPSCOLS) {
+            Text[Len++] = '\n';
+            _cmsPSActualColumn = 0;
+        }
+    }
+
+    Text[Len++] = '~';
+    Text[Len++] = '>';
+    return Len;
+}
+
+static
+cmsUInt32Number EncodeBinaryToken(char* Text, const cmsUInt8Number* Data, cmsUInt32Number n)
+{
+    // String token, 16 bits length, high-order byte first
+    Text[0] = (char) 143;
+    Text[1] = (char) (n >> 8);
+    Text[2] = (char) (n & 0xFF);
+
+    memmove(Text + 3, Data, n);
+    return n + 3;
+}
+
+static
+void EndString(cmsPsSamplerCargo* sc)
+{
+    cmsUInt32Number Len;
+
+    if (sc ->nPending == 0) return;
+
+    if ((sc ->dwFlags & cmsFLAGS_PS_BINARY) && sc ->nPending <= 0xFFFF)
+        Len = EncodeBinaryToken(sc ->Text, sc ->Pending, sc ->nPending);
+    else
+    if (sc ->dwFlags & (cmsFLAGS_PS_ASCII85|cmsFLAGS_PS_BINARY))
+        Len = EncodeASCII85(sc ->Text, sc ->Pending, sc ->nPending);
+    else
+        Len = EncodeHex(sc ->Text, sc ->Pending, sc ->nPending);
+
+    sc ->m ->Write(sc ->m, Len, sc ->Text);
+    sc ->nPending = 0;
 }
 
 // ----------------------------------------------------------------- PostScript generation
@@ -617,6 +711,7 @@ int OutputValueSampler(register const cmsUInt16Number In[], register cmsUInt16Nu
             
             if (sc ->FirstComponent != -1) {
 
+                    EndString(sc);
                     _cmsIOPrintf(sc ->m, sc ->PostMin);
                     sc ->SecondComponent = -1;
                     _cmsIOPrintf(sc ->m, sc ->PostMaj);           
@@ -634,6 +729,7 @@ int OutputValueSampler(register const cmsUInt16Number In[], register cmsUInt16Nu
             
             if (sc ->SecondComponent != -1) {
 
+                    if (sc ->MinorStrings) EndString(sc);
                     _cmsIOPrintf(sc ->m, sc ->PostMin);           
             }
                     
@@ -652,23 +748,26 @@ int OutputValueSampler(register const cmsUInt16Number In[], register cmsUInt16Nu
           // We always deal with Lab4
           
           wByteOut = Word2Byte(wWordOut);
-          WriteByte(sc -> m, wByteOut);
+          sc ->Pending[sc ->nPending++] = wByteOut;
       }
 
       return 1;
 }
 
-// Writes a Pipeline on memstream. Could be 8 or 16 bits based
+// Writes a Pipeline on memstream. Could be 8 or 16 bits based. Strings are delimited by the encoder, so the Pre and
+// Post texts should not open or close them. Tables of 4 inputs have a string per row of the second component, and the
+// others per row of the first one.
 
 static
-void WriteCLUT(cmsIOHANDLER* m, cmsStage* mpe, const char* PreMaj, 
+int WriteCLUT(cmsIOHANDLER* m, cmsStage* mpe, const char* PreMaj, 
                                              const char* PostMaj,
                                              const char* PreMin,
                                              const char* PostMin,                                             
                                              int FixWhite,
-                                             cmsColorSpaceSignature ColorSpace)
+                                             cmsColorSpaceSignature ColorSpace,
+                                             cmsUInt32Number dwFlags)
 {
-    cmsUInt32Number i;
+    cmsUInt32Number i, MaxString;
     cmsPsSamplerCargo sc;
 
     sc.FirstComponent = -1;
@@ -683,6 +782,23 @@ void WriteCLUT(cmsIOHANDLER* m, cmsStage* mpe, const char* PreMaj,
     sc.FixWhite = FixWhite;
     sc.ColorSpace = ColorSpace;
 
+    sc.MinorStrings = sc.Pipeline->Params->nInputs > 3;
+    sc.dwFlags  = dwFlags;
+    sc.nPending = 0;
+
+    MaxString = sc.Pipeline->Params->nOutputs;
+    for (i=1; i < sc.Pipeline->Params->nInputs; i++)
+        MaxString *= sc.Pipeline->Params->nSamples[i];
+
+    sc.Pending = (cmsUInt8Number*) _cmsMalloc(m ->ContextID, MaxString);
+    sc.Text    = (char*) _cmsMalloc(m ->ContextID, 3 * MaxString + 16);
+
+    if (sc.Pending == NULL || sc.Text == NULL) {
+        if (sc.Pending) _cmsFree(m ->ContextID, sc.Pending);
+        if (sc.Text)    _cmsFree(m ->ContextID, sc.Text);
+        return 0;
+    }
+
     _cmsIOPrintf(m, "[");
 
     for (i=0; i < sc.Pipeline->Params->nInputs; i++)
@@ -692,10 +808,14 @@ void WriteCLUT(cmsIOHANDLER* m, cmsStage* mpe, const char* PreMaj,
 
     cmsStageSampleCLut16bit(mpe, OutputValueSampler, (void*) &sc, SAMPLER_INSPECT);
     
+    EndString(&sc);
     _cmsIOPrintf(m, PostMin);
     _cmsIOPrintf(m, PostMaj);
     _cmsIOPrintf(m, "] ");
 
+    _cmsFree(m ->ContextID, sc.Pending);
+    _cmsFree(m ->ContextID, sc.Text);
+    return 1;
 }
 
 
@@ -768,7 +888,7 @@ int EmitCIEBasedABC(cmsIOHANDLER* m, cmsFloat64Number* Matrix, cmsToneCurve** Cu
 
 
 static
-int EmitCIEBasedDEF(cmsIOHANDLER* m, cmsPipeline* Pipeline, int Intent, cmsCIEXYZ* BlackPoint)
+int EmitCIEBasedDEF(cmsIOHANDLER* m, cmsPipeline* Pipeline, int Intent, cmsCIEXYZ* BlackPoint, cmsUInt32Number dwFlags)
 {
     const char* PreMaj;
     const char* PostMaj;
@@ -782,16 +902,16 @@ int EmitCIEBasedDEF(cmsIOHANDLER* m, cmsPipeline* Pipeline, int Intent, cmsCIEXY
     case 3:
 
             _cmsIOPrintf(m, "[ /CIEBasedDEF\n");
-            PreMaj ="<"; 
-            PostMaj= ">\n";
+            PreMaj = ""; 
+            PostMaj= "\n";
             PreMin = PostMin = "";
             break;
     case 4:
             _cmsIOPrintf(m, "[ /CIEBasedDEFG\n");
             PreMaj = "[";
             PostMaj = "]\n";
-            PreMin = "<";
-            PostMin = ">\n";
+            PreMin = "";
+            PostMin = "\n";
             break;
     default:
             return 0;
@@ -814,7 +934,7 @@ int EmitCIEBasedDEF(cmsIOHANDLER* m, cmsPipeline* Pipeline, int Intent, cmsCIEXY
     if (cmsStageType(mpe) == cmsSigCLutElemType) {
 
             _cmsIOPrintf(m, "/Table ");    
-            WriteCLUT(m, mpe, PreMaj, PostMaj, PreMin, PostMin, FALSE, (cmsColorSpaceSignature) 0);
+            if (!WriteCLUT(m, mpe, PreMaj, PostMaj, PreMin, PostMin, FALSE, (cmsColorSpaceSignature) 0, dwFlags)) return 0;
             _cmsIOPrintf(m, "]\n");
     }
        
@@ -919,7 +1039,7 @@ int WriteInputLUT(cmsIOHANDLER* m, cmsHPROFILE hProfile, int Intent, cmsUInt32Nu
             dwFlags |= cmsFLAGS_FORCE_CLUT;
             _cmsOptimizePipeline(&DeviceLink, Intent, &InputFormat, &OutFrm, &dwFlags);
             
-            rc = EmitCIEBasedDEF(m, DeviceLink, Intent, &BlackPointAdaptedToD50);
+            rc = EmitCIEBasedDEF(m, DeviceLink, Intent, &BlackPointAdaptedToD50, dwFlags);
             cmsPipelineFree(DeviceLink);            
             }
             break;
@@ -1359,7 +1479,11 @@ int WriteOutputLUT(cmsIOHANDLER* m, cmsHPROFILE hProfile, int Intent, cmsUInt32N
     _cmsIOPrintf(m, "/RenderTable ");
     
     
-    WriteCLUT(m, cmsPipelineGetPtrToFirstStage(DeviceLink), "<", ">\n", "", "", lFixWhite, ColorSpace);
+    if (!WriteCLUT(m, cmsPipelineGetPtrToFirstStage(DeviceLink), "", "\n", "", "", lFixWhite, ColorSpace, dwFlags)) {
+        cmsPipelineFree(DeviceLink);
+        cmsDeleteTransform(xform);
+        return 0;
+    }
     
     _cmsIOPrintf(m, " %d {} bind ", nChannels);
 
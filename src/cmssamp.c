@@ -187,7 +187,8 @@ cmsBool BlackPointUsingPerceptualBlack(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfi
 // just that. There is a special flag for using black point tag, but turned 
 // off by default because it is bogus on most profiles. The detection algorithm 
 // involves to turn BP to neutral and to use only L component.  
-cmsBool CMSEXPORT cmsDetectBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
+static
+cmsBool DetectBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
 {    
 
     // Zero for black point
@@ -262,6 +263,17 @@ cmsBool CMSEXPORT cmsDetectBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfil
     return BlackPointAsDarkerColorant(hProfile, Intent, BlackPoint, dwFlags);
 }
 
+// Detection does not depend on dwFlags, so frozen profiles keep one black point per intent
+cmsBool CMSEXPORT cmsDetectBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
+{
+    if (_cmsReadMemoBlackPoint(hProfile, LCMS_USED_AS_INPUT, Intent, BlackPoint)) return TRUE;
+
+    if (!DetectBlackPoint(BlackPoint, hProfile, Intent, dwFlags)) return FALSE;
+
+    _cmsWriteMemoBlackPoint(hProfile, LCMS_USED_AS_INPUT, Intent, BlackPoint);
+    return TRUE;
+}
+
 
 
 // ---------------------------------------------------------------------------------------------------------
@@ -335,7 +347,8 @@ cmsBool IsMonotonic(int n, const cmsFloat64Number Table[])
 
 // Calculates the black point of a destination profile. 
 // This algorithm comes from the Adobe paper disclosing its black point compensation method. 
-cmsBool CMSEXPORT cmsDetectDestinationBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
+static
+cmsBool DetectDestinationBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
 {  
     cmsColorSpaceSignature ColorSpace;
     cmsHTRANSFORM hRoundTrip = NULL;
@@ -566,3 +579,14 @@ cmsBool CMSEXPORT cmsDetectDestinationBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROF
     cmsDeleteTransform(hRoundTrip);
     return TRUE;
 }
+
+// The Adobe algorithm builds several transforms, so this is the one most worth keeping on frozen profiles
+cmsBool CMSEXPORT cmsDetectDestinationBlackPoint(cmsCIEXYZ* BlackPoint, cmsHPROFILE hProfile, cmsUInt32Number Intent, cmsUInt32Number dwFlags)
+{
+    if (_cmsReadMemoBlackPoint(hProfile, LCMS_USED_AS_OUTPUT, Intent, BlackPoint)) return TRUE;
+
+    if (!DetectDestinationBlackPoint(BlackPoint, hProfile, Intent, dwFlags)) return FALSE;
+
+    _cmsWriteMemoBlackPoint(hProfile, LCMS_USED_AS_OUTPUT, Intent, BlackPoint);
+    return TRUE;
+}
@@ -101,15 +101,105 @@ cmsBool RegisterTypesPlugin(cmsPluginBase* Data, _cmsTagTypeLinkedList* LinkedLi
     return TRUE;
 }
 
+// Stock tags and types are found by perfect hashing. Signatures are spread by a multiplier that is
+// searched, once, to be collision free on the built-in table, so a lookup takes a single probe.
+// Entries added by plug-ins are chained after the built-in ones and are still searched linearly.
+
+#define STOCK_HASH_BITS     9
+#define STOCK_HASH_SIZE     (1 << STOCK_HASH_BITS)
+#define STOCK_MAX_ENTRIES   255
+
+typedef struct {
+
+    volatile long   Ready;
+    cmsUInt32Number Multiplier;                 // Zero if none was found, then lists are walked as usual
+    cmsUInt8Number  Slots[STOCK_HASH_SIZE];     // Position on the built-in table + 1, 0 = empty
+
+} _cmsStockIndex;
+
+static _cmsStockIndex TagTypesIndex, MPETypesIndex, TagsIndex;
+
+// Indexes are built on first use, maybe from several threads at once
+static volatile long StockIndexLock = 0;
+
+cmsINLINE cmsUInt32Number StockSlot(cmsUInt32Number Multiplier, cmsUInt32Number sig)
+{
+    return (sig * Multiplier) >> (32 - STOCK_HASH_BITS);
+}
+
+static
+void BuildStockIndex(_cmsStockIndex* Index, const cmsUInt32Number Sigs[], cmsUInt32Number Count)
+{
+    cmsUInt32Number Multiplier, Trials, i, h;
+
+    while (_cmsAtomicExchange(&StockIndexLock, 1)) { }
+
+    if (!Index ->Ready) {
+
+        Index ->Multiplier = 0;
+
+        for (Multiplier = 0x9E3779B1U, Trials = 0; Count <= STOCK_MAX_ENTRIES && Trials < 0x10000; Multiplier += 2, Trials++) {
+
+            memset(Index ->Slots, 0, sizeof(Index ->Slots));
+
+            for (i=0; i < Count; i++) {
+
+                h = StockSlot(Multiplier, Sigs[i]);
+
+                if (Index ->Slots[h] != 0 && Sigs[Index ->Slots[h] - 1] != Sigs[i]) break;
+                if (Index ->Slots[h] == 0) Index ->Slots[h] = (cmsUInt8Number) (i + 1);
+            }
+
+            if (i == Count) {
+                Index ->Multiplier = Multiplier;
+                break;
+            }
+        }
+
+        // Full barrier, the index should be complete before it is seen as ready
+        _cmsAtomicIncrement(&Index ->Ready);
+    }
+
+    _cmsAtomicRelease(&StockIndexLock);
+}
+
+// Returns the position on the built-in table, or -1 if not there. Caller should check the signature
+cmsINLINE int StockLookup(const _cmsStockIndex* Index, cmsUInt32Number sig)
+{
+    return (int) Index ->Slots[StockSlot(Index ->Multiplier, sig)] - 1;
+}
+
 // Return handler for a given type or NULL if not found. Shared between normal types and MPE
 static
-cmsTagTypeHandler* GetHandler(cmsTagTypeSignature sig, _cmsTagTypeLinkedList* LinkedList)
+cmsTagTypeHandler* GetHandler(cmsTagTypeSignature sig, _cmsTagTypeLinkedList* LinkedList, cmsUInt32Number DefaultListCount, _cmsStockIndex* Index)
 {
     _cmsTagTypeLinkedList* pt;
+    int n;
+
+    // Slots are only valid once Ready is seen, hence the acquire
+    if (!_cmsAtomicLoad(&Index ->Ready)) {
+
+        cmsUInt32Number Sigs[STOCK_MAX_ENTRIES];
+        cmsUInt32Number i;
+
+        for (i=0; i < DefaultListCount && i < STOCK_MAX_ENTRIES; i++)
+            Sigs[i] = (cmsUInt32Number) LinkedList[i].Handler.Signature;
+
+        BuildStockIndex(Index, Sigs, DefaultListCount);
+    }
+
+    if (Index ->Multiplier == 0) 
+        pt = LinkedList;
+    else {
+
+        n = StockLookup(Index, (cmsUInt32Number) sig);
+        if (n >= 0 && sig == LinkedList[n].Handler.Signature) return &LinkedList[n].Handler;
 
-    for (pt = LinkedList; 
-         pt != NULL;
-         pt = pt ->Next) {
+        // Not a built-in one, try the plug-ins
+        pt = LinkedList[DefaultListCount-1].Next;
+    }
+
+    for (; pt != NULL; pt = pt ->Next) {
 
             if (sig == pt -> Handler.Signature) return &pt ->Handler;
     }
@@ -2073,6 +2163,8 @@ void *Type_LUT16_Read(struct _cms_typehandler_struct* self, cmsIOHANDLER* io, cm
     if (!_cmsReadUInt16Number(io, &OutputEntries)) goto Error; 
 
     if (InputEntries > 0x7FFF || OutputEntries > 0x7FFF) goto Error;
+    if (!_cmsCheckCurveLimits(self ->ContextID, InputEntries) || 
+        !_cmsCheckCurveLimits(self ->ContextID, OutputEntries)) goto Error;
     if (CLUTpoints == 1) goto Error; // Impossible value, 0 for no CLUT and then 2 at least
 
     // Get input tables
@@ -3955,6 +4047,7 @@ cmsToneCurve* ReadSegmentedCurve(struct _cms_typehandler_struct* self, cmsIOHAND
                 cmsUInt32Number Count;
 
                 if (!_cmsReadUInt32Number(io, &Count)) return NULL;
+                if (!_cmsCheckCurveLimits(self ->ContextID, Count)) goto Error;
 
                 Segments[i].nGridPoints = Count;
                 Segments[i].SampledPoints = (cmsFloat32Number*) _cmsCalloc(self ->ContextID, Count, sizeof(cmsFloat32Number));
@@ -4362,7 +4455,7 @@ cmsBool ReadMPEElem(struct _cms_typehandler_struct* self,
     if (!_cmsReadUInt32Number(io, NULL)) return FALSE;
 
     // Read diverse MPE types
-    TypeHandler = GetHandler((cmsTagTypeSignature) ElementSig, SupportedMPEtypes);
+    TypeHandler = GetHandler((cmsTagTypeSignature) ElementSig, SupportedMPEtypes, DEFAULT_MPE_TYPE_COUNT, &MPETypesIndex);
     if (TypeHandler == NULL)  {
 
         char String[5];
@@ -4413,7 +4506,11 @@ void *Type_MPE_Read(struct _cms_typehandler_struct* self, cmsIOHANDLER* io, cmsU
     NewLUT = cmsPipelineAlloc(self ->ContextID, InputChans, OutputChans);
     if (NewLUT == NULL) return NULL;
 
-    if (!_cmsReadUInt32Number(io, &ElementCount)) return NULL;
+    if (!_cmsReadUInt32Number(io, &ElementCount) || 
+        !_cmsCheckPipelineDepthLimit(self ->ContextID, ElementCount)) {
+        cmsPipelineFree(NewLUT);
+        return NULL;
+    }
 
     if (!ReadPositionTable(self, io, ElementCount, BaseOffset, NewLUT, ReadMPEElem)) {
         if (NewLUT != NULL) cmsPipelineFree(NewLUT);
@@ -4475,7 +4572,7 @@ cmsBool Type_MPE_Write(struct _cms_typehandler_struct* self, cmsIOHANDLER* io, v
 
         ElementSig = Elem ->Type;
 
-        TypeHandler = GetHandler((cmsTagTypeSignature) ElementSig, SupportedMPEtypes);
+        TypeHandler = GetHandler((cmsTagTypeSignature) ElementSig, SupportedMPEtypes, DEFAULT_MPE_TYPE_COUNT, &MPETypesIndex);
         if (TypeHandler == NULL)  {
 
                 char String[5];
@@ -5261,7 +5358,7 @@ cmsBool  _cmsRegisterMultiProcessElementPlugin(cmsPluginBase* Data)
 // Wrapper for tag types
 cmsTagTypeHandler* _cmsGetTagTypeHandler(cmsTagTypeSignature sig)
 {
-    return GetHandler(sig, SupportedTagTypes);
+    return GetHandler(sig, SupportedTagTypes, DEFAULT_TAG_TYPE_COUNT, &TagTypesIndex);
 }
     
 // ********************************************************************************
@@ -5416,10 +5513,31 @@ cmsBool  _cmsRegisterTagPlugin(cmsPluginBase* Data)
 cmsTagDescriptor* _cmsGetTagDescriptor(cmsTagSignature sig)
 {
     _cmsTagLinkedList* pt;
+    int n;
+
+    if (!_cmsAtomicLoad(&TagsIndex.Ready)) {
+
+        cmsUInt32Number Sigs[DEFAULT_TAG_COUNT];
+        cmsUInt32Number i;
+
+        for (i=0; i < DEFAULT_TAG_COUNT; i++)
+            Sigs[i] = (cmsUInt32Number) SupportedTags[i].Signature;
+
+        BuildStockIndex(&TagsIndex, Sigs, DEFAULT_TAG_COUNT);
+    }
+
+    if (TagsIndex.Multiplier == 0)
+        pt = SupportedTags;
+    else {
+
+        n = StockLookup(&TagsIndex, (cmsUInt32Number) sig);
+        if (n >= 0 && sig == SupportedTags[n].Signature) return &SupportedTags[n].Descriptor;
+
+        // Not a built-in one, try the plug-ins
+        pt = SupportedTags[DEFAULT_TAG_COUNT-1].Next;
+    }
 
-    for (pt = SupportedTags; 
-            pt != NULL;
-            pt = pt ->Next) {
+    for (; pt != NULL; pt = pt ->Next) {
 
                 if (sig == pt -> Signature) return &pt ->Descriptor;
     }
@@ -1016,7 +1016,57 @@ const cmsAllowedLUT* FindCombination(const cmsPipeline* Lut, cmsBool IsV4, cmsTa
 
     return NULL;
 }
-    
+
+
+// The transform pipeline may already be in its optimized form, that is, a 16 bits CLUT optionally
+// surrounded by prelinearization curves. In such case, there is no need to resample it again: just
+// fill the missing curves with identities, so it fits in a lut16 or a lutAtoB/lutBtoA tag.
+static
+cmsBool FitOptimizedCLUT(cmsContext ContextID, cmsPipeline* Lut, cmsUInt32Number ChansIn, cmsUInt32Number ChansOut)
+{
+    cmsStage* mpe;
+    cmsStage* CLUT = NULL;
+    _cmsStageCLutData* Data;
+    cmsUInt32Number i, nPre = 0, nPost = 0;
+
+    for (mpe = cmsPipelineGetPtrToFirstStage(Lut); mpe != NULL; mpe = cmsStageNext(mpe)) {
+
+        switch (cmsStageType(mpe)) {
+
+        case cmsSigCLutElemType:
+            if (CLUT != NULL) return FALSE;
+            CLUT = mpe;
+            break;
+
+        case cmsSigCurveSetElemType:
+            if (CLUT == NULL) nPre++; else nPost++;
+            if (nPre > 1 || nPost > 1) return FALSE;
+            break;
+
+        default:
+            return FALSE;
+        }
+    }
+
+    if (CLUT == NULL) return FALSE;
+
+    // Only 16 bits tables with same number of nodes on all dimensions can be saved as-is
+    Data = (_cmsStageCLutData*) CLUT ->Data;
+    if (Data ->HasFloatValues || Data ->Params == NULL) return FALSE;
+
+    for (i=1; i < Data ->Params ->nInputs; i++) {
+        if (Data ->Params ->nSamples[i] != Data ->Params ->nSamples[0]) return FALSE;
+    }
+
+    if (nPre == 0)
+        cmsPipelineInsertStage(Lut, cmsAT_BEGIN, _cmsStageAllocIdentityCurves(ContextID, ChansIn));
+
+    if (nPost == 0)
+        cmsPipelineInsertStage(Lut, cmsAT_END,   _cmsStageAllocIdentityCurves(ContextID, ChansOut));
+
+    return TRUE;
+}
+
 
 // Does convert a transform into a device link profile
 cmsHPROFILE CMSEXPORT cmsTransform2DeviceLink(cmsHTRANSFORM hTransform, cmsFloat64Number Version, cmsUInt32Number dwFlags)
@@ -1091,6 +1141,11 @@ cmsHPROFILE CMSEXPORT cmsTransform2DeviceLink(cmsHTRANSFORM hTransform, cmsFloat
     else
         AllowedLUT = FindCombination(LUT, Version >= 4.0, DestinationTag);
 
+    // The transform has been already optimized at creation time, so reuse its CLUT if possible.
+    // An explicit grid size asks for resampling, however.
+    if (AllowedLUT == NULL && !(dwFlags & cmsFLAGS_GRIDPOINTS(0xFF)) && FitOptimizedCLUT(ContextID, LUT, ChansIn, ChansOut))
+        AllowedLUT = FindCombination(LUT, Version >= 4.0, DestinationTag);
+
     if (AllowedLUT == NULL) {
 
         // Try to optimize
@@ -37,9 +37,8 @@ const cmsCIEXYZ* CMSEXPORT cmsD50_XYZ(void)
 
 const cmsCIExyY* CMSEXPORT cmsD50_xyY(void)
 {
-    static cmsCIExyY D50xyY;
-
-    cmsXYZ2xyY(&D50xyY, cmsD50_XYZ());
+    // cmsXYZ2xyY of D50, worked out in advance. Filling it on each call would race when transforms are built concurrently
+    static cmsCIExyY D50xyY = { 0.345702914918791, 0.3585385966799326, cmsD50Y };
 
     return &D50xyY;
 }
@@ -267,16 +267,84 @@ void PrecalculatedXFORMGamutCheck(_cmsTRANSFORM* p,
 }
 
 
-// No gamut check, Cach, 16 bits, 
+// Run-length detection. Flat areas are long runs of byte-identical pixels, so on those the
+// packed input is compared against the last one and, if equal, the last packed output is
+// replicated without unrolling, evaluating or packing anything.
+
+// Biggest packed pixel: 15 channels plus 7 extra, 8 bytes each
+#define MAX_PACKED_PIXEL    (8 * 24)
+
+// Replicating bytes is only safe on chunky buffers in which the output formatter does write
+// every byte it advances over. Extra channels on output are skipped, so they don't qualify.
 static
-void CachedXFORM(_cmsTRANSFORM* p,
-                 const void* in,
-                 void* out, cmsUInt32Number Size, cmsUInt32Number Stride)
+cmsBool CanDetectRuns(_cmsTRANSFORM* p)
+{
+    if (T_PLANAR(p ->InputFormat) || T_PLANAR(p ->OutputFormat)) return FALSE;
+    if (T_EXTRA(p ->OutputFormat) != 0) return FALSE;
+
+    return TRUE;
+}
+
+// Bytes taken by a chunky pixel. Zero bytes per sample means doubles
+static
+cmsUInt32Number PackedPixelSize(cmsUInt32Number Format)
+{
+    cmsUInt32Number Bytes = T_BYTES(Format);
+
+    if (Bytes == 0) Bytes = sizeof(cmsFloat64Number);
+    return Bytes * (T_CHANNELS(Format) + T_EXTRA(Format));
+}
+
+// In-place transforms overwrite the input, so last pixel cannot be read back from the buffer. Addresses are
+// compared as integers, since pointers past the end of the buffers would be undefined
+static
+cmsBool BuffersMayOverlap(_cmsTRANSFORM* p, const void* in, void* out, cmsUInt32Number Size)
+{
+    size_t a = (size_t) in;
+    size_t b = (size_t) out;
+
+    if (Size > ((size_t) -1) / MAX_PACKED_PIXEL) return TRUE;
+
+    // Input spans [a, a + SpanIn) and output [b, b + SpanOut)
+    if (b >= a)
+        return b - a < (size_t) Size * PackedPixelSize(p ->InputFormat);
+    else
+        return a - b < (size_t) Size * PackedPixelSize(p ->OutputFormat);
+}
+
+// Pixels are a few bytes long and most of times differ in the first byte, so this is faster than memcmp
+cmsINLINE cmsBool IsSamePixel(const cmsUInt8Number* a, const cmsUInt8Number* b, cmsUInt32Number n)
+{
+    while (n--) {
+        if (*a++ != *b++) return FALSE;
+    }
+
+    return TRUE;
+}
+
+cmsINLINE void CopyPixel(cmsUInt8Number* Dest, const cmsUInt8Number* Src, cmsUInt32Number n)
+{
+    while (n--) 
+        *Dest++ = *Src++;
+}
+
+// Cach, 16 bits, run-length detection. The only difference between the plain and the gamut checking flavours
+// is how a pixel that misses both the run and the cache gets evaluated.
+static
+void CachedRunsXFORM(_cmsTRANSFORM* p,
+                     const void* in,
+                     void* out, cmsUInt32Number Size, cmsUInt32Number Stride, cmsBool GamutCheck)
 {
     cmsUInt8Number* accum;
     cmsUInt8Number* output;
+    cmsUInt8Number* PixelIn;
+    cmsUInt8Number* PixelOut;
+    const cmsUInt8Number* RunIn  = NULL;
+    const cmsUInt8Number* RunOut = NULL;
+    cmsUInt8Number  KeepIn[MAX_PACKED_PIXEL], KeepOut[MAX_PACKED_PIXEL];
     cmsUInt16Number wIn[cmsMAXCHANNELS], wOut[cmsMAXCHANNELS];
-    cmsUInt32Number i, n;
+    cmsUInt32Number i, n, nRunIn, nRunOut;
+    cmsBool DetectRuns, KeepCopy;
     _cmsCACHE Cache;
 
     accum  = (cmsUInt8Number*)  in;
@@ -290,8 +358,22 @@ void CachedXFORM(_cmsTRANSFORM* p,
     // Get copy of zero cache
     memcpy(&Cache, &p ->Cache, sizeof(Cache));
 
+    DetectRuns = CanDetectRuns(p);
+    KeepCopy   = DetectRuns && BuffersMayOverlap(p, in, out, Size);
+    nRunIn = nRunOut = 0;
+
     for (i=0; i < n; i++) {
 
+        // Same packed bytes as the last pixel? Then same packed output
+        if (nRunIn > 0 && IsSamePixel(accum, RunIn, nRunIn)) {
+
+            CopyPixel(output, RunOut, nRunOut);
+            accum  += nRunIn;
+            output += nRunOut;
+            continue;
+        }
+
+        PixelIn = accum;
         accum = p -> FromInput(p, wIn, accum, Stride);
 
         if (memcmp(wIn, Cache.CacheIn, sizeof(Cache.CacheIn)) == 0) {
@@ -300,17 +382,57 @@ void CachedXFORM(_cmsTRANSFORM* p,
         }
         else {   
 
-            p ->Lut ->Eval16Fn(wIn, wOut, p -> Lut->Data);  
+            if (GamutCheck)
+                TransformOnePixelWithGamutCheck(p, wIn, wOut);
+            else
+                p ->Lut ->Eval16Fn(wIn, wOut, p -> Lut->Data);  
 
             memcpy(Cache.CacheIn,  wIn,  sizeof(Cache.CacheIn));
             memcpy(Cache.CacheOut, wOut, sizeof(Cache.CacheOut));
         }
 
-        output = p -> ToOutput(p, wOut, output, Stride);            
+        PixelOut = output;
+
+        if (KeepCopy) {
+
+            // Input has to be kept before packing, as it is going to be overwritten
+            nRunIn = (cmsUInt32Number) (accum - PixelIn);
+            if (nRunIn > MAX_PACKED_PIXEL) nRunIn = 0;
+
+            CopyPixel(KeepIn, PixelIn, nRunIn);
+            output = p -> ToOutput(p, wOut, output, Stride);
+
+            nRunOut = (cmsUInt32Number) (output - PixelOut);
+            if (nRunOut > MAX_PACKED_PIXEL) nRunIn = nRunOut = 0;
+
+            CopyPixel(KeepOut, PixelOut, nRunOut);
+            RunIn  = KeepIn;
+            RunOut = KeepOut;
+        }
+        else {
+
+            output = p -> ToOutput(p, wOut, output, Stride);
+
+            if (DetectRuns) {
+                nRunIn  = (cmsUInt32Number) (accum - PixelIn);
+                nRunOut = (cmsUInt32Number) (output - PixelOut);
+                RunIn   = PixelIn;
+                RunOut  = PixelOut;
+            }
+        }
     }
  
 }
 
+// No gamut check, Cach, 16 bits, 
+static
+void CachedXFORM(_cmsTRANSFORM* p,
+                 const void* in,
+                 void* out, cmsUInt32Number Size, cmsUInt32Number Stride)
+{
+    CachedRunsXFORM(p, in, out, Size, Stride, FALSE);
+}
+
 
 // All those nice features together
 static
@@ -318,39 +440,561 @@ void CachedXFORMGamutCheck(_cmsTRANSFORM* p,
                            const void* in,
                            void* out, cmsUInt32Number Size, cmsUInt32Number Stride)
 {
-       cmsUInt8Number* accum;
-       cmsUInt8Number* output;
-       cmsUInt16Number wIn[cmsMAXCHANNELS], wOut[cmsMAXCHANNELS];
-       cmsUInt32Number i, n;
-       _cmsCACHE Cache;
+    CachedRunsXFORM(p, in, out, Size, Stride, TRUE);
+}
 
-       accum  = (cmsUInt8Number*)  in;
-       output = (cmsUInt8Number*)  out;
-       n = Size;                    // Buffer len
+// Sparse transforms -------------------------------------------------------------------------------------------
 
-       // Empty buffers for quick memcmp
-       memset(wIn,  0, sizeof(cmsUInt16Number) * cmsMAXCHANNELS);
-       memset(wOut, 0, sizeof(cmsUInt16Number) * cmsMAXCHANNELS);
+// Runs of selected pixels at least this long are transformed in place. Shorter ones, on chunky buffers, are gathered
+// in blocks of GATHER_BLOCK pixels, transformed at once and scattered back. That keeps the per call overhead low on
+// scattered selections, and the blocks small enough to stay in the L1 cache.
+#define MIN_DIRECT_RUN      16
+#define GATHER_BLOCK        256
 
-       // Get copy of zero cache
-       memcpy(&Cache, &p ->Cache, sizeof(Cache));
+typedef struct {
 
-       for (i=0; i < n; i++) {
+    _cmsTRANSFORM*        p;
+    const cmsUInt8Number* In;
+    cmsUInt8Number*       Out;
+    cmsUInt32Number       InStep;       // Bytes from one pixel to the next, on first plane if planar
+    cmsUInt32Number       OutStep;
+    cmsUInt32Number       InSize;       // Bytes of a packed pixel, chunky only
+    cmsUInt32Number       OutSize;
+    cmsUInt32Number       Stride;
+
+    cmsUInt8Number*       GatherIn;     // NULL if gathering is not possible
+    cmsUInt8Number*       GatherOut;
+    cmsUInt32Number       Pending[GATHER_BLOCK];
+    cmsUInt32Number       nPending;
+
+} _cmsSparse;
+
+// Bytes per sample, doubles are marked as zero
+static
+cmsUInt32Number SampleSize(cmsUInt32Number Format)
+{
+    cmsUInt32Number n = T_BYTES(Format);
+
+    return n == 0 ? sizeof(cmsFloat64Number) : n;
+}
 
-            accum = p -> FromInput(p, wIn, accum, Stride);
-     
-            if (memcmp(wIn, Cache.CacheIn, sizeof(Cache.CacheIn)) == 0) {
-                    memcpy(wOut, Cache.CacheOut, sizeof(Cache.CacheOut));
+// Bytes from one pixel to the next one. On planar buffers, that is within a plane
+static
+cmsUInt32Number PixelStep(cmsUInt32Number Format)
+{
+    if (T_PLANAR(Format)) return SampleSize(Format);
+    return (T_CHANNELS(Format) + T_EXTRA(Format)) * SampleSize(Format);
+}
+
+static
+cmsBool SparseBegin(_cmsSparse* sp, _cmsTRANSFORM* p, const void* In, void* Out, cmsUInt32Number Stride)
+{
+    cmsBool Planar = T_PLANAR(p ->InputFormat) || T_PLANAR(p ->OutputFormat);
+
+    if (p ->InputFormat == 0 || p ->OutputFormat == 0) {
+        cmsSignalError(p ->ContextID, cmsERROR_NOT_SUITABLE, "Sparse transforms need known formats");
+        return FALSE;
+    }
+
+    sp ->p        = p;
+    sp ->In       = (const cmsUInt8Number*) In;
+    sp ->Out      = (cmsUInt8Number*) Out;
+    sp ->InSize   = (T_CHANNELS(p ->InputFormat)  + T_EXTRA(p ->InputFormat))  * SampleSize(p ->InputFormat);
+    sp ->OutSize  = (T_CHANNELS(p ->OutputFormat) + T_EXTRA(p ->OutputFormat)) * SampleSize(p ->OutputFormat);
+    sp ->InStep   = PixelStep(p ->InputFormat);
+    sp ->OutStep  = PixelStep(p ->OutputFormat);
+    sp ->Stride   = Stride;
+    sp ->nPending = 0;
+    sp ->GatherIn = sp ->GatherOut = NULL;
+
+    // If no memory for the blocks, every run just goes in place
+    if (!Planar) {
+
+        sp ->GatherIn = (cmsUInt8Number*) _cmsMalloc(p ->ContextID, GATHER_BLOCK * (sp ->InSize + sp ->OutSize));
+        if (sp ->GatherIn != NULL)
+            sp ->GatherOut = sp ->GatherIn + GATHER_BLOCK * sp ->InSize;
+    }
+
+    return TRUE;
+}
+
+static
+void SparseFlush(_cmsSparse* sp)
+{
+    cmsUInt32Number i;
+
+    if (sp ->nPending == 0) return;
+
+    // Output is gathered as well, so bytes not written by the formatter (extra channels) are kept
+    for (i=0; i < sp ->nPending; i++) {
+
+        CopyPixel(sp ->GatherIn  + i * sp ->InSize,  sp ->In  + sp ->Pending[i] * sp ->InStep,  sp ->InSize);
+        CopyPixel(sp ->GatherOut + i * sp ->OutSize, sp ->Out + sp ->Pending[i] * sp ->OutStep, sp ->OutSize);
+    }
+
+    sp ->p ->xform(sp ->p, sp ->GatherIn, sp ->GatherOut, sp ->nPending, sp ->nPending);
+
+    for (i=0; i < sp ->nPending; i++) {
+
+        CopyPixel(sp ->Out + sp ->Pending[i] * sp ->OutStep, sp ->GatherOut + i * sp ->OutSize, sp ->OutSize);
+    }
+
+    sp ->nPending = 0;
+}
+
+// Transforms Count selected pixels, starting at First
+static
+void SparseRun(_cmsSparse* sp, cmsUInt32Number First, cmsUInt32Number Count)
+{
+    cmsUInt32Number i;
+
+    if (Count >= MIN_DIRECT_RUN || sp ->GatherIn == NULL) {
+
+        sp ->p ->xform(sp ->p, sp ->In + First * sp ->InStep, sp ->Out + First * sp ->OutStep, Count, sp ->Stride);
+        return;
+    }
+
+    for (i=0; i < Count; i++) {
+
+        sp ->Pending[sp ->nPending++] = First + i;
+        if (sp ->nPending == GATHER_BLOCK) SparseFlush(sp);
+    }
+}
+
+static
+void SparseEnd(_cmsSparse* sp)
+{
+    if (sp ->GatherIn != NULL) {
+
+        SparseFlush(sp);
+        _cmsFree(sp ->p ->ContextID, sp ->GatherIn);
+    }
+}
+
+// Transforms only the pixels whose index is in the list. Consecutive indexes are grouped in runs
+cmsBool CMSEXPORT cmsDoTransformIndexed(cmsHTRANSFORM Transform,
+                                        const void* InputBuffer,
+                                        void* OutputBuffer,
+                                        const cmsUInt32Number Indexes[],
+                                        cmsUInt32Number nIndexes,
+                                        cmsUInt32Number Stride)
+{
+    _cmsSparse sp;
+    cmsUInt32Number i, First, Count;
+
+    if (!SparseBegin(&sp, (_cmsTRANSFORM*) Transform, InputBuffer, OutputBuffer, Stride)) return FALSE;
+
+    i = 0;
+    while (i < nIndexes) {
+
+        First = Indexes[i++];
+        Count = 1;
+
+        while (i < nIndexes && Indexes[i] == First + Count) {
+            Count++; i++;
+        }
+
+        SparseRun(&sp, First, Count);
+    }
+
+    SparseEnd(&sp);
+    return TRUE;
+}
+
+// Byte masks. Unselected spans are skipped a word at a time, as those are most of the mask on scattered selections
+static
+void ScanByteMask(_cmsSparse* sp, const cmsUInt8Number Mask[], cmsUInt32Number Size)
+{
+    cmsUInt32Number i = 0, First;
+
+    while (i < Size) {
+
+        while (i + sizeof(cmsUInt32Number) <= Size) {
+
+            cmsUInt32Number Word;
+
+            memcpy(&Word, Mask + i, sizeof(Word));
+            if (Word != 0) break;
+            i += sizeof(cmsUInt32Number);
+        }
+
+        while (i < Size && Mask[i] == 0) i++;
+        if (i >= Size) break;
+
+        First = i;
+        while (i < Size && Mask[i] != 0) i++;
+
+        SparseRun(sp, First, i - First);
+    }
+}
+
+// Bit masks, most significant bit first. Bytes all clear or all set are taken at once
+static
+void ScanBitMask(_cmsSparse* sp, const cmsUInt8Number Mask[], cmsUInt32Number Size)
+{
+    cmsUInt32Number i = 0, First = 0, Count = 0;
+
+    while (i < Size) {
+
+        cmsUInt8Number Bits = Mask[i >> 3];
+        cmsUInt32Number n, Last;
+
+        // Number of pixels left in this byte
+        n = 8 - (i & 7);
+        if (n > Size - i) n = Size - i;
+
+        if (Bits == 0) {
+
+            if (Count > 0) SparseRun(sp, First, Count);
+            Count = 0;
+            i += n;
+            continue;
+        }
+
+        if (Bits == 0xFF) {
+
+            if (Count == 0) First = i;
+            Count += n;
+            i += n;
+            continue;
+        }
+
+        for (Last = i + n; i < Last; i++) {
+
+            if ((Bits >> (7 - (i & 7))) & 1) {
+                if (Count == 0) First = i;
+                Count++;
             }
-            else {            
-                    TransformOnePixelWithGamutCheck(p, wIn, wOut);
-                    memcpy(Cache.CacheIn, wIn, sizeof(Cache.CacheIn));
-                    memcpy(Cache.CacheOut, wOut, sizeof(Cache.CacheOut));
+            else {
+                if (Count > 0) SparseRun(sp, First, Count);
+                Count = 0;
             }
+        }
+    }
 
-            output = p -> ToOutput(p, wOut, output, Stride);
-       }
-       
+    if (Count > 0) SparseRun(sp, First, Count);
+}
+
+// Transforms only the pixels selected by the mask
+cmsBool CMSEXPORT cmsDoTransformMasked(cmsHTRANSFORM Transform,
+                                       const void* InputBuffer,
+                                       void* OutputBuffer,
+                                       const cmsUInt8Number Mask[],
+                                       cmsUInt32Number MaskBits,
+                                       cmsUInt32Number Size,
+                                       cmsUInt32Number Stride)
+{
+    _cmsTRANSFORM* p = (_cmsTRANSFORM*) Transform;
+    _cmsSparse sp;
+
+    if (MaskBits != 1 && MaskBits != 8) {
+        cmsSignalError(p ->ContextID, cmsERROR_RANGE, "Mask should have 1 or 8 bits per pixel, %d found", MaskBits);
+        return FALSE;
+    }
+
+    if (!SparseBegin(&sp, p, InputBuffer, OutputBuffer, Stride)) return FALSE;
+
+    if (MaskBits == 8)
+        ScanByteMask(&sp, Mask, Size);
+    else
+        ScanBitMask(&sp, Mask, Size);
+
+    SparseEnd(&sp);
+    return TRUE;
+}
+
+// Palette transforms ------------------------------------------------------------------------------------------
+
+// Colors go through the transform and then to the index of the nearest palette entry, measured in output device
+// space. The nearest entry search is exact and has a precomputed grid in front, see _cmsNearestAlloc
+
+// Each thread takes a run of pixels, so it should not be too short
+#define PALETTE_MIN_RUN     4096
+
+typedef struct {
+
+    _cmsTRANSFORM*   p;
+    _cmsNEAREST*     Nearest;
+    cmsUInt32Number  nEntries;
+
+} _cmsPaletteMap;
+
+typedef struct {
+
+    const _cmsPaletteMap* Map;
+    const cmsUInt8Number* In;
+    void*                 Out;
+    cmsUInt32Number       First, Count;
+    cmsUInt32Number       Stride;
+
+} PaletteJob;
+
+// Transform must have 8 or 16 bits formats, and the palette is given in its output format
+cmsHANDLE CMSEXPORT cmsPaletteMapAlloc(cmsHTRANSFORM Transform, const void* Palette, cmsUInt32Number nEntries)
+{
+    _cmsTRANSFORM* p = (_cmsTRANSFORM*) Transform;
+    _cmsTRANSFORM Fake;
+    _cmsPaletteMap* Map;
+    cmsFormatter16 Unroll;
+    cmsFloat32Number* Points;
+    cmsFloat32Number DomainMin[cmsMAXCHANNELS], DomainMax[cmsMAXCHANNELS];
+    cmsUInt16Number wEntry[cmsMAXCHANNELS];
+    cmsUInt8Number* ptr = (cmsUInt8Number*) Palette;
+    cmsUInt32Number i, j, nChans;
+
+    _cmsAssert(p != NULL);
+
+    if (p ->FromInput == NULL || p ->ToOutput == NULL) {
+        cmsSignalError(p ->ContextID, cmsERROR_NOT_SUITABLE, "Palette maps need a transform with 8 or 16 bits formats");
+        return NULL;
+    }
+
+    if (nEntries == 0 || nEntries > 65535) {
+        cmsSignalError(p ->ContextID, cmsERROR_RANGE, "Wrong palette size, %d entries", nEntries);
+        return NULL;
+    }
+
+    // Palette entries are read by using an unroller of the output format
+    Unroll = _cmsGetFormatter(p ->OutputFormat, cmsFormatterInput, CMS_PACK_FLAGS_16BITS).Fmt16;
+    if (Unroll == NULL) {
+        cmsSignalError(p ->ContextID, cmsERROR_UNKNOWN_EXTENSION, "Unsupported palette format");
+        return NULL;
+    }
+
+    memset(&Fake, 0, sizeof(Fake));
+    Fake.InputFormat = p ->OutputFormat;
+    Fake.ContextID   = p ->ContextID;
+
+    nChans = cmsPipelineOutputChannels(p ->Lut);
+
+    Points = (cmsFloat32Number*) _cmsCalloc(p ->ContextID, nEntries * nChans, sizeof(cmsFloat32Number));
+    if (Points == NULL) return NULL;
+
+    for (i=0; i < nEntries; i++) {
+
+        ptr = Unroll(&Fake, wEntry, ptr, nEntries);
+
+        for (j=0; j < nChans; j++)
+            Points[i * nChans + j] = (cmsFloat32Number) wEntry[j];
+    }
+
+    for (j=0; j < nChans; j++) {
+        DomainMin[j] = 0;
+        DomainMax[j] = 65535;
+    }
+
+    Map = (_cmsPaletteMap*) _cmsMallocZero(p ->ContextID, sizeof(_cmsPaletteMap));
+    if (Map != NULL) {
+
+        Map ->p        = p;
+        Map ->nEntries = nEntries;
+        Map ->Nearest  = _cmsNearestAlloc(p ->ContextID, nChans, Points, nEntries, DomainMin, DomainMax);
+
+        if (Map ->Nearest == NULL) {
+            _cmsFree(p ->ContextID, Map);
+            Map = NULL;
+        }
+    }
+
+    _cmsFree(p ->ContextID, Points);
+    return (cmsHANDLE) Map;
+}
+
+void CMSEXPORT cmsPaletteMapFree(cmsHANDLE hMap)
+{
+    _cmsPaletteMap* Map = (_cmsPaletteMap*) hMap;
+
+    if (Map == NULL) return;
+
+    _cmsNearestFree(Map ->Nearest);
+    _cmsFree(Map ->p ->ContextID, Map);
+}
+
+static
+void PaletteThread(void* Cargo)
+{
+    PaletteJob* Job = (PaletteJob*) Cargo;
+    _cmsTRANSFORM* p = Job ->Map ->p;
+    cmsUInt8Number* accum = (cmsUInt8Number*) Job ->In + Job ->First * PixelStep(p ->InputFormat);
+    cmsUInt16Number wIn[cmsMAXCHANNELS], wOut[cmsMAXCHANNELS], wLast[cmsMAXCHANNELS];
+    cmsFloat32Number Value[cmsMAXCHANNELS];
+    cmsUInt32Number i, j, Index = 0;
+    cmsUInt32Number nChans = cmsPipelineOutputChannels(p ->Lut);
+
+    memset(wIn, 0, sizeof(wIn));
+    memset(wOut, 0, sizeof(wOut));
+
+    for (i=0; i < Job ->Count; i++) {
+
+        accum = p ->FromInput(p, wIn, accum, Job ->Stride);
+
+        // Same color as the last pixel, same index
+        if (i == 0 || memcmp(wIn, wLast, sizeof(wIn)) != 0) {
+
+            if (p ->GamutCheck != NULL)
+                TransformOnePixelWithGamutCheck(p, wIn, wOut);
+            else
+                p ->Lut ->Eval16Fn(wIn, wOut, p ->Lut ->Data);
+
+            for (j=0; j < nChans; j++)
+                Value[j] = (cmsFloat32Number) wOut[j];
+
+            Index = _cmsNearestFind(Job ->Map ->Nearest, Value);
+            memmove(wLast, wIn, sizeof(wIn));
+        }
+
+        if (Job ->Map ->nEntries <= 256)
+            ((cmsUInt8Number*) Job ->Out)[Job ->First + i] = (cmsUInt8Number) Index;
+        else
+            ((cmsUInt16Number*) Job ->Out)[Job ->First + i] = (cmsUInt16Number) Index;
+    }
+}
+
+// Transforms to palette indexes, which are bytes for 256 palette entries or less and 16 bits words otherwise. Input
+// buffer is laid out as in cmsDoTransformStride. The work is split among nThreads threads, 0 meaning one per processor
+cmsBool CMSEXPORT cmsDoTransformToPalette(cmsHANDLE hMap,
+                                          const void* InputBuffer,
+                                          void* IndexBuffer,
+                                          cmsUInt32Number Size,
+                                          cmsUInt32Number Stride,
+                                          cmsUInt32Number nThreads)
+{
+    _cmsPaletteMap* Map = (_cmsPaletteMap*) hMap;
+    PaletteJob* Jobs;
+    cmsUInt32Number i;
+
+    _cmsAssert(Map != NULL);
+
+    if (Size == 0) return TRUE;
+
+    if (nThreads == 0) nThreads = _cmsGetProcessorCount();
+    if (nThreads > Size / PALETTE_MIN_RUN) nThreads = Size / PALETTE_MIN_RUN;
+    if (nThreads == 0) nThreads = 1;
+
+    Jobs = (PaletteJob*) _cmsCalloc(Map ->p ->ContextID, nThreads, sizeof(PaletteJob));
+    if (Jobs == NULL) return FALSE;
+
+    for (i=0; i < nThreads; i++) {
+
+        Jobs[i].Map    = Map;
+        Jobs[i].In     = (const cmsUInt8Number*) InputBuffer;
+        Jobs[i].Out    = IndexBuffer;
+        Jobs[i].First  = (cmsUInt32Number) (((cmsUInt64Number) Size * i) / nThreads);
+        Jobs[i].Count  = (cmsUInt32Number) (((cmsUInt64Number) Size * (i + 1)) / nThreads) - Jobs[i].First;
+        Jobs[i].Stride = Stride;
+    }
+
+    _cmsRunThreads(Map ->p ->ContextID, nThreads, PaletteThread, Jobs, sizeof(PaletteJob));
+    _cmsFree(Map ->p ->ContextID, Jobs);
+
+    return TRUE;
+}
+
+// Vectored transforms -----------------------------------------------------------------------------------------
+
+// Many buffers for one transform. The pixels of all buffers are split in runs of about the same size, one per thread,
+// and a buffer may be cut between two runs. Pixel offsets need known formats; if a format is zero, runs end at buffer
+// boundaries only.
+
+#define VECTOR_MIN_RUN      4096
+
+typedef struct {
+
+    _cmsTRANSFORM*            p;
+    const cmsTRANSFORMBUFFER* Buffers;
+    cmsUInt32Number           FirstBuffer, LastBuffer;   // Last is inclusive
+    cmsUInt32Number           FirstPixel;                // Within FirstBuffer
+    cmsUInt32Number           LastPixel;                 // Within LastBuffer, exclusive
+
+} VectorJob;
+
+static
+void VectorThread(void* Cargo)
+{
+    VectorJob* Job = (VectorJob*) Cargo;
+    _cmsTRANSFORM* p = Job ->p;
+    cmsUInt32Number i, First, Last;
+
+    for (i = Job ->FirstBuffer; i <= Job ->LastBuffer; i++) {
+
+        const cmsTRANSFORMBUFFER* b = Job ->Buffers + i;
+
+        First = (i == Job ->FirstBuffer) ? Job ->FirstPixel : 0;
+        Last  = (i == Job ->LastBuffer)  ? Job ->LastPixel  : b ->Size;
+
+        if (Last <= First) continue;
+
+        if (First == 0)
+            p ->xform(p, b ->InputBuffer, b ->OutputBuffer, Last, b ->Stride);
+        else
+            p ->xform(p, (const cmsUInt8Number*) b ->InputBuffer + First * PixelStep(p ->InputFormat),
+                         (cmsUInt8Number*) b ->OutputBuffer + First * PixelStep(p ->OutputFormat),
+                         Last - First, b ->Stride);
+    }
+}
+
+// Each buffer is laid out as in cmsDoTransformStride. The work is split among nThreads threads, 0 meaning one per processor
+void CMSEXPORT cmsDoTransformBuffers(cmsHTRANSFORM Transform,
+                                     const cmsTRANSFORMBUFFER Buffers[],
+                                     cmsUInt32Number nBuffers,
+                                     cmsUInt32Number nThreads)
+{
+    _cmsTRANSFORM* p = (_cmsTRANSFORM*) Transform;
+    VectorJob* Jobs = NULL;
+    cmsUInt64Number Total = 0, Done, Next;
+    cmsUInt32Number i, b, Offset;
+    cmsBool CanCut;
+
+    _cmsAssert(p != NULL);
+    _cmsAssert(Buffers != NULL || nBuffers == 0);
+
+    for (i=0; i < nBuffers; i++)
+        Total += Buffers[i].Size;
+
+    if (nThreads == 0) nThreads = _cmsGetProcessorCount();
+    if (nThreads > Total / VECTOR_MIN_RUN) nThreads = (cmsUInt32Number) (Total / VECTOR_MIN_RUN);
+
+    CanCut = p ->InputFormat != 0 && p ->OutputFormat != 0;
+    if (!CanCut && nThreads > nBuffers) nThreads = nBuffers;
+
+    if (nThreads > 1)
+        Jobs = (VectorJob*) _cmsCalloc(p ->ContextID, nThreads, sizeof(VectorJob));
+
+    // Back to back on the calling thread
+    if (Jobs == NULL) {
+
+        for (i=0; i < nBuffers; i++) {
+            if (Buffers[i].Size > 0)
+                p ->xform(p, Buffers[i].InputBuffer, Buffers[i].OutputBuffer, Buffers[i].Size, Buffers[i].Stride);
+        }
+        return;
+    }
+
+    // Walk the buffers once, placing the end of each run. Done counts the pixels before buffer b
+    b = 0; Offset = 0; Done = 0;
+    for (i=0; i < nThreads; i++) {
+
+        Jobs[i].p           = p;
+        Jobs[i].Buffers     = Buffers;
+        Jobs[i].FirstBuffer = b;
+        Jobs[i].FirstPixel  = Offset;
+
+        Next = (Total * (i + 1)) / nThreads;
+
+        while (b < nBuffers - 1 && Done + Buffers[b].Size <= Next) {
+            Done += Buffers[b].Size;
+            b++;
+        }
+
+        Offset = (cmsUInt32Number) (Next - Done);
+        if (!CanCut && Offset > 0) Offset = Buffers[b].Size;
+
+        Jobs[i].LastBuffer = b;
+        Jobs[i].LastPixel  = Offset;
+    }
+
+    _cmsRunThreads(p ->ContextID, nThreads, VectorThread, Jobs, sizeof(VectorJob));
+    _cmsFree(p ->ContextID, Jobs);
 }
 
 // -------------------------------------------------------------------------------------------------------------
@@ -614,6 +1258,10 @@ cmsHTRANSFORM CMSEXPORT cmsCreateExtendedTransform(cmsContext ContextID,
         if (hGamutProfile == NULL) dwFlags &= ~cmsFLAGS_GAMUTCHECK;
     }
 
+    // Fast precision is taken here, once. It goes to the flags the transform keeps, unless a grid is already asked for
+    if (cmsSetPrecisionPolicy(-1) == cmsPRECISION_FAST && !(dwFlags & (cmsFLAGS_HIGHRESPRECALC|cmsFLAGS_GRIDPOINTS(0xFF))))
+        dwFlags |= cmsFLAGS_LOWRESPRECALC;
+
     // On floating point transforms, inhibit optimizations 
     FloatTransform = (_cmsFormatterIsFloat(InputFormat) && _cmsFormatterIsFloat(OutputFormat));
 
@@ -915,3 +1563,331 @@ cmsBool CMSEXPORT cmsChangeBuffersFormat(cmsHTRANSFORM hTransform,
     xform ->ToOutput     = ToOutput;
     return TRUE;
 }
+
+
+// ----------------------------------------------------------------------------------------------------------------
+// Transform tables. A set of transforms known in advance, built at once and looked up by key. 
+
+typedef struct {
+
+    cmsTRANSFORMSPEC Spec;          // Strings are owned by the table
+    cmsHTRANSFORM    hTransform;    // NULL until built
+
+} _cmsTransformTableEntry;
+
+typedef struct {
+
+    cmsContext ContextID;
+    cmsUInt32Number nEntries;
+    _cmsTransformTableEntry*  Entries;
+    _cmsTransformTableEntry** Sorted;   // Sorted by key, for lookups
+
+} _cmsTransformTable;
+
+
+static
+char* DupString(cmsContext ContextID, const char* s)
+{
+    if (s == NULL) return NULL;
+    return (char*) _cmsDupMem(ContextID, s, (cmsUInt32Number) strlen(s) + 1);
+}
+
+static
+int CompareEntryKeys(const void* a, const void* b)
+{
+    const _cmsTransformTableEntry* e1 = *(const _cmsTransformTableEntry**) a;
+    const _cmsTransformTableEntry* e2 = *(const _cmsTransformTableEntry**) b;
+
+    return strcmp(e1 ->Spec.Key, e2 ->Spec.Key);
+}
+
+// Frees everything, including transforms already built
+void CMSEXPORT cmsTransformTableFree(cmsHANDLE hTable)
+{
+    _cmsTransformTable* Table = (_cmsTransformTable*) hTable;
+    cmsUInt32Number i;
+
+    if (Table == NULL) return;
+
+    if (Table ->Entries != NULL) {
+
+        for (i=0; i < Table ->nEntries; i++) {
+
+            _cmsTransformTableEntry* e = Table ->Entries + i;
+
+            if (e ->hTransform) cmsDeleteTransform(e ->hTransform);
+            if (e ->Spec.Key) _cmsFree(Table ->ContextID, (void*) e ->Spec.Key);
+            if (e ->Spec.InputProfile) _cmsFree(Table ->ContextID, (void*) e ->Spec.InputProfile);
+            if (e ->Spec.OutputProfile) _cmsFree(Table ->ContextID, (void*) e ->Spec.OutputProfile);
+        }
+
+        _cmsFree(Table ->ContextID, Table ->Entries);
+    }
+
+    if (Table ->Sorted) _cmsFree(Table ->ContextID, Table ->Sorted);
+    _cmsFree(Table ->ContextID, Table);
+}
+
+// Allocates the table and indexes the keys. No transform is built yet
+cmsHANDLE CMSEXPORT cmsTransformTableAlloc(cmsContext ContextID, const cmsTRANSFORMSPEC Specs[], cmsUInt32Number nSpecs)
+{
+    _cmsTransformTable* Table;
+    cmsUInt32Number i;
+
+    Table = (_cmsTransformTable*) _cmsMallocZero(ContextID, sizeof(_cmsTransformTable));
+    if (Table == NULL) return NULL;
+
+    Table ->ContextID = ContextID;
+
+    if (nSpecs > 0) {
+
+        Table ->Entries = (_cmsTransformTableEntry*) _cmsCalloc(ContextID, nSpecs, sizeof(_cmsTransformTableEntry));
+        Table ->Sorted  = (_cmsTransformTableEntry**) _cmsCalloc(ContextID, nSpecs, sizeof(_cmsTransformTableEntry*));
+        if (Table ->Entries == NULL || Table ->Sorted == NULL) goto Error;
+    }
+
+    Table ->nEntries = nSpecs;
+
+    for (i=0; i < nSpecs; i++) {
+
+        _cmsTransformTableEntry* e = Table ->Entries + i;
+
+        if (Specs[i].Key == NULL || Specs[i].InputProfile == NULL) {
+            cmsSignalError(ContextID, cmsERROR_NULL, "Transform table entry %d lacks key or input profile", i);
+            goto Error;
+        }
+
+        e ->Spec = Specs[i];
+        e ->Spec.Key           = DupString(ContextID, Specs[i].Key);
+        e ->Spec.InputProfile  = DupString(ContextID, Specs[i].InputProfile);
+        e ->Spec.OutputProfile = DupString(ContextID, Specs[i].OutputProfile);
+
+        if (e ->Spec.Key == NULL || e ->Spec.InputProfile == NULL || 
+            (Specs[i].OutputProfile != NULL && e ->Spec.OutputProfile == NULL)) goto Error;
+
+        Table ->Sorted[i] = e;
+    }
+
+    if (nSpecs > 0) {
+
+        qsort(Table ->Sorted, nSpecs, sizeof(_cmsTransformTableEntry*), CompareEntryKeys);
+
+        for (i=1; i < nSpecs; i++) {
+
+            if (strcmp(Table ->Sorted[i-1] ->Spec.Key, Table ->Sorted[i] ->Spec.Key) == 0) {
+                cmsSignalError(ContextID, cmsERROR_ALREADY_DEFINED, "Duplicated transform table key '%s'", Table ->Sorted[i] ->Spec.Key);
+                goto Error;
+            }
+        }
+    }
+
+    return (cmsHANDLE) Table;
+
+Error:
+    cmsTransformTableFree((cmsHANDLE) Table);
+    return NULL;
+}
+
+cmsUInt32Number CMSEXPORT cmsTransformTableCount(cmsHANDLE hTable)
+{
+    _cmsTransformTable* Table = (_cmsTransformTable*) hTable;
+
+    if (Table == NULL) return 0;
+    return Table ->nEntries;
+}
+
+// Profiles are given by file name or by the name of a built-in
+static
+cmsHPROFILE OpenSpecProfile(cmsContext ContextID, const char* Name)
+{
+    if (cmsstrcasecmp(Name, "*sRGB") == 0) return cmsCreate_sRGBProfileTHR(ContextID);
+    if (cmsstrcasecmp(Name, "*Lab")  == 0) return cmsCreateLab4ProfileTHR(ContextID, NULL);
+    if (cmsstrcasecmp(Name, "*Lab4") == 0) return cmsCreateLab4ProfileTHR(ContextID, NULL);
+    if (cmsstrcasecmp(Name, "*Lab2") == 0) return cmsCreateLab2ProfileTHR(ContextID, NULL);
+    if (cmsstrcasecmp(Name, "*XYZ")  == 0) return cmsCreateXYZProfileTHR(ContextID);
+
+    return cmsOpenProfileFromFileTHR(ContextID, Name, "r");
+}
+
+// Builds the n-th entry. Each entry opens its own profiles, so distinct entries can be built at same time
+cmsBool CMSEXPORT cmsTransformTableBuild(cmsHANDLE hTable, cmsUInt32Number n)
+{
+    _cmsTransformTable* Table = (_cmsTransformTable*) hTable;
+    _cmsTransformTableEntry* e;
+    cmsHPROFILE hInput, hOutput = NULL;
+
+    _cmsAssert(Table != NULL);
+
+    if (n >= Table ->nEntries) {
+        cmsSignalError(Table ->ContextID, cmsERROR_RANGE, "Transform table entry %d out of range", n);
+        return FALSE;
+    }
+
+    e = Table ->Entries + n;
+    if (e ->hTransform != NULL) return TRUE;
+
+    hInput = OpenSpecProfile(Table ->ContextID, e ->Spec.InputProfile);
+    if (hInput == NULL) return FALSE;
+
+    if (e ->Spec.OutputProfile != NULL) {
+
+        hOutput = OpenSpecProfile(Table ->ContextID, e ->Spec.OutputProfile);
+        if (hOutput == NULL) {
+            cmsCloseProfile(hInput);
+            return FALSE;
+        }
+    }
+
+    e ->hTransform = cmsCreateTransformTHR(Table ->ContextID, hInput, e ->Spec.InputFormat, hOutput, e ->Spec.OutputFormat, 
+                                                              e ->Spec.Intent, e ->Spec.dwFlags);
+    cmsCloseProfile(hInput);
+    if (hOutput) cmsCloseProfile(hOutput);
+
+    return e ->hTransform != NULL;
+}
+
+// Returns the transform for the key, or NULL if not found or not built. The table keeps ownership
+cmsHTRANSFORM CMSEXPORT cmsTransformTableLookup(cmsHANDLE hTable, const char* Key)
+{
+    _cmsTransformTable* Table = (_cmsTransformTable*) hTable;
+    _cmsTransformTableEntry Probe, *pProbe = &Probe, **Found;
+
+    if (Table == NULL || Key == NULL || Table ->nEntries == 0) return NULL;
+
+    Probe.Spec.Key = Key;
+    Found = (_cmsTransformTableEntry**) bsearch(&pProbe, Table ->Sorted, Table ->nEntries, sizeof(_cmsTransformTableEntry*), CompareEntryKeys);
+
+    if (Found == NULL) return NULL;
+    return (*Found) ->hTransform;
+}
+
+
+// ----------------------------------------------------------------------------------------------------------------
+
+// Transform bundles. Same profile chain, several intent/flags variants
+
+typedef struct {
+
+    cmsContext                 ContextID;
+    cmsHPROFILE*               hProfiles;
+    cmsUInt32Number            nProfiles;
+    cmsUInt32Number            InputFormat;
+    cmsUInt32Number            OutputFormat;
+    const cmsTRANSFORMVARIANT* Variants;
+    cmsUInt32Number            nVariants;
+    cmsUInt32Number            First;       // This thread builds First, First + Step, ...
+    cmsUInt32Number            Step;
+    cmsHTRANSFORM*             Transforms;
+
+} BundleJob;
+
+static
+void BundleThread(void* Cargo)
+{
+    BundleJob* Job = (BundleJob*) Cargo;
+    cmsUInt32Number i;
+
+    for (i = Job ->First; i < Job ->nVariants; i += Job ->Step) {
+
+        Job ->Transforms[i] = cmsCreateMultiprofileTransformTHR(Job ->ContextID, Job ->hProfiles, Job ->nProfiles,
+                                                                Job ->InputFormat, Job ->OutputFormat,
+                                                                Job ->Variants[i].Intent, Job ->Variants[i].dwFlags);
+    }
+}
+
+// Builds one transform for each variant, concurrently, so the cost is roughly the one of the slowest variant.
+// Variants are built out of frozen profiles, so they share the decoded tags and whatever frozen profiles keep
+// once derived: black points, adaptation matrices and matrix-shaper segments. On error, no transform is returned.
+cmsBool CMSEXPORT cmsCreateTransformBundleTHR(cmsContext ContextID,
+                                              cmsHPROFILE hProfiles[],
+                                              cmsUInt32Number nProfiles,
+                                              cmsUInt32Number InputFormat,
+                                              cmsUInt32Number OutputFormat,
+                                              const cmsTRANSFORMVARIANT Variants[],
+                                              cmsUInt32Number nVariants,
+                                              cmsUInt32Number nThreads,
+                                              cmsHTRANSFORM Transforms[])
+{
+    BundleJob* Jobs;
+    cmsHPROFILE* hFrozen;
+    cmsUInt32Number i;
+    cmsBool rc = TRUE;
+
+    _cmsAssert(Transforms != NULL);
+
+    if (nVariants == 0 || Variants == NULL) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Empty transform bundle");
+        return FALSE;
+    }
+
+    if (nProfiles <= 0 || nProfiles > 255) {
+        cmsSignalError(ContextID, cmsERROR_RANGE, "Wrong number of profiles. 1..255 expected, %d found.", nProfiles);
+        return FALSE;
+    }
+
+    for (i=0; i < nVariants; i++) Transforms[i] = NULL;
+
+    if (nThreads == 0) nThreads = _cmsGetProcessorCount();
+    if (nThreads > nVariants) nThreads = nVariants;
+
+    hFrozen = (cmsHPROFILE*) _cmsCalloc(ContextID, nProfiles, sizeof(cmsHPROFILE));
+    if (hFrozen == NULL) return FALSE;
+
+    // Frozen profiles are shared as they are, any other gets a private frozen copy, so the caller's
+    // handle is neither frozen nor read from several threads
+    for (i=0; i < nProfiles; i++) {
+
+        hFrozen[i] = cmsIsProfileFrozen(hProfiles[i]) ? cmsRetainProfile(hProfiles[i]) : _cmsDupFrozenProfile(hProfiles[i]);
+        if (hFrozen[i] == NULL) {
+            rc = FALSE;
+            goto Done;
+        }
+    }
+
+    Jobs = (BundleJob*) _cmsCalloc(ContextID, nThreads, sizeof(BundleJob));
+    if (Jobs == NULL) {
+        rc = FALSE;
+        goto Done;
+    }
+
+    for (i=0; i < nThreads; i++) {
+
+        Jobs[i].ContextID    = ContextID;
+        Jobs[i].hProfiles    = hFrozen;
+        Jobs[i].nProfiles    = nProfiles;
+        Jobs[i].InputFormat  = InputFormat;
+        Jobs[i].OutputFormat = OutputFormat;
+        Jobs[i].Variants     = Variants;
+        Jobs[i].nVariants    = nVariants;
+        Jobs[i].First        = i;
+        Jobs[i].Step         = nThreads;
+        Jobs[i].Transforms   = Transforms;
+    }
+
+    _cmsRunThreads(ContextID, nThreads, BundleThread, Jobs, sizeof(BundleJob));
+    _cmsFree(ContextID, Jobs);
+
+    for (i=0; i < nVariants; i++) {
+        if (Transforms[i] == NULL) rc = FALSE;
+    }
+
+Done:
+    if (!rc) {
+
+        for (i=0; i < nVariants; i++) {
+
+            if (Transforms[i] != NULL) {
+                cmsDeleteTransform(Transforms[i]);
+                Transforms[i] = NULL;
+            }
+        }
+    }
+
+    // Transforms keep nothing from the profiles they were built from
+    for (i=0; i < nProfiles; i++) {
+        if (hFrozen[i] != NULL) cmsCloseProfile(hFrozen[i]);
+    }
+    _cmsFree(ContextID, hFrozen);
+
+    return rc;
+}
@@ -106,6 +106,36 @@
 #      define _cmsAssert(a)   assert((a))
 #endif
 
+// Atomic operations on 32 bit counters. Those return the new value, exchange returns the old one.
+// Release stores zero with release semantics and is the only right way to drop a spin lock taken by exchange.
+// Load reads with acquire semantics, so whatever was written before the value was published is seen as well.
+// Other compilers go through the functions in cmsplugin.c, which use the platform's threading primitives.
+#if defined(__GNUC__)
+#      define _cmsAtomicIncrement(p)    __sync_add_and_fetch((p), 1)
+#      define _cmsAtomicDecrement(p)    __sync_sub_and_fetch((p), 1)
+#      define _cmsAtomicExchange(p, v)  __sync_lock_test_and_set((p), (v))
+#      define _cmsAtomicRelease(p)      __sync_lock_release((p))
+#   if defined(__ATOMIC_ACQUIRE)
+#      define _cmsAtomicLoad(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#   else
+#      define _cmsAtomicLoad(p)         __sync_fetch_and_add((p), 0)
+#   endif
+#elif defined(_MSC_VER)
+#      include <intrin.h>
+#      define _cmsAtomicIncrement(p)    _InterlockedIncrement((volatile long*) (p))
+#      define _cmsAtomicDecrement(p)    _InterlockedDecrement((volatile long*) (p))
+#      define _cmsAtomicExchange(p, v)  _InterlockedExchange((volatile long*) (p), (v))
+#      define _cmsAtomicRelease(p)      _InterlockedExchange((volatile long*) (p), 0)
+#      define _cmsAtomicLoad(p)         _InterlockedOr((volatile long*) (p), 0)
+#else
+#      define CMS_ATOMICS_BY_FUNCTION   1
+long _cmsAtomicIncrement(volatile long* p);
+long _cmsAtomicDecrement(volatile long* p);
+long _cmsAtomicExchange(volatile long* p, long v);
+void _cmsAtomicRelease(volatile long* p);
+long _cmsAtomicLoad(volatile long* p);
+#endif
+
 //---------------------------------------------------------------------------------
 
 // Determinant lower than that are assumed zero (used on matrix invert)
@@ -276,14 +306,20 @@ struct _cms_NAMEDCOLORLIST_struct {
     cmsContext ContextID;
 };
 
+// Nearest point search. Exact euclidean nearest neighbour over a fixed set of points. Values out of the domain given
+// on allocation are still right, but are searched linearly. On ties, the lowest index wins
+typedef struct _cms_nearest_struct _cmsNEAREST;
+
+_cmsNEAREST*     _cmsNearestAlloc(cmsContext ContextID, cmsUInt32Number nDims, const cmsFloat32Number Points[], cmsUInt32Number nPoints,
+                                  const cmsFloat32Number DomainMin[], const cmsFloat32Number DomainMax[]);
+void             _cmsNearestFree(_cmsNEAREST* nn);
+cmsUInt32Number  _cmsNearestFind(const _cmsNEAREST* nn, const cmsFloat32Number Value[]);
+
 
 // ----------------------------------------------------------------------------------
 
 // This is the internal struct holding profile details.
 
-// Maximum supported tags in a profile
-#define MAX_TABLE_TAG       100
-
 typedef struct _cms_iccprofile_struct {
 
     // I/O handler
@@ -307,18 +343,34 @@ typedef struct _cms_iccprofile_struct {
 
     cmsProfileID             ProfileID;
 
-    // Dictionary
+    // Dictionary. Grows on demand, all arrays are carved from a single block
     cmsUInt32Number          TagCount;
-    cmsTagSignature          TagNames[MAX_TABLE_TAG];
-    cmsTagSignature          TagLinked[MAX_TABLE_TAG];           // The tag to wich is linked (0=none)
-    cmsUInt32Number          TagSizes[MAX_TABLE_TAG];            // Size on disk
-    cmsUInt32Number          TagOffsets[MAX_TABLE_TAG];
-    cmsBool                  TagSaveAsRaw[MAX_TABLE_TAG];        // True to write uncooked
-    void *                   TagPtrs[MAX_TABLE_TAG];
-    cmsTagTypeHandler*       TagTypeHandlers[MAX_TABLE_TAG];     // Same structure may be serialized on different types
-                                                                 // depending on profile version, so we keep track of the                                                             // type handler for each tag in the list.
+    cmsUInt32Number          TagCapacity;
+    void **                  TagPtrs;                            // Start of the block
+    cmsTagTypeHandler**      TagTypeHandlers;                    // Same structure may be serialized on different types
+                                                                 // depending on profile version, so we keep track of the
+                                                                 // type handler for each tag in the list.
+    cmsTagSignature*         TagNames;
+    cmsTagSignature*         TagLinked;                          // The tag to wich is linked (0=none)
+    cmsUInt32Number*         TagSizes;                           // Size on disk
+    cmsUInt32Number*         TagOffsets;
+    cmsBool*                 TagSaveAsRaw;                       // True to write uncooked
+    cmsUInt32Number*         TagHash;                            // Open addressing index on TagNames, position + 1
+
     // Special
     cmsBool                  IsWrite;
+
+    // Handles may be shared. Frozen profiles are read only, with all tags already in memory
+    volatile long            RefCount;
+    cmsBool                  IsFrozen;
+
+    // What transforms derive from a frozen profile cannot change either, so it is kept for the next one
+    volatile long            MemoLock;
+    cmsPipeline*             MemoShaper[2];                      // Matrix-shaper, as input and as output. Same on any intent
+    cmsUInt32Number          MemoBlackPointSet[2];               // One bit per intent, source and destination black points
+    cmsCIEXYZ                MemoBlackPoint[2][4];
+    cmsBool                  MemoCHADSet;
+    cmsMAT3                  MemoCHAD;
     
 } _cmsICCPROFILE;
 
@@ -327,15 +379,65 @@ cmsBool              _cmsReadHeader(_cmsICCPROFILE* Icc);
 cmsBool              _cmsWriteHeader(_cmsICCPROFILE* Icc, cmsUInt32Number UsedSpace);
 int                  _cmsSearchTag(_cmsICCPROFILE* Icc, cmsTagSignature sig, cmsBool lFollowLinks);
 
+// Frozen copy, the original is left as it was
+cmsHPROFILE          _cmsDupFrozenProfile(cmsHPROFILE hProfile);
+
+// Results derived from frozen profiles. Direction is LCMS_USED_AS_INPUT or LCMS_USED_AS_OUTPUT. Nothing is kept
+// for profiles that are not frozen. _cmsWriteMemoShaper keeps a copy of Lut and gives Lut back.
+cmsPipeline*         _cmsReadMemoShaper(cmsHPROFILE hProfile, int Direction);
+cmsPipeline*         _cmsWriteMemoShaper(cmsHPROFILE hProfile, int Direction, cmsPipeline* Lut);
+cmsBool              _cmsReadMemoBlackPoint(cmsHPROFILE hProfile, int Direction, cmsUInt32Number Intent, cmsCIEXYZ* BlackPoint);
+void                 _cmsWriteMemoBlackPoint(cmsHPROFILE hProfile, int Direction, cmsUInt32Number Intent, const cmsCIEXYZ* BlackPoint);
+cmsBool              _cmsReadMemoCHAD(cmsHPROFILE hProfile, cmsMAT3* CHAD);
+void                 _cmsWriteMemoCHAD(cmsHPROFILE hProfile, const cmsMAT3* CHAD);
+
 // Tag types
 cmsTagTypeHandler*   _cmsGetTagTypeHandler(cmsTagTypeSignature sig);
 cmsTagTypeSignature  _cmsGetTagTrueType(cmsHPROFILE hProfile, cmsTagSignature sig);
+
+// MD5 of a profile given as raw bytes
+cmsBool              _cmsMD5computeIDFromMem(cmsContext ContextID, const cmsUInt8Number* Mem, cmsUInt32Number Size,
+                                             cmsBool LegacyFields, cmsProfileID* ProfileID);
 cmsTagDescriptor*    _cmsGetTagDescriptor(cmsTagSignature sig);
 
 // Error logging ---------------------------------------------------------------------------------------------------------
 
 void                 _cmsTagSignature2String(char String[5], cmsTagSignature sig);
 
+// Resource limits -------------------------------------------------------------------------------------------------------
+
+// All return FALSE and signal cmsERROR_RESOURCE_LIMIT if the request goes beyond the limits set by the user
+cmsBool              _cmsCheckCLUTLimits(cmsContext ContextID, cmsUInt32Number nEntries, cmsUInt32Number EntrySize);
+cmsBool              _cmsCheckCurveLimits(cmsContext ContextID, cmsUInt32Number nEntries);
+cmsBool              _cmsCheckTableBytesLimit(cmsContext ContextID, cmsFloat64Number nBytes);
+cmsBool              _cmsCheckPipelineDepthLimit(cmsContext ContextID, cmsUInt32Number nStages);
+cmsBool              _cmsCheckSamplerLimit(cmsContext ContextID, cmsUInt32Number nEvaluations);
+
+// Precision policy ------------------------------------------------------------------------------------------------------
+
+// Approximation used by objects created under cmsPRECISION_FAST. Callers check their own stored policy
+cmsFloat64Number     _cmsArcTan2(cmsFloat64Number y, cmsFloat64Number x);
+
+// Shared tables ---------------------------------------------------------------------------------------------------------
+
+// Tables handed to the store must not be written afterwards. Use _cmsUnshareTable to get a private copy first
+void*                _cmsShareTable(cmsContext ContextID, void* Table, cmsUInt32Number Size);
+void*                _cmsDupSharedTable(cmsContext ContextID, const void* Table, cmsUInt32Number Size);
+void                 _cmsFreeSharedTable(cmsContext ContextID, void* Table);
+void*                _cmsUnshareTable(cmsContext ContextID, void* Table, cmsUInt32Number Size);
+
+// CPU dispatch ----------------------------------------------------------------------------------------------------------
+
+// Level to use when selecting kernels. Kernel tables keep the lowest level each entry needs and are scanned best first
+cmsInt32Number       _cmsCPUFeatureLevel(void);
+
+// Threads ---------------------------------------------------------------------------------------------------------------
+
+// The runner, _cmsRunThreads, is exported on lcms2_plugin.h
+
+// Thread safe gmtime
+cmsBool              _cmsGetTime(struct tm* ptr_time);
+
 // Interpolation ---------------------------------------------------------------------------------------------------------
 
 cmsInterpParams*     _cmsComputeInterpParams(cmsContext ContextID, int nSamples, int InputChan, int OutputChan, const void* Table, cmsUInt32Number dwFlags);
@@ -408,6 +510,28 @@ cmsStage*        _cmsStageNormalizeToXyzFloat(cmsContext ContextID);
 // For curve set only  
 cmsToneCurve**     _cmsStageGetPtrToCurveSet(const cmsStage* mpe);
 
+// Adaptive CLUT. Coarse grid plus refined blocks, CellMap holds block number + 1 for refined cells, zero otherwise
+typedef struct {
+
+    cmsUInt32Number  nGridPoints;        // Coarse nodes by side
+    cmsUInt32Number  nRefine;            // Steps by side on refined cells
+    cmsUInt32Number  nOutputs;
+    cmsUInt32Number  nRefined;           // How many refined cells
+    cmsUInt32Number  nCoarseEntries;
+    cmsUInt32Number  BlockSize;          // Entries on each refined cell
+    cmsUInt32Number  CoarseOpta[3];
+    cmsUInt32Number  FineOpta[3];
+
+    cmsUInt16Number* Coarse;
+    cmsUInt32Number* CellMap;
+    cmsUInt16Number* Fine;
+
+} _cmsStageAdaptiveCLutData;
+
+void              _cmsEvalAdaptiveCLut16(register const cmsUInt16Number In[], 
+                                         register cmsUInt16Number Out[], 
+                                         register const void* D);
+
 
 // Pipeline Evaluator (in floating point)
 typedef void (* _cmsPipelineEvalFloatFn)(const cmsFloat32Number In[], 
@@ -501,6 +625,11 @@ cmsFormatter    _cmsGetFormatter(cmsUInt32Number Type,          // Specific type
                                  cmsFormatterDirection Dir, 
                                  cmsUInt32Number dwFlags);
 
+const char*     _cmsGetStockFormatterName(cmsUInt32Number Type, 
+                                          cmsFormatterDirection Dir, 
+                                          cmsUInt32Number dwFlags, 
+                                          cmsBool* IsGeneric);
+
 
 // Transform logic ------------------------------------------------------------------------------------------------------
 
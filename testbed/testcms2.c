@@ -1431,6 +1431,340 @@ Error:
     return 0;
 }
 
+// Grids of 9, 17, 33 and 65 nodes have their own tetrahedral kernels, which should match the generic one bit by bit.
+// The generic one is taken from a grid of 10 nodes, which has no kernel of its own, and run on the same parameters.
+static
+cmsInt32Number CheckSpecializedTetrahedral16(void)
+{
+    static const cmsUInt32Number Grids[] = { 9, 17, 33, 65 };
+    static const cmsUInt32Number Outputs[] = { 1, 3, 4 };
+    cmsUInt16Number Dummy[10*10*10*4];
+    cmsUInt16Number In[3], Ref[4], Out[4];
+    cmsUInt16Number* Table;
+    cmsInterpParams *p, *pGeneric;
+    _cmsInterpFn16 Generic;
+    cmsUInt32Number g, o, i, k, nEntries, Seed = 1;
+    cmsInt32Number rc = 1;
+
+    memset(Dummy, 0, sizeof(Dummy));
+
+    for (g=0; g < sizeof(Grids) / sizeof(Grids[0]); g++) {
+        for (o=0; o < sizeof(Outputs) / sizeof(Outputs[0]); o++) {
+
+            nEntries = Grids[g] * Grids[g] * Grids[g] * Outputs[o];
+            Table = (cmsUInt16Number*) malloc(nEntries * sizeof(cmsUInt16Number));
+
+            for (i=0; i < nEntries; i++) {
+                Seed = Seed * 1103515245 + 12345;
+                Table[i] = (cmsUInt16Number) (Seed >> 16);
+            }
+
+            p        = _cmsComputeInterpParams(DbgThread(), Grids[g], 3, Outputs[o], Table, CMS_LERP_FLAGS_16BITS);
+            pGeneric = _cmsComputeInterpParams(DbgThread(), 10, 3, Outputs[o], Dummy, CMS_LERP_FLAGS_16BITS);
+            Generic  = pGeneric ->Interpolation.Lerp16;
+
+            if (p ->Interpolation.Lerp16 == Generic) {
+                Fail("No specialized kernel for %dx%d", Grids[g], Outputs[o]);
+                rc = 0;
+            }
+
+            for (i=0; i < 0x10000; i++) {
+
+                // Random points, and the ones sitting on the nodes and the edges
+                for (k=0; k < 3; k++) {
+                    Seed = Seed * 1103515245 + 12345;
+                    In[k] = (cmsUInt16Number) (Seed >> 16);
+                }
+
+                if (i & 1) In[i % 3] = (cmsUInt16Number) (((i >> 1) % Grids[g]) * 65535 / (Grids[g] - 1));
+                if ((i & 6) == 6) In[(i + 1) % 3] = 0xFFFF;
+
+                Generic(In, Ref, p);
+                p ->Interpolation.Lerp16(In, Out, p);
+
+                if (memcmp(Ref, Out, Outputs[o] * sizeof(cmsUInt16Number)) != 0) {
+                    Fail("%dx%d kernel differs from the generic one at %d %d %d", Grids[g], Outputs[o], In[0], In[1], In[2]);
+                    rc = 0;
+                    break;
+                }
+            }
+
+            _cmsFreeInterpParams(pGeneric);
+            _cmsFreeInterpParams(p);
+            free(Table);
+        }
+    }
+
+    return rc;
+}
+
+// Interpolator conformance. Every default interpolator is instantiated on random grids of random sizes and
+// checked against a double precision evaluation of the same scheme: linear, bilinear, trilinear or tetrahedral,
+// and for more than 3 inputs, linear interpolation along the first input between lower dimensional results.
+
+#define INTERP_TRIALS       3
+#define INTERP_POINTS       200
+#define INTERP_MAX_TABLE    (1 << 18)
+
+// Random tables are steep, so the 16 bits position rounding alone is worth about one unit. On top of that,
+// fixed point rounding happens once per linear step, and deeper LUTs accumulate some more.
+#define INTERP_MAX_ERR16(n) (1.5 + 0.25 * (n))
+
+static cmsUInt32Number TestSeed;
+
+static
+cmsUInt32Number TestRandom(cmsUInt32Number Range)
+{
+    TestSeed = TestSeed * 1103515245U + 12345U;
+    return (TestSeed >> 8) % Range;
+}
+
+// Evaluates dimensions d to nInputs-1 in double precision, with Pos[] already scaled to the grid
+static
+void InterpReference(const cmsFloat64Number* Table, const cmsUInt32Number nSamples[], const cmsUInt32Number opta[],
+                     cmsUInt32Number nInputs, cmsUInt32Number nOutputs, cmsBool IsTrilinear,
+                     const cmsFloat64Number Pos[], cmsUInt32Number d, cmsFloat64Number Out[])
+{
+    cmsUInt32Number k0[MAX_INPUT_DIMENSIONS], k1[MAX_INPUT_DIMENSIONS], Order[MAX_INPUT_DIMENSIONS];
+    cmsFloat64Number r[MAX_INPUT_DIMENSIONS];
+    cmsFloat64Number Tmp1[MAX_STAGE_CHANNELS], Tmp2[MAX_STAGE_CHANNELS];
+    cmsUInt32Number i, j, n = nInputs - d, Corner, Offset;
+
+    for (i=0; i < n; i++) {
+
+        cmsFloat64Number x = Pos[d+i];
+        cmsUInt32Number  Stride = opta[nInputs - 1 - (d+i)];
+
+        k0[i] = (cmsUInt32Number) floor(x);
+        if (k0[i] >= nSamples[d+i] - 1) k0[i] = nSamples[d+i] - 1;
+        r[i]  = x - k0[i];
+        k1[i] = (r[i] > 0 ? k0[i] + 1 : k0[i]) * Stride;
+        k0[i] *= Stride;
+    }
+
+    // More than 3 inputs: linear between the two lower dimensional results
+    if (n > 3) {
+
+        InterpReference(Table + k0[0], nSamples, opta, nInputs, nOutputs, IsTrilinear, Pos, d+1, Tmp1);
+        InterpReference(Table + k1[0], nSamples, opta, nInputs, nOutputs, IsTrilinear, Pos, d+1, Tmp2);
+
+        for (i=0; i < nOutputs; i++)
+            Out[i] = Tmp1[i] + (Tmp2[i] - Tmp1[i]) * r[0];
+        return;
+    }
+
+    // Tetrahedral walks the simplex from the origin along the axes, largest fraction first
+    if (n == 3 && !IsTrilinear) {
+
+        for (i=0; i < 3; i++) Order[i] = i;
+        for (i=0; i < 3; i++)
+            for (j=i+1; j < 3; j++)
+                if (r[Order[j]] > r[Order[i]]) { cmsUInt32Number t = Order[i]; Order[i] = Order[j]; Order[j] = t; }
+
+        for (i=0; i < nOutputs; i++) {
+
+            cmsUInt32Number Idx[3];
+            cmsFloat64Number Prev, Next;
+
+            Idx[0] = k0[0]; Idx[1] = k0[1]; Idx[2] = k0[2];
+            Prev = Out[i] = Table[Idx[0] + Idx[1] + Idx[2] + i];
+
+            for (j=0; j < 3; j++) {
+
+                Idx[Order[j]] = (Order[j] == 0 ? k1[0] : Order[j] == 1 ? k1[1] : k1[2]);
+                Next = Table[Idx[0] + Idx[1] + Idx[2] + i];
+                Out[i] += r[Order[j]] * (Next - Prev);
+                Prev = Next;
+            }
+        }
+        return;
+    }
+
+    // Linear, bilinear and trilinear are the multilinear blend of the cell corners
+    for (i=0; i < nOutputs; i++) Out[i] = 0;
+
+    for (Corner = 0; Corner < (1U << n); Corner++) {
+
+        cmsFloat64Number w = 1;
+
+        Offset = 0;
+        for (j=0; j < n; j++) {
+
+            if (Corner & (1U << j)) { w *= r[j];     Offset += k1[j]; }
+            else                    { w *= 1 - r[j]; Offset += k0[j]; }
+        }
+
+        for (i=0; i < nOutputs; i++)
+            Out[i] += w * Table[Offset + i];
+    }
+}
+
+// Checks one interpolator on one grid. Returns the max error in output units, or -1 if it cannot be instantiated.
+static
+cmsFloat64Number CheckOneInterpolator(const cmsUInt32Number nSamples[], cmsUInt32Number nInputs, cmsUInt32Number nOutputs, cmsUInt32Number dwFlags)
+{
+    cmsBool IsFloat = (dwFlags & CMS_LERP_FLAGS_FLOAT) != 0;
+    cmsUInt32Number opta[MAX_INPUT_DIMENSIONS];
+    cmsUInt32Number i, j, nEntries, Point;
+    cmsFloat64Number* Ref;
+    void* Table;
+    cmsInterpParams* p;
+    cmsFloat64Number Pos[MAX_INPUT_DIMENSIONS], Expected[MAX_STAGE_CHANNELS], Err, MaxE = 0;
+    cmsUInt16Number  In16[MAX_INPUT_DIMENSIONS], Out16[MAX_STAGE_CHANNELS];
+    cmsFloat32Number InF[MAX_INPUT_DIMENSIONS],  OutF[MAX_STAGE_CHANNELS];
+
+    nEntries = nOutputs;
+    opta[0]  = nOutputs;
+    for (i=0; i < nInputs; i++) {
+        nEntries *= nSamples[i];
+        if (i > 0) opta[i] = opta[i-1] * nSamples[nInputs-i];
+    }
+
+    Ref   = (cmsFloat64Number*) malloc(nEntries * sizeof(cmsFloat64Number));
+    Table = malloc(nEntries * (IsFloat ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number)));
+    if (Ref == NULL || Table == NULL) { free(Ref); free(Table); return -1; }
+
+    for (i=0; i < nEntries; i++) {
+
+        if (IsFloat) {
+            ((cmsFloat32Number*) Table)[i] = (cmsFloat32Number) TestRandom(65536) / 65535.0F;
+            Ref[i] = ((cmsFloat32Number*) Table)[i];
+        }
+        else {
+            ((cmsUInt16Number*) Table)[i] = (cmsUInt16Number) TestRandom(65536);
+            Ref[i] = ((cmsUInt16Number*) Table)[i];
+        }
+    }
+
+    p = _cmsComputeInterpParamsEx(DbgThread(), nSamples, nInputs, nOutputs, Table, dwFlags);
+    if (p == NULL) { free(Ref); free(Table); return -1; }
+
+    for (Point = 0; Point < INTERP_POINTS; Point++) {
+
+        // Mostly anywhere, but hit the domain ends and the grid nodes as well
+        for (j=0; j < nInputs; j++) {
+
+            cmsUInt32Number Kind = TestRandom(8);
+            cmsUInt32Number v;
+
+            if (Kind == 0)      v = 0;
+            else if (Kind == 1) v = 0xFFFF;
+            else if (Kind == 2) v = _cmsQuickSaturateWord(TestRandom(nSamples[j]) * 65535.0 / (nSamples[j] - 1));
+            else                v = TestRandom(65536);
+
+            In16[j] = (cmsUInt16Number) v;
+            InF[j]  = (cmsFloat32Number) v / 65535.0F;
+
+            // Float interpolators scale the input in single precision, and so does the reference
+            if (IsFloat) Pos[j] = (cmsFloat32Number) (InF[j] * (cmsFloat32Number) (nSamples[j] - 1));
+            else         Pos[j] = v * (nSamples[j] - 1) / 65535.0;
+        }
+
+        InterpReference(Ref, nSamples, opta, nInputs, nOutputs, (dwFlags & CMS_LERP_FLAGS_TRILINEAR) != 0, Pos, 0, Expected);
+
+        if (IsFloat) p ->Interpolation.LerpFloat(InF, OutF, p);
+        else         p ->Interpolation.Lerp16(In16, Out16, p);
+
+        for (j=0; j < nOutputs; j++) {
+
+            Err = fabs(Expected[j] - (IsFloat ? (cmsFloat64Number) OutF[j] : (cmsFloat64Number) Out16[j]));
+            if (Err > MaxE) MaxE = Err;
+        }
+    }
+
+    _cmsFreeInterpParams(p);
+    free(Ref);
+    free(Table);
+    return MaxE;
+}
+
+// Fills a random grid of nInputs dimensions whose table stays below INTERP_MAX_TABLE entries
+static
+void RandomGrid(cmsUInt32Number nSamples[], cmsUInt32Number nInputs, cmsUInt32Number nOutputs)
+{
+    cmsUInt32Number i, MaxSamples;
+
+    MaxSamples = (cmsUInt32Number) floor(pow((cmsFloat64Number) INTERP_MAX_TABLE / nOutputs, 1.0 / nInputs));
+    if (MaxSamples > 4096) MaxSamples = 4096;
+    if (MaxSamples < 2) MaxSamples = 2;
+
+    for (i=0; i < nInputs; i++)
+        nSamples[i] = 2 + TestRandom(MaxSamples - 1);
+}
+
+static
+cmsInt32Number CheckInterpolatorConformance(void)
+{
+    const cmsFloat64Number MaxFloat = FLOAT_PRECISSION;
+    static const cmsUInt32Number Sizes[] = { 9, 17, 33, 65 };
+    static const cmsUInt32Number Outputs[] = { 1, 3, 4 };
+    static const cmsUInt32Number Modes[] = { CMS_LERP_FLAGS_16BITS, CMS_LERP_FLAGS_FLOAT,
+                                             CMS_LERP_FLAGS_TRILINEAR, CMS_LERP_FLAGS_FLOAT|CMS_LERP_FLAGS_TRILINEAR };
+    cmsUInt32Number nSamples[MAX_INPUT_DIMENSIONS];
+    cmsUInt32Number nInputs, nOutputs, Mode, Trial, i, j;
+    cmsFloat64Number Err, Worst16 = 0, WorstFloat = 0;
+
+    TestSeed = 1;
+
+    for (nInputs = 1; nInputs <= MAX_INPUT_DIMENSIONS; nInputs++) {
+        for (nOutputs = 1; nOutputs <= cmsMAXCHANNELS + 1; nOutputs++) {
+
+            // The last round goes for the largest output count a stage can have
+            cmsUInt32Number nOut = (nOutputs > cmsMAXCHANNELS) ? MAX_STAGE_CHANNELS - 1 : nOutputs;
+
+            for (Mode = 0; Mode < 4; Mode++) {
+
+                // Trilinear is only meaningful on 3 inputs
+                if ((Modes[Mode] & CMS_LERP_FLAGS_TRILINEAR) && nInputs != 3) continue;
+
+                for (Trial = 0; Trial < INTERP_TRIALS; Trial++) {
+
+                    RandomGrid(nSamples, nInputs, nOut);
+
+                    Err = CheckOneInterpolator(nSamples, nInputs, nOut, Modes[Mode]);
+                    if (Err < 0) {
+                        Fail("Cannot instantiate %d -> %d interpolator", nInputs, nOut);
+                        return 0;
+                    }
+
+                    if (Modes[Mode] & CMS_LERP_FLAGS_FLOAT) {
+                        if (Err > WorstFloat) WorstFloat = Err;
+                        if (Err > MaxFloat) {
+                            Fail("%d -> %d float interpolation off by %g", nInputs, nOut, Err);
+                            return 0;
+                        }
+                    }
+                    else {
+                        if (Err > Worst16) Worst16 = Err;
+                        if (Err > INTERP_MAX_ERR16(nInputs)) {
+                            Fail("%d -> %d 16 bits interpolation off by %g", nInputs, nOut, Err);
+                            return 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // The specialized tetrahedral kernels only get selected on equal grids of 2^n+1 nodes
+    for (i=0; i < sizeof(Sizes) / sizeof(Sizes[0]); i++) {
+        for (j=0; j < sizeof(Outputs) / sizeof(Outputs[0]); j++) {
+
+            nSamples[0] = nSamples[1] = nSamples[2] = Sizes[i];
+
+            Err = CheckOneInterpolator(nSamples, 3, Outputs[j], CMS_LERP_FLAGS_16BITS);
+            if (Err < 0 || Err > INTERP_MAX_ERR16(3)) {
+                Fail("%dx%dx%d -> %d tetrahedral kernel off by %g", Sizes[i], Sizes[i], Sizes[i], Outputs[j], Err);
+                return 0;
+            }
+            if (Err > Worst16) Worst16 = Err;
+        }
+    }
+
+    printf("|Err16|<%g |ErrFloat|<%g ", Worst16, WorstFloat);
+    return 1;
+}
+
 // Check reverse interpolation on LUTS. This is right now exclusively used by K preservation algorithm
 static
 cmsInt32Number CheckReverseInterpolation3x3(void)
@@ -1914,135 +2248,473 @@ cmsInt32Number Check3DinterpGranular(void)
 }
 
 
+// Smooth on most of the space, but steep near the dark end of first channel
 static
-cmsInt32Number Check4Dinterp(void)
+cmsInt32Number SamplerSteep3D(register const cmsUInt16Number In[],
+               register cmsUInt16Number Out[],
+               register void * Cargo)
 {
-    cmsPipeline* lut;
-    cmsStage* mpe;
-
-    lut = cmsPipelineAlloc(DbgThread(), 4, 3);
-    mpe = cmsStageAllocCLut16bit(DbgThread(), 9, 4, 3, NULL);
-    cmsStageSampleCLut16bit(mpe, Sampler4D, NULL, 0);
-    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
-
-    // Check accuracy
-
-    if (!CheckOne4D(lut, 0, 0, 0, 0)) return 0;
-    if (!CheckOne4D(lut, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
-
-    if (!CheckOne4D(lut, 0x8080, 0x8080, 0x8080, 0x8080)) return 0;
-    if (!CheckOne4D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888)) return 0;
-    if (!CheckOne4D(lut, 0x1111, 0x2222, 0x3333, 0x4444)) return 0;
-    if (!CheckOne4D(lut, 0x0000, 0x0012, 0x0013, 0x0014)) return 0; 
-    if (!CheckOne4D(lut, 0x3141, 0x1415, 0x1592, 0x9261)) return 0; 
-    if (!CheckOne4D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13)) return 0; 
-
-    cmsPipelineFree(lut);
+    Out[0] = _cmsQuickSaturateWord(65535.0 * sqrt(In[0] / 65535.0));
+    Out[1] = Fn8D2(In[0], In[1], In[2], 0, 0, 0, 0, 0, 3);
+    Out[2] = Fn8D3(In[0], In[1], In[2], 0, 0, 0, 0, 0, 3);
 
     return 1;
-}
-
 
+    cmsUNUSED_PARAMETER(Cargo);
+}
 
 static
-cmsInt32Number Check4DinterpGranular(void)
+cmsInt32Number CheckAdaptive3Dinterp(void)
 {
-    cmsPipeline* lut;
-    cmsStage* mpe;
-    cmsUInt32Number Dimensions[] = { 9, 8, 7, 6 };
+    cmsStage *Adaptive, *Dup, *Dense;
+    _cmsStageAdaptiveCLutData* Data;
+    cmsUInt16Number In[3], Out1[3], Out2[3], Out3[3];
+    cmsInt32Number i, j, Diff, MaxDiff = 0;
+    cmsUInt32Number Entries;
 
-    lut = cmsPipelineAlloc(DbgThread(), 4, 3);
-    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 4, 3, NULL);
-    cmsStageSampleCLut16bit(mpe, Sampler4D, NULL, 0);
-    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+    Adaptive = cmsStageAllocCLutAdaptive16bit(DbgThread(), 9, 4, 3, 3, 256, SamplerSteep3D, NULL);
+    Dense = cmsStageAllocCLut16bit(DbgThread(), 33, 3, 3, NULL);
+    cmsStageSampleCLut16bit(Dense, SamplerSteep3D, NULL, 0);
+    if (Adaptive == NULL || Dense == NULL) return 0;
 
-    // Check accuracy
+    Dup = cmsStageDup(Adaptive);
+    if (Dup == NULL) return 0;
 
-    if (!CheckOne4D(lut, 0, 0, 0, 0)) return 0;
-    if (!CheckOne4D(lut, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+    // Only the shadows of the first channel should need refinement
+    Data = (_cmsStageAdaptiveCLutData*) cmsStageData(Adaptive);
+    Entries = Data ->nCoarseEntries + Data ->nRefined * Data ->BlockSize;
 
-    if (!CheckOne4D(lut, 0x8080, 0x8080, 0x8080, 0x8080)) return 0;
-    if (!CheckOne4D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888)) return 0;
-    if (!CheckOne4D(lut, 0x1111, 0x2222, 0x3333, 0x4444)) return 0;
-    if (!CheckOne4D(lut, 0x0000, 0x0012, 0x0013, 0x0014)) return 0; 
-    if (!CheckOne4D(lut, 0x3141, 0x1415, 0x1592, 0x9261)) return 0; 
-    if (!CheckOne4D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13)) return 0; 
+    if (Data ->nRefined == 0 || Data ->nRefined >= 8*8*8 / 2) {
+        Fail("%d cells refined", Data ->nRefined);
+        return 0;
+    }
 
-    cmsPipelineFree(lut);
+    if (Entries * 2 > 33*33*33*3) {
+        Fail("Adaptive table too big (%d entries)", Entries);
+        return 0;
+    }
 
-    return 1;
-}
+    for (i=0; i < 2000; i++) {
 
+        for (j=0; j < 3; j++) 
+            In[j] = (cmsUInt16Number) ((i * 7919 * (j + 1) + j * 0x3333) & 0xFFFF);
 
-static
-cmsInt32Number Check5DinterpGranular(void)
-{
-    cmsPipeline* lut;
-    cmsStage* mpe;
-    cmsUInt32Number Dimensions[] = { 3, 2, 2, 2, 2 };
+        // Keep some of them on the edges
+        if (i % 100 == 0) In[i % 3] = 0xFFFF;
 
-    lut = cmsPipelineAlloc(DbgThread(), 5, 3);
-    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 5, 3, NULL);
-    cmsStageSampleCLut16bit(mpe, Sampler5D, NULL, 0);
-    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+        _cmsEvalAdaptiveCLut16(In, Out1, cmsStageData(Adaptive));
+        _cmsEvalAdaptiveCLut16(In, Out2, cmsStageData(Dup));
+        ((_cmsStageCLutData*) cmsStageData(Dense)) ->Params ->Interpolation.Lerp16(In, Out3, ((_cmsStageCLutData*) cmsStageData(Dense)) ->Params);
 
-    // Check accuracy
+        for (j=0; j < 3; j++) {
 
-    if (!CheckOne5D(lut, 0, 0, 0, 0, 0)) return 0;
-    if (!CheckOne5D(lut, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+            if (Out1[j] != Out2[j]) {
+                Fail("Duplicated adaptive CLUT differs");
+                return 0;
+            }
 
-    if (!CheckOne5D(lut, 0x8080, 0x8080, 0x8080, 0x8080, 0x1234)) return 0;
-    if (!CheckOne5D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888, 0x8078)) return 0;
-    if (!CheckOne5D(lut, 0x1111, 0x2222, 0x3333, 0x4444, 0x1455)) return 0;
-    if (!CheckOne5D(lut, 0x0000, 0x0012, 0x0013, 0x0014, 0x2333)) return 0; 
-    if (!CheckOne5D(lut, 0x3141, 0x1415, 0x1592, 0x9261, 0x4567)) return 0; 
-    if (!CheckOne5D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13, 0xF344)) return 0; 
+            Diff = abs((int) Out1[j] - (int) Out3[j]);
+            if (Diff > MaxDiff) MaxDiff = Diff;
+        }
+    }
 
-    cmsPipelineFree(lut);
+    cmsStageFree(Adaptive);
+    cmsStageFree(Dup);
+    cmsStageFree(Dense);
+
+    // Same accuracy as the dense table, within tolerance
+    if (MaxDiff > 2 * 256) {
+        Fail("Adaptive CLUT deviates %d from dense", MaxDiff);
+        return 0;
+    }
 
     return 1;
 }
 
+// Optimizer should build an adaptive CLUT when asked, and stay close to the unoptimized transform
 static
-cmsInt32Number Check6DinterpGranular(void)
+cmsInt32Number CheckAdaptiveCLUTOptimization(void)
 {
-    cmsPipeline* lut;
-    cmsStage* mpe;
-    cmsUInt32Number Dimensions[] = { 4, 3, 3, 2, 2, 2 };
+    cmsHPROFILE hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+    cmsHPROFILE hLab  = cmsCreateLab4ProfileTHR(DbgThread(), NULL);
+    cmsHTRANSFORM xformRef, xformAdaptive;
+    cmsPipeline* Lut;
+    cmsUInt16Number In[3], Out1[3], Out2[3];
+    cmsInt32Number i, j, Diff, MaxDiff = 0;
+    cmsBool IsAdaptive;
 
-    lut = cmsPipelineAlloc(DbgThread(), 6, 3);
-    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 6, 3, NULL);
-    cmsStageSampleCLut16bit(mpe, Sampler6D, NULL, 0);
-    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+    xformRef      = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hLab, TYPE_Lab_16, INTENT_PERCEPTUAL, cmsFLAGS_NOOPTIMIZE);
+    xformAdaptive = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hLab, TYPE_Lab_16, INTENT_PERCEPTUAL, cmsFLAGS_FORCE_CLUT|cmsFLAGS_ADAPTIVE_CLUT);
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hLab);
 
-    // Check accuracy
+    Lut = ((_cmsTRANSFORM*) xformAdaptive) ->Lut;
+    IsAdaptive = cmsStageType(cmsPipelineGetPtrToFirstStage(Lut)) == cmsSigAdaptiveCLutElemType;
 
-    if (!CheckOne6D(lut, 0, 0, 0, 0, 0, 0)) return 0;
-    if (!CheckOne6D(lut, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+    for (i=0; i < 2000; i++) {
 
-    if (!CheckOne6D(lut, 0x8080, 0x8080, 0x8080, 0x8080, 0x1234, 0x1122)) return 0;
-    if (!CheckOne6D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888, 0x8078, 0x2233)) return 0;
-    if (!CheckOne6D(lut, 0x1111, 0x2222, 0x3333, 0x4444, 0x1455, 0x3344)) return 0;
-    if (!CheckOne6D(lut, 0x0000, 0x0012, 0x0013, 0x0014, 0x2333, 0x4455)) return 0; 
-    if (!CheckOne6D(lut, 0x3141, 0x1415, 0x1592, 0x9261, 0x4567, 0x5566)) return 0; 
-    if (!CheckOne6D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13, 0xF344, 0x6677)) return 0; 
+        for (j=0; j < 3; j++) 
+            In[j] = (cmsUInt16Number) ((i * 7919 * (j + 1) + j * 0x3333) & 0xFFFF);
 
-    cmsPipelineFree(lut);
+        cmsDoTransform(xformRef, In, Out1, 1);
+        cmsDoTransform(xformAdaptive, In, Out2, 1);
+
+        for (j=0; j < 3; j++) {
+
+            Diff = abs((int) Out1[j] - (int) Out2[j]);
+            if (Diff > MaxDiff) MaxDiff = Diff;
+        }
+    }
+
+    cmsDeleteTransform(xformRef);
+    cmsDeleteTransform(xformAdaptive);
+
+    if (!IsAdaptive) {
+        Fail("Adaptive CLUT was not used");
+        return 0;
+    }
+
+    if (MaxDiff > 2 * cmsSetAdaptiveCLutTolerance(-1)) {
+        Fail("Adaptive optimization deviates %d", MaxDiff);
+        return 0;
+    }
 
     return 1;
 }
 
+// A device link holding a CLUT between two RGB spaces that share the sRGB transfer curve should be 
+// replaced by a fitted matrix-shaper, once a fitting tolerance is set
 static
-cmsInt32Number Check7DinterpGranular(void)
+cmsInt32Number CheckMatrixShaperFitting(void)
 {
-    cmsPipeline* lut;
+    cmsCIExyYTRIPLE Primaries = {{0.64, 0.33, 1}, {0.21, 0.71, 1}, {0.15, 0.06, 1}};
+    cmsFloat64Number Params[5] = { 2.4, 1. / 1.055, 0.055 / 1.055, 1. / 12.92, 0.04045 };
+    cmsCIExyY D65;
+    cmsToneCurve* Curve[3];
+    cmsHPROFILE hsRGB, hWide, hLink;
+    cmsHTRANSFORM xform, xformRef, xformFit;
     cmsStage* mpe;
-    cmsUInt32Number Dimensions[] = { 4, 3, 3, 2, 2, 2, 2 };
+    cmsUInt16Number In[3], Out1[3], Out2[3];
+    cmsInt32Number i, j, Diff, MaxDiff = 0;
+    cmsBool HasCLUT = FALSE;
+    cmsFloat64Number OldTolerance;
 
-    lut = cmsPipelineAlloc(DbgThread(), 7, 3);
-    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 7, 3, NULL);
-    cmsStageSampleCLut16bit(mpe, Sampler7D, NULL, 0);
-    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+    cmsWhitePointFromTemp(&D65, 6504);
+    Curve[0] = Curve[1] = Curve[2] = cmsBuildParametricToneCurve(DbgThread(), 4, Params);
+    hWide = cmsCreateRGBProfileTHR(DbgThread(), &D65, &Primaries, Curve);
+    cmsFreeToneCurve(Curve[0]);
+
+    hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+
+    xform = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hWide, TYPE_RGB_16, INTENT_PERCEPTUAL, cmsFLAGS_FORCE_CLUT);
+    hLink = cmsTransform2DeviceLink(xform, 3.4, 0);
+    cmsDeleteTransform(xform);
+
+    // Off by default, the link keeps its CLUT
+    xformFit = cmsCreateTransformTHR(DbgThread(), hLink, TYPE_RGB_16, NULL, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
+    for (mpe = cmsPipelineGetPtrToFirstStage(((_cmsTRANSFORM*) xformFit) ->Lut); mpe != NULL; mpe = cmsStageNext(mpe))
+        if (cmsStageType(mpe) == cmsSigCLutElemType) HasCLUT = TRUE;
+    cmsDeleteTransform(xformFit);
+
+    if (!HasCLUT) {
+        cmsCloseProfile(hsRGB); cmsCloseProfile(hWide); cmsCloseProfile(hLink);
+        Fail("Matrix-shaper fitting is on by default");
+        return 0;
+    }
+
+    OldTolerance = cmsSetMatrixShaperFitTolerance(0.5);
+
+    xformRef = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hWide, TYPE_RGB_16, INTENT_PERCEPTUAL, cmsFLAGS_NOOPTIMIZE);
+    xformFit = cmsCreateTransformTHR(DbgThread(), hLink, TYPE_RGB_16, NULL, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hWide); cmsCloseProfile(hLink);
+
+    HasCLUT = FALSE;
+    for (mpe = cmsPipelineGetPtrToFirstStage(((_cmsTRANSFORM*) xformFit) ->Lut); mpe != NULL; mpe = cmsStageNext(mpe))
+        if (cmsStageType(mpe) == cmsSigCLutElemType) HasCLUT = TRUE;
+
+    for (i=0; i < 2000; i++) {
+
+        for (j=0; j < 3; j++) 
+            In[j] = (cmsUInt16Number) ((i * 7919 * (j + 1) + j * 0x3333) & 0xFFFF);
+
+        cmsDoTransform(xformRef, In, Out1, 1);
+        cmsDoTransform(xformFit, In, Out2, 1);
+
+        for (j=0; j < 3; j++) {
+
+            Diff = abs((int) Out1[j] - (int) Out2[j]);
+            if (Diff > MaxDiff) MaxDiff = Diff;
+        }
+    }
+
+    cmsDeleteTransform(xformRef);
+    cmsDeleteTransform(xformFit);
+    cmsSetMatrixShaperFitTolerance(OldTolerance);
+
+    if (HasCLUT) {
+        Fail("Matrix-shaper fitting was not used");
+        return 0;
+    }
+
+    if (MaxDiff > 655.35 * 0.5) {
+        Fail("Matrix-shaper fitting deviates %d", MaxDiff);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Integer transforms should give bit-identical results on every CPU level
+#define NPIXELS_LEVEL_CHECK 1024
+
+static
+cmsInt32Number CheckCPUFeatureLevels(void)
+{
+    cmsHPROFILE hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+    cmsHPROFILE hLab  = cmsCreateLab4ProfileTHR(DbgThread(), NULL);
+    cmsHPROFILE hAbove = Create_AboveRGB();
+    cmsUInt16Number In16[NPIXELS_LEVEL_CHECK * 3], Ref16[NPIXELS_LEVEL_CHECK * 3], Out16[NPIXELS_LEVEL_CHECK * 3];
+    cmsUInt8Number  In8[NPIXELS_LEVEL_CHECK * 3], Ref8[NPIXELS_LEVEL_CHECK * 3], Out8[NPIXELS_LEVEL_CHECK * 3];
+    cmsHTRANSFORM xform16, xform8;
+    cmsInt32Number i, Level, OldLevel, MaxLevel, rc = 1;
+
+    for (i=0; i < NPIXELS_LEVEL_CHECK * 3; i++) {
+
+        In16[i] = (cmsUInt16Number) ((i * 7919 + (i % 3) * 0x3333) & 0xFFFF);
+        In8[i]  = (cmsUInt8Number) (In16[i] >> 8);
+    }
+
+    OldLevel = cmsSetCPUFeatureLevel(-1);
+    MaxLevel = cmsDetectCPUFeatureLevel();
+
+    for (Level = cmsCPU_GENERIC; Level <= MaxLevel; Level++) {
+
+        cmsSetCPUFeatureLevel(Level);
+
+        xform16 = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hLab, TYPE_Lab_16, INTENT_PERCEPTUAL, 0);
+        xform8  = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_8, hAbove, TYPE_RGB_8, INTENT_PERCEPTUAL, cmsFLAGS_FORCE_CLUT);
+
+        cmsDoTransform(xform16, In16, Level == cmsCPU_GENERIC ? Ref16 : Out16, NPIXELS_LEVEL_CHECK);
+        cmsDoTransform(xform8,  In8,  Level == cmsCPU_GENERIC ? Ref8  : Out8,  NPIXELS_LEVEL_CHECK);
+
+        cmsDeleteTransform(xform16);
+        cmsDeleteTransform(xform8);
+
+        if (Level != cmsCPU_GENERIC && 
+            (memcmp(Ref16, Out16, sizeof(Ref16)) != 0 || memcmp(Ref8, Out8, sizeof(Ref8)) != 0)) {
+
+                Fail("CPU level %d gives different results", Level);
+                rc = 0;
+        }
+    }
+
+    cmsSetCPUFeatureLevel(OldLevel);
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hLab); cmsCloseProfile(hAbove);
+    return rc;
+}
+
+// Same for the specialized tetrahedral kernels alone. Tables jump between 0 and 0xFFFF, so the arithmetic wraps
+static
+cmsInt32Number CheckCPUFeatureLevelsCLUT(void)
+{
+    static const cmsUInt32Number Grids[] = { 9, 17, 33, 65 };
+    static const cmsUInt32Number Outputs[] = { 1, 3, 4 };
+    cmsUInt16Number* Table;
+    cmsUInt16Number In[3], Ref[4], Out[4];
+    cmsStage *mpeRef, *mpe;
+    _cmsStageCLutData *Ref16, *Lut16;
+    cmsUInt32Number g, o, i, k, nEntries, Seed;
+    cmsInt32Number Level, OldLevel, MaxLevel, rc = 1;
+
+    OldLevel = cmsSetCPUFeatureLevel(-1);
+    MaxLevel = cmsDetectCPUFeatureLevel();
+
+    for (g=0; g < sizeof(Grids) / sizeof(Grids[0]); g++) {
+        for (o=0; o < sizeof(Outputs) / sizeof(Outputs[0]); o++) {
+
+            nEntries = Grids[g] * Grids[g] * Grids[g] * Outputs[o];
+            Table = (cmsUInt16Number*) malloc(nEntries * sizeof(cmsUInt16Number));
+
+            Seed = 1;
+            for (i=0; i < nEntries; i++) {
+                Seed = Seed * 1103515245 + 12345;
+                Table[i] = (Seed & 0x10000) ? 0xFFFF : (cmsUInt16Number) (Seed >> 16) & 0x00FF;
+            }
+
+            cmsSetCPUFeatureLevel(cmsCPU_GENERIC);
+            mpeRef = cmsStageAllocCLut16bit(DbgThread(), Grids[g], 3, Outputs[o], Table);
+            Ref16  = (_cmsStageCLutData*) cmsStageData(mpeRef);
+
+            for (Level = cmsCPU_SSE2; Level <= MaxLevel; Level++) {
+
+                cmsSetCPUFeatureLevel(Level);
+                mpe   = cmsStageAllocCLut16bit(DbgThread(), Grids[g], 3, Outputs[o], Table);
+                Lut16 = (_cmsStageCLutData*) cmsStageData(mpe);
+
+#if !defined(CMS_DONT_USE_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+                // There are SSE2 kernels for 3 and 4 outputs
+                if (Outputs[o] > 1 && Lut16 ->Params ->Interpolation.Lerp16 == Ref16 ->Params ->Interpolation.Lerp16) {
+                    Fail("No SSE2 kernel on %dx%d grid at CPU level %d", Grids[g], Outputs[o], Level);
+                    rc = 0;
+                }
+#endif
+                for (i=0; i < 0x10000; i++) {
+
+                    for (k=0; k < 3; k++) {
+                        Seed = Seed * 1103515245 + 12345;
+                        In[k] = (i & (8 << k)) ? 0xFFFF : (cmsUInt16Number) (Seed >> 15);
+                    }
+
+                    Ref16 ->Params ->Interpolation.Lerp16(In, Ref, Ref16 ->Params);
+                    Lut16 ->Params ->Interpolation.Lerp16(In, Out, Lut16 ->Params);
+
+                    if (memcmp(Ref, Out, Outputs[o] * sizeof(cmsUInt16Number)) != 0) {
+                        Fail("%dx%d grid differs at CPU level %d", Grids[g], Outputs[o], Level);
+                        rc = 0;
+                        break;
+                    }
+                }
+
+                cmsStageFree(mpe);
+            }
+
+            cmsStageFree(mpeRef);
+            free(Table);
+        }
+    }
+
+    cmsSetCPUFeatureLevel(OldLevel);
+    return rc;
+}
+
+static
+cmsInt32Number Check4Dinterp(void)
+{
+    cmsPipeline* lut;
+    cmsStage* mpe;
+
+    lut = cmsPipelineAlloc(DbgThread(), 4, 3);
+    mpe = cmsStageAllocCLut16bit(DbgThread(), 9, 4, 3, NULL);
+    cmsStageSampleCLut16bit(mpe, Sampler4D, NULL, 0);
+    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+
+    // Check accuracy
+
+    if (!CheckOne4D(lut, 0, 0, 0, 0)) return 0;
+    if (!CheckOne4D(lut, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+
+    if (!CheckOne4D(lut, 0x8080, 0x8080, 0x8080, 0x8080)) return 0;
+    if (!CheckOne4D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888)) return 0;
+    if (!CheckOne4D(lut, 0x1111, 0x2222, 0x3333, 0x4444)) return 0;
+    if (!CheckOne4D(lut, 0x0000, 0x0012, 0x0013, 0x0014)) return 0; 
+    if (!CheckOne4D(lut, 0x3141, 0x1415, 0x1592, 0x9261)) return 0; 
+    if (!CheckOne4D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13)) return 0; 
+
+    cmsPipelineFree(lut);
+
+    return 1;
+}
+
+
+
+static
+cmsInt32Number Check4DinterpGranular(void)
+{
+    cmsPipeline* lut;
+    cmsStage* mpe;
+    cmsUInt32Number Dimensions[] = { 9, 8, 7, 6 };
+
+    lut = cmsPipelineAlloc(DbgThread(), 4, 3);
+    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 4, 3, NULL);
+    cmsStageSampleCLut16bit(mpe, Sampler4D, NULL, 0);
+    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+
+    // Check accuracy
+
+    if (!CheckOne4D(lut, 0, 0, 0, 0)) return 0;
+    if (!CheckOne4D(lut, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+
+    if (!CheckOne4D(lut, 0x8080, 0x8080, 0x8080, 0x8080)) return 0;
+    if (!CheckOne4D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888)) return 0;
+    if (!CheckOne4D(lut, 0x1111, 0x2222, 0x3333, 0x4444)) return 0;
+    if (!CheckOne4D(lut, 0x0000, 0x0012, 0x0013, 0x0014)) return 0; 
+    if (!CheckOne4D(lut, 0x3141, 0x1415, 0x1592, 0x9261)) return 0; 
+    if (!CheckOne4D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13)) return 0; 
+
+    cmsPipelineFree(lut);
+
+    return 1;
+}
+
+
+static
+cmsInt32Number Check5DinterpGranular(void)
+{
+    cmsPipeline* lut;
+    cmsStage* mpe;
+    cmsUInt32Number Dimensions[] = { 3, 2, 2, 2, 2 };
+
+    lut = cmsPipelineAlloc(DbgThread(), 5, 3);
+    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 5, 3, NULL);
+    cmsStageSampleCLut16bit(mpe, Sampler5D, NULL, 0);
+    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+
+    // Check accuracy
+
+    if (!CheckOne5D(lut, 0, 0, 0, 0, 0)) return 0;
+    if (!CheckOne5D(lut, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+
+    if (!CheckOne5D(lut, 0x8080, 0x8080, 0x8080, 0x8080, 0x1234)) return 0;
+    if (!CheckOne5D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888, 0x8078)) return 0;
+    if (!CheckOne5D(lut, 0x1111, 0x2222, 0x3333, 0x4444, 0x1455)) return 0;
+    if (!CheckOne5D(lut, 0x0000, 0x0012, 0x0013, 0x0014, 0x2333)) return 0; 
+    if (!CheckOne5D(lut, 0x3141, 0x1415, 0x1592, 0x9261, 0x4567)) return 0; 
+    if (!CheckOne5D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13, 0xF344)) return 0; 
+
+    cmsPipelineFree(lut);
+
+    return 1;
+}
+
+static
+cmsInt32Number Check6DinterpGranular(void)
+{
+    cmsPipeline* lut;
+    cmsStage* mpe;
+    cmsUInt32Number Dimensions[] = { 4, 3, 3, 2, 2, 2 };
+
+    lut = cmsPipelineAlloc(DbgThread(), 6, 3);
+    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 6, 3, NULL);
+    cmsStageSampleCLut16bit(mpe, Sampler6D, NULL, 0);
+    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
+
+    // Check accuracy
+
+    if (!CheckOne6D(lut, 0, 0, 0, 0, 0, 0)) return 0;
+    if (!CheckOne6D(lut, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0xffff)) return 0; 
+
+    if (!CheckOne6D(lut, 0x8080, 0x8080, 0x8080, 0x8080, 0x1234, 0x1122)) return 0;
+    if (!CheckOne6D(lut, 0x0000, 0xFE00, 0x80FF, 0x8888, 0x8078, 0x2233)) return 0;
+    if (!CheckOne6D(lut, 0x1111, 0x2222, 0x3333, 0x4444, 0x1455, 0x3344)) return 0;
+    if (!CheckOne6D(lut, 0x0000, 0x0012, 0x0013, 0x0014, 0x2333, 0x4455)) return 0; 
+    if (!CheckOne6D(lut, 0x3141, 0x1415, 0x1592, 0x9261, 0x4567, 0x5566)) return 0; 
+    if (!CheckOne6D(lut, 0xFF00, 0xFF01, 0xFF12, 0xFF13, 0xF344, 0x6677)) return 0; 
+
+    cmsPipelineFree(lut);
+
+    return 1;
+}
+
+static
+cmsInt32Number Check7DinterpGranular(void)
+{
+    cmsPipeline* lut;
+    cmsStage* mpe;
+    cmsUInt32Number Dimensions[] = { 4, 3, 3, 2, 2, 2, 2 };
+
+    lut = cmsPipelineAlloc(DbgThread(), 7, 3);
+    mpe = cmsStageAllocCLut16bitGranular(DbgThread(), Dimensions, 7, 3, NULL);
+    cmsStageSampleCLut16bit(mpe, Sampler7D, NULL, 0);
+    cmsPipelineInsertStage(lut, cmsAT_BEGIN, mpe);
 
     // Check accuracy
 
@@ -3987,62 +4659,532 @@ cmsInt32Number CheckFormattersFloat(void)
 }
 #undef C
 
-
-
+// Formatters must take the layout from their own side of the transform only
 static
-cmsInt32Number CheckOneRGB(cmsHTRANSFORM xform, cmsUInt16Number R, cmsUInt16Number G, cmsUInt16Number B, cmsUInt16Number Ro, cmsUInt16Number Go, cmsUInt16Number Bo)
+cmsInt32Number CheckPackWordsEndianness(void)
 {
-    cmsUInt16Number RGB[3];
-    cmsUInt16Number Out[3];
+    cmsUInt16Number Values[cmsMAXCHANNELS];
+    cmsUInt8Number Buffer[64];
+    cmsFormatter b;
+    _cmsTRANSFORM info;
 
-    RGB[0] = R;
-    RGB[1] = G;
-    RGB[2] = B;
+    memset(&info, 0, sizeof(info));
+    info.InputFormat  = TYPE_GRAYA_16;
+    info.OutputFormat = TYPE_GRAYA_16_SE;
 
-    cmsDoTransform(xform, RGB, Out, 1);
+    b = _cmsGetFormatter(info.OutputFormat, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
 
-    return IsGoodWord("R", Ro , Out[0]) &&
-           IsGoodWord("G", Go , Out[1]) &&
-           IsGoodWord("B", Bo , Out[2]);
+    memset(Buffer, 0, sizeof(Buffer));
+    Values[0] = 0x1234;
+    b.Fmt16(&info, Values, Buffer, 1);
+
+    return Buffer[0] == 0x12 && Buffer[1] == 0x34;
 }
 
-// Check known values going from sRGB to XYZ
+// Generic formatters must honour SWAPFIRST when an extra channel is present: A C M Y K
 static
-cmsInt32Number CheckOneRGB_double(cmsHTRANSFORM xform, cmsFloat64Number R, cmsFloat64Number G, cmsFloat64Number B, cmsFloat64Number Ro, cmsFloat64Number Go, cmsFloat64Number Bo)
+cmsInt32Number CheckSwapFirstExtraChannel(void)
 {
-    cmsFloat64Number RGB[3];
-    cmsFloat64Number Out[3];
-
-    RGB[0] = R;
-    RGB[1] = G;
-    RGB[2] = B;
+    cmsUInt32Number Fmt8  = COLORSPACE_SH(PT_CMYK)|CHANNELS_SH(4)|EXTRA_SH(1)|BYTES_SH(1)|SWAPFIRST_SH(1);
+    cmsUInt32Number Fmt16 = COLORSPACE_SH(PT_CMYK)|CHANNELS_SH(4)|EXTRA_SH(1)|BYTES_SH(2)|SWAPFIRST_SH(1);
+    cmsUInt8Number  In8[5]  = { 0xAA, 0x10, 0x20, 0x30, 0x40 };
+    cmsUInt16Number In16[5] = { 0xAAAA, 0x1010, 0x2020, 0x3030, 0x4040 };
+    cmsUInt8Number  Out8[5];
+    cmsUInt16Number Out16[5];
+    cmsUInt16Number Values[cmsMAXCHANNELS];
+    cmsFormatter b;
+    _cmsTRANSFORM info;
+    int i;
 
-    cmsDoTransform(xform, RGB, Out, 1);
+    memset(&info, 0, sizeof(info));
+    info.InputFormat = info.OutputFormat = Fmt8;
+
+    b = _cmsGetFormatter(Fmt8, cmsFormatterInput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    b.Fmt16(&info, Values, In8, 1);
+    for (i=0; i < 4; i++)
+        if (Values[i] != FROM_8_TO_16(In8[i+1])) return 0;
+
+    b = _cmsGetFormatter(Fmt8, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    memset(Out8, 0xAA, sizeof(Out8));
+    b.Fmt16(&info, Values, Out8, 1);
+    if (memcmp(Out8, In8, sizeof(In8)) != 0) return 0;
+
+    info.InputFormat = info.OutputFormat = Fmt16;
+
+    b = _cmsGetFormatter(Fmt16, cmsFormatterInput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    b.Fmt16(&info, Values, (cmsUInt8Number*) In16, 1);
+    for (i=0; i < 4; i++)
+        if (Values[i] != In16[i+1]) return 0;
+
+    b = _cmsGetFormatter(Fmt16, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    for (i=0; i < 5; i++) Out16[i] = 0xAAAA;
+    b.Fmt16(&info, Values, (cmsUInt8Number*) Out16, 1);
+    if (memcmp(Out16, In16, sizeof(In16)) != 0) return 0;
 
-    return IsGoodVal("R", Ro , Out[0], 0.01) &&
-           IsGoodVal("G", Go , Out[1], 0.01) &&
-           IsGoodVal("B", Bo , Out[2], 0.01);
+    return 1;
 }
 
-
+// TYPE_BGRA_16_SE must be TYPE_BGRA_16 with every sample byte-swapped
 static
-cmsInt32Number CheckChangeBufferFormat(void)
+cmsInt32Number CheckBGRA16SwappedEndian(void)
 {
-    cmsHPROFILE hsRGB = cmsCreate_sRGBProfile();
-    cmsHTRANSFORM xform;
-
+    cmsUInt16Number Values[cmsMAXCHANNELS];
+    cmsUInt8Number Native[8], Swapped[8];
+    cmsFormatter b;
+    _cmsTRANSFORM info;
+    int i;
 
-    xform = cmsCreateTransform(hsRGB, TYPE_RGB_16, hsRGB, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
-    cmsCloseProfile(hsRGB);
-    if (xform == NULL) return 0;
+    Values[0] = 0x1122; Values[1] = 0x3344; Values[2] = 0x5566;
+    memset(&info, 0, sizeof(info));
 
-    
-    if (!CheckOneRGB(xform, 0, 0, 0, 0, 0, 0)) return 0;
-    if (!CheckOneRGB(xform, 120, 0, 0, 120, 0, 0)) return 0;
-    if (!CheckOneRGB(xform, 0, 222, 255, 0, 222, 255)) return 0;
+    info.OutputFormat = TYPE_BGRA_16;
+    b = _cmsGetFormatter(info.OutputFormat, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    memset(Native, 0, sizeof(Native));
+    b.Fmt16(&info, Values, Native, 1);
 
+    info.OutputFormat = TYPE_BGRA_16_SE;
+    b = _cmsGetFormatter(info.OutputFormat, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (b.Fmt16 == NULL) return 0;
+    memset(Swapped, 0, sizeof(Swapped));
+    b.Fmt16(&info, Values, Swapped, 1);
 
-    if (!cmsChangeBuffersFormat(xform, TYPE_BGR_16, TYPE_RGB_16)) return 0;
+    for (i=0; i < 8; i += 2) {
+        if (Native[i] != Swapped[i+1] || Native[i+1] != Swapped[i]) return 0;
+    }
+
+    return 1;
+}
+
+// LabV2 encodings must not drift when unrolled to V4 and packed back
+static
+cmsInt32Number CheckLabV2RoundTrip(void)
+{
+    cmsUInt16Number Values[cmsMAXCHANNELS];
+    cmsUInt16Number In16[3], Out16[3];
+    cmsUInt8Number In8[3], Out8[3];
+    cmsFormatter Unroll, Pack;
+    _cmsTRANSFORM info;
+    cmsUInt32Number i;
+
+    memset(&info, 0, sizeof(info));
+    info.InputFormat = info.OutputFormat = TYPE_LabV2_16;
+
+    Unroll = _cmsGetFormatter(TYPE_LabV2_16, cmsFormatterInput, CMS_PACK_FLAGS_16BITS);
+    Pack   = _cmsGetFormatter(TYPE_LabV2_16, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (Unroll.Fmt16 == NULL || Pack.Fmt16 == NULL) return 0;
+
+    for (i=0; i <= 0xFF00; i++) {
+
+        In16[0] = In16[1] = In16[2] = (cmsUInt16Number) i;
+        Unroll.Fmt16(&info, Values, (cmsUInt8Number*) In16, 1);
+        Pack.Fmt16(&info, Values, (cmsUInt8Number*) Out16, 1);
+
+        if (memcmp(In16, Out16, sizeof(In16)) != 0) {
+            Fail("LabV2 16 bits %x drifts to %x", i, Out16[0]);
+            return 0;
+        }
+    }
+
+    info.InputFormat = info.OutputFormat = TYPE_LabV2_8;
+
+    Unroll = _cmsGetFormatter(TYPE_LabV2_8, cmsFormatterInput, CMS_PACK_FLAGS_16BITS);
+    Pack   = _cmsGetFormatter(TYPE_LabV2_8, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+    if (Unroll.Fmt16 == NULL || Pack.Fmt16 == NULL) return 0;
+
+    for (i=0; i < 256; i++) {
+
+        // 8 bits are stable once quantized (0xFF is outside the V2 range)
+        In8[0] = In8[1] = In8[2] = (cmsUInt8Number) i;
+        Unroll.Fmt16(&info, Values, In8, 1);
+        Pack.Fmt16(&info, Values, In8, 1);
+        Unroll.Fmt16(&info, Values, In8, 1);
+        Pack.Fmt16(&info, Values, Out8, 1);
+
+        if (memcmp(In8, Out8, sizeof(In8)) != 0) {
+            Fail("LabV2 8 bits %x drifts to %x", i, Out8[0]);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Formatter conformance. Every TYPE_* in lcms2.h goes through the stock formatters. Integer formats are checked
+// against a reference implementation written after the format bits alone; all formats must round-trip.
+
+typedef struct {
+    cmsUInt32Number Type;
+    const char*     Name;
+
+} FormatterType;
+
+#define FT(a) { a, #a }
+
+static const FormatterType AllFormatterTypes[] = {
+    FT(TYPE_GRAY_8), FT(TYPE_GRAY_8_REV), FT(TYPE_GRAY_16), FT(TYPE_GRAY_16_REV), FT(TYPE_GRAY_16_SE),
+    FT(TYPE_GRAYA_8), FT(TYPE_GRAYA_16), FT(TYPE_GRAYA_16_SE), FT(TYPE_GRAYA_8_PLANAR),
+    FT(TYPE_GRAYA_16_PLANAR), FT(TYPE_RGB_8), FT(TYPE_RGB_8_PLANAR), FT(TYPE_BGR_8), FT(TYPE_BGR_8_PLANAR),
+    FT(TYPE_RGB_16), FT(TYPE_RGB_16_PLANAR), FT(TYPE_RGB_16_SE), FT(TYPE_BGR_16), FT(TYPE_BGR_16_PLANAR),
+    FT(TYPE_BGR_16_SE), FT(TYPE_RGBA_8), FT(TYPE_RGBA_8_PLANAR), FT(TYPE_RGBA_16), FT(TYPE_RGBA_16_PLANAR),
+    FT(TYPE_RGBA_16_SE), FT(TYPE_ARGB_8), FT(TYPE_ARGB_8_PLANAR), FT(TYPE_ARGB_16), FT(TYPE_ABGR_8),
+    FT(TYPE_ABGR_8_PLANAR), FT(TYPE_ABGR_16), FT(TYPE_ABGR_16_PLANAR), FT(TYPE_ABGR_16_SE), FT(TYPE_BGRA_8),
+    FT(TYPE_BGRA_8_PLANAR), FT(TYPE_BGRA_16), FT(TYPE_BGRA_16_SE), FT(TYPE_CMY_8), FT(TYPE_CMY_8_PLANAR),
+    FT(TYPE_CMY_16), FT(TYPE_CMY_16_PLANAR), FT(TYPE_CMY_16_SE), FT(TYPE_CMYK_8), FT(TYPE_CMYKA_8),
+    FT(TYPE_CMYK_8_REV), FT(TYPE_YUVK_8), FT(TYPE_CMYK_8_PLANAR), FT(TYPE_CMYK_16), FT(TYPE_CMYK_16_REV),
+    FT(TYPE_YUVK_16), FT(TYPE_CMYK_16_PLANAR), FT(TYPE_CMYK_16_SE), FT(TYPE_KYMC_8), FT(TYPE_KYMC_16),
+    FT(TYPE_KYMC_16_SE), FT(TYPE_KCMY_8), FT(TYPE_KCMY_8_REV), FT(TYPE_KCMY_16), FT(TYPE_KCMY_16_REV),
+    FT(TYPE_KCMY_16_SE), FT(TYPE_CMYK5_8), FT(TYPE_CMYK5_16), FT(TYPE_CMYK5_16_SE), FT(TYPE_KYMC5_8),
+    FT(TYPE_KYMC5_16), FT(TYPE_KYMC5_16_SE), FT(TYPE_CMYK6_8), FT(TYPE_CMYK6_8_PLANAR), FT(TYPE_CMYK6_16),
+    FT(TYPE_CMYK6_16_PLANAR), FT(TYPE_CMYK6_16_SE), FT(TYPE_CMYK7_8), FT(TYPE_CMYK7_16), FT(TYPE_CMYK7_16_SE),
+    FT(TYPE_KYMC7_8), FT(TYPE_KYMC7_16), FT(TYPE_KYMC7_16_SE), FT(TYPE_CMYK8_8), FT(TYPE_CMYK8_16),
+    FT(TYPE_CMYK8_16_SE), FT(TYPE_KYMC8_8), FT(TYPE_KYMC8_16), FT(TYPE_KYMC8_16_SE), FT(TYPE_CMYK9_8),
+    FT(TYPE_CMYK9_16), FT(TYPE_CMYK9_16_SE), FT(TYPE_KYMC9_8), FT(TYPE_KYMC9_16), FT(TYPE_KYMC9_16_SE),
+    FT(TYPE_CMYK10_8), FT(TYPE_CMYK10_16), FT(TYPE_CMYK10_16_SE), FT(TYPE_KYMC10_8), FT(TYPE_KYMC10_16),
+    FT(TYPE_KYMC10_16_SE), FT(TYPE_CMYK11_8), FT(TYPE_CMYK11_16), FT(TYPE_CMYK11_16_SE), FT(TYPE_KYMC11_8),
+    FT(TYPE_KYMC11_16), FT(TYPE_KYMC11_16_SE), FT(TYPE_CMYK12_8), FT(TYPE_CMYK12_16), FT(TYPE_CMYK12_16_SE),
+    FT(TYPE_KYMC12_8), FT(TYPE_KYMC12_16), FT(TYPE_KYMC12_16_SE), FT(TYPE_XYZ_16), FT(TYPE_Lab_8),
+    FT(TYPE_LabV2_8), FT(TYPE_ALab_8), FT(TYPE_ALabV2_8), FT(TYPE_Lab_16), FT(TYPE_LabV2_16), FT(TYPE_Yxy_16),
+    FT(TYPE_YCbCr_8), FT(TYPE_YCbCr_8_PLANAR), FT(TYPE_YCbCr_16), FT(TYPE_YCbCr_16_PLANAR),
+    FT(TYPE_YCbCr_16_SE), FT(TYPE_YUV_8), FT(TYPE_YUV_8_PLANAR), FT(TYPE_YUV_16), FT(TYPE_YUV_16_PLANAR),
+    FT(TYPE_YUV_16_SE), FT(TYPE_HLS_8), FT(TYPE_HLS_8_PLANAR), FT(TYPE_HLS_16), FT(TYPE_HLS_16_PLANAR),
+    FT(TYPE_HLS_16_SE), FT(TYPE_HSV_8), FT(TYPE_HSV_8_PLANAR), FT(TYPE_HSV_16), FT(TYPE_HSV_16_PLANAR),
+    FT(TYPE_HSV_16_SE), FT(TYPE_NAMED_COLOR_INDEX), FT(TYPE_XYZ_FLT), FT(TYPE_XYZA_FLT), FT(TYPE_Lab_FLT),
+    FT(TYPE_LabA_FLT), FT(TYPE_GRAY_FLT), FT(TYPE_RGB_FLT), FT(TYPE_RGBA_FLT), FT(TYPE_CMYK_FLT),
+    FT(TYPE_XYZ_DBL), FT(TYPE_Lab_DBL), FT(TYPE_GRAY_DBL), FT(TYPE_RGB_DBL), FT(TYPE_CMYK_DBL)
+};
+
+#undef FT
+
+#define FMT_PIXELS   5
+#define FMT_SAMPLES  (FMT_PIXELS * cmsMAXCHANNELS)
+
+// Position of colorant n within the pixel. Slots hold the colorants, then the extra channels. DOSWAP reverses
+// the order. SWAPFIRST brings the extra channels (or the last colorant, if there are none) to the front, or
+// leaves them at the end if DOSWAP already moved them there.
+static
+cmsUInt32Number RefFormatterSlot(cmsUInt32Number Type, cmsUInt32Number n)
+{
+    cmsUInt32Number nChan     = T_CHANNELS(Type);
+    cmsUInt32Number Extra     = T_EXTRA(Type);
+    cmsUInt32Number DoSwap    = T_DOSWAP(Type);
+    cmsUInt32Number SwapFirst = T_SWAPFIRST(Type);
+
+    if (Extra == 0 && SwapFirst) n = (n + 1) % nChan;
+    if (DoSwap) n = nChan - n - 1;
+
+    return ((DoSwap ^ SwapFirst) ? Extra : 0) + n;
+}
+
+// Address of the sample in a buffer holding several pixels
+static
+cmsUInt8Number* RefFormatterSample(cmsUInt32Number Type, cmsUInt8Number* Buffer, cmsUInt32Number Pixel, cmsUInt32Number Slot, cmsUInt32Number nPixels)
+{
+    cmsUInt32Number Bytes = T_BYTES(Type);
+
+    if (T_PLANAR(Type))
+        return Buffer + (Slot * nPixels + Pixel) * Bytes;
+
+    return Buffer + (Pixel * (T_CHANNELS(Type) + T_EXTRA(Type)) + Slot) * Bytes;
+}
+
+static
+void RefUnroll(cmsUInt32Number Type, cmsUInt16Number Values[], cmsUInt8Number* Buffer, cmsUInt32Number Pixel, cmsUInt32Number nPixels)
+{
+    cmsUInt32Number n;
+
+    for (n=0; n < T_CHANNELS(Type); n++) {
+
+        cmsUInt8Number* ptr = RefFormatterSample(Type, Buffer, Pixel, RefFormatterSlot(Type, n), nPixels);
+        cmsUInt16Number v;
+
+        if (T_BYTES(Type) == 1) 
+            v = (cmsUInt16Number) (ptr[0] * 257);
+        else {
+            memcpy(&v, ptr, sizeof(v));
+            if (T_ENDIAN16(Type)) v = (cmsUInt16Number) ((v << 8) | (v >> 8));
+        }
+
+        Values[n] = T_FLAVOR(Type) ? (cmsUInt16Number) (0xFFFF - v) : v;
+    }
+}
+
+static
+void RefPack(cmsUInt32Number Type, const cmsUInt16Number Values[], cmsUInt8Number* Buffer, cmsUInt32Number Pixel, cmsUInt32Number nPixels)
+{
+    cmsUInt32Number n;
+
+    for (n=0; n < T_CHANNELS(Type); n++) {
+
+        cmsUInt8Number* ptr = RefFormatterSample(Type, Buffer, Pixel, RefFormatterSlot(Type, n), nPixels);
+        cmsUInt16Number v = T_FLAVOR(Type) ? (cmsUInt16Number) (0xFFFF - Values[n]) : Values[n];
+
+        if (T_BYTES(Type) == 1) 
+            ptr[0] = (cmsUInt8Number) ((v + 128) / 257);
+        else {
+            if (T_ENDIAN16(Type)) v = (cmsUInt16Number) ((v << 8) | (v >> 8));
+            memcpy(ptr, &v, sizeof(v));
+        }
+    }
+}
+
+// Size of the room one pixel takes in the buffer, and how far the formatter should move the pointer
+static
+cmsUInt32Number FormatterPixelSize(cmsUInt32Number Type)
+{
+    cmsUInt32Number Bytes = T_BYTES(Type);
+
+    if (Bytes == 0) Bytes = sizeof(cmsFloat64Number);
+    return (T_CHANNELS(Type) + T_EXTRA(Type)) * Bytes;
+}
+
+static
+cmsUInt32Number FormatterAdvance(cmsUInt32Number Type)
+{
+    cmsUInt32Number Bytes = T_BYTES(Type);
+
+    if (Bytes == 0) Bytes = sizeof(cmsFloat64Number);
+    return T_PLANAR(Type) ? Bytes : FormatterPixelSize(Type);
+}
+
+// LabV2 encodings are not plain samples, so they only need to round-trip
+static
+cmsBool HasReferenceFormatter(cmsUInt32Number Type)
+{
+    if (T_FLOAT(Type)) return FALSE;
+    return Type != TYPE_LabV2_8 && Type != TYPE_ALabV2_8 && Type != TYPE_LabV2_16;
+}
+
+static
+cmsBool CheckOneFormatter16(const FormatterType* ft)
+{
+    cmsUInt32Number Type = ft ->Type;
+    cmsUInt32Number nChan = T_CHANNELS(Type);
+    cmsUInt8Number  Buffer[FMT_PIXELS * cmsMAXCHANNELS * 8], Expected[FMT_PIXELS * cmsMAXCHANNELS * 8];
+    cmsUInt16Number Values[cmsMAXCHANNELS], Back[cmsMAXCHANNELS], Again[cmsMAXCHANNELS], Ref[cmsMAXCHANNELS];
+    cmsUInt32Number i, n, Pixel, Stride = FMT_PIXELS;
+    cmsFormatter f, b;
+    cmsUInt8Number* ptr;
+    _cmsTRANSFORM info;
+
+    // Formatters should only look at their own side of the transform
+    memset(&info, 0, sizeof(info));
+    info.InputFormat  = Type;
+    info.OutputFormat = Type;
+
+    f = _cmsGetFormatter(Type, cmsFormatterInput,  CMS_PACK_FLAGS_16BITS);
+    b = _cmsGetFormatter(Type, cmsFormatterOutput, CMS_PACK_FLAGS_16BITS);
+
+    if (f.Fmt16 == NULL || b.Fmt16 == NULL) {
+        Fail("no 16 bits formatter for %s", ft ->Name);
+        return FALSE;
+    }
+
+    for (Pixel = 0; Pixel < FMT_PIXELS; Pixel++) {
+
+        if (HasReferenceFormatter(Type)) {
+
+            // Unroll random samples
+            for (i=0; i < sizeof(Buffer); i++) Buffer[i] = (cmsUInt8Number) TestRandom(256);
+
+            info.OutputFormat = 0;
+            ptr = f.Fmt16(&info, Values, RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS), Stride);
+            info.OutputFormat = Type;
+
+            RefUnroll(Type, Ref, Buffer, Pixel, FMT_PIXELS);
+
+            if (ptr != RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS) + FormatterAdvance(Type)) {
+                Fail("%s: unroll moved %d bytes", ft ->Name, (int) (ptr - RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS)));
+                return FALSE;
+            }
+
+            for (n=0; n < nChan; n++) {
+                if (Values[n] != Ref[n]) {
+                    Fail("%s: unroll channel %d is %x, should be %x", ft ->Name, n, Values[n], Ref[n]);
+                    return FALSE;
+                }
+            }
+
+            // Pack random values over the same background
+            for (n=0; n < nChan; n++) Values[n] = (cmsUInt16Number) TestRandom(65536);
+            memcpy(Expected, Buffer, sizeof(Buffer));
+
+            info.InputFormat = 0;
+            ptr = b.Fmt16(&info, Values, RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS), Stride);
+            info.InputFormat = Type;
+
+            RefPack(Type, Values, Expected, Pixel, FMT_PIXELS);
+
+            if (ptr != RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS) + FormatterAdvance(Type)) {
+                Fail("%s: pack moved %d bytes", ft ->Name, (int) (ptr - RefFormatterSample(Type, Buffer, Pixel, 0, FMT_PIXELS)));
+                return FALSE;
+            }
+
+            if (memcmp(Buffer, Expected, sizeof(Buffer)) != 0) {
+                Fail("%s: packed samples differ from reference", ft ->Name);
+                return FALSE;
+            }
+        }
+
+        // Round trip. Once quantized by the encoding, values should come back untouched
+        for (n=0; n < nChan; n++) Values[n] = (cmsUInt16Number) TestRandom(65536);
+        ptr = Buffer + Pixel * FormatterAdvance(Type);
+
+        b.Fmt16(&info, Values, ptr, Stride);
+        f.Fmt16(&info, Back, ptr, Stride);
+        b.Fmt16(&info, Back, ptr, Stride);
+        f.Fmt16(&info, Again, ptr, Stride);
+
+        for (n=0; n < nChan; n++) {
+
+            cmsInt32Number Err = abs((int) Back[n] - (int) Values[n]);
+
+            // Only 8 bits and V2 encodings may lose precision
+            if (Back[n] != Again[n] || 
+                (T_BYTES(Type) != 1 && Err > 1) || 
+                (T_BYTES(Type) == 1 && Err > 128)) {
+                Fail("%s: channel %d round trips %x -> %x -> %x", ft ->Name, n, Values[n], Back[n], Again[n]);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static
+cmsBool CheckOneFormatterFloat(const FormatterType* ft)
+{
+    cmsUInt32Number Type = ft ->Type;
+    cmsUInt32Number nChan = T_CHANNELS(Type);
+    cmsUInt8Number   Buffer[FMT_PIXELS * cmsMAXCHANNELS * 8];
+    cmsFloat32Number Values[cmsMAXCHANNELS], Back[cmsMAXCHANNELS];
+    cmsUInt32Number  n, Pixel, Stride = FMT_PIXELS;
+    cmsFormatter f, b;
+    cmsUInt8Number* ptr;
+    _cmsTRANSFORM info;
+
+    memset(&info, 0, sizeof(info));
+    info.InputFormat = info.OutputFormat = Type;
+
+    f = _cmsGetFormatter(Type, cmsFormatterInput,  CMS_PACK_FLAGS_FLOAT);
+    b = _cmsGetFormatter(Type, cmsFormatterOutput, CMS_PACK_FLAGS_FLOAT);
+
+    if (f.FmtFloat == NULL || b.FmtFloat == NULL) {
+        Fail("no float formatter for %s", ft ->Name);
+        return FALSE;
+    }
+
+    for (Pixel = 0; Pixel < FMT_PIXELS; Pixel++) {
+
+        for (n=0; n < nChan; n++) Values[n] = (cmsFloat32Number) TestRandom(65536) / 65535.0F;
+        ptr = Buffer + Pixel * FormatterAdvance(Type);
+
+        if (b.FmtFloat(&info, Values, ptr, Stride) != ptr + FormatterAdvance(Type) ||
+            f.FmtFloat(&info, Back,   ptr, Stride) != ptr + FormatterAdvance(Type)) {
+            Fail("%s: float formatters do not move a pixel", ft ->Name);
+            return FALSE;
+        }
+
+        for (n=0; n < nChan; n++) {
+            if (fabs(Back[n] - Values[n]) > FLOAT_PRECISSION) {
+                Fail("%s: channel %d round trips %g -> %g", ft ->Name, n, Values[n], Back[n]);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static
+cmsInt32Number CheckFormatterConformance(void)
+{
+    cmsUInt32Number i, nGeneric = 0;
+    cmsBool IsGeneric;
+
+    TestSeed = 1;
+
+    for (i=0; i < sizeof(AllFormatterTypes) / sizeof(AllFormatterTypes[0]); i++) {
+
+        const FormatterType* ft = AllFormatterTypes + i;
+
+        if (!CheckOneFormatter16(ft)) return 0;
+        if (T_FLOAT(ft ->Type) && !CheckOneFormatterFloat(ft)) return 0;
+
+        if (_cmsGetStockFormatterName(ft ->Type, cmsFormatterInput, CMS_PACK_FLAGS_16BITS, &IsGeneric) == NULL) {
+            Fail("%s has no stock formatter name", ft ->Name);
+            return 0;
+        }
+        if (IsGeneric) nGeneric++;
+    }
+
+    printf("%d types, %d on generic unroll ", i, nGeneric);
+    return 1;
+}
+
+
+
+
+static
+cmsInt32Number CheckOneRGB(cmsHTRANSFORM xform, cmsUInt16Number R, cmsUInt16Number G, cmsUInt16Number B, cmsUInt16Number Ro, cmsUInt16Number Go, cmsUInt16Number Bo)
+{
+    cmsUInt16Number RGB[3];
+    cmsUInt16Number Out[3];
+
+    RGB[0] = R;
+    RGB[1] = G;
+    RGB[2] = B;
+
+    cmsDoTransform(xform, RGB, Out, 1);
+
+    return IsGoodWord("R", Ro , Out[0]) &&
+           IsGoodWord("G", Go , Out[1]) &&
+           IsGoodWord("B", Bo , Out[2]);
+}
+
+// Check known values going from sRGB to XYZ
+static
+cmsInt32Number CheckOneRGB_double(cmsHTRANSFORM xform, cmsFloat64Number R, cmsFloat64Number G, cmsFloat64Number B, cmsFloat64Number Ro, cmsFloat64Number Go, cmsFloat64Number Bo)
+{
+    cmsFloat64Number RGB[3];
+    cmsFloat64Number Out[3];
+
+    RGB[0] = R;
+    RGB[1] = G;
+    RGB[2] = B;
+
+    cmsDoTransform(xform, RGB, Out, 1);
+
+    return IsGoodVal("R", Ro , Out[0], 0.01) &&
+           IsGoodVal("G", Go , Out[1], 0.01) &&
+           IsGoodVal("B", Bo , Out[2], 0.01);
+}
+
+
+static
+cmsInt32Number CheckChangeBufferFormat(void)
+{
+    cmsHPROFILE hsRGB = cmsCreate_sRGBProfile();
+    cmsHTRANSFORM xform;
+
+
+    xform = cmsCreateTransform(hsRGB, TYPE_RGB_16, hsRGB, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
+    cmsCloseProfile(hsRGB);
+    if (xform == NULL) return 0;
+
+    
+    if (!CheckOneRGB(xform, 0, 0, 0, 0, 0, 0)) return 0;
+    if (!CheckOneRGB(xform, 120, 0, 0, 120, 0, 0)) return 0;
+    if (!CheckOneRGB(xform, 0, 222, 255, 0, 222, 255)) return 0;
+
+
+    if (!cmsChangeBuffersFormat(xform, TYPE_BGR_16, TYPE_RGB_16)) return 0;
 
     if (!CheckOneRGB(xform, 0, 0, 123, 123, 0, 0)) return 0;
     if (!CheckOneRGB(xform, 154, 234, 0, 0, 234, 154)) return 0;
@@ -4058,6 +5200,70 @@ return 1;
 }
 
 
+// Runs of identical pixels take a shortcut on cached transforms. Results should be same as without cache.
+static
+cmsInt32Number CheckRunLengthCache(void)
+{
+    cmsHPROFILE hsRGB = cmsCreate_sRGBProfile();
+    cmsHPROFILE hAbove = Create_AboveRGB();
+    cmsHTRANSFORM xform, xformNoCache;
+    cmsUInt8Number In[3*1024], Out[3*1024], Ref[3*1024], Pair[6];
+    cmsInt32Number i, j, Run;
+    cmsInt32Number rc = 1;
+
+    xform        = cmsCreateTransform(hsRGB, TYPE_RGB_8, hAbove, TYPE_RGB_8, INTENT_PERCEPTUAL, cmsFLAGS_FORCE_CLUT);
+    xformNoCache = cmsCreateTransform(hsRGB, TYPE_RGB_8, hAbove, TYPE_RGB_8, INTENT_PERCEPTUAL, cmsFLAGS_FORCE_CLUT|cmsFLAGS_NOCACHE);
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hAbove);
+
+    if (xform == NULL || xformNoCache == NULL) return 0;
+
+    // Runs of several lengths, including single pixels and the zero color
+    for (i=0, Run=0; i < 1024; i++) {
+
+        if (i >= Run) Run = i + (i % 7) * (i % 5) + 1;
+
+        In[i*3+0] = (cmsUInt8Number) ((Run * 37) & 0xFF);
+        In[i*3+1] = (cmsUInt8Number) ((Run & 1) ? 0 : Run * 11);
+        In[i*3+2] = (cmsUInt8Number) ((Run & 1) ? 0 : Run);
+    }
+
+    cmsDoTransform(xformNoCache, In, Ref, 1024);
+    cmsDoTransform(xform, In, Out, 1024);
+
+    if (memcmp(Out, Ref, sizeof(Out)) != 0) {
+        Fail("Run-length path differs from uncached transform");
+        rc = 0;
+    }
+
+    // In place, and splitting runs across calls
+    memcpy(Out, In, sizeof(Out));
+    for (j=0; j < 1024; j += 100) {
+
+        cmsDoTransform(xform, Out + j*3, Out + j*3, (j + 100 > 1024) ? 1024 - j : 100);
+    }
+
+    if (memcmp(Out, Ref, sizeof(Out)) != 0) {
+        Fail("Run-length path differs on in-place transform");
+        rc = 0;
+    }
+
+    // In place, the second pixel equals what the first one turns into. It should not be taken as a run
+    Pair[0] = 200; Pair[1] = 10; Pair[2] = 60;
+    cmsDoTransform(xformNoCache, Pair, Pair + 3, 1);
+    cmsDoTransform(xformNoCache, Pair, Ref, 2);
+    cmsDoTransform(xform, Pair, Pair, 2);
+
+    if (memcmp(Pair, Ref, sizeof(Pair)) != 0) {
+        Fail("Run-length path differs on overlapping buffers");
+        rc = 0;
+    }
+
+    cmsDeleteTransform(xform);
+    cmsDeleteTransform(xformNoCache);
+    return rc;
+}
+
+
 // Write tag testbed ----------------------------------------------------------------------------------------
 
 static
@@ -5186,177 +6392,1390 @@ cmsInt32Number CheckProfileCreation(void)
 }
 
 
-// Error reporting  -------------------------------------------------------------------------------------------------------
+// Error reporting  -------------------------------------------------------------------------------------------------------
+
+
+static
+void ErrorReportingFunction(cmsContext ContextID, cmsUInt32Number ErrorCode, const char *Text)
+{
+    TrappedError = TRUE;
+    SimultaneousErrors++;
+    strncpy(ReasonToFailBuffer, Text, TEXT_ERROR_BUFFER_SIZE-1);   
+
+    cmsUNUSED_PARAMETER(ContextID);
+    cmsUNUSED_PARAMETER(ErrorCode);
+}
+
+
+static
+cmsInt32Number CheckBadProfiles(void)
+{
+    cmsHPROFILE h;
+
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "IDoNotExist.icc", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "IAmIllFormed*.icc", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    // No profile name given
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+    
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "..", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+    
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "IHaveBadAccessMode.icc", "@");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "bad.icc", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+     h = cmsOpenProfileFromFileTHR(DbgThread(), "toosmall.icc", "r");
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), NULL, 3);
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), "123", 3);
+    if (h != NULL) {
+        cmsCloseProfile(h);
+        return 0;
+    }
+
+    if (SimultaneousErrors != 9) return 0;      
+    
+    return 1;
+}
+
+
+static
+cmsInt32Number CheckErrReportingOnBadProfiles(void)
+{
+    cmsInt32Number rc;
+
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+    rc = CheckBadProfiles();
+    cmsSetLogErrorHandler(FatalErrorQuit);
+
+    // Reset the error state
+    TrappedError = FALSE;
+    return rc;
+}
+
+
+static
+cmsInt32Number CheckBadTransforms(void)
+{
+    cmsHPROFILE h1 = cmsCreate_sRGBProfile();
+    cmsHTRANSFORM x1;
+
+    x1 = cmsCreateTransform(NULL, 0, NULL, 0, 0, 0);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+
+    
+
+    x1 = cmsCreateTransform(h1, TYPE_RGB_8, h1, TYPE_RGB_8, 12345, 0);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+
+    x1 = cmsCreateTransform(h1, TYPE_CMYK_8, h1, TYPE_RGB_8, 0, 0);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+
+    x1 = cmsCreateTransform(h1, TYPE_RGB_8, h1, TYPE_CMYK_8, 1, 0);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+
+    // sRGB does its output as XYZ!
+    x1 = cmsCreateTransform(h1, TYPE_RGB_8, NULL, TYPE_Lab_8, 1, 0);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+
+    cmsCloseProfile(h1);
+
+
+    {
+
+    cmsHPROFILE h1 = cmsOpenProfileFromFile("test1.icc", "r");
+    cmsHPROFILE h2 = cmsCreate_sRGBProfile();
+
+    x1 = cmsCreateTransform(h1, TYPE_BGR_8, h2, TYPE_BGR_8, INTENT_PERCEPTUAL, 0);
+
+    cmsCloseProfile(h1); cmsCloseProfile(h2);
+    if (x1 != NULL) {
+        cmsDeleteTransform(x1);
+        return 0;
+    }
+    }
+
+    return 1;
+
+}
+
+static
+cmsInt32Number CheckErrReportingOnBadTransforms(void)
+{
+    cmsInt32Number rc;
+
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+    rc = CheckBadTransforms();
+    cmsSetLogErrorHandler(FatalErrorQuit);
+
+    // Reset the error state
+    TrappedError = FALSE;
+    return rc;
+}
+
+
+// Filtered messages should not reach the logger, but all of them should be counted
+static cmsUInt32Number FilteredErrors;
+
+static
+cmsBool DropCorruptionErrors(cmsContext ContextID, cmsUInt32Number ErrorCode, const char* Format, va_list Args)
+{
+    cmsUNUSED_PARAMETER(ContextID);
+    cmsUNUSED_PARAMETER(Format);
+    cmsUNUSED_PARAMETER(Args);
+
+    FilteredErrors++;
+    return ErrorCode != cmsERROR_CORRUPTION_DETECTED;
+}
+
+static
+cmsInt32Number CheckErrorFiltering(void)
+{
+    cmsInt32Number rc = 1;
+    cmsUInt32Number i;
+
+    cmsResetErrorCounts();
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+    cmsSetErrorFilter(DropCorruptionErrors);
+    FilteredErrors = 0;
+
+    cmsSignalError(DbgThread(), cmsERROR_CORRUPTION_DETECTED, "Corrupted tag '%s'", "desc");
+    cmsSignalError(DbgThread(), cmsERROR_RANGE, "Value %d out of range", 5);
+    cmsSignalError(DbgThread(), 1000, "Unknown code");
+
+    if (FilteredErrors != 3 || SimultaneousErrors != 2) rc = 0;
+
+    if (cmsGetErrorCount(cmsERROR_CORRUPTION_DETECTED) != 1 ||
+        cmsGetErrorCount(cmsERROR_RANGE) != 1 ||
+        cmsGetErrorCount(cmsERROR_UNDEFINED) != 1) rc = 0;
+
+    // Only a few per second should reach the logger
+    cmsSetErrorFilter(NULL);
+    cmsSetLogErrorRateLimit(3);
+    SimultaneousErrors = 0;
+
+    for (i=0; i < 10; i++)
+        cmsSignalError(DbgThread(), cmsERROR_RANGE, "Value %d out of range", i);
+
+    if (SimultaneousErrors < 3 || SimultaneousErrors > 6) rc = 0;
+    if (cmsGetErrorCount(cmsERROR_RANGE) != 11) rc = 0;
+
+    cmsSetLogErrorRateLimit(0);
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    cmsResetErrorCounts();
+
+    // Reset the error state
+    TrappedError = FALSE;
+    SimultaneousErrors = 0;
+    return rc;
+}
+
+
+
+
+// Profiles asking for more than allowed should fail cleanly
+static
+cmsInt32Number CheckResourceLimits(void)
+{
+    cmsResourceLimits Limits, Old;
+    cmsHPROFILE hCMYK, hsRGB;
+    cmsHTRANSFORM xform;
+    cmsToneCurve* Curve;
+    cmsStage* mpe;
+    cmsInt32Number rc = 1;
+
+    cmsGetResourceLimits(&Old);
+    memset(&Limits, 0, sizeof(Limits));
+
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+
+    // Curves
+    Limits.MaxCurveEntries = 4096;
+    cmsSetResourceLimits(&Limits);
+
+    Curve = cmsBuildTabulatedToneCurve16(DbgThread(), 4097, NULL);
+    if (Curve != NULL) { cmsFreeToneCurve(Curve); rc = 0; }
+
+    Curve = cmsBuildTabulatedToneCurve16(DbgThread(), 4096, NULL);
+    if (Curve == NULL) rc = 0; else cmsFreeToneCurve(Curve);
+
+    // CLUT
+    Limits.MaxCurveEntries = 0;
+    Limits.MaxCLUTEntries  = 17*17*17*3;
+    cmsSetResourceLimits(&Limits);
+
+    mpe = cmsStageAllocCLut16bit(DbgThread(), 18, 3, 3, NULL);
+    if (mpe != NULL) { cmsStageFree(mpe); rc = 0; }
+
+    // Sampling
+    Limits.MaxCLUTEntries = 0;
+    Limits.MaxSamplerEvaluations = 1000;
+    cmsSetResourceLimits(&Limits);
+
+    mpe = cmsStageAllocCLut16bit(DbgThread(), 17, 3, 3, NULL);
+    if (mpe == NULL) rc = 0;
+    else {
+        if (cmsStageSampleCLut16bit(mpe, Sampler3D, NULL, 0)) rc = 0;
+        cmsStageFree(mpe);
+    }
+
+    // A LUT-based profile should not be readable with tiny CLUTs
+    Limits.MaxSamplerEvaluations = 0;
+    Limits.MaxCLUTEntries = 100;
+    cmsSetResourceLimits(&Limits);
+
+    hCMYK = cmsOpenProfileFromFileTHR(DbgThread(), "test1.icc", "r");
+    hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+
+    TrappedError = FALSE;
+    xform = cmsCreateTransformTHR(DbgThread(), hCMYK, TYPE_CMYK_16, hsRGB, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
+    if (xform != NULL) { cmsDeleteTransform(xform); rc = 0; }
+    if (!TrappedError) rc = 0;
+
+    // And usable again once limits are gone
+    cmsSetResourceLimits(NULL);
+    xform = cmsCreateTransformTHR(DbgThread(), hCMYK, TYPE_CMYK_16, hsRGB, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
+    if (xform == NULL) rc = 0; else cmsDeleteTransform(xform);
+
+    cmsCloseProfile(hCMYK);
+    cmsCloseProfile(hsRGB);
+
+    cmsSetResourceLimits(&Old);
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    TrappedError = FALSE;
+    SimultaneousErrors = 0;
+
+    return rc;
+}
+
+
+// Transforms built ahead of time should be found by key and work as usual ones
+static
+cmsInt32Number CheckTransformTable(void)
+{
+    cmsTRANSFORMSPEC Specs[3] = {
+
+        { "lab",  "*sRGB", "*Lab", TYPE_RGB_8,   TYPE_Lab_DBL, INTENT_PERCEPTUAL, 0 },
+        { "cmyk", "*sRGB", "test1.icc", TYPE_RGB_8, TYPE_CMYK_8, INTENT_RELATIVE_COLORIMETRIC, 0 },
+        { "back", "test1.icc", "*sRGB", TYPE_CMYK_16, TYPE_RGB_16, INTENT_PERCEPTUAL, cmsFLAGS_NOCACHE }
+    };
+    cmsHANDLE hTable;
+    cmsHTRANSFORM xform;
+    cmsUInt8Number White[3] = { 255, 255, 255 };
+    cmsCIELab Lab;
+    cmsUInt32Number i;
+    cmsInt32Number rc = 1;
+
+    hTable = cmsTransformTableAlloc(DbgThread(), Specs, 3);
+    if (hTable == NULL) return 0;
+
+    if (cmsTransformTableLookup(hTable, "lab") != NULL) rc = 0;     // Not yet built
+
+    for (i=0; i < cmsTransformTableCount(hTable); i++)
+        if (!cmsTransformTableBuild(hTable, i)) rc = 0;
+
+    if (cmsTransformTableLookup(hTable, "missing") != NULL) rc = 0;
+    if (cmsTransformTableLookup(hTable, "cmyk") == NULL) rc = 0;
+    if (cmsTransformTableLookup(hTable, "back") == NULL) rc = 0;
+
+    xform = cmsTransformTableLookup(hTable, "lab");
+    if (xform == NULL) rc = 0;
+    else {
+        cmsDoTransform(xform, White, &Lab, 1);
+        if (!IsGoodVal("White L*", Lab.L, 100.0, 0.01)) rc = 0;
+    }
+
+    cmsTransformTableFree(hTable);
+
+    // Keys should be unique
+    Specs[2].Key = "lab";
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+    hTable = cmsTransformTableAlloc(DbgThread(), Specs, 3);
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    TrappedError = FALSE;
+
+    if (hTable != NULL) {
+        cmsTransformTableFree(hTable);
+        rc = 0;
+    }
+
+    return rc;
+}
+
+
+// Identical optimized tables should be kept only once, and go away with the last transform using them
+static
+cmsInt32Number CheckTableSharing(void)
+{
+    cmsHPROFILE hCMYK1, hCMYK2, hsRGB, hAbove;
+    cmsHTRANSFORM xform[4];
+    cmsUInt8Number In[4] = { 10, 90, 180, 30 }, Out1[3], Out2[3];
+    cmsUInt32Number nBytes;
+    cmsInt32Number Old, rc = 1;
+    cmsContext ContextID = DbgThread();
+    int i;
+
+    Old = cmsSetTableSharing(1024);
+
+    // Two handles of the same profile, so nothing is in common but the contents. Tables are only shared within a context
+    hCMYK1 = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+    hCMYK2 = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+    hsRGB  = cmsCreate_sRGBProfileTHR(ContextID);
+    hAbove = Create_AboveRGB();
+
+    xform[0] = cmsCreateTransformTHR(ContextID, hCMYK1, TYPE_CMYK_8, hsRGB, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+    xform[1] = cmsCreateTransformTHR(ContextID, hCMYK2, TYPE_CMYK_8, hsRGB, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+
+    if (cmsGetSharedTableCount(NULL) != 1) {
+        Fail("Expected one shared CLUT, got %d", cmsGetSharedTableCount(NULL));
+        rc = 0;
+    }
+
+    cmsDoTransform(xform[0], In, Out1, 1);
+    cmsDoTransform(xform[1], In, Out2, 1);
+    if (memcmp(Out1, Out2, sizeof(Out1)) != 0) rc = 0;
+
+    // Matrix-shaper tables are shared as well
+    xform[2] = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_8, hAbove, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+    xform[3] = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_8, hAbove, TYPE_RGB_8, INTENT_PERCEPTUAL, 0);
+
+    if (cmsGetSharedTableCount(&nBytes) != 2 || nBytes == 0) {
+        Fail("Expected two shared tables, got %d", cmsGetSharedTableCount(NULL));
+        rc = 0;
+    }
+
+    cmsDeleteTransform(xform[0]);
+    if (cmsGetSharedTableCount(NULL) != 2) rc = 0;
+
+    for (i=1; i < 4; i++)
+        cmsDeleteTransform(xform[i]);
+
+    if (cmsGetSharedTableCount(NULL) != 0) {
+        Fail("Shared tables leaked");
+        rc = 0;
+    }
+
+    cmsCloseProfile(hCMYK1);
+    cmsCloseProfile(hCMYK2);
+    cmsCloseProfile(hsRGB);
+    cmsCloseProfile(hAbove);
+
+    cmsSetTableSharing(Old);
+    return rc;
+}
+
+
+// Private tags of frozen profiles, and of their copies, are served as raw bytes without touching the IO handler
+static
+cmsInt32Number CheckFrozenRawTags(void)
+{
+    const char Private[] = "Private tag, unknown to the library";
+    const cmsTagSignature sig = (cmsTagSignature) 0x70726976;     // 'priv'
+    char Buffer[sizeof(Private)];
+    cmsHPROFILE h, hFrozen, hCopy;
+    cmsUInt8Number* Mem;
+    cmsUInt32Number Size;
+    cmsInt32Number rc = 1;
+
+    h = cmsCreate_sRGBProfileTHR(DbgThread());
+    cmsWriteRawTag(h, sig, Private, sizeof(Private));
+    cmsSaveProfileToMem(h, NULL, &Size);
+    Mem = (cmsUInt8Number*) malloc(Size);
+    cmsSaveProfileToMem(h, Mem, &Size);
+    cmsCloseProfile(h);
+
+    h       = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    hFrozen = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    free(Mem);
+
+    if (!cmsFreezeProfile(hFrozen)) return 0;
+    hCopy = _cmsDupFrozenProfile(h);
+    if (hCopy == NULL) return 0;
+
+    memset(Buffer, 0, sizeof(Buffer));
+    if (cmsReadRawTag(hFrozen, sig, Buffer, sizeof(Buffer)) != sizeof(Private) || strcmp(Buffer, Private) != 0) {
+        Fail("Frozen profile lost the private tag");
+        rc = 0;
+    }
+
+    // The copy has no IO handler at all
+    memset(Buffer, 0, sizeof(Buffer));
+    if (cmsReadRawTag(hCopy, sig, Buffer, sizeof(Buffer)) != sizeof(Private) || strcmp(Buffer, Private) != 0) {
+        Fail("Frozen copy lost the private tag");
+        rc = 0;
+    }
+
+    // Those still decode as usual
+    if (cmsReadTag(hCopy, cmsSigRedColorantTag) == NULL || cmsReadTag(hFrozen, cmsSigRedColorantTag) == NULL) rc = 0;
+
+    cmsCloseProfile(hCopy);
+    cmsCloseProfile(hFrozen);
+    cmsCloseProfile(h);
+    return rc;
+}
+
+// Retained handles outlive cmsCloseProfile, and frozen profiles serve tags from memory only
+static
+cmsInt32Number CheckProfileRetainAndFreeze(void)
+{
+    cmsHPROFILE h, h2;
+    cmsHTRANSFORM xform;
+    void* Tag;
+    cmsInt32Number rc = 1;
+
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "test1.icc", "r");
+    if (h == NULL) return 0;
+
+    h2 = cmsRetainProfile(h);
+    if (h2 != h) return 0;
+
+    if (!cmsCloseProfile(h)) return 0;
+
+    // Still alive
+    if (cmsGetColorSpace(h2) != cmsSigCmykData) rc = 0;
+
+    if (!cmsFreezeProfile(h2)) return 0;
+    if (!cmsIsProfileFrozen(h2)) rc = 0;
+
+    // Same cached pointer every time
+    Tag = cmsReadTag(h2, cmsSigAToB0Tag);
+    if (Tag == NULL || Tag != cmsReadTag(h2, cmsSigAToB0Tag)) rc = 0;
+
+    xform = cmsCreateTransformTHR(DbgThread(), h2, TYPE_CMYK_8, NULL, TYPE_Lab_DBL, INTENT_PERCEPTUAL, 0);
+    if (xform == NULL) rc = 0; else cmsDeleteTransform(xform);
+
+    // No writes on frozen profiles
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+    TrappedError = FALSE;
+
+    if (cmsLinkTag(h2, cmsSigAToB1Tag, cmsSigAToB0Tag)) rc = 0;
+    if (!TrappedError) rc = 0;
+
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    TrappedError = FALSE;
+    SimultaneousErrors = 0;
+
+    if (!cmsCloseProfile(h2)) rc = 0;
+
+    if (!CheckFrozenRawTags()) rc = 0;
+    return rc;
+}
+
+
+// Parallel slicing should visit every node once and combine the same way as the serial version
+typedef struct {
+
+    cmsUInt32Number   nNodes;
+    cmsFloat64Number  Sum;
+
+} SliceStats;
+
+static
+cmsInt32Number SliceSampler16(register const cmsUInt16Number In[], register cmsUInt16Number Out[], register void* Cargo)
+{
+    SliceStats* st = (SliceStats*) Cargo;
+
+    st ->nNodes++;
+    st ->Sum += (cmsFloat64Number) In[0] + 2.0 * In[1] + 3.0 * In[2] + 4.0 * In[3];
+    return TRUE;
+
+    cmsUNUSED_PARAMETER(Out);
+}
+
+static
+cmsInt32Number SliceSamplerFloat(register const cmsFloat32Number In[], register cmsFloat32Number Out[], register void* Cargo)
+{
+    SliceStats* st = (SliceStats*) Cargo;
+
+    // Stops somewhere in the middle
+    if (In[0] > 0.5) return FALSE;
+
+    st ->nNodes++;
+    return TRUE;
+
+    cmsUNUSED_PARAMETER(Out);
+}
+
+static
+cmsBool SliceReduce(void* Cargo, void* ThreadCargo)
+{
+    SliceStats* Total = (SliceStats*) Cargo;
+    SliceStats* st    = (SliceStats*) ThreadCargo;
+
+    Total ->nNodes += st ->nNodes;
+    Total ->Sum    += st ->Sum;
+    return TRUE;
+}
+
+static
+cmsInt32Number CheckParallelSlicing(void)
+{
+    cmsUInt32Number GridPoints[4] = { 17, 9, 5, 33 };
+    SliceStats Serial, Total, PerThread[5];
+    void* Cargos[5];
+    int i;
+
+    memset(&Serial, 0, sizeof(Serial));
+    if (!cmsSliceSpace16(4, GridPoints, SliceSampler16, &Serial)) return 0;
+
+    memset(&Total, 0, sizeof(Total));
+    memset(PerThread, 0, sizeof(PerThread));
+    for (i=0; i < 5; i++) Cargos[i] = &PerThread[i];
+
+    if (!cmsSliceSpace16Parallel(4, GridPoints, SliceSampler16, &Total, 5, Cargos, SliceReduce)) return 0;
+
+    if (Total.nNodes != 17*9*5*33 || Total.nNodes != Serial.nNodes || Total.Sum != Serial.Sum) {
+        Fail("Parallel slicing visited %d nodes, expected %d", Total.nNodes, Serial.nNodes);
+        return 0;
+    }
+
+    // Partitions are contiguous and balanced
+    for (i=0; i < 5; i++) {
+        if (PerThread[i].nNodes < (17*9*5*33) / 5 || PerThread[i].nNodes > (17*9*5*33) / 5 + 1) return 0;
+    }
+
+    // A failing sampler makes the whole slicing fail
+    memset(PerThread, 0, sizeof(PerThread));
+    if (cmsSliceSpaceFloatParallel(4, GridPoints, SliceSamplerFloat, NULL, 3, Cargos, NULL)) return 0;
+
+    return 1;
+}
+
+
+static
+void PutBE32(cmsUInt8Number* p, cmsUInt32Number n)
+{
+    p[0] = (cmsUInt8Number) (n >> 24); p[1] = (cmsUInt8Number) (n >> 16);
+    p[2] = (cmsUInt8Number) (n >> 8);  p[3] = (cmsUInt8Number) n;
+}
+
+static
+cmsInt32Number CheckValidationOnHugeDirectory(void)
+{
+    const cmsUInt32Number nTags = 87000;
+    cmsUInt32Number TableEnd = 128 + 4 + nTags * 12;
+    cmsUInt32Number Size = TableEnd + 16, i;
+    cmsProfileValidation Report;
+    cmsUInt8Number* Mem;
+    cmsHPROFILE h;
+    cmsInt32Number rc = 1;
+
+    Mem = (cmsUInt8Number*) calloc(Size, 1);
+
+    PutBE32(Mem, Size);
+    PutBE32(Mem + 8,  0x04200000);
+    PutBE32(Mem + 12, cmsSigDisplayClass);
+    PutBE32(Mem + 16, cmsSigRgbData);
+    PutBE32(Mem + 20, cmsSigXYZData);
+    PutBE32(Mem + 36, cmsMagicNumber);
+    PutBE32(Mem + 128, nTags);
+
+    for (i=0; i < nTags; i++) {
+
+        PutBE32(Mem + 132 + i * 12,     0x70726976);    // 'priv'
+        PutBE32(Mem + 132 + i * 12 + 4, TableEnd);
+        PutBE32(Mem + 132 + i * 12 + 8, 8);
+    }
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    if (!cmsValidateProfile(h, FALSE, &Report) || Report.nTags != nTags) {
+        Fail("Shared blocks: %s", Report.FirstError);
+        rc = 0;
+    }
+    cmsCloseProfile(h);
+
+    PutBE32(Mem + 132 + (nTags - 1) * 12 + 4, TableEnd + 4);
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    if (cmsValidateProfile(h, FALSE, &Report) || Report.Failed != cmsVALIDATE_TAGTABLE || Report.nErrors != 1) {
+        Fail("Overlap not found on a huge directory");
+        rc = 0;
+    }
+    cmsCloseProfile(h);
+
+    free(Mem);
+    return rc;
+}
+
+// Deep validation should accept good profiles and point out the broken parts of bad ones
+static
+cmsInt32Number CheckProfileValidation(void)
+{
+    const char* Good[] = { "test1.icc", "test2.icc", "test3.icc", "test5.icc" };
+    cmsProfileValidation Report;
+    cmsHPROFILE h;
+    cmsUInt8Number* Mem;
+    cmsUInt32Number Size, Offset;
+    cmsInt32Number rc = 1;
+    int i;
+
+    for (i=0; i < 4; i++) {
+
+        h = cmsOpenProfileFromFileTHR(DbgThread(), Good[i], "r");
+        if (!cmsValidateProfile(h, FALSE, &Report)) {
+            Fail("%s: %s", Good[i], Report.FirstError);
+            rc = 0;
+        }
+        cmsCloseProfile(h);
+    }
+
+    // This one carries a stale profile ID
+    h = cmsOpenProfileFromFileTHR(DbgThread(), "test4.icc", "r");
+    if (cmsValidateProfile(h, FALSE, &Report) || Report.Failed != cmsVALIDATE_ID) rc = 0;
+    cmsCloseProfile(h);
+
+    // A fresh one, with ID
+    h = cmsCreate_sRGBProfileTHR(DbgThread());
+    cmsMD5computeID(h);
+    cmsSaveProfileToMem(h, NULL, &Size);
+    Mem = (cmsUInt8Number*) malloc(Size);
+    cmsSaveProfileToMem(h, Mem, &Size);
+    cmsCloseProfile(h);
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    if (!cmsValidateProfile(h, FALSE, &Report)) rc = 0;
+    cmsCloseProfile(h);
+
+    // Also right on the bytes
+    if (!cmsValidateProfileMem(DbgThread(), Mem, Size, FALSE, &Report) || Report.nTags == 0) rc = 0;
+
+    // Any change on the contents breaks the ID
+    Mem[Size - 4] ^= 0x55;
+    h = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    if (cmsValidateProfile(h, FALSE, &Report) || !(Report.Failed & cmsVALIDATE_ID)) rc = 0;
+    cmsCloseProfile(h);
+
+    if (cmsValidateProfileMem(DbgThread(), Mem, Size, FALSE, &Report) || !(Report.Failed & cmsVALIDATE_ID)) rc = 0;
+
+    // Second tag starting in the middle of the first one
+    Offset = ((cmsUInt32Number) Mem[136] << 24) | (Mem[137] << 16) | (Mem[138] << 8) | Mem[139];
+    Offset += 4;
+    Mem[148] = (cmsUInt8Number) (Offset >> 24); Mem[149] = (cmsUInt8Number) (Offset >> 16);
+    Mem[150] = (cmsUInt8Number) (Offset >> 8);  Mem[151] = (cmsUInt8Number) Offset;
+
+    cmsSetLogErrorHandler(ErrorReportingFunction);
+
+    h = cmsOpenProfileFromMemTHR(DbgThread(), Mem, Size);
+    if (cmsValidateProfile(h, FALSE, &Report) || !(Report.Failed & cmsVALIDATE_TAGTABLE)) rc = 0;
+
+    // Fail fast stops on the first error
+    if (cmsValidateProfile(h, TRUE, &Report) || Report.nErrors != 1) rc = 0;
+    cmsCloseProfile(h);
+
+    if (cmsValidateProfileMem(DbgThread(), Mem, Size, TRUE, &Report) || Report.Failed != cmsVALIDATE_TAGTABLE) rc = 0;
+
+    // Not a profile at all
+    if (cmsValidateProfileMem(DbgThread(), Mem + 4, 64, FALSE, &Report) || Report.Failed != cmsVALIDATE_HEADER) rc = 0;
+
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    TrappedError = FALSE;
+    SimultaneousErrors = 0;
+
+    free(Mem);
+
+    // A megabyte worth of entries sharing one block, as a crafted profile would have. The last one overlaps
+    if (!CheckValidationOnHugeDirectory()) rc = 0;
+
+    return rc;
+}
+
+
+// Tag directory is no longer limited to 100 entries, and should survive a round trip
+static
+cmsInt32Number CheckManyTags(void)
+{
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE h;
+    cmsUInt8Number* Mem;
+    cmsUInt32Number Size, Data, i;
+    cmsCIEXYZ* WhitePoint;
+    cmsInt32Number rc = 1;
+
+    h = cmsCreateProfilePlaceholder(ContextID);
+
+    for (i=0; i < 300; i++) {
+
+        Data = i * 7;
+        if (!cmsWriteRawTag(h, (cmsTagSignature) (0x78000000 + i), &Data, sizeof(Data))) rc = 0;
+    }
+
+    cmsWriteTag(h, cmsSigMediaWhitePointTag, cmsD50_XYZ());
+    cmsLinkTag(h, (cmsTagSignature) 0x79000000, (cmsTagSignature) 0x78000005);
+
+    if (cmsGetTagCount(h) != 302) rc = 0;
+    if (!cmsIsTag(h, (cmsTagSignature) (0x78000000 + 299))) rc = 0;
+    if (cmsIsTag(h, (cmsTagSignature) (0x78000000 + 300))) rc = 0;
+
+    cmsSaveProfileToMem(h, NULL, &Size);
+    Mem = (cmsUInt8Number*) malloc(Size);
+    cmsSaveProfileToMem(h, Mem, &Size);
+    cmsCloseProfile(h);
+
+    h = cmsOpenProfileFromMemTHR(ContextID, Mem, Size);
+
+    if (cmsGetTagCount(h) != 302) rc = 0;
+
+    for (i=0; i < 300; i++) {
+
+        Data = 0;
+        if (cmsReadRawTag(h, (cmsTagSignature) (0x78000000 + i), &Data, sizeof(Data)) != sizeof(Data) || Data != i * 7) {
+            Fail("Tag #%d lost", i);
+            rc = 0;
+            break;
+        }
+    }
+
+    if (cmsTagLinkedTo(h, (cmsTagSignature) 0x79000000) != (cmsTagSignature) 0x78000005) rc = 0;
+
+    WhitePoint = (cmsCIEXYZ*) cmsReadTag(h, cmsSigMediaWhitePointTag);
+    if (WhitePoint == NULL || !IsGoodVal("White point", WhitePoint ->Y, 1.0, 1E-4)) rc = 0;
+
+    cmsCloseProfile(h);
+    free(Mem);
+    return rc;
+}
+
+
+// Fast precision should stay within the budgets documented on cmsSetPrecisionPolicy. Objects keep the policy they
+// were created with, so references are created and everything is evaluated back in exact mode
+static
+cmsInt32Number CheckPrecisionPolicy(void)
+{
+    cmsFloat64Number t, d, MaxErr, Sum;
+    cmsHPROFILE hsRGB, hLab;
+    cmsHTRANSFORM Exact, Fast;
+    cmsHANDLE ExactCAM, FastCAM;
+    cmsViewingConditions vc;
+    cmsCIEXYZ XYZ;
+    cmsJCh JCh1, JCh2;
+    cmsUInt16Number RGB[3], LabEnc[3];
+    cmsCIELab Lab1, Lab2;
+    cmsInt32Number rc = 1, Old;
+    int i, r, g, b, n;
+
+    if (cmsSetPrecisionPolicy(-1) != cmsPRECISION_EXACT) return 0;
+
+    // atan2
+    MaxErr = 0;
+    for (i=0; i < 3600; i++) {
+
+        t = -M_PI + (2 * M_PI * i) / 3600.0;
+        d = fabs(_cmsArcTan2(5 * sin(t), 5 * cos(t)) - atan2(5 * sin(t), 5 * cos(t)));
+        if (d > M_PI) d = fabs(d - 2 * M_PI);
+        if (d > MaxErr) MaxErr = d;
+    }
+    if (MaxErr > 1E-5) { Fail("atan2 error %g", MaxErr); rc = 0; }
+
+    // Objects created in fast mode
+    hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+    hLab  = cmsCreateLab4ProfileTHR(DbgThread(), NULL);
+
+    vc.whitePoint = *cmsD50_XYZ();
+    vc.Yb = 20; vc.La = 20; vc.surround = AVG_SURROUND; vc.D_value = 1.0;
+
+    Old = cmsSetPrecisionPolicy(cmsPRECISION_FAST);
+    Fast    = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hLab, TYPE_Lab_16, INTENT_PERCEPTUAL, 0);
+    FastCAM = cmsCIECAM02Init(DbgThread(), &vc);
+
+    // Everything else in exact mode. The reference transform is floating point
+    cmsSetPrecisionPolicy(cmsPRECISION_EXACT);
+    Exact    = cmsCreateTransformTHR(DbgThread(), hsRGB, TYPE_RGB_16, hLab, TYPE_Lab_DBL, INTENT_PERCEPTUAL, 0);
+    ExactCAM = cmsCIECAM02Init(DbgThread(), &vc);
+
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hLab);
+
+    if (!(((_cmsTRANSFORM*) Fast) ->dwOriginalFlags & cmsFLAGS_LOWRESPRECALC)) {
+        Fail("Fast transform did not keep its grid"); rc = 0;
+    }
+
+    MaxErr = Sum = 0; n = 0;
+    for (r=0; r < 65536; r += 4369)
+        for (g=0; g < 65536; g += 4369)
+            for (b=0; b < 65536; b += 4369) {
+
+                RGB[0] = (cmsUInt16Number) r; RGB[1] = (cmsUInt16Number) g; RGB[2] = (cmsUInt16Number) b;
+
+                cmsDoTransform(Exact, RGB, &Lab1, 1);
+                cmsDoTransform(Fast,  RGB, LabEnc, 1);
+                cmsLabEncoded2Float(&Lab2, LabEnc);
+
+                d = cmsDeltaE(&Lab1, &Lab2);
+                if (d > MaxErr) MaxErr = d;
+                Sum += d; n++;
+            }
+
+    if (MaxErr > 1.0 || Sum / n > 0.1) { Fail("dE max %g mean %g", MaxErr, Sum / n); rc = 0; }
+
+    // CIECAM02 hue, in degrees
+    MaxErr = 0;
+    for (i=0; i < 1000; i++) {
+
+        XYZ.X = 0.05 + 0.9 * ((i * 37) % 1000) / 1000.0;
+        XYZ.Y = 0.05 + 0.9 * ((i * 61) % 1000) / 1000.0;
+        XYZ.Z = 0.05 + 0.7 * ((i * 83) % 1000) / 1000.0;
+
+        cmsCIECAM02Forward(ExactCAM, &XYZ, &JCh1);
+        cmsCIECAM02Forward(FastCAM,  &XYZ, &JCh2);
+
+        d = fabs(JCh1.h - JCh2.h);
+        if (d > 180) d = fabs(d - 360);
+        if (d > MaxErr) MaxErr = d;
+    }
+
+    if (MaxErr == 0 || MaxErr > 1E-5 * 180.0 / M_PI) { Fail("CIECAM02 hue error %g", MaxErr); rc = 0; }
+
+    cmsDeleteTransform(Exact);
+    cmsDeleteTransform(Fast);
+    cmsCIECAM02Done(ExactCAM);
+    cmsCIECAM02Done(FastCAM);
+
+    cmsSetPrecisionPolicy(Old);
+    return rc;
+}
+
+
+// Selected pixels should match a full transform, and the rest of the output should be left as it was
+
+#define SPARSE_PIXELS 1000
+
+static
+cmsBool IsSelected(cmsUInt32Number i)
+{
+    // Long runs, short runs and isolated pixels
+    return (i % 100) < 40 || (i % 7) == 0;
+}
+
+static
+cmsInt32Number CheckSparseOne(cmsHTRANSFORM xform, cmsUInt32Number InBytes, cmsUInt32Number OutBytes, cmsBool Planar, cmsInt32Number Mode)
+{
+    cmsUInt8Number *In, *Full, *Out, Mask[SPARSE_PIXELS];
+    cmsUInt32Number Indexes[SPARSE_PIXELS], nIndexes = 0, i, j;
+    cmsInt32Number rc = 1;
+
+    In   = (cmsUInt8Number*) malloc(SPARSE_PIXELS * InBytes);
+    Full = (cmsUInt8Number*) malloc(SPARSE_PIXELS * OutBytes);
+    Out  = (cmsUInt8Number*) malloc(SPARSE_PIXELS * OutBytes);
+    if (In == NULL || Full == NULL || Out == NULL) { rc = 0; goto Done; }
+
+    for (i=0; i < SPARSE_PIXELS * InBytes; i++)
+        In[i] = (cmsUInt8Number) (i * 7 + (i >> 8));
+
+    memset(Mask, 0, sizeof(Mask));
+    for (i=SPARSE_PIXELS; i > 0; i--) {
+
+        if (IsSelected(i-1)) {
+
+            Indexes[nIndexes++] = i-1;      // Backwards, order should not matter
+
+            if (Mode == 1) Mask[(i-1) >> 3] |= (cmsUInt8Number) (0x80 >> ((i-1) & 7));
+            else Mask[i-1] = 0xAA;
+        }
+    }
+
+    // Extra channels are not written, so both start the same
+    memset(Full, 0x5A, SPARSE_PIXELS * OutBytes);
+    memset(Out,  0x5A, SPARSE_PIXELS * OutBytes);
+
+    cmsDoTransformStride(xform, In, Full, SPARSE_PIXELS, SPARSE_PIXELS);
+
+    if (Mode == 0)
+        cmsDoTransformIndexed(xform, In, Out, Indexes, nIndexes, SPARSE_PIXELS);
+    else
+        cmsDoTransformMasked(xform, In, Out, Mask, Mode, SPARSE_PIXELS, SPARSE_PIXELS);
+
+    for (i=0; i < SPARSE_PIXELS; i++) {
+
+        for (j=0; j < OutBytes; j++) {
+
+            // Planar buffers have each byte of the pixel on its own plane
+            cmsUInt32Number Pos = Planar ? (j / 2) * SPARSE_PIXELS * 2 + i * 2 + (j & 1) : i * OutBytes + j;
+            cmsUInt8Number Expected = IsSelected(i) ? Full[Pos] : 0x5A;
+
+            if (Out[Pos] != Expected) {
+                Fail("Sparse mode %d: pixel %d differs", Mode, i);
+                rc = 0;
+                goto Done;
+            }
+        }
+    }
+
+Done:
+    free(In); free(Full); free(Out);
+    return rc;
+}
+
+static
+cmsInt32Number CheckSparseTransforms(void)
+{
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE hsRGB, hCMYK;
+    cmsHTRANSFORM xform;
+    cmsInt32Number rc = 1, Mode;
+
+    hsRGB = cmsCreate_sRGBProfileTHR(ContextID);
+    hCMYK = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+
+    // Chunky, with an extra channel on output that should be kept
+    xform = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_8, hsRGB, TYPE_RGBA_8, INTENT_PERCEPTUAL, 0);
+    for (Mode = 0; Mode <= 8 && rc; Mode = Mode ? Mode + 7 : 1)
+        rc &= CheckSparseOne(xform, 3, 4, FALSE, Mode);
+    cmsDeleteTransform(xform);
+
+    // Planar
+    xform = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_16_PLANAR, hCMYK, TYPE_CMYK_16_PLANAR, INTENT_PERCEPTUAL, 0);
+    for (Mode = 0; Mode <= 8 && rc; Mode = Mode ? Mode + 7 : 1)
+        rc &= CheckSparseOne(xform, 6, 8, TRUE, Mode);
+    cmsDeleteTransform(xform);
+
+    cmsCloseProfile(hsRGB);
+    cmsCloseProfile(hCMYK);
+    return rc;
+}
+
+// Indexes should be the ones of a brute force search over the 16 bits output of the same transform
+#define PALETTE_PIXELS  20000
+#define PALETTE_SIZE    40
+
+static
+cmsInt32Number CheckPaletteTransform(void)
+{
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE hsRGB, hCMYK;
+    cmsHTRANSFORM xform, xform16;
+    cmsHANDLE hMap;
+    cmsUInt8Number *In, *Index, Palette[PALETTE_SIZE * 4];
+    cmsUInt16Number* Out;
+    cmsUInt32Number i, j, k, Best;
+    cmsFloat64Number d, Dist, BestDist;
+    cmsInt32Number rc = 1;
+
+    hsRGB = cmsCreate_sRGBProfileTHR(ContextID);
+    hCMYK = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+
+    xform   = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_8, hCMYK, TYPE_CMYK_8,  INTENT_PERCEPTUAL, 0);
+    xform16 = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_8, hCMYK, TYPE_CMYK_16, INTENT_PERCEPTUAL, 0);
+    cmsCloseProfile(hsRGB);
+    cmsCloseProfile(hCMYK);
+
+    In    = (cmsUInt8Number*) malloc(PALETTE_PIXELS * 3);
+    Index = (cmsUInt8Number*) malloc(PALETTE_PIXELS);
+    Out   = (cmsUInt16Number*) malloc(PALETTE_PIXELS * 4 * sizeof(cmsUInt16Number));
+
+    for (i=0; i < PALETTE_PIXELS * 3; i++)
+        In[i] = (cmsUInt8Number) ((i * 2654435761U) >> 13);
+
+    for (i=0; i < sizeof(Palette); i++)
+        Palette[i] = (cmsUInt8Number) ((i * 40503U) >> 3);
+
+    hMap = cmsPaletteMapAlloc(xform, Palette, PALETTE_SIZE);
+    if (hMap == NULL) {
+        rc = 0;
+        goto Error;
+    }
+
+    cmsDoTransformToPalette(hMap, In, Index, PALETTE_PIXELS, PALETTE_PIXELS, 3);
+    cmsDoTransform(xform16, In, Out, PALETTE_PIXELS);
+
+    for (i=0; i < PALETTE_PIXELS; i++) {
+
+        Best = 0;
+        BestDist = 1E300;
+
+        for (j=0; j < PALETTE_SIZE; j++) {
+
+            Dist = 0;
+            for (k=0; k < 4; k++) {
+                d = (cmsFloat64Number) Out[i * 4 + k] - Palette[j * 4 + k] * 257.0;
+                Dist += d * d;
+            }
+
+            if (Dist < BestDist) {
+                BestDist = Dist;
+                Best = j;
+            }
+        }
+
+        if (Index[i] != Best) {
+            Fail("Pixel %d maps to %d instead of %d", i, Index[i], Best);
+            rc = 0;
+            break;
+        }
+    }
+
+    cmsPaletteMapFree(hMap);
+
+Error:
+    free(In); free(Index); free(Out);
+    cmsDeleteTransform(xform);
+    cmsDeleteTransform(xform16);
+    return rc;
+}
+
+// Vectored transforms should give the same as transforming every buffer on its own, also when buffers are cut among threads
+#define VECTOR_BUFFERS  7
+
+static
+cmsInt32Number CheckVectorTransform(cmsUInt32Number InputFormat, cmsUInt32Number OutputFormat)
+{
+    static const cmsUInt32Number Sizes[VECTOR_BUFFERS] = { 256, 0, 9000, 1, 4111, 256, 7000 };
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE hsRGB, hCMYK;
+    cmsHTRANSFORM xform;
+    cmsTRANSFORMBUFFER Buffers[VECTOR_BUFFERS];
+    cmsUInt8Number *In, *Out, *Ref;
+    cmsUInt32Number i, Total = 0, Offset;
+    cmsInt32Number rc = 1;
+
+    for (i=0; i < VECTOR_BUFFERS; i++) Total += Sizes[i];
+
+    hsRGB = cmsCreate_sRGBProfileTHR(ContextID);
+    hCMYK = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+    xform = cmsCreateTransformTHR(ContextID, hsRGB, InputFormat, hCMYK, OutputFormat, INTENT_PERCEPTUAL, 0);
+    cmsCloseProfile(hsRGB);
+    cmsCloseProfile(hCMYK);
+
+    In  = (cmsUInt8Number*) malloc(Total * 3);
+    Out = (cmsUInt8Number*) malloc(Total * 4);
+    Ref = (cmsUInt8Number*) malloc(Total * 4);
+
+    for (i=0; i < Total * 3; i++)
+        In[i] = (cmsUInt8Number) ((i * 2654435761U) >> 11);
+
+    memset(Out, 0, Total * 4);
+
+    Offset = 0;
+    for (i=0; i < VECTOR_BUFFERS; i++) {
+
+        Buffers[i].InputBuffer  = In + Offset * 3;
+        Buffers[i].OutputBuffer = Out + Offset * 4;
+        Buffers[i].Size         = Sizes[i];
+        Buffers[i].Stride       = Sizes[i];
+
+        cmsDoTransformStride(xform, In + Offset * 3, Ref + Offset * 4, Sizes[i], Sizes[i]);
+        Offset += Sizes[i];
+    }
+
+    cmsDoTransformBuffers(xform, Buffers, VECTOR_BUFFERS, 3);
 
+    if (memcmp(Out, Ref, Total * 4) != 0) {
+        Fail("Vectored transform differs");
+        rc = 0;
+    }
+
+    free(In); free(Out); free(Ref);
+    cmsDeleteTransform(xform);
+    return rc;
+}
 
 static
-void ErrorReportingFunction(cmsContext ContextID, cmsUInt32Number ErrorCode, const char *Text)
+cmsInt32Number CheckVectorTransforms(void)
 {
-    TrappedError = TRUE;
-    SimultaneousErrors++;
-    strncpy(ReasonToFailBuffer, Text, TEXT_ERROR_BUFFER_SIZE-1);   
-
-    cmsUNUSED_PARAMETER(ContextID);
-    cmsUNUSED_PARAMETER(ErrorCode);
+    return CheckVectorTransform(TYPE_RGB_8, TYPE_CMYK_8) &&
+           CheckVectorTransform(TYPE_RGB_8_PLANAR, TYPE_CMYK_8_PLANAR);
 }
 
+// Nearest named colors should match an exhaustive search for every metric
+#define NCS_COLORS      700
+#define NCS_QUERIES     300
+#define NCS_K           4
 
 static
-cmsInt32Number CheckBadProfiles(void)
+cmsInt32Number CheckNamedColorSearch(void)
 {
-    cmsHPROFILE h;
+    cmsNAMEDCOLORLIST* nc = cmsAllocNamedColorList(DbgThread(), NCS_COLORS, 1, "", "");
+    cmsHANDLE hSearch;
+    cmsCIELab Lab, Color, Queries[NCS_QUERIES];
+    cmsUInt16Number PCS[3];
+    cmsUInt32Number i, j, n, Metric, nFound, Index[NCS_K], Batch[NCS_QUERIES * NCS_K];
+    cmsUInt32Number Best[NCS_K];
+    cmsFloat64Number dE[NCS_K], BestDE[NCS_K], d;
+    char Name[40];
+    cmsInt32Number rc = 1;
 
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "IDoNotExist.icc", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
+    for (i=0; i < NCS_COLORS; i++) {
 
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "IAmIllFormed*.icc", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
+        // Some colors are repeated to exercise ties
+        n = (i % 7 == 6) ? i / 2 : i;
 
-    // No profile name given
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
-    
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "..", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
-    
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "IHaveBadAccessMode.icc", "@");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
+        PCS[0] = (cmsUInt16Number) ((n * 2654435761U) >> 16);
+        PCS[1] = (cmsUInt16Number) (16384 + ((n * 40503U) & 0x7FFF));
+        PCS[2] = (cmsUInt16Number) (16384 + ((n * 69069U + 12345) & 0x7FFF));
 
-    h = cmsOpenProfileFromFileTHR(DbgThread(), "bad.icc", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
+        sprintf(Name, "#%d", i);
+        cmsAppendNamedColor(nc, Name, PCS, NULL);
     }
 
-     h = cmsOpenProfileFromFileTHR(DbgThread(), "toosmall.icc", "r");
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
-    }
+    for (i=0; i < NCS_QUERIES; i++) {
 
-    h = cmsOpenProfileFromMemTHR(DbgThread(), NULL, 3);
-    if (h != NULL) {
-        cmsCloseProfile(h);
-        return 0;
+        Queries[i].L = ((i * 37) % 110) - 5.0;
+        Queries[i].a = ((i * 53) % 180) - 90.0;
+        Queries[i].b = ((i * 71) % 180) - 90.0;
     }
 
-    h = cmsOpenProfileFromMemTHR(DbgThread(), "123", 3);
-    if (h != NULL) {
-        cmsCloseProfile(h);
+    hSearch = cmsNamedColorSearchAlloc(nc);
+    if (hSearch == NULL) {
+        cmsFreeNamedColorList(nc);
         return 0;
     }
 
-    if (SimultaneousErrors != 9) return 0;      
-    
-    return 1;
-}
+    for (Metric = cmsDELTAE_76; Metric <= cmsDELTAE_2000 && rc; Metric++) {
 
+        if (!cmsNamedColorNearestBatch(hSearch, Queries, NCS_QUERIES, Metric, NCS_K, Batch, NULL, 3)) {
+            Fail("Batch search failed");
+            rc = 0;
+            break;
+        }
 
-static
-cmsInt32Number CheckErrReportingOnBadProfiles(void)
-{
-    cmsInt32Number rc;
+        for (i=0; i < NCS_QUERIES && rc; i++) {
 
-    cmsSetLogErrorHandler(ErrorReportingFunction);
-    rc = CheckBadProfiles();
-    cmsSetLogErrorHandler(FatalErrorQuit);
+            Lab = Queries[i];
+            nFound = cmsNamedColorNearest(hSearch, &Lab, Metric, NCS_K, Index, dE);
 
-    // Reset the error state
-    TrappedError = FALSE;
+            // Exhaustive search, ties to the lower index
+            for (j=0; j < NCS_K; j++) BestDE[j] = 1E300;
+
+            for (n=0; n < NCS_COLORS; n++) {
+
+                cmsNamedColorInfo(nc, n, NULL, NULL, NULL, PCS, NULL);
+                cmsLabEncoded2FloatV2(&Color, PCS);
+
+                switch (Metric) {
+                case cmsDELTAE_CIE94:   d = cmsCIE94DeltaE(&Lab, &Color); break;
+                case cmsDELTAE_CMC_1_1: d = cmsCMCdeltaE(&Lab, &Color, 1, 1); break;
+                case cmsDELTAE_CMC_2_1: d = cmsCMCdeltaE(&Lab, &Color, 2, 1); break;
+                case cmsDELTAE_2000:    d = cmsCIE2000DeltaE(&Lab, &Color, 1, 1, 1); break;
+                default:                d = cmsDeltaE(&Lab, &Color); break;
+                }
+
+                for (j = NCS_K; j > 0 && d < BestDE[j-1]; j--) {
+                    if (j < NCS_K) { BestDE[j] = BestDE[j-1]; Best[j] = Best[j-1]; }
+                }
+
+                if (j < NCS_K) { BestDE[j] = d; Best[j] = n; }
+            }
+
+            if (nFound != NCS_K) {
+                Fail("Found %d colors", nFound);
+                rc = 0;
+            }
+
+            for (j=0; j < NCS_K && rc; j++) {
+
+                if (Index[j] != Best[j] || dE[j] != BestDE[j] || Batch[i * NCS_K + j] != Best[j]) {
+                    Fail("Metric %d, query %d: #%d is %d instead of %d", Metric, i, j, Index[j], Best[j]);
+                    rc = 0;
+                }
+            }
+        }
+    }
+
+    cmsNamedColorSearchFree(hSearch);
+    cmsFreeNamedColorList(nc);
     return rc;
 }
 
-
+// Every variant of a bundle should behave exactly as the transform built on its own. Profiles the caller
+// did not freeze are left alone, frozen ones keep what the variants worked out.
 static
-cmsInt32Number CheckBadTransforms(void)
+cmsInt32Number CheckTransformBundle(void)
 {
-    cmsHPROFILE h1 = cmsCreate_sRGBProfile();
-    cmsHTRANSFORM x1;
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE hProfiles[2], hFresh;
+    cmsTRANSFORMVARIANT Variants[8];
+    cmsHTRANSFORM Bundle[8], xform;
+    cmsUInt8Number In[3*64], Out1[4*64], Out2[4*64];
+    cmsCIEXYZ Kept, Fresh;
+    cmsPipeline* Lut;
+    cmsUInt32Number i, Pass;
+    cmsInt32Number rc = 1;
 
-    x1 = cmsCreateTransform(NULL, 0, NULL, 0, 0, 0);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
+    for (i=0; i < 8; i++) {
+        Variants[i].Intent  = i / 2;
+        Variants[i].dwFlags = (i & 1) ? cmsFLAGS_BLACKPOINTCOMPENSATION : 0;
     }
 
-    
+    for (i=0; i < sizeof(In); i++)
+        In[i] = (cmsUInt8Number) (i * 37);
 
-    x1 = cmsCreateTransform(h1, TYPE_RGB_8, h1, TYPE_RGB_8, 12345, 0);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
-    }
+    hProfiles[0] = cmsCreate_sRGBProfileTHR(ContextID);
+    hProfiles[1] = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
 
-    x1 = cmsCreateTransform(h1, TYPE_CMYK_8, h1, TYPE_RGB_8, 0, 0);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
-    }
+    for (Pass=0; Pass < 2; Pass++) {
 
-    x1 = cmsCreateTransform(h1, TYPE_RGB_8, h1, TYPE_CMYK_8, 1, 0);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
-    }
+        if (Pass == 1) {
+            cmsFreezeProfile(hProfiles[0]);
+            cmsFreezeProfile(hProfiles[1]);
+        }
 
-    // sRGB does its output as XYZ!
-    x1 = cmsCreateTransform(h1, TYPE_RGB_8, NULL, TYPE_Lab_8, 1, 0);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
-    }
+        if (!cmsCreateTransformBundleTHR(ContextID, hProfiles, 2, TYPE_RGB_8, TYPE_CMYK_8, Variants, 8, 4, Bundle)) {
+            Fail("Cannot create bundle");
+            rc = 0;
+            goto Error;
+        }
 
-    cmsCloseProfile(h1);
+        if (Pass == 0 && (cmsIsProfileFrozen(hProfiles[0]) || cmsIsProfileFrozen(hProfiles[1]))) {
+            Fail("Caller profiles should be left alone");
+            rc = 0;
+        }
 
+        for (i=0; i < 8; i++) {
 
-    {
+            xform = cmsCreateMultiprofileTransformTHR(ContextID, hProfiles, 2, TYPE_RGB_8, TYPE_CMYK_8, Variants[i].Intent, Variants[i].dwFlags);
 
-    cmsHPROFILE h1 = cmsOpenProfileFromFile("test1.icc", "r");
-    cmsHPROFILE h2 = cmsCreate_sRGBProfile();
+            cmsDoTransform(Bundle[i], In, Out1, 64);
+            cmsDoTransform(xform, In, Out2, 64);
 
-    x1 = cmsCreateTransform(h1, TYPE_BGR_8, h2, TYPE_BGR_8, INTENT_PERCEPTUAL, 0);
+            if (memcmp(Out1, Out2, sizeof(Out1)) != 0) {
+                Fail("Variant %d differs, pass %d", i, Pass);
+                rc = 0;
+            }
 
-    cmsCloseProfile(h1); cmsCloseProfile(h2);
-    if (x1 != NULL) {
-        cmsDeleteTransform(x1);
-        return 0;
+            cmsDeleteTransform(xform);
+            cmsDeleteTransform(Bundle[i]);
+        }
     }
+
+    // Black points of the BPC variants and the sRGB segment are now kept by the frozen profiles
+    hFresh = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
+
+    for (i=INTENT_PERCEPTUAL; i <= INTENT_SATURATION; i++) {
+
+        if (!_cmsReadMemoBlackPoint(hProfiles[1], LCMS_USED_AS_OUTPUT, i, &Kept)) {
+            Fail("Black point for intent %d not kept", i);
+            rc = 0;
+            continue;
+        }
+
+        cmsDetectDestinationBlackPoint(&Fresh, hFresh, i, 0);
+
+        if (memcmp(&Kept, &Fresh, sizeof(cmsCIEXYZ)) != 0) {
+            Fail("Black point for intent %d differs", i);
+            rc = 0;
+        }
     }
 
-    return 1;
+    cmsCloseProfile(hFresh);
+
+    Lut = _cmsReadMemoShaper(hProfiles[0], LCMS_USED_AS_INPUT);
+    if (Lut == NULL) {
+        Fail("sRGB matrix-shaper not kept");
+        rc = 0;
+    }
+    else
+        cmsPipelineFree(Lut);
 
+Error:
+    cmsCloseProfile(hProfiles[0]);
+    cmsCloseProfile(hProfiles[1]);
+    return rc;
 }
 
+// A device link made from an optimized transform should reuse its table, not resample it again
 static
-cmsInt32Number CheckErrReportingOnBadTransforms(void)
+cmsInt32Number CheckDeviceLinkFromOptimized(void)
 {
-    cmsInt32Number rc;
+    cmsContext ContextID = DbgThread();
+    cmsHPROFILE hsRGB, hCMYK, hLink;
+    cmsHTRANSFORM xform, xlink;
+    cmsUInt16Number In[3], Out1[4], Out2[4];
+    cmsUInt32Number r, g, b, i;
+    cmsFloat64Number Versions[] = { 3.4, 4.3 };
+    cmsInt32Number v, MaxErr = 0;
 
-    cmsSetLogErrorHandler(ErrorReportingFunction);
-    rc = CheckBadTransforms();
-    cmsSetLogErrorHandler(FatalErrorQuit);
+    hsRGB = cmsCreate_sRGBProfileTHR(ContextID);
+    hCMYK = cmsOpenProfileFromFileTHR(ContextID, "test1.icc", "r");
 
-    // Reset the error state
-    TrappedError = FALSE;
-    return rc;
-}
+    xform = cmsCreateTransformTHR(ContextID, hsRGB, TYPE_RGB_16, hCMYK, TYPE_CMYK_16, INTENT_PERCEPTUAL, 0);
+    cmsCloseProfile(hsRGB);
+    cmsCloseProfile(hCMYK);
+    if (xform == NULL) return 0;
+
+    for (v=0; v < 2; v++) {
+
+        hLink = cmsTransform2DeviceLink(xform, Versions[v], 0);
+        if (hLink == NULL) { cmsDeleteTransform(xform); return 0; }
 
+        xlink = cmsCreateTransformTHR(ContextID, hLink, TYPE_RGB_16, NULL, TYPE_CMYK_16, INTENT_PERCEPTUAL, 0);
+        cmsCloseProfile(hLink);
+        if (xlink == NULL) { cmsDeleteTransform(xform); return 0; }
 
+        for (r=0; r < 65536; r += 4369)
+            for (g=0; g < 65536; g += 4369)
+                for (b=0; b < 65536; b += 4369) {
+
+                    In[0] = (cmsUInt16Number) r; In[1] = (cmsUInt16Number) g; In[2] = (cmsUInt16Number) b;
+
+                    cmsDoTransform(xform, In, Out1, 1);
+                    cmsDoTransform(xlink, In, Out2, 1);
+
+                    for (i=0; i < 4; i++) {
+                        cmsInt32Number d = abs((cmsInt32Number) Out1[i] - (cmsInt32Number) Out2[i]);
+                        if (d > MaxErr) MaxErr = d;
+                    }
+                }
+
+        cmsDeleteTransform(xlink);
+    }
+
+    cmsDeleteTransform(xform);
+
+    // Only the 16 bits rounding of the prelinearization curves is allowed
+    if (MaxErr > 2) {
+        Fail("Device link deviates %d from transform", MaxErr);
+        return 0;
+    }
+
+    return 1;
+}
 
 
 // ---------------------------------------------------------------------------------------------------------
@@ -6120,50 +8539,180 @@ cmsInt32Number CheckCMYK(cmsInt32Number Intent, const char *Profile1, const char
         CMYK1[2] = 30;
         CMYK1[3] = (cmsFloat32Number) i;
 
-        cmsDoTransform(fogra_lab, CMYK1, &Lab1, 1);
-        cmsDoTransform(xform, CMYK1, CMYK2, 1);
-        cmsDoTransform(swop_lab, CMYK2, &Lab2, 1);
+        cmsDoTransform(fogra_lab, CMYK1, &Lab1, 1);
+        cmsDoTransform(xform, CMYK1, CMYK2, 1);
+        cmsDoTransform(swop_lab, CMYK2, &Lab2, 1);
+
+        DeltaL = fabs(Lab1.L - Lab2.L);
+
+        if (DeltaL > Max) Max = DeltaL;
+    }
+
+
+    cmsCloseProfile(hSWOP);
+    cmsCloseProfile(hFOGRA);
+    cmsCloseProfile(hLab);
+
+    cmsDeleteTransform(xform);
+    cmsDeleteTransform(swop_lab);
+    cmsDeleteTransform(fogra_lab);
+
+    return Max < 3.0;
+}
+
+static
+cmsInt32Number CheckCMYKRoundtrip(void)
+{
+    return CheckCMYK(INTENT_RELATIVE_COLORIMETRIC, "test1.icc", "test1.icc");
+}
+
+
+static
+cmsInt32Number CheckCMYKPerceptual(void)
+{
+    return CheckCMYK(INTENT_PERCEPTUAL, "test1.icc", "test2.icc");
+}
+
+
+
+static
+cmsInt32Number CheckCMYKRelCol(void)
+{
+    return CheckCMYK(INTENT_RELATIVE_COLORIMETRIC, "test1.icc", "test2.icc");
+}
+
+
+
+// CIECAM02 stages in an abstract profile should be baked into the optimized transform
+static
+cmsInt32Number CheckCAM02Stages(void)
+{
+    cmsViewingConditions vc;
+    cmsFloat64Number Scale[] = { 0.9, 0, 0,  0, 1, 0,  0, 0, 1 };
+    cmsPipeline* Lut;
+    cmsStage* mpe;
+    cmsHPROFILE hsRGB, hAbstract;
+    cmsHTRANSFORM xformRef, xformOpt;
+    cmsFloat32Number In[3], Out[3];
+    cmsUInt16Number In16[3], Out1[3], Out2[3];
+    cmsInt32Number i, j, Diff, MaxDiff = 0;
+    cmsBool HasCAM02 = FALSE;
+
+    vc.whitePoint.X = 96.42; vc.whitePoint.Y = 100; vc.whitePoint.Z = 82.49;
+    vc.Yb = 20;
+    vc.La = 20;
+    vc.surround = AVG_SURROUND;
+    vc.D_value = D_CALCULATE;
+
+    // Forward and reverse should cancel
+    Lut = cmsPipelineAlloc(DbgThread(), 3, 3);
+    cmsPipelineInsertStage(Lut, cmsAT_END, cmsStageAllocCIECAM02Forward(DbgThread(), &vc));
+    cmsPipelineInsertStage(Lut, cmsAT_END, cmsStageAllocCIECAM02Reverse(DbgThread(), &vc));
+
+    for (i=1; i < 20; i++) {
+
+        In[0] = i * 0.025f; In[1] = i * 0.02f; In[2] = i * 0.015f;
+        cmsPipelineEvalFloat(In, Out, Lut);
+
+        for (j=0; j < 3; j++) {
+            if (fabs(In[j] - Out[j]) > 1E-4) {
+                cmsPipelineFree(Lut);
+                return 0;
+            }
+        }
+    }
+    cmsPipelineFree(Lut);
+
+    // Copies keep the precision policy the stage was created with
+    {
+        cmsPipeline *Exact, *Copy;
+        cmsFloat32Number OutCopy[3];
+        cmsInt32Number Old;
+
+        Old   = cmsSetPrecisionPolicy(cmsPRECISION_EXACT);
+        Exact = cmsPipelineAlloc(DbgThread(), 3, 3);
+        cmsPipelineInsertStage(Exact, cmsAT_END, cmsStageAllocCIECAM02Forward(DbgThread(), &vc));
+        cmsSetPrecisionPolicy(cmsPRECISION_FAST);
+        Copy  = cmsPipelineDup(Exact);
+        cmsSetPrecisionPolicy(Old);
+
+        for (i=1; i < 200; i++) {
+
+            In[0] = i * 0.0025f; In[1] = (200 - i) * 0.002f; In[2] = (i % 17) * 0.05f;
+            cmsPipelineEvalFloat(In, Out, Exact);
+            cmsPipelineEvalFloat(In, OutCopy, Copy);
+
+            if (memcmp(Out, OutCopy, sizeof(Out)) != 0) {
+                Fail("Copy of a CIECAM02 stage changed its precision");
+                cmsPipelineFree(Exact); cmsPipelineFree(Copy);
+                return 0;
+            }
+        }
+
+        cmsPipelineFree(Exact); cmsPipelineFree(Copy);
+    }
+
+    // An abstract profile darkening J
+    Lut = cmsPipelineAlloc(DbgThread(), 3, 3);
+    cmsPipelineInsertStage(Lut, cmsAT_END, cmsStageAllocCIECAM02Forward(DbgThread(), &vc));
+    cmsPipelineInsertStage(Lut, cmsAT_END, cmsStageAllocMatrix(DbgThread(), 3, 3, Scale, NULL));
+    cmsPipelineInsertStage(Lut, cmsAT_END, cmsStageAllocCIECAM02Reverse(DbgThread(), &vc));
 
-        DeltaL = fabs(Lab1.L - Lab2.L);
+    hAbstract = cmsCreateProfilePlaceholder(DbgThread());
+    cmsSetProfileVersion(hAbstract, 4.2);
+    cmsSetDeviceClass(hAbstract, cmsSigAbstractClass);
+    cmsSetColorSpace(hAbstract, cmsSigXYZData);
+    cmsSetPCS(hAbstract, cmsSigXYZData);
+    cmsWriteTag(hAbstract, cmsSigAToB0Tag, Lut);
+    cmsPipelineFree(Lut);
 
-        if (DeltaL > Max) Max = DeltaL;
+    hsRGB = cmsCreate_sRGBProfileTHR(DbgThread());
+    {
+        cmsHPROFILE Profiles[3];
+
+        Profiles[0] = hsRGB; Profiles[1] = hAbstract; Profiles[2] = hsRGB;
+
+        xformRef = cmsCreateMultiprofileTransformTHR(DbgThread(), Profiles, 3, TYPE_RGB_16, TYPE_RGB_16, INTENT_PERCEPTUAL, cmsFLAGS_NOOPTIMIZE);
+        xformOpt = cmsCreateMultiprofileTransformTHR(DbgThread(), Profiles, 3, TYPE_RGB_16, TYPE_RGB_16, INTENT_PERCEPTUAL, 0);
     }
+    cmsCloseProfile(hsRGB); cmsCloseProfile(hAbstract);
 
+    for (mpe = cmsPipelineGetPtrToFirstStage(((_cmsTRANSFORM*) xformOpt) ->Lut); mpe != NULL; mpe = cmsStageNext(mpe))
+        if (cmsStageType(mpe) == cmsSigCAM02ForwardElemType || cmsStageType(mpe) == cmsSigCAM02ReverseElemType) HasCAM02 = TRUE;
 
-    cmsCloseProfile(hSWOP);
-    cmsCloseProfile(hFOGRA);
-    cmsCloseProfile(hLab);
+    for (i=0; i < 2000; i++) {
 
-    cmsDeleteTransform(xform);
-    cmsDeleteTransform(swop_lab);
-    cmsDeleteTransform(fogra_lab);
+        for (j=0; j < 3; j++) 
+            In16[j] = (cmsUInt16Number) ((i * 7919 * (j + 1) + j * 0x3333) & 0xFFFF);
 
-    return Max < 3.0;
-}
+        cmsDoTransform(xformRef, In16, Out1, 1);
+        cmsDoTransform(xformOpt, In16, Out2, 1);
 
-static
-cmsInt32Number CheckCMYKRoundtrip(void)
-{
-    return CheckCMYK(INTENT_RELATIVE_COLORIMETRIC, "test1.icc", "test1.icc");
-}
+        for (j=0; j < 3; j++) {
 
+            Diff = abs((int) Out1[j] - (int) Out2[j]);
+            if (Diff > MaxDiff) MaxDiff = Diff;
+        }
+    }
 
-static
-cmsInt32Number CheckCMYKPerceptual(void)
-{
-    return CheckCMYK(INTENT_PERCEPTUAL, "test1.icc", "test2.icc");
-}
+    cmsDeleteTransform(xformRef);
+    cmsDeleteTransform(xformOpt);
 
+    if (HasCAM02) {
+        Fail("CIECAM02 stages were not optimized");
+        return 0;
+    }
 
+    // The model is quite non-linear near black, so resampling error is higher than on colorimetric transforms
+    if (MaxDiff > 0x400) {
+        Fail("CIECAM02 optimized transform deviates %d", MaxDiff);
+        return 0;
+    }
 
-static
-cmsInt32Number CheckCMYKRelCol(void)
-{
-    return CheckCMYK(INTENT_RELATIVE_COLORIMETRIC, "test1.icc", "test2.icc");
+    return 1;
 }
 
 
-
 static
 cmsInt32Number CheckKOnlyBlackPreserving(void)
 {
@@ -6678,6 +9227,106 @@ cmsInt32Number CheckPostScript(void)
 }
 
 
+// Gets the bytes of all CLUT strings on a CRD, which may be hex, ASCII85 or binary tokens
+static
+cmsUInt32Number DecodePSStrings(const cmsUInt8Number* ps, cmsUInt32Number n, cmsUInt8Number* Out)
+{
+    cmsUInt32Number i = 0, j, nOut = 0, Group, Count, Len;
+    unsigned int v;
+
+    while (i < n) {
+
+        if (ps[i] == 143) {                             // Binary token
+
+            Len = (ps[i+1] << 8) | ps[i+2];
+            memmove(Out + nOut, ps + i + 3, Len);
+            nOut += Len;
+            i += Len + 3;
+        }
+        else
+        if (ps[i] == '<' && i + 1 < n && ps[i+1] == '~') {   // ASCII85
+
+            Group = 0; Count = 0;
+            for (i += 2; ps[i] != '~'; i++) {
+
+                if (ps[i] == '\n') continue;
+
+                if (ps[i] == 'z') {
+                    memset(Out + nOut, 0, 4); nOut += 4;
+                    continue;
+                }
+
+                Group = Group * 85 + (ps[i] - '!');
+                if (++Count == 5) {
+                    for (j=0; j < 4; j++) Out[nOut++] = (cmsUInt8Number) (Group >> (24 - 8*j));
+                    Group = 0; Count = 0;
+                }
+            }
+
+            if (Count > 0) {
+                for (j=Count; j < 5; j++) Group = Group * 85 + 84;
+                for (j=0; j < Count - 1; j++) Out[nOut++] = (cmsUInt8Number) (Group >> (24 - 8*j));
+            }
+
+            i += 2;
+        }
+        else
+        if (ps[i] == '<' && i + 1 < n && ps[i+1] != '<' && (i == 0 || ps[i-1] != '<')) {      // Hex
+
+            for (i++; ps[i] != '>'; i++) {
+
+                if (ps[i] == '\n') continue;
+                sscanf((const char*) ps + i, "%2x", &v);
+                Out[nOut++] = (cmsUInt8Number) v;
+                i++;
+            }
+            i++;
+        }
+        else i++;
+    }
+
+    return nOut;
+}
+
+// All CLUT encodings should carry the same bytes, and get smaller than hex
+static
+cmsInt32Number CheckPostScriptEncodings(void)
+{
+    static const cmsUInt32Number Flags[3] = { 0, cmsFLAGS_PS_ASCII85, cmsFLAGS_PS_BINARY };
+    cmsHPROFILE hProfile = cmsOpenProfileFromFileTHR(DbgThread(), "test1.icc", "r");
+    cmsUInt8Number* ps;
+    cmsUInt8Number* Data[3];
+    cmsUInt32Number i, n, Size[3], nData[3];
+    cmsInt32Number rc = 1;
+
+    for (i=0; i < 3; i++) {
+
+        n = cmsGetPostScriptCRD(DbgThread(), hProfile, 0, Flags[i], NULL, 0);
+        ps = (cmsUInt8Number*) malloc(n);
+        cmsGetPostScriptCRD(DbgThread(), hProfile, 0, Flags[i], ps, n);
+
+        Size[i] = n;
+        Data[i] = (cmsUInt8Number*) malloc(n);
+        nData[i] = DecodePSStrings(ps, n, Data[i]);
+        free(ps);
+    }
+
+    if (nData[0] == 0 || nData[1] != nData[0] || nData[2] != nData[0] ||
+        memcmp(Data[0], Data[1], nData[0]) != 0 || memcmp(Data[0], Data[2], nData[0]) != 0) {
+        Fail("CLUT strings differ among encodings");
+        rc = 0;
+    }
+
+    if (Size[1] >= Size[0] * 0.7 || Size[2] >= Size[1]) {
+        Fail("Encoded CRD is too big: %d, %d, %d bytes", Size[0], Size[1], Size[2]);
+        rc = 0;
+    }
+
+    for (i=0; i < 3; i++) free(Data[i]);
+    cmsCloseProfile(hProfile);
+    return rc;
+}
+
 static
 cmsInt32Number CheckGray(cmsHTRANSFORM xform, cmsUInt8Number g, double L)
 {
@@ -7290,6 +9939,189 @@ cmsHPROFILE CreateCurves(void)
 }
     
 
+// Interpolators alone, on random tables. Each call evaluates one pixel, so ns/call is ns/pixel as well;
+// the figure per output channel is given to compare LUTs of different width.
+
+#define INTERP_BENCH_PIXELS  4096
+
+static
+void SpeedTestInterpolator(const char* Title, cmsUInt32Number nInputs, cmsUInt32Number nOutputs, cmsUInt32Number nGrid, cmsUInt32Number dwFlags)
+{
+    cmsBool IsFloat = (dwFlags & CMS_LERP_FLAGS_FLOAT) != 0;
+    cmsUInt32Number nSamples[MAX_INPUT_DIMENSIONS];
+    cmsUInt32Number i, nEntries, nCalls;
+    cmsUInt16Number*  In16;
+    cmsFloat32Number* InF;
+    cmsUInt16Number   Out16[MAX_STAGE_CHANNELS];
+    cmsFloat32Number  OutF[MAX_STAGE_CHANNELS];
+    void* Table;
+    cmsInterpParams* p;
+    clock_t atime;
+    cmsFloat64Number ns;
+
+    nEntries = nOutputs;
+    for (i=0; i < nInputs; i++) {
+        nSamples[i] = nGrid;
+        nEntries *= nGrid;
+    }
+
+    Table = malloc(nEntries * (IsFloat ? sizeof(cmsFloat32Number) : sizeof(cmsUInt16Number)));
+    In16  = (cmsUInt16Number*)  malloc(INTERP_BENCH_PIXELS * nInputs * sizeof(cmsUInt16Number));
+    InF   = (cmsFloat32Number*) malloc(INTERP_BENCH_PIXELS * nInputs * sizeof(cmsFloat32Number));
+    if (Table == NULL || In16 == NULL || InF == NULL) Die("Not enough memory");
+
+    TestSeed = 1;
+    for (i=0; i < nEntries; i++) {
+
+        if (IsFloat) ((cmsFloat32Number*) Table)[i] = (cmsFloat32Number) TestRandom(65536) / 65535.0F;
+        else         ((cmsUInt16Number*)  Table)[i] = (cmsUInt16Number) TestRandom(65536);
+    }
+
+    for (i=0; i < INTERP_BENCH_PIXELS * nInputs; i++) {
+
+        In16[i] = (cmsUInt16Number) TestRandom(65536);
+        InF[i]  = In16[i] / 65535.0F;
+    }
+
+    p = _cmsComputeInterpParamsEx(DbgThread(), nSamples, nInputs, nOutputs, Table, dwFlags);
+    if (p == NULL) Die("Unable to create interpolator");
+
+    // Every extra input doubles the work, so keep the time about the same
+    nCalls = 1 << 20;
+    if (nInputs > 3) nCalls >>= (nInputs - 3);
+
+    TitlePerformance(Title);
+
+    atime = clock();
+
+    if (IsFloat) {
+        for (i=0; i < nCalls; i++)
+            p ->Interpolation.LerpFloat(InF + (i % INTERP_BENCH_PIXELS) * nInputs, OutF, p);
+    }
+    else {
+        for (i=0; i < nCalls; i++)
+            p ->Interpolation.Lerp16(In16 + (i % INTERP_BENCH_PIXELS) * nInputs, Out16, p);
+    }
+
+    ns = (cmsFloat64Number) (clock() - atime) * 1.0E9 / CLOCKS_PER_SEC / nCalls;
+
+    printf("%.1f ns/call (%.2f ns/channel)\n", ns, ns / nOutputs);
+    fflush(stdout);
+
+    _cmsFreeInterpParams(p);
+    free(Table);
+    free(In16);
+    free(InF);
+}
+
+static
+void SpeedTestInterpolators(void)
+{
+    SpeedTestInterpolator("LinLerp1D 4096 nodes (16)",                1, 1, 4096, CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("LinLerp1D 4096 nodes (float)",             1, 1, 4096, CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval1Input 256 nodes -> 3 (16)",           1, 3, 256,  CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval1Input 256 nodes -> 3 (float)",        1, 3, 256,  CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Bilinear 33x33 -> 3 (16)",                 2, 3, 33,   CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Bilinear 33x33 -> 3 (float)",              2, 3, 33,   CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Trilinear 33^3 -> 3 (16)",                 3, 3, 33,   CMS_LERP_FLAGS_TRILINEAR);
+    SpeedTestInterpolator("Trilinear 33^3 -> 3 (float)",              3, 3, 33,   CMS_LERP_FLAGS_FLOAT|CMS_LERP_FLAGS_TRILINEAR);
+    SpeedTestInterpolator("Tetrahedral 32^3 -> 3 (16)",               3, 3, 32,   CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Tetrahedral 33^3 -> 3 (16, specialized)",  3, 3, 33,   CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Tetrahedral 33^3 -> 3 (float)",            3, 3, 33,   CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval4Inputs 17^4 -> 3 (16)",               4, 3, 17,   CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval4Inputs 17^4 -> 3 (float)",            4, 3, 17,   CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval5Inputs 9^5 -> 3 (16)",                5, 3, 9,    CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval5Inputs 9^5 -> 3 (float)",             5, 3, 9,    CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval6Inputs 7^6 -> 3 (16)",                6, 3, 7,    CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval6Inputs 7^6 -> 3 (float)",             6, 3, 7,    CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval7Inputs 5^7 -> 3 (16)",                7, 3, 5,    CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval7Inputs 5^7 -> 3 (float)",             7, 3, 5,    CMS_LERP_FLAGS_FLOAT);
+    SpeedTestInterpolator("Eval8Inputs 4^8 -> 3 (16)",                8, 3, 4,    CMS_LERP_FLAGS_16BITS);
+    SpeedTestInterpolator("Eval8Inputs 4^8 -> 3 (float)",             8, 3, 4,    CMS_LERP_FLAGS_FLOAT);
+}
+
+
+// Formatters alone, for every type. Catch-all routines looping over channels are marked with '*'.
+
+#define FMT_BENCH_PIXELS  4096
+#define FMT_BENCH_ROUNDS  64
+
+static
+cmsFloat64Number SpeedTestOneFormatter(cmsUInt32Number Type, cmsFormatterDirection Dir, cmsUInt32Number dwFlags, cmsUInt8Number* Buffer)
+{
+    cmsUInt16Number  Values[cmsMAXCHANNELS];
+    cmsFloat32Number ValuesFloat[cmsMAXCHANNELS];
+    cmsFormatter fmt = _cmsGetFormatter(Type, Dir, dwFlags);
+    _cmsTRANSFORM info;
+    cmsUInt32Number i, Round;
+    cmsUInt8Number* ptr;
+    clock_t atime;
+
+    memset(&info, 0, sizeof(info));
+    info.InputFormat = info.OutputFormat = Type;
+
+    for (i=0; i < cmsMAXCHANNELS; i++) {
+        Values[i] = (cmsUInt16Number) (i * 0x1111);
+        ValuesFloat[i] = (cmsFloat32Number) i / cmsMAXCHANNELS;
+    }
+
+    atime = clock();
+
+    for (Round = 0; Round < FMT_BENCH_ROUNDS; Round++) {
+
+        ptr = Buffer;
+        for (i=0; i < FMT_BENCH_PIXELS; i++) {
+
+            if (dwFlags == CMS_PACK_FLAGS_FLOAT)
+                ptr = fmt.FmtFloat(&info, ValuesFloat, ptr, FMT_BENCH_PIXELS);
+            else
+                ptr = fmt.Fmt16(&info, Values, ptr, FMT_BENCH_PIXELS);
+        }
+    }
+
+    return (cmsFloat64Number) (clock() - atime) * 1.0E9 / CLOCKS_PER_SEC / (FMT_BENCH_PIXELS * FMT_BENCH_ROUNDS);
+}
+
+static
+void SpeedTestFormatters(void)
+{
+    static const cmsUInt32Number Modes[] = { CMS_PACK_FLAGS_16BITS, CMS_PACK_FLAGS_FLOAT };
+    cmsUInt8Number* Buffer = (cmsUInt8Number*) malloc(FMT_BENCH_PIXELS * cmsMAXCHANNELS * sizeof(cmsFloat64Number));
+    cmsUInt32Number i, Mode;
+
+    if (Buffer == NULL) Die("Not enough memory");
+    memset(Buffer, 0, FMT_BENCH_PIXELS * cmsMAXCHANNELS * sizeof(cmsFloat64Number));
+
+    printf("\n%-24s %-5s %-32s %9s   %-32s %9s\n", "Type", "", "Unroll", "ns/pixel", "Pack", "ns/pixel");
+
+    for (i=0; i < sizeof(AllFormatterTypes) / sizeof(AllFormatterTypes[0]); i++) {
+
+        const FormatterType* ft = AllFormatterTypes + i;
+
+        for (Mode = 0; Mode < 2; Mode++) {
+
+            cmsBool InGeneric, OutGeneric;
+            const char* InName, *OutName;
+
+            // Only floating point buffers have float formatters
+            if (Modes[Mode] == CMS_PACK_FLAGS_FLOAT && !T_FLOAT(ft ->Type)) continue;
+
+            InName  = _cmsGetStockFormatterName(ft ->Type, cmsFormatterInput,  Modes[Mode], &InGeneric);
+            OutName = _cmsGetStockFormatterName(ft ->Type, cmsFormatterOutput, Modes[Mode], &OutGeneric);
+
+            printf("%-24s %-5s %c%-31s %9.2f   %c%-31s %9.2f\n", 
+                ft ->Name, Modes[Mode] == CMS_PACK_FLAGS_FLOAT ? "float" : "16",
+                InGeneric ? '*' : ' ', InName, 
+                SpeedTestOneFormatter(ft ->Type, cmsFormatterInput, Modes[Mode], Buffer),
+                OutGeneric ? '*' : ' ', OutName, 
+                SpeedTestOneFormatter(ft ->Type, cmsFormatterOutput, Modes[Mode], Buffer));
+            fflush(stdout);
+        }
+    }
+
+    free(Buffer);
+}
+
 static
 void SpeedTest(void)
 {
@@ -7366,6 +10198,9 @@ void SpeedTest(void)
     SpeedTest8bitsGray("8 bits on SAME gray-to-gray",
         cmsOpenProfileFromFile("graylcms2.icc", "r"), 
         cmsOpenProfileFromFile("graylcms2.icc", "r"), INTENT_PERCEPTUAL);
+
+    SpeedTestInterpolators();
+    SpeedTestFormatters();
 }
 
 
@@ -7648,48 +10483,10 @@ cmsPluginParametricCurves NewCurvePlugin = {
 
 // ---------------------------------------------------------------------------------------
 
-int main(int argc, char* argv[])
+// The whole set of checks. Those may run several times, once per CPU level
+static
+void RunAllChecks(cmsInt32Number Exhaustive)
 {
-    cmsInt32Number Exhaustive = 0;
-    cmsInt32Number DoSpeedTests = 1;
-    cmsInt32Number DoCheckTests = 1;
-
-
-
-#ifdef _MSC_VER
-    _CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF ); 
-#endif
-
-    printf("LittleCMS %2.2f test bed %s %s\n\n", LCMS_VERSION / 1000.0, __DATE__, __TIME__);
-
-    if ((argc == 2) && strcmp(argv[1], "--exhaustive") == 0) {
-
-        Exhaustive = 1;
-        printf("Running exhaustive tests (will take a while...)\n\n");
-    }
-
-    
-    printf("Installing debug memory plug-in ... ");
-    cmsPlugin(&DebugMemHandler);
-    printf("done.\n");
-
-    printf("Installing error logger ... ");
-    cmsSetLogErrorHandler(FatalErrorQuit);
-    printf("done.\n");
-
-#ifdef CMS_IS_WINDOWS_     
-      // CheckProfileZOO();
-#endif
-
-    PrintSupportedIntents();
-
-   
-
-    // Create utility profiles
-    Check("Creation of test profiles", CreateTestProfiles);  
-
-    if (DoCheckTests) 
-    {
     Check("Base types", CheckBaseTypes);
     Check("endianess", CheckEndianess);
     Check("quick floor", CheckQuickFloor);
@@ -7728,6 +10525,9 @@ int main(int argc, char* argv[])
         Check("Exhaustive 3D interpolation Trilinear (16) ", ExhaustiveCheck3DinterpolationTrilinear16);
     }
 
+    Check("Grid-specialized tetrahedral kernels", CheckSpecializedTetrahedral16);
+    Check("Interpolator conformance", CheckInterpolatorConformance);
+
     Check("Reverse interpolation 3 -> 3", CheckReverseInterpolation3x3);
     Check("Reverse interpolation 4 -> 3", CheckReverseInterpolation4x3);
   
@@ -7736,6 +10536,11 @@ int main(int argc, char* argv[])
 
     Check("3D interpolation", Check3Dinterp);
     Check("3D interpolation with granularity", Check3DinterpGranular);
+    Check("3D adaptive interpolation", CheckAdaptive3Dinterp);
+    Check("Adaptive CLUT optimization", CheckAdaptiveCLUTOptimization);
+    Check("Matrix-shaper fitting", CheckMatrixShaperFitting);
+    Check("CPU feature levels", CheckCPUFeatureLevels);
+    Check("CPU feature levels on CLUT kernels", CheckCPUFeatureLevelsCLUT);
     Check("4D interpolation", Check4Dinterp);
     Check("4D interpolation with granularity", Check4DinterpGranular);
     Check("5D interpolation with granularity", Check5DinterpGranular);
@@ -7799,10 +10604,16 @@ int main(int argc, char* argv[])
     Check("Named Color LUT", CheckNamedColorLUT);
     Check("Usual formatters", CheckFormatters16);
     Check("Floating point formatters", CheckFormattersFloat);
+    Check("Packing words takes the output endianness", CheckPackWordsEndianness);
+    Check("Swap first with extra channels", CheckSwapFirstExtraChannel);
+    Check("Swapped endian BGRA 16 bits", CheckBGRA16SwappedEndian);
+    Check("LabV2 encoding round trip", CheckLabV2RoundTrip);
+    Check("Formatter conformance", CheckFormatterConformance);
 
     // ChangeBuffersFormat
     Check("ChangeBuffersFormat", CheckChangeBufferFormat);
-    
+    Check("Run-length cache", CheckRunLengthCache);
+
     // MLU    
     Check("Multilocalized Unicode", CheckMLU);
     
@@ -7816,12 +10627,27 @@ int main(int argc, char* argv[])
     // Error reporting
     Check("Error reporting on bad profiles", CheckErrReportingOnBadProfiles);
     Check("Error reporting on bad transforms", CheckErrReportingOnBadTransforms);
+    Check("Error filtering and counting", CheckErrorFiltering);
+    Check("Resource limits", CheckResourceLimits);
     
     // Transforms
     Check("Curves only transforms", CheckCurvesOnlyTransforms);
     Check("Float Lab->Lab transforms", CheckFloatLabTransforms);
     Check("Encoded Lab->Lab transforms", CheckEncodedLabTransforms);    
     Check("Stored identities", CheckStoredIdentities);
+    Check("Transform tables", CheckTransformTable);
+    Check("Table sharing", CheckTableSharing);
+    Check("Profile retain and freeze", CheckProfileRetainAndFreeze);
+    Check("Parallel slicing", CheckParallelSlicing);
+    Check("Profile validation", CheckProfileValidation);
+    Check("Many tags", CheckManyTags);
+    Check("Precision policy", CheckPrecisionPolicy);
+    Check("Device link from optimized transform", CheckDeviceLinkFromOptimized);
+    Check("Transform bundles", CheckTransformBundle);
+    Check("Sparse transforms", CheckSparseTransforms);
+    Check("Palette transforms", CheckPaletteTransform);
+    Check("Named color search", CheckNamedColorSearch);
+    Check("Vectored transforms", CheckVectorTransforms);
 
     Check("Matrix-shaper transform (float)",   CheckMatrixShaperXFORMFloat);
     Check("Matrix-shaper transform (16 bits)", CheckMatrixShaperXFORM16);   
@@ -7840,6 +10666,7 @@ int main(int argc, char* argv[])
     Check("Matrix-shaper proofing transform (16 bits)",  CheckProofingXFORM16);
     
     Check("Gamut check", CheckGamutCheck);
+    Check("CIECAM02 pipeline stages", CheckCAM02Stages);
         
     Check("CMYK roundtrip on perceptual transform",   CheckCMYKRoundtrip);
     
@@ -7857,8 +10684,75 @@ int main(int argc, char* argv[])
 
     Check("CGATS parser", CheckCGATS);
     Check("PostScript generator", CheckPostScript);
+    Check("PostScript CLUT encodings", CheckPostScriptEncodings);
     Check("Segment maxima GBD", CheckGBD);
     Check("MD5 digest", CheckMD5);
+}
+
+int main(int argc, char* argv[])
+{
+    cmsInt32Number Exhaustive = 0;
+    cmsInt32Number DoSpeedTests = 1;
+    cmsInt32Number DoCheckTests = 1;
+    cmsInt32Number AllCPULevels = 0;
+    cmsInt32Number Level, MaxLevel;
+
+
+
+#ifdef _MSC_VER
+    _CrtSetDbgFlag ( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF ); 
+#endif
+
+    printf("LittleCMS %2.2f test bed %s %s\n\n", LCMS_VERSION / 1000.0, __DATE__, __TIME__);
+
+    if ((argc == 2) && strcmp(argv[1], "--exhaustive") == 0) {
+
+        Exhaustive = 1;
+        printf("Running exhaustive tests (will take a while...)\n\n");
+    }
+
+    // Kernels are picked by CPU level, so checks may be repeated on each level up to the detected one
+    if ((argc == 2) && strcmp(argv[1], "--cpu-levels") == 0) {
+
+        AllCPULevels = 1;
+        DoSpeedTests = 0;
+        printf("Running checks once per CPU level (up to %d)\n\n", cmsDetectCPUFeatureLevel());
+    }
+
+    
+    printf("Installing debug memory plug-in ... ");
+    cmsPlugin(&DebugMemHandler);
+    printf("done.\n");
+
+    printf("Installing error logger ... ");
+    cmsSetLogErrorHandler(FatalErrorQuit);
+    printf("done.\n");
+
+#ifdef CMS_IS_WINDOWS_     
+      // CheckProfileZOO();
+#endif
+
+    PrintSupportedIntents();
+
+   
+
+    // Create utility profiles
+    Check("Creation of test profiles", CreateTestProfiles);  
+
+    if (DoCheckTests) {
+
+        MaxLevel = AllCPULevels ? cmsDetectCPUFeatureLevel() : cmsCPU_GENERIC;
+
+        for (Level = cmsCPU_GENERIC; Level <= MaxLevel; Level++) {
+
+            if (AllCPULevels) {
+
+                cmsSetCPUFeatureLevel(Level);
+                printf("\nCPU level %d\n\n", Level);
+            }
+
+            RunAllChecks(Exhaustive);
+        }
     }
 
 
@@ -48,6 +48,9 @@ static int PrecalcMode             = 1;
 
 static int jpegQuality             = 75;
 
+static int Reduce                  = 1;      // Preview mode: output is 1/Reduce of the input size
+static cmsBool BoxFilter           = FALSE;  // Average pixels instead of picking them when reducing
+
 static cmsFloat64Number ObserverAdaptationState = 0;
 
 
@@ -846,11 +849,100 @@ void DoEmbedProfile(const char* ProfileFile)
 
 
 
+// Preview mode. The decoder does as much of the reduction as it can by
+// DCT scaling (1/2, 1/4 or 1/8), which skips most of the IDCT work. Whatever
+// is left is done on the decoded scanlines. Returns the remaining factor.
+static
+int SetupPreview(void)
+{
+    int Scale, Box, Factor;
+
+    if (Reduce <= 1) return 1;
+
+    for (Scale = 8; Scale > 1; Scale >>= 1) {
+        if ((Reduce % Scale) == 0) break;
+    }
+
+    Decompressor.scale_num   = 1;
+    Decompressor.scale_denom = Scale;
+    jpeg_calc_output_dimensions(&Decompressor);
+
+    Box = Reduce / Scale;
+
+    if (Box > (int) Decompressor.output_width)  Box = (int) Decompressor.output_width;
+    if (Box > (int) Decompressor.output_height) Box = (int) Decompressor.output_height;
+    if (Box < 1) Box = 1;
+
+    Compressor.image_width  = Decompressor.output_width  / Box;
+    Compressor.image_height = Decompressor.output_height / Box;
+
+    // Keep the physical size of the image
+    if (Compressor.density_unit != 0) {
+
+        Factor = (int) ((Decompressor.image_width + Compressor.image_width / 2) / Compressor.image_width);
+
+        Compressor.X_density = (UINT16) (Compressor.X_density / Factor);
+        Compressor.Y_density = (UINT16) (Compressor.Y_density / Factor);
+        if (Compressor.X_density == 0) Compressor.X_density = 1;
+        if (Compressor.Y_density == 0) Compressor.Y_density = 1;
+    }
+
+    if (Verbose)
+        fprintf(stderr, "Preview %dx%d (DCT scale 1/%d, %s 1/%d)\n", 
+                         Compressor.image_width, Compressor.image_height, Scale,
+                         BoxFilter ? "box filter" : "subsampling", Box);
+
+    return Box;
+}
+
+
+// Reads Box scanlines and reduces them to a single one, either by taking
+// the top-left pixel of each Box x Box block or by averaging the block.
+static
+void ReadReducedScanline(JSAMPROW Lines, JSAMPROW Reduced, int Box)
+{
+    int nChan = Decompressor.num_components;
+    int Stride = Decompressor.output_width * nChan;
+    int Area   = Box * Box;
+    JDIMENSION x;
+    int i, j, k, c;
+
+    for (i=0; i < Box; i++) {
+
+        JSAMPROW Row = Lines + i * Stride;
+        jpeg_read_scanlines(&Decompressor, &Row, 1);
+    }
+
+    for (x=0; x < Compressor.image_width; x++) {
+
+        JSAMPROW Block = Lines + x * Box * nChan;
+
+        for (c=0; c < nChan; c++) {
+
+            if (BoxFilter) {
+
+                int Sum = 0;
+
+                for (j=0; j < Box; j++)
+                    for (k=0; k < Box; k++)
+                        Sum += Block[j * Stride + k * nChan + c];
+
+                *Reduced++ = (JSAMPLE) ((Sum + Area / 2) / Area);
+            }
+            else
+                *Reduced++ = Block[c];
+        }
+    }
+}
+
+
 static
 int DoTransform(cmsHTRANSFORM hXForm, int OutputColorSpace)
 {       
     JSAMPROW ScanLineIn;
     JSAMPROW ScanLineOut;
+    JSAMPROW Reduced = NULL;
+    int      Box;
 
     
        //Preserve resolution values from the original
@@ -860,6 +952,8 @@ int DoTransform(cmsHTRANSFORM hXForm, int OutputColorSpace)
        Compressor.Y_density    = Decompressor.Y_density;
 
       //  Compressor.write_JFIF_header = 1;
+
+       Box = SetupPreview();
      
        jpeg_start_decompress(&Decompressor);
        jpeg_start_compress(&Compressor, TRUE);
@@ -871,21 +965,37 @@ int DoTransform(cmsHTRANSFORM hXForm, int OutputColorSpace)
        if (EmbedProfile && cOutProf) 
            DoEmbedProfile(cOutProf);
 
-       ScanLineIn  = (JSAMPROW) malloc(Decompressor.output_width * Decompressor.num_components);
+       ScanLineIn  = (JSAMPROW) malloc(Box * Decompressor.output_width * Decompressor.num_components);
        ScanLineOut = (JSAMPROW) malloc(Compressor.image_width * Compressor.num_components);
 
-       while (Decompressor.output_scanline <
-                            Decompressor.output_height) {
+       if (Box > 1)
+           Reduced = (JSAMPROW) malloc(Compressor.image_width * Decompressor.num_components);
+
+       while (Compressor.next_scanline < Compressor.image_height) {
+
+       if (Box > 1) {
 
-       jpeg_read_scanlines(&Decompressor, &ScanLineIn, 1);
+           // Fuse the remaining reduction with the transform, so only
+           // the pixels that end up in the preview go through the CMM
+           ReadReducedScanline(ScanLineIn, Reduced, Box);
+           cmsDoTransform(hXForm, Reduced, ScanLineOut, Compressor.image_width);
+       }
+       else {
 
-       cmsDoTransform(hXForm, ScanLineIn, ScanLineOut, Decompressor.output_width);
+           jpeg_read_scanlines(&Decompressor, &ScanLineIn, 1);
+           cmsDoTransform(hXForm, ScanLineIn, ScanLineOut, Decompressor.output_width);
+       }
 
        jpeg_write_scanlines(&Compressor, &ScanLineOut, 1);
        }
 
+       // Rows that don't fill a whole block are discarded
+       while (Decompressor.output_scanline < Decompressor.output_height)
+           jpeg_read_scanlines(&Decompressor, &ScanLineIn, 1);
+
        free(ScanLineIn); 
        free(ScanLineOut);
+       if (Reduced) free(Reduced);
 
        jpeg_finish_decompress(&Decompressor);
        jpeg_finish_compress(&Compressor);
@@ -1074,6 +1184,10 @@ void Help(int level)
      fprintf(stderr, "\n");
      fprintf(stderr, "%cq<0..100> - Output JPEG quality\n", SW);
 
+     fprintf(stderr, "\n");
+     fprintf(stderr, "%cr<1..64> - Preview: reduce image size by this factor\n", SW);
+     fprintf(stderr, "%cx - Preview: box filter instead of subsampling\n", SW);
+
      fprintf(stderr, "\n");
      fprintf(stderr, "%ch<0,1,2,3> - More help\n", SW);
      break;
@@ -1119,7 +1233,7 @@ void HandleSwitches(int argc, char *argv[])
 {
     int s;
     
-    while ((s=xgetopt(argc,argv,"bBnNvVGgh:H:i:I:o:O:P:p:t:T:c:C:Q:q:M:m:L:l:eEs:S:!:D:d:")) != EOF) {
+    while ((s=xgetopt(argc,argv,"bBnNvVGgh:H:i:I:o:O:P:p:t:T:c:C:Q:q:M:m:L:l:eEs:S:!:D:d:r:R:xX")) != EOF) {
         
         switch (s)
         {
@@ -1191,6 +1305,18 @@ void HandleSwitches(int argc, char *argv[])
         case 'G':
             GamutCheck = TRUE;
             break;
+
+        case 'r':
+        case 'R':
+            Reduce = atoi(xoptarg);
+            if (Reduce < 1 || Reduce > 64)
+                FatalError("Reduction factor must be 1..64");
+            break;
+
+        case 'x':
+        case 'X':
+            BoxFilter = TRUE;
+            break;
             
         case 'c':
         case 'C':
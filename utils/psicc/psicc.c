@@ -35,6 +35,7 @@ static int BlackPointCompensation = FALSE;
 static int Undecorated = FALSE;
 static int PrecalcMode = 1;
 static int NumOfGridPoints = 0;
+static int Encoding = 0;
 
 
 // The toggles stuff
@@ -44,7 +45,7 @@ void HandleSwitches(int argc, char *argv[])
 {
        int s;
       
-       while ((s = xgetopt(argc,argv,"uUbBI:i:O:o:T:t:c:C:n:N:")) != EOF) {
+       while ((s = xgetopt(argc,argv,"uUbBI:i:O:o:T:t:c:C:n:N:e:E:")) != EOF) {
 
        switch (s){
 
@@ -91,6 +92,13 @@ void HandleSwitches(int argc, char *argv[])
                 NumOfGridPoints = atoi(xoptarg);
                 break;
 
+       case 'e':
+       case 'E':
+            Encoding = atoi(xoptarg);
+            if (Encoding < 0 || Encoding > 2)
+                    FatalError("ERROR: Unknown encoding '%d'", Encoding);
+            break;
+
 
   default:
 
@@ -117,6 +125,7 @@ void Help(void)
      fprintf(stderr, "%cu - Do NOT generate resource name on CRD\n", SW);    
      fprintf(stderr, "%cc<0,1,2> - Precision (0=LowRes, 1=Normal (default), 2=Hi-res) (CRD only)\n", SW);     
      fprintf(stderr, "%cn<gridpoints> - Alternate way to set precission, number of CLUT points (CRD only)\n", SW);     
+     fprintf(stderr, "%ce<0,1,2> - Encoding of tables (0=Hex (default), 1=ASCII85, 2=Binary)\n", SW);     
      
 	 fprintf(stderr, "\n");
      fprintf(stderr, "This program is intended to be a demo of the little cms\n"
@@ -128,6 +137,18 @@ void Help(void)
 }
 
 
+static
+cmsUInt32Number EncodingFlags(void)
+{
+    switch (Encoding) {
+
+    case 1:  return cmsFLAGS_PS_ASCII85;
+    case 2:  return cmsFLAGS_PS_BINARY;
+    default: return 0;
+    }
+}
+
+
 static
 void GenerateCSA(void)
 {
@@ -137,14 +158,14 @@ void GenerateCSA(void)
 
 	if (hProfile == NULL) return;
 
-	n = cmsGetPostScriptCSA(0, hProfile, Intent, 0, NULL, 0);
+	n = cmsGetPostScriptCSA(0, hProfile, Intent, EncodingFlags(), NULL, 0);
 	if (n == 0) return;
 
 	Buffer = (char*) malloc(n + 1);
-	cmsGetPostScriptCSA(0, hProfile, Intent, 0, Buffer, n);
+	cmsGetPostScriptCSA(0, hProfile, Intent, EncodingFlags(), Buffer, n);
 	Buffer[n] = 0;
 
-	fprintf(OutFile, "%s", Buffer);	
+	fwrite(Buffer, 1, n, OutFile);
 	
 	free(Buffer);
 	cmsCloseProfile(hProfile);
@@ -163,6 +184,7 @@ void GenerateCRD(void)
 
     if (BlackPointCompensation) dwFlags |= cmsFLAGS_BLACKPOINTCOMPENSATION;
     if (Undecorated)            dwFlags |= cmsFLAGS_NODEFAULTRESOURCEDEF;
+    dwFlags |= EncodingFlags();
 
     switch (PrecalcMode) {
            	
@@ -183,7 +205,7 @@ void GenerateCRD(void)
     cmsGetPostScriptCRD(0, hProfile, Intent, dwFlags, Buffer, n);
 	Buffer[n] = 0;
 
-	fprintf(OutFile, "%s", Buffer);			
+	fwrite(Buffer, 1, n, OutFile);
 	free(Buffer);
 	cmsCloseProfile(hProfile);
 }
@@ -205,7 +227,7 @@ int main(int argc, char *argv[])
 	 if (nargs == 0) 
 			OutFile = stdout;
 	 else
-			OutFile = fopen(argv[xoptind], "wt");
+			OutFile = fopen(argv[xoptind], Encoding == 2 ? "wb" : "wt");
 	   		
 
 	 if (cInProf == NULL && cOutProf == NULL)
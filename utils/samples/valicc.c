@@ -0,0 +1,335 @@
+//---------------------------------------------------------------------------------
+//
+//  Little Color Management System
+//  Copyright (c) 1998-2011 Marti Maria Saguer
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//---------------------------------------------------------------------------------
+//
+
+
+// Example: deep validation of many profiles at once, as an ingestion pipeline would do before accepting
+// customer profiles. Every profile is memory mapped, fully decoded and checked in place by cmsValidateProfileMem.
+// Profiles are spread over several threads and the time taken by each one is reported. Threads come
+// from the library runner, _cmsRunThreads.
+//
+// Build with:
+//
+//    cc -I../../include -I../common valicc.c ../common/xgetopt.c ../common/vprf.c -llcms2
+//
+// Exit code is the number of rejected profiles, up to 255.
+
+#include "utils.h"
+#include "lcms2_plugin.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <sys/time.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#endif
+
+#define MAX_THREADS     64
+
+typedef struct {
+
+    const char*          FileName;
+    cmsBool              Done;
+    cmsBool              Ok;
+    double               Time;
+    cmsProfileValidation Report;
+
+} Job;
+
+static int nThreads   = 4;
+static cmsBool FailFast   = FALSE;
+static cmsBool StopOnFail = FALSE;
+
+static Job* Jobs = NULL;
+static int  nJobs = 0;
+
+// Raised when a profile is rejected and -s was given
+static volatile int Stop = 0;
+
+
+// Wall clock in milliseconds
+static
+double Now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER Freq, Count;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Count);
+    return 1000.0 * (double) Count.QuadPart / (double) Freq.QuadPart;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+
+// Maps the file and validates the profile right on the mapping, which is released afterwards
+static
+cmsBool ValidateMapped(const char* FileName, cmsProfileValidation* Report)
+{
+    cmsBool Ok = FALSE;
+
+#ifdef _WIN32
+    HANDLE hFile, hMap;
+    LARGE_INTEGER Size;
+    void* Ptr;
+
+    hFile = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        strcpy(Report ->FirstError, "Cannot open the file");
+        return FALSE;
+    }
+
+    if (GetFileSizeEx(hFile, &Size) && Size.QuadPart > 0 && Size.QuadPart < 0x7FFFFFFF) {
+
+        hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMap != NULL) {
+
+            Ptr = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+            if (Ptr != NULL) {
+
+                Ok = cmsValidateProfileMem(NULL, Ptr, (cmsUInt32Number) Size.QuadPart, FailFast, Report);
+                UnmapViewOfFile(Ptr);
+            }
+            CloseHandle(hMap);
+        }
+    }
+
+    CloseHandle(hFile);
+#else
+    struct stat st;
+    void* Ptr;
+    int fd;
+
+    fd = open(FileName, O_RDONLY);
+    if (fd < 0) {
+        strcpy(Report ->FirstError, "Cannot open the file");
+        return FALSE;
+    }
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size < 0x7FFFFFFF) {
+
+        Ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (Ptr != MAP_FAILED) {
+
+            Ok = cmsValidateProfileMem(NULL, Ptr, (cmsUInt32Number) st.st_size, FailFast, Report);
+            munmap(Ptr, (size_t) st.st_size);
+        }
+    }
+
+    close(fd);
+#endif
+
+    // Nothing was reported if the file could not be mapped
+    if (!Ok && Report ->nErrors == 0)
+        strcpy(Report ->FirstError, "Cannot map the file");
+
+    return Ok;
+}
+
+static
+void ValidateOne(Job* j)
+{
+    double t = Now();
+
+    j ->Ok   = ValidateMapped(j ->FileName, &j ->Report);
+    j ->Time = Now() - t;
+    j ->Done = TRUE;
+
+    if (!j ->Ok && StopOnFail) Stop = 1;
+}
+
+// Each worker takes every nThreads-th profile
+static
+void ValidateEntries(int Worker)
+{
+    int i;
+
+    for (i = Worker; i < nJobs && !Stop; i += nThreads)
+        ValidateOne(&Jobs[i]);
+}
+
+// The cargo of each thread is just its worker number
+static
+void WorkerThread(void* Cargo)
+{
+    ValidateEntries(*(int*) Cargo);
+}
+
+static
+void ValidateAll(void)
+{
+    int Workers[MAX_THREADS];
+    int i;
+
+    for (i=0; i < nThreads; i++)
+        Workers[i] = i;
+
+    _cmsRunThreads(NULL, (cmsUInt32Number) nThreads, WorkerThread, Workers, sizeof(int));
+}
+
+// Which areas failed, as text
+static
+const char* AreaNames(cmsUInt32Number Failed, char* Buffer)
+{
+    static const struct { cmsUInt32Number Flag; const char* Name; } Areas[] = {
+
+        { cmsVALIDATE_HEADER,   "header" },
+        { cmsVALIDATE_TAGTABLE, "tags" },
+        { cmsVALIDATE_DECODE,   "decode" },
+        { cmsVALIDATE_CURVES,   "curves" },
+        { cmsVALIDATE_MATRIX,   "matrix" },
+        { cmsVALIDATE_CLUT,     "clut" },
+        { cmsVALIDATE_ID,       "id" }
+    };
+    int i;
+
+    Buffer[0] = 0;
+    for (i=0; i < (int) (sizeof(Areas) / sizeof(Areas[0])); i++) {
+
+        if (Failed & Areas[i].Flag) {
+            if (Buffer[0]) strcat(Buffer, ",");
+            strcat(Buffer, Areas[i].Name);
+        }
+    }
+
+    return Buffer;
+}
+
+
+static
+void Help(void)
+{
+    fprintf(stderr, "little cms profile validator - v1.0 (lcms %2.2f)\n\n", LCMS_VERSION / 1000.0);
+    fprintf(stderr, "usage: valicc [flags] <profiles...>\n\n");
+    fprintf(stderr, "flags:\n\n");
+    fprintf(stderr, "%ct<n> - Number of threads (default 4, max %d)\n", SW, MAX_THREADS);
+    fprintf(stderr, "%cf - Stop checking a profile on its first error\n", SW);
+    fprintf(stderr, "%cs - Stop the whole batch on the first rejected profile\n", SW);
+    fprintf(stderr, "%cv<0..3> - Verbosity level, -1 hides library messages\n\n", SW);
+    exit(0);
+}
+
+static
+void HandleSwitches(int argc, char *argv[])
+{
+    int s;
+
+    while ((s = xgetopt(argc, argv, "t:T:fFsSv:V:h:H")) != EOF) {
+
+        switch (s) {
+
+        case 't':
+        case 'T':
+            nThreads = atoi(xoptarg);
+            if (nThreads < 1 || nThreads > MAX_THREADS)
+                FatalError("Number of threads should be 1..%d", MAX_THREADS);
+            break;
+
+        case 'f':
+        case 'F':
+            FailFast = TRUE;
+            break;
+
+        case 's':
+        case 'S':
+            StopOnFail = TRUE;
+            break;
+
+        case 'v':
+        case 'V':
+            Verbose = atoi(xoptarg);
+            break;
+
+        case 'h':
+        case 'H':
+        default:
+            Help();
+        }
+    }
+
+    if (argc - xoptind < 1) Help();
+}
+
+
+int main(int argc, char *argv[])
+{
+    int i, nRejected = 0, nSkipped = 0;
+    double Start, Wall, Sum = 0, Slowest = 0;
+    char Areas[128];
+
+    InitUtils("valicc");
+    HandleSwitches(argc, argv);
+
+    nJobs = argc - xoptind;
+    Jobs  = (Job*) calloc(nJobs, sizeof(Job));
+    if (Jobs == NULL) FatalError("Out of memory");
+
+    for (i=0; i < nJobs; i++)
+        Jobs[i].FileName = argv[xoptind + i];
+
+    if (nThreads > nJobs) nThreads = nJobs;
+
+    Start = Now();
+    ValidateAll();
+    Wall = Now() - Start;
+
+    // The report
+    printf("%-40s %10s  %s\n", "Profile", "ms", "Status");
+
+    for (i=0; i < nJobs; i++) {
+
+        Job* j = &Jobs[i];
+
+        if (!j ->Done) {
+            printf("%-40s %10s  skipped\n", j ->FileName, "-");
+            nSkipped++;
+            continue;
+        }
+
+        if (j ->Ok)
+            printf("%-40s %10.2f  ok (%u tags, %u warnings)\n", j ->FileName, j ->Time, j ->Report.nTags, j ->Report.nWarnings);
+        else {
+            printf("%-40s %10.2f  REJECTED [%s] %s", j ->FileName, j ->Time, AreaNames(j ->Report.Failed, Areas), j ->Report.FirstError);
+            if (j ->Report.nErrors > 1) printf(" (and %u more)", j ->Report.nErrors - 1);
+            printf("\n");
+            nRejected++;
+        }
+
+        Sum += j ->Time;
+        if (j ->Time > Slowest) Slowest = j ->Time;
+    }
+
+    printf("\n%d profiles, %d rejected, %d skipped. %d threads, %.2f ms wall clock, %.2f ms total, %.2f ms slowest\n",
+                    nJobs, nRejected, nSkipped, nThreads, Wall, Sum, Slowest);
+
+    free(Jobs);
+    return nRejected > 255 ? 255 : nRejected;
+}
@@ -0,0 +1,329 @@
+//---------------------------------------------------------------------------------
+//
+//  Little Color Management System
+//  Copyright (c) 1998-2011 Marti Maria Saguer
+//
+// Permission is hereby granted, free of charge, to any person obtaining
+// a copy of this software and associated documentation files (the "Software"),
+// to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense,
+// and/or sell copies of the Software, and to permit persons to whom the Software
+// is furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+// LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//---------------------------------------------------------------------------------
+//
+
+// Example: builds all transforms listed on a manifest by using several threads, and reports
+// how long each one took. This is what a server would do at startup to avoid stalls on first use.
+// Threads come from the library runner, _cmsRunThreads.
+//
+// Build with:
+//
+//    cc -I../../include -I../common warmicc.c ../common/xgetopt.c ../common/vprf.c -llcms2
+//
+// The manifest is a text file, one transform per line. Blank lines and lines starting with # are ignored.
+//
+//    <key> <input profile> <output profile or -> <intent> <input format> <output format> [flags]
+//
+// Profiles may be file names or *sRGB, *Lab, *Lab2, *Lab4, *XYZ. Intent is a number or one of perceptual,
+// relative, saturation, absolute. Formats are names as TYPE_RGB_8 or numbers. Flags are numbers, 0x prefix allowed.
+
+#include "utils.h"
+#include "lcms2_plugin.h"
+
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <sys/time.h>
+#endif
+
+#define MAX_THREADS     64
+#define MAX_LINE        4096
+
+// Known formats, by name
+#define FMT(x) { #x, x }
+
+static const struct {
+    const char* Name;
+    cmsUInt32Number Type;
+
+} Formats[] = {
+
+    FMT(TYPE_GRAY_8),  FMT(TYPE_GRAY_16), FMT(TYPE_GRAY_FLT), FMT(TYPE_GRAY_DBL),
+    FMT(TYPE_RGB_8),   FMT(TYPE_RGB_16),  FMT(TYPE_RGB_FLT),  FMT(TYPE_RGB_DBL),
+    FMT(TYPE_BGR_8),   FMT(TYPE_BGR_16),
+    FMT(TYPE_RGBA_8),  FMT(TYPE_RGBA_16), FMT(TYPE_RGBA_FLT),
+    FMT(TYPE_ARGB_8),  FMT(TYPE_ABGR_8),  FMT(TYPE_BGRA_8),
+    FMT(TYPE_CMYK_8),  FMT(TYPE_CMYK_16), FMT(TYPE_CMYK_FLT), FMT(TYPE_CMYK_DBL),
+    FMT(TYPE_Lab_8),   FMT(TYPE_Lab_16),  FMT(TYPE_Lab_FLT),  FMT(TYPE_Lab_DBL),
+    FMT(TYPE_XYZ_16),  FMT(TYPE_XYZ_FLT), FMT(TYPE_XYZ_DBL)
+};
+
+#undef FMT
+
+static int nThreads = 4;
+static const char* ManifestFile = NULL;
+
+static cmsHANDLE hTable = NULL;
+static double* BuildTimes = NULL;
+static cmsBool* BuildOk = NULL;
+
+
+// Wall clock in milliseconds
+static
+double Now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER Freq, Count;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Count);
+    return 1000.0 * (double) Count.QuadPart / (double) Freq.QuadPart;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+
+
+static
+cmsUInt32Number ParseFormat(const char* s)
+{
+    int i;
+
+    for (i=0; i < (int) (sizeof(Formats) / sizeof(Formats[0])); i++) {
+
+        if (cmsstrcasecmp(s, Formats[i].Name) == 0)
+            return Formats[i].Type;
+    }
+
+    if (isdigit((int) *s))
+        return (cmsUInt32Number) strtoul(s, NULL, 0);
+
+    FatalError("Unknown format '%s'", s);
+    return 0;
+}
+
+static
+cmsUInt32Number ParseIntent(const char* s)
+{
+    if (cmsstrcasecmp(s, "perceptual") == 0) return INTENT_PERCEPTUAL;
+    if (cmsstrcasecmp(s, "relative") == 0)   return INTENT_RELATIVE_COLORIMETRIC;
+    if (cmsstrcasecmp(s, "saturation") == 0) return INTENT_SATURATION;
+    if (cmsstrcasecmp(s, "absolute") == 0)   return INTENT_ABSOLUTE_COLORIMETRIC;
+
+    if (isdigit((int) *s))
+        return (cmsUInt32Number) atoi(s);
+
+    FatalError("Unknown intent '%s'", s);
+    return 0;
+}
+
+static
+char* DupStr(const char* s)
+{
+    char* p = (char*) malloc(strlen(s) + 1);
+
+    if (p == NULL) FatalError("Out of memory");
+    strcpy(p, s);
+    return p;
+}
+
+// Reads the manifest. Strings are allocated and never freed, as the table keeps its own copies
+static
+cmsTRANSFORMSPEC* ReadManifest(const char* FileName, cmsUInt32Number* nSpecs)
+{
+    FILE* fp;
+    char Line[MAX_LINE];
+    char Key[MAX_LINE], In[MAX_LINE], Out[MAX_LINE], Intent[MAX_LINE], InFmt[MAX_LINE], OutFmt[MAX_LINE], Flags[MAX_LINE];
+    cmsTRANSFORMSPEC* Specs = NULL;
+    cmsUInt32Number n = 0, Max = 0;
+    int LineNo = 0, nFields;
+
+    fp = fopen(FileName, "rt");
+    if (fp == NULL) FatalError("Cannot open '%s'", FileName);
+
+    while (fgets(Line, sizeof(Line), fp) != NULL) {
+
+        char* p = Line;
+
+        LineNo++;
+        while (isspace((int) *p)) p++;
+        if (*p == 0 || *p == '#') continue;
+
+        Flags[0] = 0;
+        nFields = sscanf(p, "%s %s %s %s %s %s %s", Key, In, Out, Intent, InFmt, OutFmt, Flags);
+        if (nFields < 6)
+            FatalError("%s:%d: expected <key> <input> <output> <intent> <input format> <output format> [flags]", FileName, LineNo);
+
+        if (n == Max) {
+
+            Max = Max ? Max * 2 : 64;
+            Specs = (cmsTRANSFORMSPEC*) realloc(Specs, Max * sizeof(cmsTRANSFORMSPEC));
+            if (Specs == NULL) FatalError("Out of memory");
+        }
+
+        Specs[n].Key           = DupStr(Key);
+        Specs[n].InputProfile  = DupStr(In);
+        Specs[n].OutputProfile = strcmp(Out, "-") == 0 ? NULL : DupStr(Out);
+        Specs[n].Intent        = ParseIntent(Intent);
+        Specs[n].InputFormat   = ParseFormat(InFmt);
+        Specs[n].OutputFormat  = ParseFormat(OutFmt);
+        Specs[n].dwFlags       = nFields > 6 ? (cmsUInt32Number) strtoul(Flags, NULL, 0) : 0;
+        n++;
+    }
+
+    fclose(fp);
+
+    *nSpecs = n;
+    return Specs;
+}
+
+
+// Each worker takes every nThreads-th entry, so no entry is built twice
+static
+void BuildEntries(int Worker)
+{
+    cmsUInt32Number i, n = cmsTransformTableCount(hTable);
+
+    for (i = (cmsUInt32Number) Worker; i < n; i += (cmsUInt32Number) nThreads) {
+
+        double t = Now();
+
+        BuildOk[i] = cmsTransformTableBuild(hTable, i);
+        BuildTimes[i] = Now() - t;
+    }
+}
+
+// The cargo of each thread is just its worker number
+static
+void WorkerThread(void* Cargo)
+{
+    BuildEntries(*(int*) Cargo);
+}
+
+static
+void BuildAll(void)
+{
+    int Workers[MAX_THREADS];
+    int i;
+
+    for (i=0; i < nThreads; i++)
+        Workers[i] = i;
+
+    _cmsRunThreads(NULL, (cmsUInt32Number) nThreads, WorkerThread, Workers, sizeof(int));
+}
+
+
+static
+void Help(void)
+{
+    fprintf(stderr, "little cms transform warm-up - v1.0 (lcms %2.2f)\n\n", LCMS_VERSION / 1000.0);
+    fprintf(stderr, "usage: warmicc [flags] <manifest>\n\n");
+    fprintf(stderr, "flags:\n\n");
+    fprintf(stderr, "%ct<n> - Number of threads (default 4, max %d)\n", SW, MAX_THREADS);
+    fprintf(stderr, "%cv<0..3> - Verbosity level\n\n", SW);
+
+    PrintBuiltins();
+    exit(0);
+}
+
+static
+void HandleSwitches(int argc, char *argv[])
+{
+    int s;
+
+    while ((s = xgetopt(argc, argv, "t:T:v:V:h:H")) != EOF) {
+
+        switch (s) {
+
+        case 't':
+        case 'T':
+            nThreads = atoi(xoptarg);
+            if (nThreads < 1 || nThreads > MAX_THREADS)
+                FatalError("Number of threads should be 1..%d", MAX_THREADS);
+            break;
+
+        case 'v':
+        case 'V':
+            Verbose = atoi(xoptarg);
+            break;
+
+        case 'h':
+        case 'H':
+        default:
+            Help();
+        }
+    }
+
+    if (argc - xoptind != 1) Help();
+    ManifestFile = argv[xoptind];
+}
+
+
+int main(int argc, char *argv[])
+{
+    cmsTRANSFORMSPEC* Specs;
+    cmsUInt32Number i, n, nFailed = 0;
+    double Start, Wall, Sum = 0, Slowest = 0;
+
+    InitUtils("warmicc");
+    HandleSwitches(argc, argv);
+
+    Specs = ReadManifest(ManifestFile, &n);
+    if (n == 0) FatalError("Empty manifest");
+
+    hTable = cmsTransformTableAlloc(NULL, Specs, n);
+    if (hTable == NULL) FatalError("Cannot create the transform table");
+
+    BuildTimes = (double*) calloc(n, sizeof(double));
+    BuildOk    = (cmsBool*) calloc(n, sizeof(cmsBool));
+    if (BuildTimes == NULL || BuildOk == NULL) FatalError("Out of memory");
+
+    if ((cmsUInt32Number) nThreads > n) nThreads = (int) n;
+
+    Start = Now();
+    BuildAll();
+    Wall = Now() - Start;
+
+    // The report
+    printf("%-32s %10s  %s\n", "Key", "ms", "Status");
+
+    for (i=0; i < n; i++) {
+
+        printf("%-32s %10.2f  %s\n", Specs[i].Key, BuildTimes[i], BuildOk[i] ? "ok" : "FAILED");
+
+        Sum += BuildTimes[i];
+        if (BuildTimes[i] > Slowest) Slowest = BuildTimes[i];
+        if (!BuildOk[i]) nFailed++;
+    }
+
+    printf("\n%u transforms, %u failed. %d threads, %.2f ms wall clock, %.2f ms total, %.2f ms slowest\n",
+                    n, nFailed, nThreads, Wall, Sum, Slowest);
+
+    // A server would keep the table and look transforms up by key from here on
+    if (Verbose > 0) {
+
+        for (i=0; i < n; i++)
+            printf("%s -> %p\n", Specs[i].Key, (void*) cmsTransformTableLookup(hTable, Specs[i].Key));
+    }
+
+    cmsTransformTableFree(hTable);
+    free(BuildTimes);
+    free(BuildOk);
+
+    return nFailed ? 1 : 0;
+}
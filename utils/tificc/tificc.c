@@ -40,6 +40,8 @@ static cmsBool GamutCheck             = FALSE;
 static cmsBool lIsDeviceLink          = FALSE;
 static cmsBool StoreAsAlpha           = FALSE;
 static cmsBool InputLabUsingICC       = FALSE;
+static int     Reduce                 = 1;       // Preview mode: output is 1/Reduce of the input size
+static cmsBool BoxFilter              = FALSE;   // Average pixels instead of picking them when reducing
 
 static int Intent                  = INTENT_PERCEPTUAL;
 static int ProofingIntent          = INTENT_PERCEPTUAL;
@@ -443,6 +445,167 @@ cleanup:
 }
 
 
+// Preview mode. Only the strips holding rows that end up in the output are
+// decoded, the others are skipped altogether, and only the reduced scanline
+// goes through the transform. Optionally, each Reduce x Reduce
+// block is averaged instead of sampled.
+
+static
+cmsFloat64Number GetSample(const unsigned char* Ptr, int Index, int nBytes)
+{
+    switch (nBytes) {
+
+    case 1: return (cmsFloat64Number) Ptr[Index];
+    case 2: return (cmsFloat64Number) ((cmsUInt16Number*) Ptr)[Index];
+    default: return (cmsFloat64Number) ((cmsFloat32Number*) Ptr)[Index];
+    }
+}
+
+static
+void PutSample(unsigned char* Ptr, int Index, int nBytes, cmsFloat64Number v)
+{
+    switch (nBytes) {
+
+    case 1: Ptr[Index] = (unsigned char) (v + 0.5); break;
+    case 2: ((cmsUInt16Number*) Ptr)[Index] = (cmsUInt16Number) (v + 0.5); break;
+    default: ((cmsFloat32Number*) Ptr)[Index] = (cmsFloat32Number) v; break;
+    }
+}
+
+static
+int ReducedXform(cmsHTRANSFORM hXForm, TIFF* in, TIFF* out, cmsUInt32Number wInput, int nPlanes)
+{
+    tsize_t StripSizeIn = TIFFStripSize(in);
+    tsize_t LineSizeIn  = TIFFScanlineSize(in);
+    tsize_t LineSizeOut = TIFFScanlineSize(out);
+    tsize_t ReducedSize;
+    ttile_t Strip, Current = -1, StripCount = TIFFNumberOfStrips(in) / nPlanes;
+    unsigned char *Strips, *BufferIn, *BufferOut, *Image;
+    cmsFloat64Number* Sums;
+    uint32 sw, sl, iml, ow, ol, x, y, Row;
+    int nBytes   = T_BYTES(wInput);
+    int nSamples = T_PLANAR(wInput) ? 1 : T_CHANNELS(wInput) + T_EXTRA(wInput);
+    int Box, nRows, nPixels, i, j, k, c;
+    cmsBool Average = BoxFilter;
+
+    TIFFGetFieldDefaulted(in,  TIFFTAG_IMAGEWIDTH,  &sw);
+    TIFFGetFieldDefaulted(in,  TIFFTAG_IMAGELENGTH, &iml);
+    TIFFGetFieldDefaulted(in,  TIFFTAG_ROWSPERSTRIP, &sl);
+    TIFFGetFieldDefaulted(out, TIFFTAG_IMAGEWIDTH,  &ow);
+    TIFFGetFieldDefaulted(out, TIFFTAG_IMAGELENGTH, &ol);
+
+    // It is possible to get infinite rows per strip
+    if (sl == 0 || sl > iml)
+        sl = iml;
+
+    // Same reduction CopyOtherTags used to size the output
+    Box = Reduce;
+    if (Box > (int) sw)  Box = (int) sw;
+    if (Box > (int) iml) Box = (int) iml;
+
+    // Signed a*b* values cannot be averaged on their encoded form
+    if (T_COLORSPACE(wInput) == PT_Lab && !InputLabUsingICC)
+        Average = FALSE;
+
+    nRows   = Average ? Box : 1;
+    nPixels = Average ? Box : 1;
+    ReducedSize = ow * nSamples * nBytes;
+
+    // One decoded strip per plane. Compressed strips cannot be entered at an
+    // arbitrary row, so strips are decoded whole, in order, and only if they
+    // hold sampled rows.
+    Strips = (unsigned char *) _TIFFmalloc(StripSizeIn * nPlanes);
+    if (!Strips) OutOfMem(StripSizeIn * nPlanes);
+
+    Sums = (cmsFloat64Number *) _TIFFmalloc(ow * nSamples * nPlanes * sizeof(cmsFloat64Number));
+    if (!Sums) OutOfMem(ow * nSamples * nPlanes * sizeof(cmsFloat64Number));
+
+    BufferIn = (unsigned char *) _TIFFmalloc(ReducedSize * nPlanes);
+    if (!BufferIn) OutOfMem(ReducedSize * nPlanes);
+
+    BufferOut = (unsigned char *) _TIFFmalloc(LineSizeOut * nPlanes);
+    if (!BufferOut) OutOfMem(LineSizeOut * nPlanes);
+
+    // Separated planes have to be written one after another, so the whole
+    // preview is kept in memory. It is Reduce * Reduce times smaller than the input.
+    Image = (unsigned char *) _TIFFmalloc(LineSizeOut * ol * nPlanes);
+    if (!Image) OutOfMem(LineSizeOut * ol * nPlanes);
+
+    for (y=0; y < ol; y++) {
+
+        memset(Sums, 0, ow * nSamples * nPlanes * sizeof(cmsFloat64Number));
+
+        for (i=0; i < nRows; i++) {
+
+            Row   = y * Box + i;
+            Strip = (ttile_t) (Row / sl);
+
+            if (Strip != Current) {
+
+                for (j=0; j < nPlanes; j++) {
+
+                    if (TIFFReadEncodedStrip(in, Strip + (j * StripCount),
+                        Strips + (j * StripSizeIn), StripSizeIn) < 0) goto cleanup;
+                }
+                Current = Strip;
+            }
+
+            for (j=0; j < nPlanes; j++) {
+
+                unsigned char* Line = Strips + j * StripSizeIn + (Row % sl) * LineSizeIn;
+                cmsFloat64Number* Sum = Sums + j * ow * nSamples;
+
+                for (x=0; x < ow; x++)
+                    for (k=0; k < nPixels; k++)
+                        for (c=0; c < nSamples; c++)
+                            Sum[x * nSamples + c] += GetSample(Line, (x * Box + k) * nSamples + c, nBytes);
+            }
+        }
+
+        for (j=0; j < nPlanes; j++) {
+
+            for (x=0; x < ow * nSamples; x++) {
+
+                cmsFloat64Number v = Sums[j * ow * nSamples + x];
+
+                if (Average) v /= (Box * Box);
+
+                PutSample(BufferIn + j * ReducedSize, x, nBytes, v);
+            }
+        }
+
+        cmsDoTransform(hXForm, BufferIn, BufferOut, ow);
+
+        for (j=0; j < nPlanes; j++)
+            memmove(Image + (j * ol + y) * LineSizeOut, BufferOut + j * LineSizeOut, LineSizeOut);
+    }
+
+    for (j=0; j < nPlanes; j++) {
+
+        for (y=0; y < ol; y++) {
+
+            if (TIFFWriteScanline(out, Image + (j * ol + y) * LineSizeOut, y, (tsample_t) j) < 0) goto cleanup;
+        }
+    }
+
+    _TIFFfree(Strips);
+    _TIFFfree(Sums);
+    _TIFFfree(BufferIn);
+    _TIFFfree(BufferOut);
+    _TIFFfree(Image);
+    return 1;
+
+cleanup:
+
+    _TIFFfree(Strips);
+    _TIFFfree(Sums);
+    _TIFFfree(BufferIn);
+    _TIFFfree(BufferOut);
+    _TIFFfree(Image);
+    return 0;
+}
+
+
 // Creates minimum required tags
 static
 void WriteOutputTags(TIFF *out, int Colorspace, int BytesPerSample)
@@ -565,6 +728,18 @@ void CopyOtherTags(TIFF* in, TIFF* out)
     TIFFGetField(in, TIFFTAG_IMAGEWIDTH, &ow);
     TIFFGetField(in, TIFFTAG_IMAGELENGTH, &ol);
 
+    if (Reduce > 1) {
+
+        // Preview mode, same reduction on both axes
+        uint32 Box = (uint32) Reduce;
+
+        if (Box > ow) Box = ow;
+        if (Box > ol) Box = ol;
+
+        ow /= Box;
+        ol /= Box;
+    }
+
     TIFFSetField(out, TIFFTAG_IMAGEWIDTH, ow);
     TIFFSetField(out, TIFFTAG_IMAGELENGTH, ol);
 
@@ -579,17 +754,30 @@ void CopyOtherTags(TIFF* in, TIFF* out)
     CopyField(TIFFTAG_ORIENTATION, shortv);
     CopyField(TIFFTAG_MINSAMPLEVALUE, shortv);
     CopyField(TIFFTAG_MAXSAMPLEVALUE, shortv);
-    CopyField(TIFFTAG_XRESOLUTION, floatv);
-    CopyField(TIFFTAG_YRESOLUTION, floatv);
-    CopyField(TIFFTAG_RESOLUTIONUNIT, shortv);
-    CopyField(TIFFTAG_ROWSPERSTRIP, longv);
+    if (Reduce > 1) {
+
+        // Keep the physical size. Preview is always written as strips
+        if (TIFFGetField(in, TIFFTAG_XRESOLUTION, &floatv)) TIFFSetField(out, TIFFTAG_XRESOLUTION, floatv / Reduce);
+        if (TIFFGetField(in, TIFFTAG_YRESOLUTION, &floatv)) TIFFSetField(out, TIFFTAG_YRESOLUTION, floatv / Reduce);
+        CopyField(TIFFTAG_RESOLUTIONUNIT, shortv);
+        TIFFSetField(out, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(out, 0));
+    }
+    else {
+
+        CopyField(TIFFTAG_XRESOLUTION, floatv);
+        CopyField(TIFFTAG_YRESOLUTION, floatv);
+        CopyField(TIFFTAG_RESOLUTIONUNIT, shortv);
+        CopyField(TIFFTAG_ROWSPERSTRIP, longv);
+    }
     CopyField(TIFFTAG_XPOSITION, floatv);
     CopyField(TIFFTAG_YPOSITION, floatv);
     CopyField(TIFFTAG_IMAGEDEPTH, longv);
     CopyField(TIFFTAG_TILEDEPTH, longv);
 
-    CopyField(TIFFTAG_TILEWIDTH,  longv);
-    CopyField(TIFFTAG_TILELENGTH, longv);
+    if (Reduce <= 1) {
+        CopyField(TIFFTAG_TILEWIDTH,  longv);
+        CopyField(TIFFTAG_TILELENGTH, longv);
+    }
 
     CopyField(TIFFTAG_ARTIST, stringv);
     CopyField(TIFFTAG_IMAGEDESCRIPTION, stringv);
@@ -796,6 +984,9 @@ int TransformImage(TIFF* in, TIFF* out, const char *cDefInpProf)
 
     wOutput  = ComputeOutputFormatDescriptor(wInput, OutputColorSpace, bps);
 
+    if (Reduce > 1 && TIFFIsTiled(in))
+        FatalError("Preview mode needs a strip based TIFF");
+
     WriteOutputTags(out, OutputColorSpace, bps);
     CopyOtherTags(in, out);
 
@@ -849,6 +1040,15 @@ int TransformImage(TIFF* in, TIFF* out, const char *cDefInpProf)
 
 
     // Handle tile by tile or strip by strip
+    if (Reduce > 1) {
+
+        if (!ReducedXform(xform, in, out, wInput, nPlanes)) {
+
+            cmsDeleteTransform(xform);
+            FatalError("Unable to write the preview image");
+        }
+    }
+    else
     if (TIFFIsTiled(in)) {
 
         TileBasedXform(xform, in, out, nPlanes);
@@ -911,6 +1111,9 @@ void Help(int level)
    
          fprintf(stderr, "%ck<0..400> - Ink-limiting in %% (CMYK only)\n", SW);       
          fprintf(stderr, "\n");
+         fprintf(stderr, "%cr<1..64> - Preview: reduce image size by this factor\n", SW);
+         fprintf(stderr, "%cx - Preview: box filter instead of subsampling\n", SW);
+         fprintf(stderr, "\n");
          fprintf(stderr, "%ch<0,1,2,3> - More help\n", SW);
          break;
 
@@ -957,7 +1160,7 @@ void HandleSwitches(int argc, char *argv[])
 {
     int s;
 
-    while ((s=xgetopt(argc,argv,"aAeEbBw:W:nNvVGgh:H:i:I:o:O:P:p:t:T:c:C:l:L:M:m:K:k:S:s:D:d:")) != EOF) {
+    while ((s=xgetopt(argc,argv,"aAeEbBw:W:nNvVGgh:H:i:I:o:O:P:p:t:T:c:C:l:L:M:m:K:k:S:s:D:d:r:R:xX")) != EOF) {
 
         switch (s) {
 
@@ -1063,6 +1266,18 @@ void HandleSwitches(int argc, char *argv[])
         case 'S': SaveEmbedded = xoptarg;
             break;
 
+        case 'r':
+        case 'R':
+            Reduce = atoi(xoptarg);
+            if (Reduce < 1 || Reduce > 64)
+                FatalError("Reduction factor must be 1..64");
+            break;
+
+        case 'x':
+        case 'X':
+            BoxFilter = TRUE;
+            break;
+
         case 'H':
         case 'h':  {
 